@@ -0,0 +1,214 @@
+"""
+ @copyright  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ @brief      Simulator throughput benchmark with the baseline comparison.
+
+ Every workload of the suite runs in the headless batch mode on every
+ enabled target. Results (MIPS, host ns per instruction, startup time and
+ peak resident memory) are written as JSON, the comparison with the stored
+ baseline flags regressions and sets non-zero exit code.
+
+ Example:
+    python3 simbench.py --app ../linuxbuild/bin/appdbg64g.exe -o new.json
+    python3 simbench.py --app ... --baseline simbench_baseline.json
+"""
+
+import argparse
+import json
+import os
+import platform
+import re
+import subprocess
+import sys
+import tempfile
+import time
+
+SCRIPT_DIR = os.path.dirname(os.path.abspath(__file__))
+
+# Metric name, report key, True when bigger value is better, absolute change
+# ignored as the measurement noise
+METRICS = [
+    ("MIPS", "mips", True, 0.0),
+    ("Startup", "startup_ms", False, 20),
+    ("Memory", "max_rss_kb", False, 1024),
+]
+
+
+def parse_report(text):
+    """Pick values from the batch runner report."""
+    res = {}
+    pat = [("startup_ms", r"Batch: startup (\d+) ms", int),
+           ("instructions", r"Instructions:\s+(\d+)", int),
+           ("wall_s", r"Wall time:\s+([\d.]+) s", float),
+           ("mips", r"MIPS:\s+([\d.]+)", float),
+           ("exit_code", r"Exit code:\s+(-?\d+)", int)]
+    for key, rexp, conv in pat:
+        m = re.search(rexp, text)
+        if m:
+            res[key] = conv(m.group(1))
+    m = re.search(r"Batch: (?!startup)(.*)", text)
+    if m:
+        res["descr"] = m.group(1).strip()
+    return res
+
+
+def run_once(app, cmd, timeout):
+    """Run the simulator, return (stdout, wait status, peak RSS in KB,
+    timeout flag)."""
+    env = dict(os.environ)
+    appdir = os.path.dirname(app)
+    env["LD_LIBRARY_PATH"] = appdir + os.pathsep + env.get("LD_LIBRARY_PATH", "")
+    with tempfile.TemporaryFile() as out:
+        proc = subprocess.Popen(cmd, cwd=appdir, env=env,
+                                stdin=subprocess.DEVNULL,
+                                stdout=out, stderr=subprocess.STDOUT)
+        # wait4() instead of wait() to get the peak RSS of this run only
+        tmo = False
+        t_end = time.time() + timeout
+        while True:
+            pid, status, usage = os.wait4(proc.pid, os.WNOHANG)
+            if pid == proc.pid:
+                break
+            if time.time() > t_end:
+                proc.kill()
+                tmo = True
+                pid, status, usage = os.wait4(proc.pid, 0)
+                break
+            time.sleep(0.05)
+        out.seek(0)
+        text = out.read().decode(errors="replace")
+    return text, status, usage.ru_maxrss, tmo
+
+
+def run_suite(args):
+    suite_dir = os.path.dirname(os.path.abspath(args.suite))
+    with open(args.suite) as f:
+        suite = json.load(f)
+    app = os.path.abspath(args.app)
+    results = []
+    for tgt in suite["Targets"]:
+        if not tgt.get("Enable", True):
+            print("skip %s: %s" % (tgt["Name"], tgt.get("Note", "disabled")))
+            continue
+        arch = tgt["Arch"]
+        for wl in suite["Workloads"]:
+            if args.only and wl["Name"] not in args.only:
+                continue
+            if arch not in wl["Elf"]:
+                continue
+            elf = os.path.join(suite_dir, wl["Elf"][arch])
+            cmd = [app, "-c", os.path.join(suite_dir, tgt["Config"]),
+                   "--batch", elf,
+                   "--exit", wl.get("Exit", "tohost"),
+                   "--steps", str(wl.get("Steps", 0))]
+            for item in tgt.get("Set", []):
+                cmd += ["--set", item]
+            for item in wl.get("Regs", {}).get(arch, []):
+                cmd += ["--reg", item]
+
+            best = None
+            for _ in range(args.repeat):
+                text, status, rss, tmo = run_once(app, cmd, args.timeout)
+                rep = parse_report(text)
+                rep["max_rss_kb"] = rss
+                rep["timeout"] = tmo
+                if os.WIFSIGNALED(status):
+                    rep["signal"] = os.WTERMSIG(status)
+                else:
+                    rep["returncode"] = os.WEXITSTATUS(status)
+                if best is None or rep.get("mips", 0) > best.get("mips", 0):
+                    best = rep
+            mips = best.get("mips", 0.0)
+            best["ns_per_instr"] = round(1000.0 / mips, 3) if mips else 0.0
+            best["target"] = tgt["Name"]
+            best["cpu"] = tgt["Cpu"]
+            best["workload"] = wl["Name"]
+            expect = wl.get("Expect", 0)
+            ok = (not best["timeout"] and "mips" in best
+                  and "signal" not in best
+                  and best.get("returncode") == expect & 0xff
+                  and best.get("exit_code") == expect)
+            best["status"] = "ok" if ok else "fail"
+            results.append(best)
+            print("%-12s %-12s %8.2f MIPS %8.3f ns/instr %6d ms %8d KB  %s"
+                  % (tgt["Name"], wl["Name"], mips, best["ns_per_instr"],
+                     best.get("startup_ms", 0), best["max_rss_kb"],
+                     best["status"]))
+            sys.stdout.flush()
+    return results
+
+
+def compare(results, baseline, tol):
+    """@return number of regressions and failures."""
+    base = {}
+    for r in baseline.get("results", []):
+        base[(r["target"], r["workload"])] = r
+    bad = 0
+    for r in results:
+        if r["status"] != "ok":
+            print("FAIL %s/%s" % (r["target"], r["workload"]))
+            bad += 1
+            continue
+        b = base.get((r["target"], r["workload"]))
+        if b is None:
+            print("new  %s/%s" % (r["target"], r["workload"]))
+            continue
+        for name, key, higher, noise in METRICS:
+            old, new = b.get(key, 0), r.get(key, 0)
+            if not old or not new:
+                continue
+            delta = 100.0 * (new - old) / old
+            worse = delta < -tol if higher else delta > tol
+            worse = worse and abs(new - old) > noise
+            if worse:
+                bad += 1
+            r.setdefault("delta", {})[key] = round(delta, 2)
+            print("%-4s %s/%s %s: %g -> %g (%+.1f%%)"
+                  % ("REGR" if worse else "ok", r["target"], r["workload"],
+                     name, old, new, delta))
+    return bad
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Simulator throughput suite")
+    parser.add_argument("--app", default=os.path.join(
+                        SCRIPT_DIR, "..", "linuxbuild", "bin", "appdbg64g.exe"),
+                        help="simulator executable")
+    parser.add_argument("--suite", default=os.path.join(SCRIPT_DIR,
+                                                        "simbench.json"))
+    parser.add_argument("-o", "--output", help="write results JSON")
+    parser.add_argument("--baseline", help="compare with stored results")
+    parser.add_argument("--tolerance", type=float, default=10.0,
+                        help="allowed degradation in percents")
+    parser.add_argument("--repeat", type=int, default=1,
+                        help="runs per workload, the fastest one is kept")
+    parser.add_argument("--timeout", type=float, default=600.0)
+    parser.add_argument("--only", nargs="*", help="workload names")
+    args = parser.parse_args()
+
+    results = run_suite(args)
+    report = {
+        "date": time.strftime("%Y-%m-%dT%H:%M:%S"),
+        "host": {"machine": platform.machine(), "system": platform.system(),
+                 "python": platform.python_version(),
+                 "cpus": os.cpu_count()},
+        "app": os.path.abspath(args.app),
+        "results": results,
+    }
+    ret = 0
+    if any(r["status"] != "ok" for r in results):
+        ret = 1
+    if args.baseline:
+        with open(args.baseline) as f:
+            if compare(results, json.load(f), args.tolerance):
+                ret = 1
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(report, f, indent=2)
+    else:
+        json.dump(report, sys.stdout, indent=2)
+        print()
+    return ret
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,186 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "batch_runner.h"
+#include "iservice.h"
+#include "coreservices/icmdexec.h"
+#include "coreservices/ielfreader.h"
+#include "coreservices/icpufunctional.h"
+#include "coreservices/iclock.h"
+#include <stdio.h>
+#include <string.h>
+
+namespace debugger {
+
+BatchRunner::BatchRunner() : IHap(HAP_All) {
+    RISCV_event_create(&eventDone_, "BatchRunner_done");
+    done_.store(false);
+    type_ = HAP_All;
+    code_ = 0;
+    descr_[0] = '\0';
+    steps_ = 0;
+    msec_ = 0;
+    ret_ = EXIT_ERROR;
+    regs_.make_list(0);
+}
+
+BatchRunner::~BatchRunner() {
+    RISCV_event_close(&eventDone_);
+}
+
+bool BatchRunner::setupConfig(AttributeType *cfg, const char *exitcond,
+                              uint64_t steps) {
+    AttributeType t1, t2, t3;
+    t1.make_string(exitcond);
+    t2.make_uint64(steps);
+    t3.make_boolean(false);
+    (*cfg)["GlobalSettings"]["GUI"].make_boolean(false);
+    setAttribute(cfg, "ConsoleServiceClass", "Enable", t3);
+    return setAttribute(cfg, 0, "ExitCondition", t1) != 0
+        && setAttribute(cfg, 0, "StepLimit", t2) != 0;
+}
+
+int BatchRunner::setAttribute(AttributeType *cfg, const char *cls,
+                              const char *name, const AttributeType &val) {
+    int ret = 0;
+    AttributeType &serv = (*cfg)["Services"];
+    for (unsigned i = 0; i < serv.size(); i++) {
+        if (cls && strcmp(serv[i]["Class"].to_string(), cls) != 0) {
+            continue;
+        }
+        AttributeType &inst = serv[i]["Instances"];
+        for (unsigned n = 0; n < inst.size(); n++) {
+            AttributeType &attr = inst[n]["Attr"];
+            for (unsigned k = 0; k < attr.size(); k++) {
+                AttributeType &item = attr[k];
+                if (item.size() < 2 || !item[0u].is_string()) {
+                    continue;
+                }
+                if (strcmp(item[0u].to_string(), name) == 0) {
+                    item[1] = val;
+                    ret++;
+                }
+            }
+        }
+    }
+    return ret;
+}
+
+void BatchRunner::hapTriggered(EHapType type, uint64_t param,
+                               const char *descr) {
+    if (type != HAP_CpuExit && type != HAP_Halt
+        && type != HAP_BreakSimulation) {
+        return;
+    }
+    // The first notification wins, exit halts the hart too
+    if (done_.exchange(true)) {
+        return;
+    }
+    type_ = type;
+    code_ = param;
+    RISCV_sprintf(descr_, sizeof(descr_), "%s", descr ? descr : "");
+    RISCV_event_set(&eventDone_);
+}
+
+uint64_t BatchRunner::totalSteps() {
+    AttributeType clocks;
+    uint64_t ret = 0;
+    RISCV_get_services_with_iface(IFACE_CPU_FUNCTIONAL, &clocks);
+    for (unsigned i = 0; i < clocks.size(); i++) {
+        IService *iserv = static_cast<IService *>(clocks[i].to_iface());
+        IClock *iclk = static_cast<IClock *>(iserv->getInterface(IFACE_CLOCK));
+        if (iclk) {
+            ret += iclk->getStepCounter();
+        }
+    }
+    return ret;
+}
+
+int BatchRunner::run(const char *elffile) {
+    AttributeType res, lst;
+    char cmd[1024];
+    ICmdExecutor *iexec = static_cast<ICmdExecutor *>(
+            RISCV_get_service_iface("cmdexec0", IFACE_CMD_EXECUTOR));
+    RISCV_get_services_with_iface(IFACE_ELFREADER, &lst);
+    if (!iexec || lst.size() == 0) {
+        printf("Error: command executor or elf-reader not found\n");
+        return EXIT_ERROR;
+    }
+    IService *iserv = static_cast<IService *>(lst[0u].to_iface());
+    IElfReader *ielf = static_cast<IElfReader *>(
+                            iserv->getInterface(IFACE_ELFREADER));
+
+    RISCV_sprintf(cmd, sizeof(cmd), "loadelf %s", elffile);
+    iexec->exec(cmd, &res, true);
+    if (ielf->loadableSectionTotal() == 0) {
+        printf("Error: no loadable sections in '%s'\n", elffile);
+        return EXIT_ERROR;
+    }
+
+    RISCV_register_hap(static_cast<IHap *>(this));
+    RISCV_get_services_with_iface(IFACE_CPU_FUNCTIONAL, &lst);
+    for (unsigned i = 0; i < lst.size(); i++) {
+        iserv = static_cast<IService *>(lst[i].to_iface());
+        RISCV_sprintf(cmd, sizeof(cmd), "%s reg npc 0x%" RV_PRI64 "x",
+                      iserv->getObjName(), ielf->entryPoint());
+        iexec->exec(cmd, &res, true);
+        for (unsigned n = 0; n < regs_.size(); n++) {
+            const char *pval = strchr(regs_[n].to_string(), '=');
+            if (!pval) {
+                continue;
+            }
+            RISCV_sprintf(cmd, sizeof(cmd), "%s reg %.*s %s",
+                          iserv->getObjName(),
+                          static_cast<int>(pval - regs_[n].to_string()),
+                          regs_[n].to_string(), pval + 1);
+            iexec->exec(cmd, &res, true);
+        }
+    }
+
+    uint64_t steps = totalSteps();
+    uint64_t t0 = RISCV_get_time_ms();
+    for (unsigned i = 0; i < lst.size(); i++) {
+        iserv = static_cast<IService *>(lst[i].to_iface());
+        RISCV_sprintf(cmd, sizeof(cmd), "%s go", iserv->getObjName());
+        iexec->exec(cmd, &res, true);
+    }
+
+    RISCV_event_wait(&eventDone_);
+    msec_ = RISCV_get_time_ms() - t0;
+    steps_ = totalSteps() - steps;
+    RISCV_unregister_hap(static_cast<IHap *>(this));
+
+    ret_ = EXIT_HALTED;
+    if (type_ == HAP_CpuExit && code_ == ~0ull) {
+        ret_ = EXIT_STEP_LIMIT;
+    } else if (type_ == HAP_CpuExit) {
+        ret_ = code_ < 256 ? static_cast<int>(code_) : 255;
+    }
+    return ret_;
+}
+
+void BatchRunner::printReport() {
+    double sec = static_cast<double>(msec_) / 1000.0;
+    printf("Batch: %s\n", descr_);
+    printf("    Instructions: %" RV_PRI64 "d\n", steps_);
+    printf("    Wall time:    %.3f s\n", sec);
+    printf("    MIPS:         %.2f\n",
+           msec_ ? static_cast<double>(steps_) / sec / 1000000.0 : 0.0);
+    printf("    Exit code:    %d\n", ret_);
+    fflush(stdout);
+}
+
+}  // namespace debugger
@@ -0,0 +1,92 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef __DEBUGGER_SRC_APPDBG64G_BATCH_RUNNER_H__
+#define __DEBUGGER_SRC_APPDBG64G_BATCH_RUNNER_H__
+
+#include "api_core.h"
+#include "ihap.h"
+#include <atomic>
+
+namespace debugger {
+
+/**
+ * Headless run of the ELF-file: the image is loaded, all harts start from
+ * its entry point and the main thread sleeps until the CPU model detects
+ * the exit condition set by the 'ExitCondition' and 'StepLimit' attributes.
+ */
+class BatchRunner : public IHap {
+ public:
+    /** Process exit codes when the program exit code isn't available */
+    static const int EXIT_STEP_LIMIT = 124;
+    static const int EXIT_HALTED = 125;
+    static const int EXIT_ERROR = 126;
+
+    BatchRunner();
+    virtual ~BatchRunner();
+
+    /**
+     * Headless configuration: no GUI, no console input thread, exit
+     * condition and step limit of all CPUs.
+     * @return false if CPUs don't support the exit detection
+     */
+    static bool setupConfig(AttributeType *cfg, const char *exitcond,
+                            uint64_t steps);
+    /**
+     * Redefine attribute value in all instances where it is defined, 'cls'
+     * limits the instances to the specified class.
+     * @return number of modified instances
+     */
+    static int setAttribute(AttributeType *cfg, const char *cls,
+                            const char *name, const AttributeType &val);
+
+    /** IHap */
+    virtual void hapTriggered(EHapType type, uint64_t param,
+                              const char *descr);
+
+    /**
+     * Registers initialized after the entry point: list of "name=value"
+     * strings, for an example stack pointer of the bare-metal application
+     * that expects the bootloader to set it.
+     */
+    void setRegisters(const AttributeType &regs) { regs_ = regs; }
+
+    /** @return process exit code */
+    int run(const char *elffile);
+    void printReport();
+
+    uint64_t getSteps() { return steps_; }
+    uint64_t getTimeMs() { return msec_; }
+    const char *getDescr() { return descr_; }
+
+ private:
+    uint64_t totalSteps();
+
+ private:
+    AttributeType regs_;
+    uint64_t steps_;
+    uint64_t msec_;
+    int ret_;
+    event_def eventDone_;
+    std::atomic<bool> done_;
+    EHapType type_;
+    uint64_t code_;
+    char descr_[256];
+};
+
+}  // namespace debugger
+
+#endif  // __DEBUGGER_SRC_APPDBG64G_BATCH_RUNNER_H__
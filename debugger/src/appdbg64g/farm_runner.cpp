@@ -0,0 +1,164 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "farm_runner.h"
+#include "batch_runner.h"
+#include "coreservices/icmdexec.h"
+#include <stdio.h>
+
+namespace debugger {
+
+FarmRunner::FarmRunner(const char *config, const char *exitcond,
+                       uint64_t steps) {
+    config_ = config;
+    exitcond_ = exitcond;
+    steps_ = steps;
+    jobRet_ = 0;
+    next_.store(0);
+    totalSteps_.store(0);
+    RISCV_mutex_init(&mutexPrint_);
+}
+
+FarmRunner::~FarmRunner() {
+    if (jobRet_) {
+        delete [] jobRet_;
+    }
+    RISCV_mutex_destroy(&mutexPrint_);
+}
+
+void FarmRunner::runWorker(void *arg) {
+    WorkerType *p = reinterpret_cast<WorkerType *>(arg);
+    p->farm->worker(p->idx);
+}
+
+void FarmRunner::worker(unsigned idx) {
+    unsigned n;
+    while ((n = next_.fetch_add(1)) < jobs_.size()) {
+        jobRet_[n] = runJob(idx, jobs_[n]);
+    }
+}
+
+int FarmRunner::runJob(unsigned idx, AttributeType &job) {
+    AttributeType cfg(cfg_);
+    AttributeType res;
+    const char *elf = job.is_list() ? job[0u].to_string() : job.to_string();
+    const char *exitcond = exitcond_;
+    uint64_t steps = steps_;
+    if (job.is_list() && job.size() > 1) {
+        exitcond = job[1].to_string();
+    }
+    if (job.is_list() && job.size() > 2) {
+        steps = job[2].to_uint64();
+    }
+
+    // Every platform owns its copy of the configuration
+    BatchRunner::setupConfig(&cfg, exitcond, steps);
+
+    char name[64];
+    RISCV_sprintf(name, sizeof(name), "farm%d", idx);
+    void *hplatform = RISCV_create_platform(name);
+    RISCV_select_platform(hplatform);
+
+    int ret = BatchRunner::EXIT_ERROR;
+    uint64_t t0 = RISCV_get_time_ms();
+    BatchRunner runner;
+    if (RISCV_set_configuration(&cfg) == 0) {
+        ICmdExecutor *iexec = static_cast<ICmdExecutor *>(
+                RISCV_get_service_iface("cmdexec0", IFACE_CMD_EXECUTOR));
+        AttributeType &initCmds = cfg["GlobalSettings"]["InitCommands"];
+        for (unsigned i = 0; iexec && initCmds.is_list()
+                             && i < initCmds.size(); i++) {
+            iexec->exec(initCmds[i].to_string(), &res, false);
+        }
+        ret = runner.run(elf);
+    }
+    RISCV_delete_platform(hplatform);
+    RISCV_select_platform(0);
+    totalSteps_.fetch_add(runner.getSteps());
+
+    RISCV_mutex_lock(&mutexPrint_);
+    printf("Farm: [%s] %s: exit %d, %" RV_PRI64 "d instr, "
+           "%" RV_PRI64 "d ms (total %" RV_PRI64 "d ms): %s\n",
+           name, elf, ret, runner.getSteps(), runner.getTimeMs(),
+           RISCV_get_time_ms() - t0, runner.getDescr());
+    fflush(stdout);
+    RISCV_mutex_unlock(&mutexPrint_);
+    return ret;
+}
+
+int FarmRunner::run(const char *jobsfile, unsigned workers) {
+    AttributeType databuf;
+    if (RISCV_read_json_file(jobsfile, &databuf) <= 0) {
+        printf("Error: can't read jobs file '%s'\n", jobsfile);
+        return BatchRunner::EXIT_ERROR;
+    }
+    jobs_.from_config(databuf.to_string());
+    if (!jobs_.is_list() || jobs_.size() == 0) {
+        printf("Error: jobs list is empty\n");
+        return BatchRunner::EXIT_ERROR;
+    }
+
+    AttributeType t1;
+    cfg_.from_config(config_);
+    // Host ports and COM-ports cannot be shared between platforms
+    t1.make_boolean(false);
+    BatchRunner::setAttribute(&cfg_, "TcpServerClass", "Enable", t1);
+    BatchRunner::setAttribute(&cfg_, "ComPortServiceClass", "Enable", t1);
+
+    jobRet_ = new int[jobs_.size()];
+    if (workers == 0) {
+        workers = 1;
+    }
+    if (workers > jobs_.size()) {
+        workers = jobs_.size();
+    }
+
+    uint64_t t0 = RISCV_get_time_ms();
+    WorkerType *w = new WorkerType[workers];
+    for (unsigned i = 0; i < workers; i++) {
+        w[i].farm = this;
+        w[i].idx = i;
+        w[i].th.func = reinterpret_cast<lib_thread_func>(runWorker);
+        w[i].th.args = &w[i];
+        w[i].th.Handle = 0;
+        RISCV_thread_create(&w[i].th);
+    }
+    for (unsigned i = 0; i < workers; i++) {
+        if (w[i].th.Handle) {
+            RISCV_thread_join(w[i].th.Handle, -1);
+        }
+    }
+    delete [] w;
+    uint64_t msec = RISCV_get_time_ms() - t0;
+
+    unsigned failed = 0;
+    for (unsigned i = 0; i < jobs_.size(); i++) {
+        if (jobRet_[i] != 0) {
+            failed++;
+        }
+    }
+    double sec = static_cast<double>(msec) / 1000.0;
+    printf("Farm: %d jobs, %d failed, %d workers\n",
+           jobs_.size(), failed, workers);
+    printf("    Instructions: %" RV_PRI64 "d\n", totalSteps_.load());
+    printf("    Wall time:    %.3f s\n", sec);
+    printf("    MIPS:         %.2f\n", msec ? static_cast<double>(
+            totalSteps_.load()) / sec / 1000000.0 : 0.0);
+    fflush(stdout);
+    return failed ? 1 : 0;
+}
+
+}  // namespace debugger
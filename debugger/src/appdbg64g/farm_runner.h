@@ -0,0 +1,72 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef __DEBUGGER_SRC_APPDBG64G_FARM_RUNNER_H__
+#define __DEBUGGER_SRC_APPDBG64G_FARM_RUNNER_H__
+
+#include "api_core.h"
+#include "attribute.h"
+#include <atomic>
+
+namespace debugger {
+
+/**
+ * Simulation farm: the queue of batch jobs is distributed between the
+ * worker threads. Every job runs on its own platform instantiated from the
+ * same target configuration, so jobs don't share services, haps and clocks.
+ *
+ * Jobs file is the JSON list: [['app.elf', 'tohost', 0], ...] where the exit
+ * condition and the step limit are optional.
+ *
+ * The configuration is parsed once and cloned for each job. The ELF-file
+ * is still read by the elf-reader of each platform (symbols belong to the
+ * platform source code service) and every hart builds its own decoder:
+ * instruction objects are bound to their CPU.
+ */
+class FarmRunner {
+ public:
+    FarmRunner(const char *config, const char *exitcond, uint64_t steps);
+    ~FarmRunner();
+
+    /** @return 0 if all jobs exited with zero code */
+    int run(const char *jobsfile, unsigned workers);
+
+ private:
+    struct WorkerType {
+        LibThreadType th;
+        FarmRunner *farm;
+        unsigned idx;
+    };
+
+    static void runWorker(void *arg);
+    void worker(unsigned idx);
+    int runJob(unsigned idx, AttributeType &job);
+
+ private:
+    const char *config_;
+    const char *exitcond_;
+    uint64_t steps_;
+    AttributeType cfg_;             // parsed once, read-only for workers
+    AttributeType jobs_;
+    int *jobRet_;
+    std::atomic<unsigned> next_;
+    std::atomic<uint64_t> totalSteps_;
+    mutex_def mutexPrint_;
+};
+
+}  // namespace debugger
+
+#endif  // __DEBUGGER_SRC_APPDBG64G_FARM_RUNNER_H__
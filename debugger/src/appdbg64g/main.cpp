@@ -19,6 +19,8 @@
 #include "coreservices/ilink.h"
 #include "coreservices/ithread.h"
 #include "coreservices/icmdexec.h"
+#include "batch_runner.h"
+#include "farm_runner.h"
 #include <stdio.h>
 #include <string>
 
@@ -40,6 +42,40 @@ const AttributeType *getConfigOfService(const AttributeType &cfg,
     return 0;
 }
 
+/**
+ * Redefine attribute of the service instance: "<instance>.<attr>=<value>",
+ * value is parsed as JSON item.
+ */
+static bool setAttributeOfInstance(AttributeType &cfg, const char *arg) {
+    char inst[256];
+    const char *pattr = strchr(arg, '.');
+    const char *pval = strchr(arg, '=');
+    if (!pattr || !pval || pattr > pval
+        || static_cast<size_t>(pattr - arg) >= sizeof(inst)) {
+        return false;
+    }
+    memcpy(inst, arg, pattr - arg);
+    inst[pattr - arg] = '\0';
+    pattr++;
+    const AttributeType *pinst = getConfigOfService(cfg, inst);
+    if (!pinst) {
+        return false;
+    }
+    AttributeType &attr = const_cast<AttributeType &>((*pinst)["Attr"]);
+    for (unsigned i = 0; i < attr.size(); i++) {
+        AttributeType &item = attr[i];
+        if (item.size() < 2 || !item[0u].is_string()) {
+            continue;
+        }
+        if (strlen(item[0u].to_string()) == static_cast<size_t>(pval - pattr)
+            && strncmp(item[0u].to_string(), pattr, pval - pattr) == 0) {
+            item[1].from_config(pval + 1);
+            return true;
+        }
+    }
+    return false;
+}
+
 int main(int argc, char* argv[]) {
     RISCV_init();
     RISCV_set_current_dir();
@@ -48,6 +84,15 @@ int main(int argc, char* argv[]) {
     AttributeType databuf;
     bool nogui = false;
     bool gui = false;
+    const char *batch = 0;
+    const char *exitcond = "tohost";
+    uint64_t steps = 0;
+    unsigned farm = 0;
+    const char *jobs = 0;
+    AttributeType setlist;
+    AttributeType reglist;
+    setlist.make_list(0);
+    reglist.make_list(0);
 
     // Parse arguments:
     if (argc > 1) {
@@ -62,6 +107,22 @@ int main(int argc, char* argv[]) {
                 nogui = true;
             } else if (strcmp(argv[i], "--gui") == 0) {
                 gui = true;
+            } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+                batch = argv[++i];
+            } else if (strcmp(argv[i], "--steps") == 0 && i + 1 < argc) {
+                steps = strtoull(argv[++i], 0, 0);
+            } else if (strcmp(argv[i], "--exit") == 0 && i + 1 < argc) {
+                exitcond = argv[++i];
+            } else if (strcmp(argv[i], "--farm") == 0 && i + 1 < argc) {
+                farm = atoi(argv[++i]);
+            } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+                jobs = argv[++i];
+            } else if (strcmp(argv[i], "--set") == 0 && i + 1 < argc) {
+                AttributeType item(argv[++i]);
+                setlist.add_to_list(&item);
+            } else if (strcmp(argv[i], "--reg") == 0 && i + 1 < argc) {
+                AttributeType item(argv[++i]);
+                reglist.add_to_list(&item);
             }
         }
     }
@@ -72,9 +133,29 @@ int main(int argc, char* argv[]) {
         printf("Example: appdbg64.exe -c ../../targets/default.json\n");
         return 0;
     }
+    uint64_t t_start = RISCV_get_time_ms();
 
     Config.from_config(databuf.to_string());
 	
+    for (unsigned i = 0; i < setlist.size(); i++) {
+        if (!setAttributeOfInstance(Config, setlist[i].to_string())) {
+            printf("Error: can't set '%s'\n", setlist[i].to_string());
+            return BatchRunner::EXIT_ERROR;
+        }
+    }
+
+    /**
+     * Farm mode: default platform isn't instantiated, every job creates
+     * its own one from the same configuration.
+     */
+    if (jobs) {
+        FarmRunner runner(Config.to_config().to_string(), exitcond, steps);
+        int ret = runner.run(jobs, farm);
+        databuf.attr_free();
+        RISCV_cleanup();
+        return ret;
+    }
+
 	/** Disable GUI using application arguments list */
     if (nogui) {
         Config["GlobalSettings"]["GUI"].make_boolean(false);
@@ -82,6 +163,17 @@ int main(int argc, char* argv[]) {
         Config["GlobalSettings"]["GUI"].make_boolean(true);
     }
 
+    /**
+     * Batch mode: no GUI and no console input thread that polls stdin,
+     * CPU models stop on the exit condition.
+     */
+    if (batch) {
+        if (!BatchRunner::setupConfig(&Config, exitcond, steps)) {
+            printf("Error: CPU 'ExitCondition' or 'StepLimit' not defined\n");
+            return BatchRunner::EXIT_ERROR;
+        }
+    }
+
     /** Redefine TCP port value using application arguments list. It is useful
 	 *  in a case of several Simulator instances running at the same time and
 	 *  controlled remotely from the python scripts.
@@ -123,6 +215,21 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    if (batch) {
+        BatchRunner runner;
+        runner.setRegisters(reglist);
+        printf("Batch: startup %" RV_PRI64 "d ms\n",
+               RISCV_get_time_ms() - t_start);
+        int ret = runner.run(batch);
+        runner.printReport();
+        // Dispatcher returns immediately when the core is already exiting
+        RISCV_break_simulation();
+        RISCV_dispatcher_start();
+        databuf.attr_free();
+        RISCV_cleanup();
+        return ret;
+    }
+
     /** Main loop */
     RISCV_dispatcher_start();
     databuf.attr_free();
@@ -54,6 +54,29 @@ int RISCV_init();
  */
 void RISCV_cleanup();
 
+/**
+ * @brief Create isolated platform (farm mode).
+ * @details Platform has its own services namespace, haps, log and default
+ *          clock while classes and plugins are shared. It becomes the
+ *          current platform after RISCV_select_platform(), then the
+ *          configuration methods and lookups apply to it only.
+ * @param [in] name Unique namespace of the platform services.
+ * @return Platform handle.
+ */
+void *RISCV_create_platform(const char *name);
+
+/**
+ * @brief Select platform of the calling thread.
+ * @details Threads created by RISCV_thread_create() inherit the platform of
+ *          their parent. NULL selects the default platform.
+ */
+void RISCV_select_platform(void *hplatform);
+
+/**
+ * @brief Stop threads, delete services and free the platform.
+ */
+void RISCV_delete_platform(void *hplatform);
+
 /** 
  * @brief Set core library configuration.
  * @details Configuration specify all instantiated services and interconnect
@@ -73,99 +73,262 @@ void AsyncTQueueType::initProc() {
 
 /** Clock queue */
 ClockAsyncTQueueType::ClockAsyncTQueueType() {
-    size_ = 1;
-    queue_ = new StepQueueItemType[size_];
+    size_ = 16;
+    item_ = new StepQueueItemType[size_];
+    heap_ = new int[size_];
+    prequeue_ = 0;
 
     RISCV_mutex_init(&mutex_);
     hardReset();
 }
 
 ClockAsyncTQueueType::~ClockAsyncTQueueType() {
+    PreQueueItemType *p = prequeue_.exchange(0);
+    while (p) {
+        PreQueueItemType *pnext = p->next;
+        delete p;
+        p = pnext;
+    }
     RISCV_mutex_destroy(&mutex_);
-    delete [] queue_;
+    delete [] item_;
+    delete [] heap_;
 }
 
 void ClockAsyncTQueueType::hardReset() {
-    item_total_ = 0;
-    precnt_ = 0;
-    item_cnt_ = 0;
-}
-
-
-void ClockAsyncTQueueType::put(uint64_t time, IFace *cb) {
     RISCV_mutex_lock(&mutex_);
-    if (precnt_ >= 1024) {
-        RISCV_mutex_unlock(&mutex_);
-        RISCV_printf(0, 0, "clock pre-queue overflow: %d", precnt_);
-        return;
+    drainPreQueued();
+    heap_total_ = 0;
+    free_ = 0;
+    for (int i = 0; i < size_; i++) {
+        item_[i].hnext = i + 1;
     }
-    prequeue_[precnt_].left = 0;
-    prequeue_[precnt_].right = 0;
-    prequeue_[precnt_].time = time;
-    prequeue_[precnt_++].iface = cb;
+    item_[size_ - 1].hnext = -1;
+    for (int i = 0; i < HASH_SIZE; i++) {
+        hash_[i] = -1;
+    }
+    next_time_ = ~0ull;
     RISCV_mutex_unlock(&mutex_);
 }
 
+void ClockAsyncTQueueType::put(uint64_t time, IFace *cb) {
+    PreQueueItemType *p = new PreQueueItemType;
+    p->time = time;
+    p->iface = cb;
+    p->next = prequeue_.load();
+    while (!prequeue_.compare_exchange_weak(p->next, p)) {}
+
+    // Must follow the list insertion, see updateNextTime()
+    uint64_t t = next_time_.load();
+    while (time < t && !next_time_.compare_exchange_weak(t, time)) {}
+}
+
 bool ClockAsyncTQueueType::move(IFace *cb, uint64_t time) {
+    bool ret = false;
     RISCV_mutex_lock(&mutex_);
-    for (int i = 0; i < precnt_; i++) {
-        if (prequeue_[i].iface == cb) {
-            prequeue_[i].time = time;
-            RISCV_mutex_unlock(&mutex_);
-            return true;
+    drainPreQueued();
+    int idx = hashFind(cb);
+    if (idx >= 0) {
+        uint64_t prev = item_[idx].time;
+        item_[idx].time = time;
+        if (time < prev) {
+            heapUp(item_[idx].pos);
+        } else {
+            heapDown(item_[idx].pos);
         }
+        updateNextTime();
+        ret = true;
     }
-    for (int i = 0; i < item_total_; i++) {
-        if (queue_[i].iface == cb) {
-            queue_[i].time = time;
-            RISCV_mutex_unlock(&mutex_);
-            return true;
-        }
+    RISCV_mutex_unlock(&mutex_);
+    return ret;
+}
+
+bool ClockAsyncTQueueType::remove(IFace *cb) {
+    bool ret = false;
+    RISCV_mutex_lock(&mutex_);
+    drainPreQueued();
+    int idx = hashFind(cb);
+    if (idx >= 0) {
+        hashRemove(idx);
+        heapRemove(item_[idx].pos);
+        freeItem(idx);
+        updateNextTime();
+        ret = true;
     }
     RISCV_mutex_unlock(&mutex_);
-    return false;
+    return ret;
 }
 
 void ClockAsyncTQueueType::pushPreQueued() {
-    if (precnt_ == 0) {
+    if (prequeue_.load(std::memory_order_relaxed) == 0) {
         return;
     }
     RISCV_mutex_lock(&mutex_);
-    while ((precnt_ + item_total_) > size_) {
+    drainPreQueued();
+    RISCV_mutex_unlock(&mutex_);
+}
+
+IFace *ClockAsyncTQueueType::getNext(uint64_t step_cnt) {
+    IFace *ret = 0;
+    RISCV_mutex_lock(&mutex_);
+    if (heap_total_ && item_[heap_[0]].time <= step_cnt) {
+        int idx = heap_[0];
+        ret = item_[idx].iface;
+        hashRemove(idx);
+        heapRemove(0);
+        freeItem(idx);
+    } else {
+        // Callbacks registered during processing will be handled on the
+        // next step even if they are already expired.
+        updateNextTime();
+    }
+    RISCV_mutex_unlock(&mutex_);
+    return ret;
+}
+
+/** Move lock-free registered items into the heap, mutex must be locked */
+int ClockAsyncTQueueType::getTotal() {
+    pushPreQueued();
+    return heap_total_;
+}
+
+void ClockAsyncTQueueType::getItem(int idx, uint64_t *time, IFace **cb) {
+    *time = item_[heap_[idx]].time;
+    *cb = item_[heap_[idx]].iface;
+}
+
+void ClockAsyncTQueueType::drainPreQueued() {
+    PreQueueItemType *p = prequeue_.exchange(0);
+    PreQueueItemType *fifo = 0;
+    PreQueueItemType *pnext;
+    // Restore registration order to keep equal time callbacks ordered
+    while (p) {
+        pnext = p->next;
+        p->next = fifo;
+        fifo = p;
+        p = pnext;
+    }
+    while (fifo) {
+        int idx = allocItem();
+        unsigned key = hashKey(fifo->iface);
+        item_[idx].time = fifo->time;
+        item_[idx].iface = fifo->iface;
+        item_[idx].hnext = hash_[key];
+        hash_[key] = idx;
+        item_[idx].pos = heap_total_;
+        heap_[heap_total_++] = idx;
+        heapUp(heap_total_ - 1);
+
+        pnext = fifo->next;
+        delete fifo;
+        fifo = pnext;
+    }
+}
+
+/**
+ * Store the earliest time, mutex must be locked. Concurrent put() decreases
+ * the time only after its item became visible in the list, so the loop
+ * cannot lose an earlier deadline.
+ */
+void ClockAsyncTQueueType::updateNextTime() {
+    do {
+        drainPreQueued();
+        next_time_ = heap_total_ ? item_[heap_[0]].time : ~0ull;
+    } while (prequeue_.load() != 0);
+}
+
+int ClockAsyncTQueueType::allocItem() {
+    if (free_ < 0) {
         int t1 = 2*size_;
         StepQueueItemType *p1 = new StepQueueItemType[t1];
-        memcpy(p1, queue_, item_total_*sizeof(StepQueueItemType));
-        delete [] queue_;
-        queue_ = p1;
+        int *h1 = new int[t1];
+        memcpy(p1, item_, size_*sizeof(StepQueueItemType));
+        memcpy(h1, heap_, size_*sizeof(int));
+        delete [] item_;
+        delete [] heap_;
+        item_ = p1;
+        heap_ = h1;
+        for (int i = size_; i < t1; i++) {
+            item_[i].hnext = i + 1;
+        }
+        item_[t1 - 1].hnext = -1;
+        free_ = size_;
         size_ = t1;
     }
-    memcpy(&queue_[item_total_], prequeue_, precnt_*sizeof(StepQueueItemType));
-    item_total_ += precnt_;
-    precnt_ = 0;
-    RISCV_mutex_unlock(&mutex_);
+    int ret = free_;
+    free_ = item_[ret].hnext;
+    return ret;
 }
 
+void ClockAsyncTQueueType::freeItem(int idx) {
+    item_[idx].hnext = free_;
+    free_ = idx;
+}
 
-IFace *ClockAsyncTQueueType::getNext(uint64_t step_cnt) {
-    IFace *ret = 0;
-    if (item_cnt_ >= item_total_) {
-        return ret;
-    }
-    for (; item_cnt_ < item_total_; item_cnt_++) {
-        if (step_cnt < queue_[item_cnt_].time) {
-            continue;
+void ClockAsyncTQueueType::heapUp(int pos) {
+    int idx = heap_[pos];
+    uint64_t t = item_[idx].time;
+    while (pos > 0) {
+        int parent = (pos - 1) >> 1;
+        if (item_[heap_[parent]].time <= t) {
+            break;
         }
-        ret = queue_[item_cnt_].iface;
+        heap_[pos] = heap_[parent];
+        item_[heap_[pos]].pos = pos;
+        pos = parent;
+    }
+    heap_[pos] = idx;
+    item_[idx].pos = pos;
+}
 
-        // remove item from list using swap function to avoid usage
-        // of allocation/deallocation calls.
-        if (item_cnt_ < (item_total_ - 1)) {
-            queue_[item_cnt_] = queue_[item_total_ - 1];
+void ClockAsyncTQueueType::heapDown(int pos) {
+    int idx = heap_[pos];
+    uint64_t t = item_[idx].time;
+    int child;
+    while ((child = 2*pos + 1) < heap_total_) {
+        if (child + 1 < heap_total_
+            && item_[heap_[child + 1]].time < item_[heap_[child]].time) {
+            child++;
+        }
+        if (t <= item_[heap_[child]].time) {
+            break;
         }
-        item_total_--;
-        break;
+        heap_[pos] = heap_[child];
+        item_[heap_[pos]].pos = pos;
+        pos = child;
     }
-    return ret;
+    heap_[pos] = idx;
+    item_[idx].pos = pos;
+}
+
+void ClockAsyncTQueueType::heapRemove(int pos) {
+    heap_total_--;
+    if (pos == heap_total_) {
+        return;
+    }
+    uint64_t t = item_[heap_[pos]].time;
+    heap_[pos] = heap_[heap_total_];
+    item_[heap_[pos]].pos = pos;
+    if (item_[heap_[pos]].time < t) {
+        heapUp(pos);
+    } else {
+        heapDown(pos);
+    }
+}
+
+int ClockAsyncTQueueType::hashFind(IFace *cb) {
+    int idx = hash_[hashKey(cb)];
+    while (idx >= 0 && item_[idx].iface != cb) {
+        idx = item_[idx].hnext;
+    }
+    return idx;
+}
+
+void ClockAsyncTQueueType::hashRemove(int idx) {
+    int *pidx = &hash_[hashKey(item_[idx].iface)];
+    while (*pidx != idx) {
+        pidx = &item_[*pidx].hnext;
+    }
+    *pidx = item_[idx].hnext;
 }
 
 
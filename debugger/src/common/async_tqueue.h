@@ -20,6 +20,7 @@
 #include <api_types.h>
 #include <iface.h>
 #include <attribute.h>
+#include <atomic>
 
 namespace debugger {
 
@@ -51,6 +52,12 @@ class AsyncTQueueType {
 };
 
 
+/**
+ * Clock events queue: indexed binary min-heap ordered by time with the
+ * callbacks hash for the move/remove requests. Registration from any thread
+ * is lock-free and unbounded, the earliest time is cached so that the owner
+ * checks the queue only when the deadline is reached.
+ */
 class ClockAsyncTQueueType {
  public:
     ClockAsyncTQueueType();
@@ -59,37 +66,70 @@ class ClockAsyncTQueueType {
     /** Power ON/OFF cycle */
     void hardReset();
 
-    /** Thread safe method of the callbacks registration */
+    /** Thread safe lock-free method of the callbacks registration */
     void put(uint64_t time, IFace *cb);
 
     /** push registered to the main queue */
     void pushPreQueued();
 
-    /** Reset proccessed counter at the begining of each iteration */
-    void initProc() { item_cnt_ = 0; }
-
     /** move previously regsiterd callbacks: true: moved; false: not found */
     bool move(IFace *cb, uint64_t time);
 
+    /** remove previously registered callback: true: removed; false: not found */
+    bool remove(IFace *cb);
+
     /**
      * Get next registered interface with counter less or equal to 'step_cnt'
      */
     IFace *getNext(uint64_t step_cnt);
 
+    /** Registered callbacks for the checkpoints, owner thread only */
+    int getTotal();
+    void getItem(int idx, uint64_t *time, IFace **cb);
+
+    /** Earliest registered time (could be less than actual after move) */
+    uint64_t getNextTime() {
+        return next_time_.load(std::memory_order_relaxed);
+    }
+
  private:
+    void drainPreQueued();
+    void updateNextTime();
+    int allocItem();
+    void freeItem(int idx);
+    void heapUp(int pos);
+    void heapDown(int pos);
+    void heapRemove(int pos);
+    int hashFind(IFace *cb);
+    void hashRemove(int idx);
+    unsigned hashKey(IFace *cb) {
+        uintptr_t t = reinterpret_cast<uintptr_t>(cb);
+        return static_cast<unsigned>((t >> 4) ^ (t >> 12)) & (HASH_SIZE - 1);
+    }
+
+ private:
+    static const int HASH_SIZE = 256;
+
+    // Lock-free list of registered but not yet queued callbacks
+    struct PreQueueItemType {
+        PreQueueItemType *next;
+        uint64_t time;
+        IFace *iface;
+    };
     struct StepQueueItemType {
-        StepQueueItemType *left;
-        StepQueueItemType *right;
         uint64_t time;
         IFace *iface;
+        int pos;        // index in heap_
+        int hnext;      // hash chain or free list
     };
-    StepQueueItemType *queue_;
+    std::atomic<PreQueueItemType *> prequeue_;
+    StepQueueItemType *item_;
+    int *heap_;
     int size_;
-    int item_total_;
-    int item_cnt_;
-
-    int precnt_;
-    StepQueueItemType prequeue_[1024];
+    int heap_total_;
+    int free_;
+    int hash_[HASH_SIZE];
+    std::atomic<uint64_t> next_time_;
 
     mutex_def mutex_;
 };
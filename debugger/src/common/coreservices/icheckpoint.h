@@ -0,0 +1,148 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+
+#include <inttypes.h>
+#include <string.h>
+#include <iface.h>
+
+namespace debugger {
+
+static const char *const IFACE_CHECKPOINT = "ICheckpoint";
+
+/**
+ * Memory page of the checkpoint. Pages not modified between checkpoints
+ * are shared (copy-on-write), so that the in-process snapshot copies only
+ * pages written since the previous save or restore.
+ */
+class CheckpointPageType {
+ public:
+    static const int PAGE_BITS = 12;
+    static const uint64_t PAGE_SIZE = 1ull << PAGE_BITS;
+
+    CheckpointPageType() : refcnt_(1) {}
+
+    void addRef() { refcnt_++; }
+    void release() {
+        if (--refcnt_ == 0) {
+            delete this;
+        }
+    }
+
+    uint8_t data[PAGE_SIZE];
+
+ private:
+    int refcnt_;        // accessed only while the platform is halted
+};
+
+/**
+ * Saved state of one service: raw registers stream and optional memory
+ * pages (zero pointer means zero filled page).
+ */
+class CheckpointState {
+ public:
+    CheckpointState() : buf_(0), size_(0), bufsz_(0), rdpos_(0),
+        pages_(0), pageTotal_(0), local_(true) {}
+    ~CheckpointState() {
+        setPages(0, 0);
+        if (buf_) {
+            delete [] buf_;
+        }
+    }
+
+    void write(const void *p, uint64_t sz) {
+        if (size_ + sz > bufsz_) {
+            uint64_t nsz = 2*bufsz_ > size_ + sz ? 2*bufsz_ : size_ + sz;
+            uint8_t *t = new uint8_t[nsz];
+            if (buf_) {
+                memcpy(t, buf_, size_);
+                delete [] buf_;
+            }
+            buf_ = t;
+            bufsz_ = nsz;
+        }
+        memcpy(&buf_[size_], p, sz);
+        size_ += sz;
+    }
+    void write64(uint64_t v) { write(&v, sizeof(v)); }
+
+    /** @return false when the stream is over */
+    bool read(void *p, uint64_t sz) {
+        if (rdpos_ + sz > size_) {
+            memset(p, 0, sz);
+            return false;
+        }
+        memcpy(p, &buf_[rdpos_], sz);
+        rdpos_ += sz;
+        return true;
+    }
+    uint64_t read64() {
+        uint64_t v;
+        read(&v, sizeof(v));
+        return v;
+    }
+
+    void rewind() { rdpos_ = 0; }
+    const uint8_t *data() { return buf_; }
+    uint64_t size() { return size_; }
+
+    /** Takes ownership of the page references */
+    void setPages(CheckpointPageType **pages, uint64_t total) {
+        for (uint64_t i = 0; i < pageTotal_; i++) {
+            if (pages_[i]) {
+                pages_[i]->release();
+            }
+        }
+        if (pages_) {
+            delete [] pages_;
+        }
+        pages_ = pages;
+        pageTotal_ = total;
+    }
+    CheckpointPageType **pages() { return pages_; }
+    uint64_t pageTotal() { return pageTotal_; }
+
+    /** State was taken in this process, not read from file */
+    bool isLocal() { return local_; }
+    void setLocal(bool v) { local_ = v; }
+
+ private:
+    uint8_t *buf_;
+    uint64_t size_;
+    uint64_t bufsz_;
+    uint64_t rdpos_;
+    CheckpointPageType **pages_;
+    uint64_t pageTotal_;
+    bool local_;
+};
+
+/**
+ * Architectural state save/restore. Methods are called from the commands
+ * thread while all harts are halted or from the thread of the single hart
+ * between the instructions (reverse execution history).
+ */
+class ICheckpoint : public IFace {
+ public:
+    ICheckpoint() : IFace(IFACE_CHECKPOINT) {}
+
+    virtual void saveState(CheckpointState *state) = 0;
+
+    /** @return false if the state doesn't match the service configuration */
+    virtual bool restoreState(CheckpointState *state) = 0;
+};
+
+}  // namespace debugger
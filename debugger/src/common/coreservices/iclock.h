@@ -33,6 +33,18 @@ class IClockListener : public IFace {
 };
 
 
+static const char *const IFACE_CLOCK_INPUT = "IClockInput";
+
+/** Device receiving data from outside of the simulated platform */
+class IClockInput : public IFace {
+ public:
+    IClockInput() : IFace(IFACE_CLOCK_INPUT) {}
+
+    /** Called by the clock owner on the step the input is accepted */
+    virtual void clockInput(const char *buf, int sz) = 0;
+};
+
+
 static const char *const IFACE_CLOCK = "IClock";
 
 class IClock : public IFace {
@@ -53,6 +65,19 @@ class IClock : public IFace {
     virtual bool moveStepCallback(IClockListener *cb, uint64_t t) = 0;
 
     virtual double getFreqHz() = 0;
+
+    /** Asynchronous input from another thread. Clock could deliver it on
+     *  a step boundary to make the simulation reproducible, by default the
+     *  data is passed immediately.
+     */
+    virtual void postInput(IClockInput *dev, const char *buf, int sz) {
+        dev->clockInput(buf, sz);
+    }
+
+    /** Re-execution of the already recorded history, devices shouldn't
+     *  repeat the output to the outside world.
+     */
+    virtual bool isReplay() { return false; }
 };
 
 }  // namespace debugger
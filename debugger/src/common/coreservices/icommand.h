@@ -64,8 +64,12 @@ class ICommand : public IFace {
         if (!ibus_) {
             return ret;
         }
+        if (dma_burst(MemAction_Read, addr, sz, payload) == TRANS_OK) {
+            return TRANS_OK;
+        }
         Axi4TransactionType tr;
         tr.action = MemAction_Read;
+        tr.source_idx = -1;
         tr.addr = addr;
         uint32_t bytecnt = 0;
         while (bytecnt < sz) {
@@ -93,8 +97,12 @@ class ICommand : public IFace {
         if (!ibus_) {
             return ret;
         }
+        if (dma_burst(MemAction_Write, addr, sz, payload) == TRANS_OK) {
+            return TRANS_OK;
+        }
         Axi4TransactionType tr;
         tr.action = MemAction_Write;
+        tr.source_idx = -1;
         tr.addr = addr;
         uint32_t bytecnt = 0;
         while (bytecnt < sz) {
@@ -119,6 +127,31 @@ class ICommand : public IFace {
         return ret;
     }
 
+ protected:
+    /**
+     * Memories copy the whole range at once. Devices behind SystemC (DMI)
+     * answer only on nb_transport and fail here, so that the caller
+     * repeats the access beat by beat.
+     */
+    ETransStatus dma_burst(EAxi4Action action, uint64_t addr, uint32_t sz,
+                           uint8_t *payload) {
+        Axi4BurstType burst;
+        burst.action = action;
+        burst.source_idx = -1;      // debugger isn't a bus master
+        while (sz) {
+            burst.addr = addr;
+            burst.buf = payload;
+            burst.size = sz < BURST_MAX_BYTES ? sz : BURST_MAX_BYTES;
+            if (ibus_->b_burst(&burst) != TRANS_OK) {
+                return TRANS_ERROR;
+            }
+            addr += burst.size;
+            payload += burst.size;
+            sz -= burst.size;
+        }
+        return TRANS_OK;
+    }
+
  protected:
     AttributeType cmdName_;
     AttributeType briefDescr_;
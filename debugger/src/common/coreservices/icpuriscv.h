@@ -42,9 +42,10 @@ public:
     virtual uint64_t readNonStandardReg(uint32_t regno) = 0;
     virtual void writeNonStandardReg(uint32_t regno, uint64_t val) = 0;
 
-    // atomic instruction LR/SC reservation
-    virtual void mmuAddrReserve(uint64_t addr) = 0;
-    virtual bool mmuAddrRelease(uint64_t addr) = 0;
+    // atomic instruction LR/SC reservation, value is the loaded data that
+    // SC compares with memory content before the store
+    virtual void mmuAddrReserve(uint64_t addr, uint64_t value) = 0;
+    virtual bool mmuAddrRelease(uint64_t addr, uint64_t *value) = 0;
 
     enum ERiscvRegNames {
         Reg_Zero,
@@ -218,6 +219,18 @@ public:
     static const uint16_t CSR_mtvec          = 0x305;
     /** Scratch register for machine trap handlers. */
     static const uint16_t CSR_mscratch       = 0x340;
+    /** Supervisor status register, restricted view of mstatus */
+    static const uint16_t CSR_sstatus        = 0x100;
+    /** Supervisor interrupt enable, delegated bits of mie */
+    static const uint16_t CSR_sie            = 0x104;
+    /** The base address of the S-mode trap vector. */
+    static const uint16_t CSR_stvec          = 0x105;
+    /** Scratch register for supervisor trap handlers. */
+    static const uint16_t CSR_sscratch       = 0x140;
+    /** Supervisor trap cause */
+    static const uint16_t CSR_scause         = 0x142;
+    /** Supervisor bad address or instruction. */
+    static const uint16_t CSR_stval          = 0x143;
     /** Exception program counters. */
     static const uint16_t CSR_uepc           = 0x041;
     static const uint16_t CSR_sepc           = 0x141;
@@ -40,6 +40,8 @@ class IElfReader : public IFace {
     virtual uint64_t sectionSize(unsigned idx) = 0;
 
     virtual uint8_t *sectionData(unsigned idx) = 0;
+
+    virtual uint64_t entryPoint() = 0;
 };
 
 }  // namespace debugger
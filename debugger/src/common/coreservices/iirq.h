@@ -17,6 +17,7 @@
 #pragma once
 
 #include <inttypes.h>
+#include <atomic>
 #include <iface.h>
 
 namespace debugger {
@@ -38,6 +39,23 @@ static const int IRQ_REQUEST_NONE = 0;
 //   HART1_TIMER_IRQ = 3
 //   etc
 
+// Bit of the CPU pending mask owned by the interrupt controller context
+struct IrqPendingBitType {
+    std::atomic<uint64_t> *pmask;
+    uint64_t bit;
+
+    void setLevel(bool level) {
+        if (!pmask) {
+            return;
+        }
+        if (level) {
+            pmask->fetch_or(bit);
+        } else {
+            pmask->fetch_and(~bit);
+        }
+    }
+};
+
 class IIrqController : public IFace {
  public:
     IIrqController() : IFace(IFACE_IRQ_CONTROLLER) {}
@@ -49,6 +67,15 @@ class IIrqController : public IFace {
     // prioiry and enabled for context. Called by CPU.
     // @ret IRQ_REQUEST_NONE if no requests
     virtual int getPendingRequest(int ctxid) = 0;
+
+    // Subscribe CPU on the request level changes instead of polling.
+    // Bit 'bitidx' of the '*pmask' must be set while getPendingRequest(ctxid)
+    // could return non-zero value, the CPU confirms request by polling.
+    // @ret false if the controller doesn't support notification
+    virtual bool registerPendingMask(int ctxid, std::atomic<uint64_t> *pmask,
+                                     int bitidx) {
+        return false;
+    }
 };
 
 }  // namespace debugger
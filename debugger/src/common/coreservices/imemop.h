@@ -18,17 +18,22 @@
 #define __DEBUGGER_IMEMOP_PLUGIN_H__
 
 #include <inttypes.h>
+#include <string.h>
+#include <atomic>
 #include <iface.h>
 #include <attribute.h>
 
 namespace debugger {
 class IService;
+class ReservationTable;
+class CheckpointState;
 
 static const char *const IFACE_MEMORY_OPERATION = "IMemoryOperation";
 static const char *const IFACE_AXI4_NB_RESPONSE = "IAxi4NbResponse";
 static const char *const IFACE_ADDRESS_TRANSLATOR = "IAddressTranslator";
 
 static const int PAYLOAD_MAX_BYTES = 8;
+static const int BURST_MAX_BYTES = 4096;    // one page
 
 enum EAxi4Action {
     MemAction_Read,
@@ -62,6 +67,31 @@ typedef struct Axi4TransactionType {
     int source_idx;             // Need for bus utilization statistic
 } Axi4TransactionType;
 
+/**
+ * Burst transaction: continuous range of the bus addresses copied from or
+ * into the host buffer. Length is limited by BURST_MAX_BYTES instead of the
+ * payload width.
+ */
+typedef struct Axi4BurstType {
+    EAxi4Action action;
+    uint64_t addr;
+    uint32_t size;              // [Bytes]
+    uint8_t *buf;               // host buffer of 'size' bytes
+    int source_idx;
+} Axi4BurstType;
+
+/**
+ * Host memory range of the RAM-backed device that could be accessed
+ * directly without transaction.
+ */
+typedef struct HostMemoryRangeType {
+    uint64_t addr;              // bus address of the first byte
+    uint64_t size;              // [Bytes]
+    uint8_t *ptr;               // host pointer of the first byte
+    bool readonly;
+    uint8_t *dirty;             // 4 KB pages flags set on direct write or 0
+} HostMemoryRangeType;
+
 /**
  * Non-blocking memory access response interface (Initiator/Master)
  */
@@ -113,6 +143,84 @@ class IMemoryOperation : public IFace {
         return ret;
     }
 
+    /**
+     * Blocking burst transaction
+     *
+     * Default implementation splits the burst into the aligned beats of
+     * PAYLOAD_MAX_BYTES. Memories copy the whole range at once.
+     */
+    virtual ETransStatus b_burst(Axi4BurstType *burst) {
+        Axi4TransactionType tr;
+        ETransStatus ret = TRANS_OK;
+        uint32_t off = 0;
+        tr.action = burst->action;
+        tr.source_idx = burst->source_idx;
+        while (off < burst->size) {
+            tr.addr = burst->addr + off;
+            tr.xsize = PAYLOAD_MAX_BYTES
+                     - static_cast<uint32_t>(tr.addr & (PAYLOAD_MAX_BYTES - 1));
+            if (tr.xsize > burst->size - off) {
+                tr.xsize = burst->size - off;
+            }
+            tr.wstrb = 0;
+            if (tr.action == MemAction_Write) {
+                tr.wstrb = (1u << tr.xsize) - 1;
+                memcpy(tr.wpayload.b8, &burst->buf[off], tr.xsize);
+            }
+            if (b_transport(&tr) != TRANS_OK) {
+                ret = TRANS_ERROR;
+            }
+            if (tr.action == MemAction_Read) {
+                memcpy(&burst->buf[off], tr.rpayload.b8, tr.xsize);
+            }
+            off += tr.xsize;
+        }
+        return ret;
+    }
+
+    /**
+     * Direct access to the device memory
+     *
+     * Device backed by the plain host memory (without side effects on
+     * access) may return the host pointer of the range containing the
+     * address. Default implementation requires transport.
+     */
+    virtual bool getHostMemory(uint64_t addr, HostMemoryRangeType *range) {
+        return false;
+    }
+
+    /**
+     * Counter incremented each time the address map is replaced. Masters
+     * caching the getHostMemory() pointers drop them when it changes.
+     * Default implementation never remaps (0 pointer).
+     */
+    virtual const std::atomic<uint32_t> *getMapGeneration() { return 0; }
+
+    /**
+     * Bus doesn't serialize transactions of different masters. Device with
+     * the state shared between registers (FIFOs, state machines) that
+     * doesn't lock it itself returns true and the bus serializes all
+     * accesses to it.
+     */
+    virtual bool isSerialized() { return false; }
+
+    /**
+     * LR/SC reservations shared by all masters of the bus. Default
+     * implementation doesn't track stores of other masters.
+     */
+    virtual ReservationTable *getReservationTable() { return 0; }
+
+    /**
+     * Registers content for the checkpoints, stored and loaded without
+     * access side effects. Default implementation has no state.
+     */
+    virtual void saveRegisters(CheckpointState *state) {}
+    virtual void restoreRegisters(CheckpointState *state) {}
+
+    /**
+     * Base address and length must be fixed before HAP_ConfigDone: buses
+     * compile their address maps once on this hap.
+     */
     virtual uint64_t getBaseAddress() { return baseAddress_.to_uint64(); }
     virtual void setBaseAddress(uint64_t addr) {
         baseAddress_.make_uint64(addr);
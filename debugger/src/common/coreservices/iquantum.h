@@ -0,0 +1,54 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+
+#include <inttypes.h>
+#include <iface.h>
+#include <iservice.h>
+
+namespace debugger {
+
+static const char *const IFACE_QUANTUM_SYNC = "IQuantumSync";
+
+/**
+ * Time window synchronization of the harts running in separate threads.
+ * Each hart executes up to the end of the current window (quantum) and
+ * then waits for others, so the step counters of the active harts never
+ * differ more than on one quantum.
+ */
+class IQuantumSync : public IFace {
+ public:
+    IQuantumSync() : IFace(IFACE_QUANTUM_SYNC) {}
+
+    /** Register hart (CPU service with IDPort interface)
+     * @return hart index used in other methods
+     */
+    virtual int attachHart(IService *isrv) = 0;
+
+    /** Report hart state at the quantum boundary. Called from the hart thread.
+     * @param step   Hart step counter.
+     * @param active Hart is running, halted harts don't hold the window.
+     * @return Step (in the hart counter units) where the hart should call
+     *         this method again, 0 if the hart should wait.
+     */
+    virtual uint64_t syncQuantum(int idx, uint64_t step, bool active) = 0;
+
+    /** Block hart thread until the window state changed or timeout. */
+    virtual void waitQuantum(int idx, int ms) = 0;
+};
+
+}  // namespace debugger
@@ -17,9 +17,67 @@
 #include <api_core.h>
 #include "bus_generic.h"
 #include "debug/dsumap.h"
+#include "coreservices/icheckpoint.h"
+#include "cmd_bus_bench.h"
 
 namespace debugger {
 
+BusUtilBank::BusUtilBank(IService *parent, const char *name,
+                         uint64_t addr, int len)
+    : GenericReg64Bank(parent, name, addr, len) {
+    for (int i = 0; i < MASTERS_MAX; i++) {
+        cnt_[i].wr.store(0);
+        cnt_[i].rd.store(0);
+    }
+}
+
+Reg64Type BusUtilBank::read(int idx) {
+    Reg64Type ret;
+    ret.val = 0;
+    if (idx < 2*MASTERS_MAX) {
+        ret.val = (idx & 1) ? cnt_[idx >> 1].rd.load()
+                            : cnt_[idx >> 1].wr.load();
+    }
+    regs_[idx] = ret;
+    return ret;
+}
+
+void BusUtilBank::write(int idx, uint64_t val) {
+    regs_[idx].val = val;
+    if (idx >= 2*MASTERS_MAX) {
+        return;
+    }
+    if (idx & 1) {
+        cnt_[idx >> 1].rd.store(val);
+    } else {
+        cnt_[idx >> 1].wr.store(val);
+    }
+}
+
+void BusUtilBank::reset() {
+    GenericReg64Bank::reset();
+    for (int i = 0; i < MASTERS_MAX; i++) {
+        cnt_[i].wr.store(0);
+        cnt_[i].rd.store(0);
+    }
+}
+
+void BusUtilBank::saveRegisters(CheckpointState *state) {
+    int total = length_.to_int() / static_cast<int>(sizeof(Reg64Type));
+    for (int i = 0; i < total; i++) {
+        read(i);
+    }
+    GenericReg64Bank::saveRegisters(state);
+}
+
+void BusUtilBank::restoreRegisters(CheckpointState *state) {
+    GenericReg64Bank::restoreRegisters(state);
+    int total = length_.to_int() / static_cast<int>(sizeof(Reg64Type));
+    for (int i = 0; i < total; i++) {
+        write(i, regs_[i].val);
+    }
+}
+
 BusGeneric::BusGeneric(const char *name) : IService(name),
     IHap(HAP_ConfigDone),
     busUtil_(static_cast<IService *>(this), "bus_util",
@@ -28,25 +86,41 @@ BusGeneric::BusGeneric(const char *name) : IService(name),
                    local_region_type::mst_bus_util_type)) {
     registerInterface(static_cast<IMemoryOperation *>(this));
     registerAttribute("AddrWidth", &addrWidth_);
-    RISCV_mutex_init(&mutexBAccess_);
-    RISCV_mutex_init(&mutexNBAccess_);
+    RISCV_mutex_init(&mutexMap_);
     RISCV_register_hap(static_cast<IHap *>(this));
     busUtil_.setPriority(10);     // Overmap DSU registers
     imaphash_ = 0;
+    pcmdBench_ = 0;
+    iexec_ = 0;
+    devlock_ = 0;
+    devlockTotal_ = 0;
 
-    memset(imemtbl_, 0, sizeof(imemtbl_));
-    for (int i = 0; i < HASH_TBL_SIZE; i++) {
-        imemtbl_[i].devlist.make_list(0);
-    }
+    // Empty map until the configuration is done
+    MapSnapshotType *map = new MapSnapshotType;
+    memset(map->bucket, 0, sizeof(map->bucket));
+    map->interval = 0;
+    map->interval_total = 0;
+    map->retired = 0;
+    map_.store(map);
+    mapGeneration_.store(0);
     addrWidth_.make_int64(39);      // 39-bits address width for FU740
 }
 
 BusGeneric::~BusGeneric() {
-    RISCV_mutex_destroy(&mutexBAccess_);
-    RISCV_mutex_destroy(&mutexNBAccess_);
+    RISCV_mutex_destroy(&mutexMap_);
     if (imaphash_) {
         delete [] imaphash_;
     }
+    freeMap(map_.load());
+    for (unsigned i = 0; i < devlockTotal_; i++) {
+        if (devlock_[i]) {
+            RISCV_mutex_destroy(devlock_[i]);
+            delete devlock_[i];
+        }
+    }
+    if (devlock_) {
+        delete [] devlock_;
+    }
 }
 
 void BusGeneric::postinitService() {
@@ -82,64 +156,69 @@ void BusGeneric::postinitService() {
             map(imem);
         }
     }
+
+    AttributeType execlist;
+    RISCV_get_services_with_iface(IFACE_CMD_EXECUTOR, &execlist);
+    if (execlist.size()) {
+        IService *iserv = static_cast<IService *>(execlist[0u].to_iface());
+        iexec_ = static_cast<ICmdExecutor *>(
+            iserv->getInterface(IFACE_CMD_EXECUTOR));
+        pcmdBench_ = new CmdBusBench(this);
+        iexec_->registerCommand(pcmdBench_);
+    }
 }
 
-/** We need correctly mapped device list to compute hash, postinit
+void BusGeneric::predeleteService() {
+    if (pcmdBench_) {
+        iexec_->unregisterCommand(pcmdBench_);
+        delete pcmdBench_;
+        pcmdBench_ = 0;
+    }
+}
+
+/** We need correctly mapped device list to compile the map, postinit
     doesn't allow to guarantee order of initialization. */
 void BusGeneric::hapTriggered(EHapType type,
                               uint64_t param,
                               const char *descr) {
-    RISCV_mutex_lock(&mutexNBAccess_);
-    RISCV_mutex_lock(&mutexBAccess_);
+    RISCV_mutex_lock(&mutexMap_);
     maphash();
-    RISCV_mutex_unlock(&mutexBAccess_);
-    RISCV_mutex_unlock(&mutexNBAccess_);
+    RISCV_mutex_unlock(&mutexMap_);
 }
 
 ETransStatus BusGeneric::b_transport(Axi4TransactionType *trans) {
     ETransStatus ret = TRANS_OK;
-    uint32_t sz;
-    IMemoryOperation *memdev = 0;
-
-    RISCV_mutex_lock(&mutexBAccess_);
+    const MapIntervalType *iv = getMapedInterval(trans->addr);
 
-    getMapedDevice(trans, &memdev, &sz);
-
-    if (memdev == 0) {
+    if (iv == 0) {
         RISCV_error("Blocking request to unmapped address "
                     "%08" RV_PRI64 "x", trans->addr);
         memset(trans->rpayload.b8, 0xFF, trans->xsize);
         ret = TRANS_ERROR;
     } else {
-        memdev->b_transport(trans);
+        if (iv->lock) {
+            RISCV_mutex_lock(iv->lock);
+            iv->idev->b_transport(trans);
+            RISCV_mutex_unlock(iv->lock);
+        } else {
+            iv->idev->b_transport(trans);
+        }
         RISCV_debug("[%08" RV_PRI64 "x] => [%08x %08x]",
             trans->addr,
             trans->rpayload.b32[1], trans->rpayload.b32[0]);
     }
 
-    // Update Bus utilization counters:
-    if (trans->source_idx >= 0 && trans->source_idx < 8) {
-        if (trans->action == MemAction_Read) {
-            busUtil_.getpR64()[2*trans->source_idx + 1]++;
-        } else if (trans->action == MemAction_Write) {
-            busUtil_.getpR64()[2*trans->source_idx]++;
-        }
-    }
-    RISCV_mutex_unlock(&mutexBAccess_);
+    updateStatistic(trans->action, trans->source_idx,
+                    trans->addr, trans->xsize);
     return ret;
 }
 
 ETransStatus BusGeneric::nb_transport(Axi4TransactionType *trans,
                                IAxi4NbResponse *cb) {
     ETransStatus ret = TRANS_OK;
-    IMemoryOperation *memdev = 0;
-    uint32_t sz;
-
-    RISCV_mutex_lock(&mutexNBAccess_);
-
-    getMapedDevice(trans, &memdev, &sz);
+    const MapIntervalType *iv = getMapedInterval(trans->addr);
 
-    if (memdev == 0) {
+    if (iv == 0) {
         RISCV_error("Non-blocking request from %d to unmapped address "
                     "%08" RV_PRI64 "x", trans->source_idx, trans->addr);
         memset(trans->rpayload.b8, 0xFF, trans->xsize);
@@ -147,72 +226,305 @@ ETransStatus BusGeneric::nb_transport(Axi4TransactionType *trans,
         cb->nb_response(trans);
         ret = TRANS_ERROR;
     } else {
-        memdev->nb_transport(trans, cb);
+        if (iv->lock) {
+            RISCV_mutex_lock(iv->lock);
+            iv->idev->nb_transport(trans, cb);
+            RISCV_mutex_unlock(iv->lock);
+        } else {
+            iv->idev->nb_transport(trans, cb);
+        }
         RISCV_debug("Non-blocking request to [%08" RV_PRI64 "x]",
                     trans->addr);
     }
 
-    // Update Bus utilization counters:
-    if (trans->source_idx >= 0 && trans->source_idx < 8) {
-        if (trans->action == MemAction_Read) {
-            busUtil_.getpR64()[2*trans->source_idx + 1]++;
-        } else if (trans->action == MemAction_Write) {
-            busUtil_.getpR64()[2*trans->source_idx]++;
+    updateStatistic(trans->action, trans->source_idx,
+                    trans->addr, trans->xsize);
+    return ret;
+}
+
+/**
+ * Burst is split on the interval boundaries only, each part is forwarded
+ * into the device as a single call. Unmapped beats are read as 0xFF.
+ */
+ETransStatus BusGeneric::b_burst(Axi4BurstType *burst) {
+    ETransStatus ret = TRANS_OK;
+    const MapIntervalType *iv;
+    Axi4BurstType part = *burst;
+    uint64_t unmapped = 0;
+    uint32_t off = 0;
+
+    while (off < burst->size) {
+        part.addr = burst->addr + off;
+        part.buf = &burst->buf[off];
+        part.size = burst->size - off;
+        iv = getMapedInterval(part.addr);
+        if (iv == 0) {
+            // Skip up to the next beat, the map may resume there
+            if (part.size > PAYLOAD_MAX_BYTES - (part.addr & 0x7)) {
+                part.size = PAYLOAD_MAX_BYTES
+                          - static_cast<uint32_t>(part.addr & 0x7);
+            }
+            if (part.action == MemAction_Read) {
+                memset(part.buf, 0xFF, part.size);
+            }
+            if (unmapped == 0) {
+                unmapped = part.addr | 1;   // non-zero even at address 0
+            }
+            ret = TRANS_ERROR;
+        } else {
+            if (iv->end - part.addr < part.size) {
+                part.size = static_cast<uint32_t>(iv->end - part.addr);
+            }
+            if (iv->lock) {
+                RISCV_mutex_lock(iv->lock);
+            }
+            if (iv->idev->b_burst(&part) != TRANS_OK) {
+                ret = TRANS_ERROR;
+            }
+            if (iv->lock) {
+                RISCV_mutex_unlock(iv->lock);
+            }
         }
+        off += part.size;
+    }
+
+    if (unmapped) {
+        RISCV_error("Burst request from %d to unmapped address "
+                    "%08" RV_PRI64 "x", burst->source_idx, unmapped & ~1ull);
     }
-    RISCV_mutex_unlock(&mutexNBAccess_);
+    RISCV_debug("Burst request to [%08" RV_PRI64 "x] %d bytes",
+                burst->addr, burst->size);
+    updateStatistic(burst->action, burst->source_idx,
+                    burst->addr, burst->size);
     return ret;
 }
 
-void BusGeneric::getMapedDevice(Axi4TransactionType *trans,
-                         IMemoryOperation **pdev, uint32_t *sz) {
-    IMemoryOperation *imem;
-    uint64_t bar, barsz;
-    *pdev = 0;
-    *sz = 0;
-
-    uint64_t hashidx = (trans->addr & ADDR_MASK_) >> HASH_LVL1_OFFSET_;
-    HashTableItemType &item = imemtbl_[hashidx];
-    if (item.idev) {
-        *pdev = item.idev;
-    } else if (item.nxtlvlena) {
-        for (unsigned i = 0; i < item.devlist.size(); i++) {
-            imem = static_cast<IMemoryOperation *>(item.devlist[i].to_iface());
-            bar = imem->getBaseAddress();
-            barsz = imem->getLength();
-            if (bar <= trans->addr && trans->addr < (bar + barsz)) {
-                if (!(*pdev) || imem->getPriority() > (*pdev)->getPriority()) {
-                    *pdev = imem;
+void BusGeneric::updateStatistic(EAxi4Action action, int source_idx,
+                                 uint64_t addr, uint32_t size) {
+    uint64_t beats;
+    if (action == MemAction_Write) {
+        resv_.invalidate(source_idx, addr, size);
+    }
+
+    // Update Bus utilization counters, burst counted in 64-bits beats:
+    if (source_idx >= 0 && source_idx < BusUtilBank::MASTERS_MAX) {
+        beats = ((addr & 0x7) + size + 7) >> 3;
+        if (action == MemAction_Read) {
+            busUtil_.incrementRead(source_idx, beats);
+        } else if (action == MemAction_Write) {
+            busUtil_.incrementWrite(source_idx, beats);
+        }
+    }
+}
+
+/**
+ * Returned range is limited by the map interval so that all addresses
+ * inside of the range are routed into the same device.
+ */
+bool BusGeneric::getHostMemory(uint64_t addr, HostMemoryRangeType *range) {
+    const MapIntervalType *iv;
+    uint64_t rend;
+    bool ret = false;
+
+    iv = getMapedInterval(addr);
+    if (iv && iv->idev->getHostMemory(addr, range)) {
+        ret = true;
+        rend = range->addr + range->size;
+        if (range->addr < iv->start) {
+            uint64_t shift = iv->start - range->addr;
+            range->ptr += shift;
+            range->addr = iv->start;
+            // Dirty flags are per page of the device memory, the unaligned
+            // range without own flags is written through the transport.
+            if (range->dirty) {
+                if (shift & ((1ull << CheckpointPageType::PAGE_BITS) - 1)) {
+                    return false;
                 }
+                range->dirty += shift >> CheckpointPageType::PAGE_BITS;
             }
         }
+        if (rend > iv->end) {
+            rend = iv->end;
+        }
+        range->size = rend - range->addr;
     }
+    return ret;
+}
+
+IMemoryOperation *BusGeneric::getMapedDevice(uint64_t addr) {
+    const MapIntervalType *iv = getMapedInterval(addr);
+    return iv ? iv->idev : 0;
+}
+
+const BusGeneric::MapIntervalType *
+BusGeneric::getMapedInterval(uint64_t addr) {
+    const MapSnapshotType *map = map_.load(std::memory_order_acquire);
+    const MapBucketType &bkt =
+        map->bucket[(addr & ADDR_MASK_) >> HASH_LVL1_OFFSET_];
+    if (bkt.iv) {
+        return bkt.iv;
+    }
+    if (bkt.total == 0) {
+        return 0;
+    }
+    const MapIntervalType *iv = &map->interval[bkt.first];
+    unsigned lo = 0;
+    unsigned hi = bkt.total;
+    while (lo < hi) {
+        unsigned mid = (lo + hi) >> 1;
+        if (addr < iv[mid].start) {
+            hi = mid;
+        } else if (addr >= iv[mid].end) {
+            lo = mid + 1;
+        } else {
+            return &iv[mid];
+        }
+    }
+    return 0;
 }
 
 void BusGeneric::maphash() {
-    IMemoryOperation *imem;
-    uint64_t first, last;
-    uint64_t bar;
-    for (unsigned i = 0; i < imap_.size(); i++) {
+    // New map is completely built before it replaces the current one
+    MapSnapshotType *map = compileMap();
+    map->retired = map_.load();
+    map_.store(map, std::memory_order_release);
+    mapGeneration_.fetch_add(1, std::memory_order_release);
+}
+
+/**
+ * Devices boundaries split the address space on the elementary intervals,
+ * each of them is assigned to the device with the highest priority (the
+ * first mapped one if equal) and neighbours of the same device are merged.
+ */
+BusGeneric::MapSnapshotType *BusGeneric::compileMap() {
+    MapSnapshotType *map = new MapSnapshotType;
+    IMemoryOperation *imem, *sel;
+    uint64_t bar, end;
+    unsigned devtotal = imap_.size();
+
+    memset(map->bucket, 0, sizeof(map->bucket));
+    map->interval = 0;
+    map->interval_total = 0;
+    map->retired = 0;
+    if (devtotal == 0) {
+        return map;
+    }
+
+    // Sorted unique boundaries of all devices
+    uint64_t *edge = new uint64_t[2*devtotal];
+    unsigned edgetotal = 0;
+    for (unsigned i = 0; i < devtotal; i++) {
         imem = static_cast<IMemoryOperation *>(imap_[i].to_iface());
-        bar = imem->getBaseAddress();
-        first = (bar >> HASH_LVL1_OFFSET_) & HASH_MASK_;
-        last = ((bar + imem->getLength()) >> HASH_LVL1_OFFSET_) & HASH_MASK_;
+        uint64_t v[2];
+        v[0] = imem->getBaseAddress();
+        v[1] = v[0] + imem->getLength();
+        for (int k = 0; k < 2; k++) {
+            unsigned pos = edgetotal;
+            while (pos > 0 && edge[pos - 1] > v[k]) {
+                pos--;
+            }
+            if (pos > 0 && edge[pos - 1] == v[k]) {
+                continue;
+            }
+            memmove(&edge[pos + 1], &edge[pos],
+                    (edgetotal - pos) * sizeof(uint64_t));
+            edge[pos] = v[k];
+            edgetotal++;
+        }
+    }
+
+    MapIntervalType *iv = new MapIntervalType[edgetotal];
+    unsigned ivtotal = 0;
+    unsigned selidx = 0;
+    for (unsigned k = 0; k + 1 < edgetotal; k++) {
+        sel = 0;
+        for (unsigned i = 0; i < devtotal; i++) {
+            imem = static_cast<IMemoryOperation *>(imap_[i].to_iface());
+            bar = imem->getBaseAddress();
+            end = bar + imem->getLength();
+            if (bar <= edge[k] && edge[k] < end) {
+                if (!sel || imem->getPriority() > sel->getPriority()) {
+                    sel = imem;
+                    selidx = i;
+                }
+            }
+        }
+        if (sel == 0) {
+            continue;
+        }
+        if (ivtotal && iv[ivtotal - 1].idev == sel
+            && iv[ivtotal - 1].end == edge[k]) {
+            iv[ivtotal - 1].end = edge[k + 1];
+            continue;
+        }
+        iv[ivtotal].start = edge[k];
+        iv[ivtotal].end = edge[k + 1];
+        iv[ivtotal].idev = sel;
+        iv[ivtotal].lock = sel->isSerialized() ? getDeviceLock(selidx) : 0;
+        ivtotal++;
+    }
+    delete [] edge;
 
+    // First level index
+    uint64_t bktsz = 1ull << HASH_LVL1_OFFSET_;
+    for (unsigned k = 0; k < ivtotal; k++) {
+        uint64_t first = (iv[k].start & ADDR_MASK_) >> HASH_LVL1_OFFSET_;
+        uint64_t last = ((iv[k].end - 1) & ADDR_MASK_) >> HASH_LVL1_OFFSET_;
         for (uint64_t n = first; n <= last; n++) {
-            HashTableItemType &item = imemtbl_[n];
-            if (!item.nxtlvlena && !item.idev) {
-                item.idev = imem;
-            } else if (item.idev) {
-                item.nxtlvlena = true;
-                item.devlist.new_list_item().make_iface(item.idev);
-                item.devlist.new_list_item().make_iface(imem);
-                item.idev = 0;
-            } else {
-                item.devlist.new_list_item().make_iface(imem);
+            MapBucketType &bkt = map->bucket[n];
+            if (bkt.total == 0) {
+                bkt.first = k;
             }
+            bkt.total++;
         }
     }
+    for (int n = 0; n < HASH_TBL_SIZE; n++) {
+        MapBucketType &bkt = map->bucket[n];
+        if (bkt.total != 1) {
+            continue;
+        }
+        bar = static_cast<uint64_t>(n) * bktsz;
+        if ((iv[bkt.first].start & ADDR_MASK_) <= bar
+            && ((iv[bkt.first].end - 1) & ADDR_MASK_) >= bar + bktsz - 1) {
+            bkt.iv = &iv[bkt.first];
+        }
+    }
+    map->interval = iv;
+    map->interval_total = ivtotal;
+    return map;
+}
+
+void BusGeneric::freeMap(MapSnapshotType *map) {
+    if (map->retired) {
+        freeMap(map->retired);
+    }
+    if (map->interval) {
+        delete [] map->interval;
+    }
+    delete map;
+}
+
+/**
+ * Locks are bound to the device index in the map list and live until the
+ * bus is deleted, so the device stays serialized across the remaps.
+ */
+mutex_def *BusGeneric::getDeviceLock(unsigned idx) {
+    if (idx >= devlockTotal_) {
+        unsigned total = imap_.size() > idx ? imap_.size() : idx + 1;
+        mutex_def **t = new mutex_def *[total];
+        memset(t, 0, total * sizeof(mutex_def *));
+        if (devlock_) {
+            memcpy(t, devlock_, devlockTotal_ * sizeof(mutex_def *));
+            delete [] devlock_;
+        }
+        devlock_ = t;
+        devlockTotal_ = total;
+    }
+    if (devlock_[idx] == 0) {
+        devlock_[idx] = new mutex_def;
+        RISCV_mutex_init(devlock_[idx]);
+    }
+    return devlock_[idx];
 }
 
 }  // namespace debugger
@@ -21,10 +21,48 @@
 #include <iservice.h>
 #include <ihap.h>
 #include "coreservices/imemop.h"
+#include "coreservices/icmdexec.h"
 #include "generic/mapreg.h"
+#include "generic/reservation.h"
+#include <atomic>
 
 namespace debugger {
 
+/**
+ * Bus utilization registers of the DSU. Counters are incremented by the
+ * masters without locks and folded into the registers on read.
+ */
+class BusUtilBank : public GenericReg64Bank {
+ public:
+    static const int MASTERS_MAX = 8;
+
+    BusUtilBank(IService *parent, const char *name, uint64_t addr, int len);
+
+    void incrementRead(int idx, uint64_t cnt) {
+        cnt_[idx].rd.fetch_add(cnt, std::memory_order_relaxed);
+    }
+    void incrementWrite(int idx, uint64_t cnt) {
+        cnt_[idx].wr.fetch_add(cnt, std::memory_order_relaxed);
+    }
+
+    /** GenericReg64Bank */
+    virtual Reg64Type read(int idx);
+    virtual void write(int idx, Reg64Type val) { write(idx, val.val); }
+    virtual void write(int idx, uint64_t val);
+    virtual void reset();
+    virtual void saveRegisters(CheckpointState *state);
+    virtual void restoreRegisters(CheckpointState *state);
+
+ private:
+    /** Two cache lines per master so that neighbours never share a line
+        whatever the alignment of the bus object is. */
+    struct MasterCounterType {
+        std::atomic<uint64_t> wr;
+        std::atomic<uint64_t> rd;
+        uint8_t rsrv[128 - 2*sizeof(uint64_t)];
+    } cnt_[MASTERS_MAX];
+};
+
 class BusGeneric : public IService,
                    public IMemoryOperation,
                    public IHap {
@@ -34,40 +72,93 @@ class BusGeneric : public IService,
 
     /** IService interface */
     virtual void postinitService();
+    virtual void predeleteService();
 
     /** IMemoryOperation interface */
     virtual ETransStatus b_transport(Axi4TransactionType *trans);
     virtual ETransStatus nb_transport(Axi4TransactionType *trans,
                                       IAxi4NbResponse *cb);
+    virtual ETransStatus b_burst(Axi4BurstType *burst);
+    virtual bool getHostMemory(uint64_t addr, HostMemoryRangeType *range);
+    virtual const std::atomic<uint32_t> *getMapGeneration() {
+        return &mapGeneration_;
+    }
+    virtual ReservationTable *getReservationTable() { return &resv_; }
 
     /** IHap */
     virtual void hapTriggered(EHapType type, uint64_t param,
                               const char *descr);
 
+    /** Mapped devices, used by bus_bench to generate addresses */
+    unsigned getMapedTotal() { return imap_.size(); }
+    IMemoryOperation *getMapedItem(unsigned idx) {
+        return static_cast<IMemoryOperation *>(imap_[idx].to_iface());
+    }
+    int getAddrWidth() { return addrWidth_.to_int(); }
+    /** Compiled map lookup */
+    IMemoryOperation *getMapedDevice(uint64_t addr);
+
  protected:
+    static const int HASH_ADDR_WIDTH = 14;
+    static const int HASH_TBL_SIZE = 1 << HASH_ADDR_WIDTH;
+
+    /**
+     * Compiled memory map: address intervals sorted by address without
+     * overlapping, each of them routed into the device with the highest
+     * priority.
+     */
+    struct MapIntervalType {
+        uint64_t start;
+        uint64_t end;                   // exclusive
+        IMemoryOperation *idev;
+        mutex_def *lock;                // serialized device or 0
+    };
+
+    /**
+     * First level index on the top address bits: bucket covered by one
+     * interval points to it directly, otherwise intervals
+     * [first, first + total) are searched.
+     */
+    struct MapBucketType {
+        const MapIntervalType *iv;
+        uint32_t first;
+        uint32_t total;
+    };
+
+    /**
+     * Snapshot is never modified after publishing. Transactions in flight
+     * may still use the replaced one so it is kept in the 'retired' chain
+     * until the bus is deleted (remaps are rare).
+     */
+    struct MapSnapshotType {
+        MapBucketType bucket[HASH_TBL_SIZE];
+        MapIntervalType *interval;
+        unsigned interval_total;
+        MapSnapshotType *retired;
+    };
+
     /** Speed-optimized mapping */
     virtual void maphash();
-    void getMapedDevice(Axi4TransactionType *trans,
-                        IMemoryOperation **pdev, uint32_t *sz);
+    MapSnapshotType *compileMap();
+    void freeMap(MapSnapshotType *map);
+    const MapIntervalType *getMapedInterval(uint64_t addr);
+    mutex_def *getDeviceLock(unsigned idx);
+    void updateStatistic(EAxi4Action action, int source_idx,
+                         uint64_t addr, uint32_t size);
 
  protected:
-    static const int HASH_ADDR_WIDTH = 14;
-    static const int HASH_TBL_SIZE = 1 << HASH_ADDR_WIDTH;
     AttributeType addrWidth_;       // address bits (39 bits for FU740). [63:39] must be equal to [38]
-    mutex_def mutexBAccess_;
-    mutex_def mutexNBAccess_;
-    Axi4TransactionType b_tr_;
-    Axi4TransactionType nb_tr_;
+    mutex_def mutexMap_;          // map rebuild only, transport is lock-free
 
-    GenericReg64Bank busUtil_;    // per master read/write access statistic
+    BusUtilBank busUtil_;         // per master read/write access statistic
+    ReservationTable resv_;       // LR/SC reservations of all masters
     IMemoryOperation **imaphash_;
-
-    struct HashTableItemType {
-        bool nxtlvlena;
-        IMemoryOperation *idev;
-        HashTableItemType *tbl;
-        AttributeType devlist;
-    } imemtbl_[HASH_TBL_SIZE];
+    std::atomic<MapSnapshotType *> map_;    // replaced as a whole on remap
+    std::atomic<uint32_t> mapGeneration_;   // incremented after replacing
+    mutex_def **devlock_;         // locks of the serialized devices by index
+    unsigned devlockTotal_;
+    ICommand *pcmdBench_;
+    ICmdExecutor *iexec_;
 
     uint64_t ADDR_MASK_;
     uint64_t HASH_MASK_;
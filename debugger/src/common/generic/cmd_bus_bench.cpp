@@ -0,0 +1,177 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "cmd_bus_bench.h"
+#include "bus_generic.h"
+
+namespace debugger {
+
+CmdBusBench::CmdBusBench(BusGeneric *ibus)
+    : ICommand("bus_bench", 0, 0) {
+
+    briefDescr_.make_string("Measure bus address decoder performance");
+    detailedDescr_.make_string(
+        "Description:\n"
+        "    Decode a set of addresses randomly distributed over the mapped\n"
+        "    devices using the hash buckets scanning and the compiled\n"
+        "    interval map.\n"
+        "Usage:\n"
+        "    bus_bench [total]\n"
+        "Output format:\n"
+        "    [i,d,d,i]\n"
+        "         i - Total number of decoded addresses (int64_t).\n"
+        "         d - Buckets scanning ns per access (double).\n"
+        "         d - Compiled map ns per access (double).\n"
+        "         i - Number of mismatches between two decoders.\n"
+        "Example:\n"
+        "    bus_bench\n"
+        "    bus_bench 10000000\n");
+
+    ibus_ = ibus;
+    addrMask_ = 0;
+    hashOffset_ = 0;
+}
+
+int CmdBusBench::isValid(AttributeType *args) {
+    if (!cmdName_.is_equal((*args)[0u].to_string())) {
+        return CMD_INVALID;
+    }
+    if (args->size() == 1
+        || (args->size() == 2 && (*args)[1].is_integer())) {
+        return CMD_VALID;
+    }
+    return CMD_WRONG_ARGS;
+}
+
+void CmdBusBench::exec(AttributeType *args, AttributeType *res) {
+    static const unsigned VECTORS_TOTAL = 4096;
+    uint64_t total = 10000000;
+    if (args->size() == 2) {
+        total = (*args)[1].to_uint64();
+    }
+    unsigned dev_total = ibus_->getMapedTotal();
+    if (dev_total == 0 || total == 0) {
+        generateError(res, "Empty memory map");
+        return;
+    }
+
+    addrMask_ = (1ull << ibus_->getAddrWidth()) - 1;
+    hashOffset_ = ibus_->getAddrWidth() - HASH_ADDR_WIDTH;
+    HashTableItemType *tbl = new HashTableItemType[HASH_TBL_SIZE];
+    buildHash(tbl);
+
+    // Test vectors: pseudo-random offsets inside of each mapped device
+    uint64_t *vec = new uint64_t[VECTORS_TOTAL];
+    uint64_t lfsr = 0x123456789abcdefull;
+    for (unsigned i = 0; i < VECTORS_TOTAL; i++) {
+        IMemoryOperation *imem = ibus_->getMapedItem(i % dev_total);
+        lfsr = lfsr * 6364136223846793005ull + 1442695040888963407ull;
+        vec[i] = imem->getBaseAddress();
+        if (imem->getLength()) {
+            vec[i] += (lfsr >> 16) % imem->getLength();
+        }
+    }
+
+    uint64_t mismatch = 0;
+    uintptr_t chk1 = 0;
+    uintptr_t chk2 = 0;
+    uint64_t t_start = RISCV_get_time_ms();
+    for (uint64_t i = 0; i < total; i++) {
+        chk1 += reinterpret_cast<uintptr_t>(
+                    getDeviceList(tbl, vec[i % VECTORS_TOTAL]));
+    }
+    uint64_t t_list = RISCV_get_time_ms() - t_start;
+
+    t_start = RISCV_get_time_ms();
+    for (uint64_t i = 0; i < total; i++) {
+        chk2 += reinterpret_cast<uintptr_t>(
+                    ibus_->getMapedDevice(vec[i % VECTORS_TOTAL]));
+    }
+    uint64_t t_map = RISCV_get_time_ms() - t_start;
+
+    if (chk1 != chk2) {
+        for (unsigned i = 0; i < VECTORS_TOTAL; i++) {
+            if (getDeviceList(tbl, vec[i])
+                != ibus_->getMapedDevice(vec[i])) {
+                mismatch++;
+            }
+        }
+    }
+    delete [] vec;
+    delete [] tbl;
+
+    res->make_list(4);
+    (*res)[0u].make_uint64(total);
+    (*res)[1].make_floating(1000000.0 * static_cast<double>(t_list) / total);
+    (*res)[2].make_floating(1000000.0 * static_cast<double>(t_map) / total);
+    (*res)[3].make_uint64(mismatch);
+}
+
+void CmdBusBench::buildHash(HashTableItemType *tbl) {
+    IMemoryOperation *imem;
+    uint64_t first, last;
+    uint64_t bar;
+    for (int i = 0; i < HASH_TBL_SIZE; i++) {
+        tbl[i].idev = 0;
+        tbl[i].devlist.make_list(0);
+    }
+    for (unsigned i = 0; i < ibus_->getMapedTotal(); i++) {
+        imem = ibus_->getMapedItem(i);
+        bar = imem->getBaseAddress();
+        first = ((bar & addrMask_) >> hashOffset_) & (HASH_TBL_SIZE - 1);
+        last = (((bar + imem->getLength()) & addrMask_) >> hashOffset_)
+             & (HASH_TBL_SIZE - 1);
+
+        for (uint64_t n = first; n <= last; n++) {
+            HashTableItemType &item = tbl[n];
+            if (item.devlist.size() == 0 && !item.idev) {
+                item.idev = imem;
+            } else if (item.idev) {
+                item.devlist.new_list_item().make_iface(item.idev);
+                item.devlist.new_list_item().make_iface(imem);
+                item.idev = 0;
+            } else {
+                item.devlist.new_list_item().make_iface(imem);
+            }
+        }
+    }
+}
+
+IMemoryOperation *CmdBusBench::getDeviceList(HashTableItemType *tbl,
+                                             uint64_t addr) {
+    IMemoryOperation *imem;
+    IMemoryOperation *ret = 0;
+    uint64_t bar, barsz;
+
+    HashTableItemType &item = tbl[(addr & addrMask_) >> hashOffset_];
+    if (item.idev) {
+        ret = item.idev;
+    } else {
+        for (unsigned i = 0; i < item.devlist.size(); i++) {
+            imem = static_cast<IMemoryOperation *>(item.devlist[i].to_iface());
+            bar = imem->getBaseAddress();
+            barsz = imem->getLength();
+            if (bar <= addr && addr < (bar + barsz)) {
+                if (!ret || imem->getPriority() > ret->getPriority()) {
+                    ret = imem;
+                }
+            }
+        }
+    }
+    return ret;
+}
+
+}  // namespace debugger
@@ -0,0 +1,59 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef __SRC_COMMON_GENERIC_CMD_BUS_BENCH_H__
+#define __SRC_COMMON_GENERIC_CMD_BUS_BENCH_H__
+
+#include "api_core.h"
+#include "coreservices/icommand.h"
+#include "coreservices/imemop.h"
+
+namespace debugger {
+
+class BusGeneric;
+
+class CmdBusBench : public ICommand {
+ public:
+    explicit CmdBusBench(BusGeneric *ibus);
+
+    /** ICommand */
+    virtual int isValid(AttributeType *args);
+    virtual void exec(AttributeType *args, AttributeType *res);
+
+ private:
+    static const int HASH_ADDR_WIDTH = 14;
+    static const int HASH_TBL_SIZE = 1 << HASH_ADDR_WIDTH;
+
+    /**
+     * Reference decoder: hash buckets on the top address bits with the
+     * list of devices crossing each bucket. Built on each run from the
+     * mapped devices, the bus itself uses the compiled interval map only.
+     */
+    struct HashTableItemType {
+        IMemoryOperation *idev;
+        AttributeType devlist;
+    };
+    void buildHash(HashTableItemType *tbl);
+    IMemoryOperation *getDeviceList(HashTableItemType *tbl, uint64_t addr);
+
+    BusGeneric *ibus_;
+    uint64_t addrMask_;
+    int hashOffset_;
+};
+
+}  // namespace debugger
+
+#endif  // __SRC_COMMON_GENERIC_CMD_BUS_BENCH_H__
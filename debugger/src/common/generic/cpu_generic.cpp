@@ -25,13 +25,17 @@ CpuGeneric::CpuGeneric(const char *name)
     portCSR_(this,  "csr",  0,     1<<12),
     portRegs_(this, "regs", 1<<12, 0x1000),
     stackTraceCnt_(this, "stack_trace_cnt", 0),
-    stackTraceBuf_(this, "stack_trace_buf", 0, 0) {
+    stackTraceBuf_(this, "stack_trace_buf", 0, 0),
+    reverseInput_(this),
+    reverseHalt_(this),
+    exitLimit_(this) {
     registerInterface(static_cast<IThread *>(this));
     registerInterface(static_cast<IClock *>(this));
     registerInterface(static_cast<ICpuFunctional *>(this));
     registerInterface(static_cast<IDPort *>(this));
     registerInterface(static_cast<IPower *>(this));
     registerInterface(static_cast<IResetListener *>(this));
+    registerInterface(static_cast<ICheckpoint *>(this));
     registerInterface(static_cast<IHap *>(this));
     registerAttribute("Enable", &isEnable_);
     registerAttribute("SysBus", &sysBus_);
@@ -42,19 +46,36 @@ CpuGeneric::CpuGeneric(const char *name)
     registerAttribute("StackTraceSize", &stackTraceSize_);
     registerAttribute("FreqHz", &freqHz_);
     registerAttribute("GenerateTraceFile", &generateTraceFile_);
+    registerAttribute("BinaryTrace", &binaryTrace_);
+    registerAttribute("TraceCompression", &traceCompression_);
+    registerAttribute("FlightRecorder", &flightRecorder_);
     registerAttribute("ResetVector", &resetVector_);
     registerAttribute("SysBusMasterID", &sysBusMasterID_);
-    registerAttribute("CacheBaseAddress", &cacheBaseAddr_);
-    registerAttribute("CacheAddressMask", &cacheAddrMask_);
+    registerAttribute("ICacheBudget", &icacheBudget_);
     registerAttribute("CoverageTracker", &coverageTracker_);
     registerAttribute("TriggersTotal", &triggersTotal_);
     registerAttribute("McontrolMaskmax", &mcontrolMaskmax_);
     registerAttribute("ResetState", &resetState_);
+    registerAttribute("BlockCacheSize", &blockCacheSize_);
+    registerAttribute("DirectMemAccess", &directMemAccess_);
+    registerAttribute("IdleFastForward", &idleFastForward_);
+    registerAttribute("IdleLoops", &idleLoops_);
+    registerAttribute("QuantumSync", &quantumSync_);
+    registerAttribute("ReverseInterval", &reverseInterval_);
+    registerAttribute("ReverseSnapshots", &reverseSnapshots_);
+    registerAttribute("ProfilerEntries", &profilerEntries_);
+    registerAttribute("ExitCondition", &exitCondition_);
+    registerAttribute("StepLimit", &stepLimit_);
 
     char tstr[256];
     RISCV_sprintf(tstr, sizeof(tstr), "eventConfigDone_%s", name);
     RISCV_event_create(&eventConfigDone_, tstr);
-    RISCV_mutex_init(&mutex_csr_);
+    RISCV_sprintf(tstr, sizeof(tstr), "eventDbgReqDone_%s", name);
+    RISCV_event_create(&eventDbgReqDone_, tstr);
+    RISCV_mutex_init(&mutex_dbgreq_);
+    dbgreqState_ = DbgReq_Idle;
+    dbgreq_ = 0;
+    simThreadId_ = 0;
     RISCV_register_hap(static_cast<IHap *>(this));
 
     isysbus_ = 0;
@@ -70,16 +91,80 @@ CpuGeneric::CpuGeneric(const char *name)
     resumereq_ = false;
 
     ptriggers_ = 0;
+    trigExec_ = 0;
+    trigExecCnt_ = 0;
+    trigICount_ = false;
+    trigEvalCnt_ = 0;
     trace_file_ = 0;
+    trace_writer_ = 0;
+    trace_ena_ = false;
+    binaryTrace_.make_boolean(false);
+    traceCompression_.make_boolean(true);
     memset(&trace_data_, 0, sizeof(trace_data_));
-    icache_ = 0;
-    memcache_sz_ = 0;
+    flightRecorder_.make_uint64(256);
+    flight_ = 0;
+    flightCur_ = 0;
+    flightCnt_ = 0;
+    flightMask_ = 0;
+    memset(icacheHash_, 0, sizeof(icacheHash_));
+    icacheHead_ = 0;
+    icacheTail_ = 0;
+    icacheLast_ = 0;
+    icachePages_ = 0;
+    icachePagesMax_ = 0;
+    icacheItem_ = 0;
     fetch_addr_ = 0;
-    cache_offset_ = 0;
-    cachable_pc_ = false;
-    CACHE_BASE_ADDR_ = 0;
-    CACHE_MASK_ = 0;
     oplen_ = 0;
+    blocks_ = 0;
+    blockTotal_ = 0;
+    blockPages_ = 0;
+    blockPageHash_ = 0;
+    blockPageFree_ = 0;
+    blockPageUsed_ = 0;
+    directMemAccess_.make_boolean(true);
+    memtlbEna_ = false;
+    mapGen_ = 0;
+    memtlbGen_ = 0;
+    vmemEna_ = false;
+    flushFetchPage();
+    memtlbFlush();
+    resvtbl_ = &resvLocal_;
+    idleFastForward_.make_boolean(true);
+    idleLoops_.make_list(0);
+    idleEna_ = false;
+    idleAddr_ = 0;
+    idleAddrTotal_ = 0;
+    idleStepCnt_ = 0;
+    iquantum_ = 0;
+    quantumIdx_ = 0;
+    quantumEnd_ = ~0ull;
+    quantumActive_ = false;
+    reverseInterval_.make_uint64(0);
+    reverseSnapshots_.make_uint64(256);
+    rhist_ = 0;
+    reverseNext_ = 0;
+    reverseFrontier_ = 0;
+    reverseTarget_ = ~0ull;
+    reverseInputNext_ = ~0ull;
+    reverseModified_ = false;
+    rewinding_ = false;
+    reverseDbgCtl_ = 0;
+    reverseTrig_ = 0;
+    scanType_ = Scan_None;
+    scanAddr_ = 0;
+    scanSize_ = 0;
+    scanHit_ = ~0ull;
+    scanBp_ = 0;
+    scanBpTotal_ = 0;
+    profilerEntries_.make_uint64(1 << 16);
+    prof_ = 0;
+    exitCondition_.make_string("");
+    stepLimit_.make_uint64(0);
+    exitType_ = Exit_None;
+    exitAddr_ = ~0ull;
+    exitCode_ = 0;
+    exitDescr_ = "";
+    exitPending_ = false;
     RISCV_set_default_clock(static_cast<IClock *>(this));
 
     R = portRegs_.getpR64();
@@ -92,17 +177,46 @@ CpuGeneric::CpuGeneric(const char *name)
 CpuGeneric::~CpuGeneric() {
     RISCV_set_default_clock(0);
     RISCV_event_close(&eventConfigDone_);
-    RISCV_mutex_destroy(&mutex_csr_);
-    if (icache_) {
-        delete [] icache_;
+    RISCV_event_close(&eventDbgReqDone_);
+    RISCV_mutex_destroy(&mutex_dbgreq_);
+    ICachePageType *p;
+    while (icacheHead_) {
+        p = icacheHead_;
+        icacheHead_ = p->next;
+        delete p;
     }
     if (ptriggers_) {
         delete [] ptriggers_;
+        delete [] trigExec_;
+    }
+    if (idleAddr_) {
+        delete [] idleAddr_;
+    }
+    if (blocks_) {
+        delete [] blocks_;
+        delete [] blockPages_;
+        delete [] blockPageHash_;
     }
     if (trace_file_) {
         trace_file_->close();
         delete trace_file_;
     }
+    if (trace_writer_) {
+        delete trace_writer_;
+    }
+    if (flight_) {
+        delete [] flight_;
+    }
+    if (rhist_) {
+        delete rhist_;
+        delete [] reverseTrig_;
+    }
+    if (scanBp_) {
+        delete [] scanBp_;
+    }
+    if (prof_) {
+        delete prof_;
+    }
 }
 
 void CpuGeneric::postinitService() {
@@ -111,6 +225,14 @@ void CpuGeneric::postinitService() {
     } else {
         estate_ = CORE_OFF;
     }
+    prof_ = new CpuProfiler(profilerEntries_.to_uint32());
+    if (exitCondition_.is_equal("tohost")) {
+        exitType_ = Exit_Tohost;
+    } else if (exitCondition_.is_equal("ecall")) {
+        exitType_ = Exit_Ecall;
+    } else if (exitCondition_.is_string() && exitCondition_.size()) {
+        exitType_ = Exit_Break;
+    }
 
     isysbus_ = static_cast<IMemoryOperation *>(
         RISCV_get_service_iface(sysBus_.to_string(), IFACE_MEMORY_OPERATION));
@@ -119,6 +241,10 @@ void CpuGeneric::postinitService() {
                     sysBus_.to_string());
         return;
     }
+    if (isysbus_->getReservationTable()) {
+        resvtbl_ = isysbus_->getReservationTable();
+    }
+    mapGen_ = isysbus_->getMapGeneration();
 
     isrc_ = static_cast<ISourceCode *>(
        RISCV_get_service_iface(sourceCode_.to_string(), IFACE_SOURCE_CODE));
@@ -147,17 +273,70 @@ void CpuGeneric::postinitService() {
         return;
     }
 
+    if (quantumSync_.is_string() && quantumSync_.size()) {
+        iquantum_ = static_cast<IQuantumSync *>(
+            RISCV_get_service_iface(quantumSync_.to_string(),
+                                    IFACE_QUANTUM_SYNC));
+        if (!iquantum_) {
+            RISCV_error("IQuantumSync interface '%s' not found",
+                        quantumSync_.to_string());
+        } else {
+            quantumIdx_ = iquantum_->attachHart(static_cast<IService *>(this));
+            if (quantumIdx_ < 0) {
+                iquantum_ = 0;
+            }
+        }
+    }
+
     stackTraceBuf_.setRegTotal(2 * stackTraceSize_.to_int());
 
     ptriggers_ = new TriggerStorageType[triggersTotal_.to_int()];
     memset(ptriggers_, 0, triggersTotal_.to_int()*sizeof(TriggerStorageType));
+    trigExec_ = new TriggerMatchType[triggersTotal_.to_int()];
+    updateTriggers();
+
+    if (icacheBudget_.is_integer() && icacheBudget_.to_uint64()) {
+        icachePagesMax_ = static_cast<unsigned>(
+            icacheBudget_.to_uint64() / sizeof(ICachePageType));
+        if (icachePagesMax_ == 0) {
+            icachePagesMax_ = 1;
+        }
+    }
+
+    memtlbEna_ = directMemAccess_.to_bool();
+
+    if (blockCacheSize_.is_integer() && blockCacheSize_.to_uint32()) {
+        // Round down to power of 2 to use address bits as an index
+        blockTotal_ = 1;
+        while (2*blockTotal_ <= blockCacheSize_.to_uint32()) {
+            blockTotal_ <<= 1;
+        }
+        blocks_ = new BlockType[blockTotal_];
+        blockPages_ = new BlockPageType[2*blockTotal_];
+        blockPageHash_ = new BlockPageType *[2*blockTotal_];
+        for (unsigned i = 0; i < blockTotal_; i++) {
+            blocks_[i].cnt = 0;
+        }
+        blockPagesReset();
+    }
 
-    CACHE_BASE_ADDR_ = cacheBaseAddr_.to_uint64();
-    CACHE_MASK_ = ~cacheAddrMask_.to_uint64();
-    if (cacheAddrMask_.to_uint64()) {
-        memcache_sz_ = cacheAddrMask_.to_int() + 1;
-        icache_ = new ICacheType[memcache_sz_];
-        memset(icache_, 0, memcache_sz_*sizeof(ICacheType));
+    if (flightRecorder_.is_integer() && flightRecorder_.to_uint32()) {
+        unsigned total = 1;
+        while (2*total <= flightRecorder_.to_uint32()) {
+            total <<= 1;
+        }
+        flight_ = new FlightRecordType[total];
+        flightMask_ = total - 1;
+    }
+
+    if (reverseInterval_.to_uint64()) {
+        if (iquantum_) {
+            RISCV_error("Reverse execution isn't supported with %s",
+                        quantumSync_.to_string());
+        } else {
+            rhist_ = new ReverseHistory(reverseSnapshots_.to_int());
+            reverseTrig_ = new TriggerStorageType[triggersTotal_.to_int()];
+        }
     }
 
     // Get global settings:
@@ -168,7 +347,18 @@ void CpuGeneric::postinitService() {
             return;
         }
         if (generateTraceFile_.is_string() && generateTraceFile_.size()) {
-            trace_file_ = new std::ofstream(generateTraceFile_.to_string());
+            if (binaryTrace_.to_bool()) {
+                trace_writer_ = new TraceWriter(generateTraceFile_.to_string(),
+                                                traceCompression_.to_bool());
+                if (!trace_writer_->isOpened()) {
+                    RISCV_error("Can't open trace file %s",
+                                generateTraceFile_.to_string());
+                }
+                trace_writer_->run();
+            } else {
+                trace_file_ = new std::ofstream(generateTraceFile_.to_string());
+            }
+            trace_ena_ = true;
         }
     }
 
@@ -180,17 +370,139 @@ void CpuGeneric::hapTriggered(EHapType type,
                               uint64_t param,
                               const char *descr) {
 	RISCV_unregister_hap(static_cast<IHap *>(this));
+    // Symbols are available only when all services were initialized
+    resolveIdleLoops();
     RISCV_event_set(&eventConfigDone_);
 }
 
 void CpuGeneric::busyLoop() {
     RISCV_event_wait(&eventConfigDone_);
+    simThreadId_ = RISCV_thread_id();
 
     while (isEnabled()) {
-        updatePipeline();
+        if (dbgreqState_.load(std::memory_order_relaxed) == DbgReq_Posted) {
+            serveDbgRequest();
+        }
+        if (mapGen_) {
+            memtlbCheckMap();
+        }
+        if (iquantum_ && (step_cnt_ >= quantumEnd_
+                        || quantumActive_ != isQuantumActive())) {
+            syncQuantum();
+            continue;
+        }
+        if (rhist_) {
+            updateHistory();
+        }
+        if (blockTotal_ && isBlockExecEnabled()) {
+            updateBlock();
+        } else {
+            updatePipeline();
+        }
+    }
+    if (iquantum_) {
+        // Don't hold other harts
+        iquantum_->syncQuantum(quantumIdx_, step_cnt_, false);
+    }
+}
+
+/**
+ * Report the hart state at the window boundary or on run/halt change and
+ * wait while other harts reach the window end. Debug requests are served
+ * while waiting.
+ */
+void CpuGeneric::syncQuantum() {
+    uint64_t end;
+    quantumActive_ = isQuantumActive();
+    end = iquantum_->syncQuantum(quantumIdx_, step_cnt_, quantumActive_);
+    while (end == 0 && isEnabled()) {
+        iquantum_->waitQuantum(quantumIdx_, 10);
+        if (dbgreqState_.load(std::memory_order_relaxed) == DbgReq_Posted) {
+            serveDbgRequest();
+        }
+        quantumActive_ = isQuantumActive();
+        end = iquantum_->syncQuantum(quantumIdx_, step_cnt_, quantumActive_);
+    }
+    quantumEnd_ = end;
+}
+
+uint64_t CpuGeneric::readRegDbg(uint32_t regno) {
+    DbgRegRequestType req;
+    req.write = false;
+    req.rewind = false;
+    req.flush = false;
+    req.regno = regno;
+    req.val = 0;
+    postDbgRequest(&req);
+    return req.val;
+}
+
+void CpuGeneric::writeRegDbg(uint32_t regno, uint64_t val) {
+    DbgRegRequestType req;
+    req.write = true;
+    req.rewind = false;
+    req.flush = false;
+    req.regno = regno;
+    req.val = val;
+    postDbgRequest(&req);
+}
+
+void CpuGeneric::execDbgRequest(DbgRegRequestType *req) {
+    if (req->rewind) {
+        req->val = rewind(req->val, static_cast<int>(req->regno)) ? 1 : 0;
+    } else if (req->flush) {
+        flushCaches(req->val);
+    } else if (req->write) {
+        uint64_t dbgctl = getDebugControl();
+        writeRegDbgDirect(req->regno, req->val);
+        if (dbgctl == getDebugControl()) {
+            reverseModified_ = true;
+        }
+    } else {
+        req->val = readRegDbgDirect(req->regno);
     }
 }
 
+/**
+ * Wait while the simulation thread executes request. Request is executed
+ * in the calling thread if the simulation thread isn't running or the
+ * access is initiated by the simulated CPU itself (via DMI region).
+ */
+void CpuGeneric::postDbgRequest(DbgRegRequestType *req) {
+    if (simThreadId_ == 0 || RISCV_thread_id() == simThreadId_) {
+        execDbgRequest(req);
+        return;
+    }
+
+    RISCV_mutex_lock(&mutex_dbgreq_);
+    RISCV_event_clear(&eventDbgReqDone_);
+    dbgreq_ = req;
+    dbgreqState_.store(DbgReq_Posted, std::memory_order_release);
+    while (dbgreqState_.load(std::memory_order_acquire) != DbgReq_Idle) {
+        RISCV_event_wait_ms(&eventDbgReqDone_, 10);
+        int posted = DbgReq_Posted;
+        if (!isEnabled()
+            && dbgreqState_.compare_exchange_strong(posted, DbgReq_Idle)) {
+            // Simulation thread was stopped
+            execDbgRequest(req);
+            break;
+        }
+    }
+    dbgreq_ = 0;
+    RISCV_mutex_unlock(&mutex_dbgreq_);
+}
+
+void CpuGeneric::serveDbgRequest() {
+    int posted = DbgReq_Posted;
+    if (!dbgreqState_.compare_exchange_strong(posted, DbgReq_Busy,
+                                              std::memory_order_acquire)) {
+        return;
+    }
+    execDbgRequest(dbgreq_);
+    dbgreqState_.store(DbgReq_Idle, std::memory_order_release);
+    RISCV_event_set(&eventDbgReqDone_);
+}
+
 void CpuGeneric::updatePipeline() {
     if (!updateState()) {
         return;
@@ -200,10 +512,18 @@ void CpuGeneric::updatePipeline() {
     branch_ = false;
     oplen_ = 0;
 
-    if (!isTriggerInstruction()) {
+    if (trigExecCnt_ == 0 || !isTriggerInstruction()) {
         fetchILine();
-        instr_ = decodeInstruction(cacheline_);
+        if (!instr_) {
+            instr_ = decodeInstruction(cacheline_);
+        }
 
+        if (flight_) {
+            flightStart(getPC(), cacheline_[0].buf32[0]);
+        }
+        if (prof_->isEnabled()) {
+            prof_->step(getPC(), instr_, cur_prv_level);
+        }
         trackContextStart();
         if (instr_) {
             oplen_ = instr_->exec(cacheline_);
@@ -211,6 +531,7 @@ void CpuGeneric::updatePipeline() {
             generateIllegalOpcode();
         }
         trackContextEnd();
+        flightCur_ = 0;
 
         pc_z_ = getPC();
     }
@@ -219,11 +540,19 @@ void CpuGeneric::updatePipeline() {
         setNPC(getPC() + oplen_);
     }
 
-    updateQueue();
+    if (step_cnt_ >= queue_.getNextTime()) {
+        updateQueue();
+    }
+
+    if (branch_ && idleEna_ && isIdleLoop(cacheline_)) {
+        skipIdleSteps();
+    }
 
     handleTrap();
 
-    if (trace_file_) {
+    if (trace_writer_) {
+        trace_writer_->writeStep(&trace_data_);
+    } else if (trace_file_) {
         traceOutput();
     }
 }
@@ -241,7 +570,7 @@ bool CpuGeneric::updateState() {
             resumereq_ = false;
             upd = true;
             resume();
-        } else {
+        } else if (step_cnt_ >= queue_.getNextTime()) {
             updateQueue();
         }
         break;
@@ -249,11 +578,19 @@ bool CpuGeneric::updateState() {
         if (haltreq_) {
             haltreq_ = false;
             upd = false;
-            halt(HALT_CAUSE_HALTREQ, "External Halt request");
-        } else if (isTriggerICount()) {
+            if (rewinding_ && step_cnt_ == reverseTarget_) {
+                haltRewind();
+            } else if (exitPending_) {
+                exitPending_ = false;
+                halt(HALT_CAUSE_HALTREQ, exitDescr_);
+                RISCV_trigger_hap(HAP_CpuExit, exitCode_, exitDescr_);
+            } else {
+                halt(HALT_CAUSE_HALTREQ, "External Halt request");
+            }
+        } else if (trigICount_ && isTriggerICount()) {
             upd = false;
             halt(HALT_CAUSE_TRIGGER, "Trigger icount hit");
-        } else if (isStepEnabled()) {
+        } else if (!rewinding_ && isStepEnabled()) {
             upd = false;
             halt(HALT_CAUSE_STEP, "Stepping breakpoint");
         }
@@ -270,7 +607,6 @@ bool CpuGeneric::updateState() {
 
 void CpuGeneric::updateQueue() {
     IFace *cb;
-    queue_.initProc();
     queue_.pushPreQueued();
 
     while ((cb = queue_.getNext(step_cnt_)) != 0) {
@@ -280,7 +616,7 @@ void CpuGeneric::updateQueue() {
 
 void CpuGeneric::fetchILine() {
     fetch_addr_ = fetchingAddress();
-    cachable_pc_ = false;
+    icacheItem_ = 0;
     instr_ = 0;
 
     if (estate_ == CORE_ProgbufExec) {
@@ -290,21 +626,45 @@ void CpuGeneric::fetchILine() {
         return;
     }
 
-    if ((fetch_addr_ & CACHE_MASK_) == CACHE_BASE_ADDR_) {
-        cachable_pc_ = true;
-        cache_offset_ = fetch_addr_ - CACHE_BASE_ADDR_;
-        instr_ = icache_[cache_offset_].instr;
-        cacheline_[0].buf32[0] = icache_[cache_offset_].buf;  // for tracer
+    if (vmemEna_) {
+        uint64_t vpage = fetch_addr_ >> VMEM_PAGE_BITS;
+        uint64_t poff = fetch_addr_ & ((1ull << VMEM_PAGE_BITS) - 1);
+        if (vpage == fetchVpage_) {
+            fetch_addr_ = fetchPbase_ | poff;
+        } else if (translateAddress(fetch_addr_, MemAccess_Fetch,
+                                    &fetch_addr_)) {
+            fetchVpage_ = vpage;
+            fetchPbase_ = fetch_addr_ & ~((1ull << VMEM_PAGE_BITS) - 1);
+        } else {
+            handleTrap();
+            setPC(getNPC());
+            fetchILine();
+            return;
+        }
+        if (poff > (1ull << VMEM_PAGE_BITS) - 4) {
+            fetchCrossPage();
+            return;
+        }
+    }
+
+    if (icachePagesMax_) {
+        uint64_t page = fetch_addr_ >> ICACHE_PAGE_BITS;
+        ICachePageType *p = icacheLast_;
+        if (p == 0 || p->page != page) {
+            p = icacheAlloc(page);
+        }
+        icacheItem_ = &p->item[(fetch_addr_ >> 1) & (ICACHE_PAGE_ITEMS - 1)];
+        instr_ = icacheItem_->instr;
+        cacheline_[0].buf32[0] = icacheItem_->buf;  // for tracer
     }
-    
 
     if (!instr_) {
         trans_.action = MemAction_Read;
-        trans_.addr = getPC();
+        trans_.addr = fetch_addr_;
         trans_.xsize = 4;
         trans_.wstrb = 0;
-        if (dma_memop(&trans_) == TRANS_ERROR) {
-            generateExceptionLoadInstruction(trans_.addr);
+        if (phys_memop(&trans_) == TRANS_ERROR) {
+            generateExceptionLoadInstruction(getPC());
             handleTrap();
             setPC(getNPC());
             fetchILine();
@@ -314,6 +674,35 @@ void CpuGeneric::fetchILine() {
     }
 }
 
+/**
+ * Instruction at the end of the translated page could continue on the
+ * next page mapped anywhere. Such instructions aren't cached.
+ */
+void CpuGeneric::fetchCrossPage() {
+    uint64_t pa = fetch_addr_;
+    cacheline_[0].val = 0;
+    for (unsigned off = 0; off < 4; off += 2) {
+        if (off && !translateAddress(getPC() + off, MemAccess_Fetch, &pa)) {
+            break;
+        }
+        trans_.action = MemAction_Read;
+        trans_.addr = pa;
+        trans_.xsize = 2;
+        trans_.wstrb = 0;
+        if (phys_memop(&trans_) == TRANS_ERROR) {
+            generateExceptionLoadInstruction(getPC() + off);
+            break;
+        }
+        cacheline_[0].buf16[off >> 1] = trans_.rpayload.b16[0];
+        if (off || getInstrLength(cacheline_) == 2) {
+            return;
+        }
+    }
+    handleTrap();
+    setPC(getNPC());
+    fetchILine();
+}
+
 void CpuGeneric::handleTrap() {
     checkStackProtection();
     if (exceptions_) {
@@ -324,28 +713,148 @@ void CpuGeneric::handleTrap() {
             e++;
         }
         exceptions_ &= ~(1ull << e);
+        if (prof_->isEnabled()) {
+            prof_->exception(e);
+        }
         handleException(e);
     } else {
         handleInterrupts();
     }
 }
 
+/**
+ * Decoded instructions and blocks are owned by the simulation thread, so
+ * that the debugger threads (loadelf, loadbin) post the flush request.
+ */
 void CpuGeneric::flush(uint64_t addr) {
-    if (icache_ == 0) {
-        return;
+    DbgRegRequestType req;
+    req.write = false;
+    req.rewind = false;
+    req.flush = true;
+    req.regno = 0;
+    req.val = addr;
+    postDbgRequest(&req);
+}
+
+void CpuGeneric::flushCaches(uint64_t addr) {
+    if (blockTotal_) {
+        if (addr == ~0ull) {
+            for (unsigned i = 0; i < blockTotal_; i++) {
+                blocks_[i].cnt = 0;
+            }
+            blockPagesReset();
+        } else {
+            invalidateBlocks(addr, 1);
+        }
     }
     if (addr == ~0ull) {
-        memset(icache_, 0, memcache_sz_*sizeof(ICacheType));
-    } else if ((addr & CACHE_MASK_) == CACHE_BASE_ADDR_) {
+        for (ICachePageType *p = icacheHead_; p; p = p->next) {
+            memset(p->item, 0, sizeof(p->item));
+        }
+        icacheItem_ = 0;
+    } else {
         /** SW breakpoint manager must call this flush operation */
-        if ((addr & CACHE_MASK_) == CACHE_BASE_ADDR_) {
-            icache_[addr - CACHE_BASE_ADDR_].instr = 0;
+        icacheInvalidate(addr, 4);
+    }
+}
+
+CpuGeneric::ICachePageType *CpuGeneric::icacheFind(uint64_t page) {
+    ICachePageType *p = icacheHash_[page & (ICACHE_HASH_SIZE - 1)];
+    while (p && p->page != page) {
+        p = p->hnext;
+    }
+    return p;
+}
+
+/**
+ * Get page for the fetch address. Allocated pages are moved into the head
+ * of the LRU list, the least recently used page is reused when the budget
+ * is exhausted.
+ */
+CpuGeneric::ICachePageType *CpuGeneric::icacheAlloc(uint64_t page) {
+    ICachePageType *p = icacheFind(page);
+    if (p) {
+        if (p != icacheHead_) {
+            // unlink
+            p->prev->next = p->next;
+            if (p->next) {
+                p->next->prev = p->prev;
+            } else {
+                icacheTail_ = p->prev;
+            }
+            p->prev = 0;
+            p->next = icacheHead_;
+            icacheHead_->prev = p;
+            icacheHead_ = p;
+        }
+        icacheLast_ = p;
+        return p;
+    }
+
+    memtlbCodePage(page);
+    if (icachePages_ < icachePagesMax_) {
+        p = new ICachePageType;
+        icachePages_++;
+    } else {
+        // Evict LRU page
+        p = icacheTail_;
+        icacheTail_ = p->prev;
+        if (icacheTail_) {
+            icacheTail_->next = 0;
+        } else {
+            icacheHead_ = 0;
+        }
+        ICachePageType **pp = &icacheHash_[p->page & (ICACHE_HASH_SIZE - 1)];
+        while (*pp != p) {
+            pp = &(*pp)->hnext;
+        }
+        *pp = p->hnext;
+    }
+    memset(p->item, 0, sizeof(p->item));
+    p->page = page;
+    p->hnext = icacheHash_[page & (ICACHE_HASH_SIZE - 1)];
+    icacheHash_[page & (ICACHE_HASH_SIZE - 1)] = p;
+    p->prev = 0;
+    p->next = icacheHead_;
+    if (icacheHead_) {
+        icacheHead_->prev = p;
+    } else {
+        icacheTail_ = p;
+    }
+    icacheHead_ = p;
+    icacheLast_ = p;
+    return p;
+}
+
+/**
+ * Drop decoded instructions overlapping the modified memory. Instruction
+ * could start up to 2 bytes before the address.
+ */
+void CpuGeneric::icacheInvalidate(uint64_t addr, uint64_t sz) {
+    uint64_t start = (addr - 2) & ~1ull;
+    uint64_t end = addr + sz;
+    ICachePageType *p = 0;
+    ICacheItemType *item;
+    for (uint64_t a = start; a < end; a += 2) {
+        if (p == 0 || p->page != (a >> ICACHE_PAGE_BITS)) {
+            p = icacheFind(a >> ICACHE_PAGE_BITS);
+            if (p == 0) {
+                // skip to the next page
+                a = (((a >> ICACHE_PAGE_BITS) + 1) << ICACHE_PAGE_BITS) - 2;
+                continue;
+            }
+        }
+        item = &p->item[(a >> 1) & (ICACHE_PAGE_ITEMS - 1)];
+        item->instr = 0;
+        if (item == icacheItem_) {
+            // Instruction modifies itself: do not put it back
+            icacheItem_ = 0;
         }
     }
 }
 
 void CpuGeneric::trackContextStart() {
-    if (!trace_file_) {
+    if (!trace_ena_) {
         return;
     }
     trace_data_.action_cnt = 0;
@@ -356,37 +865,49 @@ void CpuGeneric::trackContextStart() {
 
 void CpuGeneric::trackContextEnd() {
     if (do_not_cache_) {
-        if (cachable_pc_) {
-            icache_[cache_offset_].instr = 0;
+        if (icacheItem_) {
+            icacheItem_->instr = 0;
         }
     } else {
         if (icovtracker_) {
             icovtracker_->markAddress(fetch_addr_,
                                       static_cast<uint8_t>(oplen_));
         }
-        if (cachable_pc_) {
-            icache_[cache_offset_].instr = instr_;
-            icache_[cache_offset_].buf = cacheline_[0].buf32[0];
+        if (icacheItem_) {
+            icacheItem_->instr = instr_;
+            icacheItem_->buf = cacheline_[0].buf32[0];
         }
     }
     do_not_cache_ = false;
 }
 
 void CpuGeneric::traceRegister(int idx, uint64_t v) {
-    if (trace_data_.action_cnt >= 64) {
+    if (trace_data_.action_cnt >= TRACE_ACTIONS_MAX) {
         return;
     }
-    trace_action_type *p = &trace_data_.action[trace_data_.action_cnt++];
+    TraceActionType *p = &trace_data_.action[trace_data_.action_cnt++];
     p->memop = false;
     p->waddr = idx;
     p->wdata = v;
 }
 
 void CpuGeneric::traceMemop(uint64_t addr, int we, uint64_t v, uint32_t sz) {
-    if (trace_data_.action_cnt >= 64) {
+    if (trace_data_.action_cnt >= TRACE_ACTIONS_MAX) {
+        return;
+    }
+    TraceActionType *p = &trace_data_.action[trace_data_.action_cnt++];
+    p->memop = true;
+    p->memop_addr = addr;
+    p->memop_write = we;
+    p->memop_data.val = v;
+    p->memop_size = sz;
+}
+
+void CpuGeneric::flightMemop(uint64_t addr, int we, uint64_t v, uint32_t sz) {
+    if (flightCur_->action_cnt >= FLIGHT_ACTIONS_MAX) {
         return;
     }
-    trace_action_type *p = &trace_data_.action[trace_data_.action_cnt++];
+    TraceActionType *p = &flightCur_->action[flightCur_->action_cnt++];
     p->memop = true;
     p->memop_addr = addr;
     p->memop_write = we;
@@ -394,6 +915,186 @@ void CpuGeneric::traceMemop(uint64_t addr, int we, uint64_t v, uint32_t sz) {
     p->memop_size = sz;
 }
 
+void CpuGeneric::getFlightRecords(unsigned cnt, AttributeType *res) {
+    uint64_t total = flightCnt_;
+    res->make_list(0);
+    if (!flight_) {
+        return;
+    }
+    if (total > flightMask_ + 1) {
+        total = flightMask_ + 1;
+    }
+    if (cnt == 0 || cnt > total) {
+        cnt = static_cast<unsigned>(total);
+    }
+
+    AttributeType item, mnemonic, comment;
+    res->make_list(cnt);
+    for (unsigned i = 0; i < cnt; i++) {
+        FlightRecordType *p = &flight_[(flightCnt_ - cnt + i) & flightMask_];
+        item.make_list(5);
+        AttributeType &actions = item[4];
+        item[0u].make_uint64(p->step);
+        item[1].make_uint64(p->pc);
+        item[2].make_uint64(p->instr);
+        if (p->block) {
+            item[3].make_string("block");
+        } else if (isrc_) {
+            isrc_->disasm(p->pc, reinterpret_cast<uint8_t *>(&p->instr), 0,
+                          &mnemonic, &comment);
+            item[3].make_string(mnemonic.to_string());
+        } else {
+            item[3].make_string("");
+        }
+        actions.make_list(p->action_cnt);
+        for (int n = 0; n < p->action_cnt; n++) {
+            TraceActionType *a = &p->action[n];
+            if (a->memop) {
+                actions[n].make_list(4);
+                actions[n][0u].make_string(a->memop_write ? "st" : "ld");
+                actions[n][1].make_uint64(a->memop_addr);
+                actions[n][2].make_uint64(a->memop_data.val);
+                actions[n][3].make_uint64(a->memop_size);
+            } else {
+                actions[n].make_list(3);
+                actions[n][0u].make_string("reg");
+                actions[n][1].make_uint64(a->waddr);
+                actions[n][2].make_uint64(a->wdata);
+            }
+        }
+        (*res)[i] = item;
+    }
+}
+
+/**
+ * State of the halted hart. Clock events are stored with the name of the
+ * listener service so that they can be restored in another process.
+ */
+void CpuGeneric::saveState(CheckpointState *state) {
+    AttributeType listeners;
+    IService *iserv;
+    IFace *cb;
+    uint64_t t;
+    RISCV_get_services_with_iface(IFACE_CLOCK_LISTENER, &listeners);
+
+    state->write64(estate_);
+    state->write64(step_cnt_);
+    state->write64(idleStepCnt_);
+    state->write64(cur_prv_level);
+    state->write64(exceptions_);
+    state->write(interrupt_pending_, sizeof(interrupt_pending_));
+    state->write(ctxregs_, sizeof(ctxregs_));
+    portRegs_.saveRegisters(state);
+    portCSR_.saveRegisters(state);
+    stackTraceCnt_.saveRegisters(state);
+    stackTraceBuf_.saveRegisters(state);
+    state->write64(triggersTotal_.to_uint64());
+    state->write(ptriggers_,
+                 triggersTotal_.to_int()*sizeof(TriggerStorageType));
+
+    // Events of the reverse execution are restored by the history itself
+    int total = queue_.getTotal();
+    int saved = 0;
+    for (int i = 0; i < total; i++) {
+        queue_.getItem(i, &t, &cb);
+        if (cb != &reverseInput_ && cb != &reverseHalt_
+            && cb != &exitLimit_) {
+            saved++;
+        }
+    }
+    state->write64(saved);
+    for (int i = 0; i < total; i++) {
+        const char *name = "";
+        queue_.getItem(i, &t, &cb);
+        if (cb == &reverseInput_ || cb == &reverseHalt_
+            || cb == &exitLimit_) {
+            continue;
+        }
+        for (unsigned n = 0; n < listeners.size(); n++) {
+            iserv = static_cast<IService *>(listeners[n].to_iface());
+            if (iserv->getInterface(IFACE_CLOCK_LISTENER) == cb) {
+                name = iserv->getObjName();
+                break;
+            }
+        }
+        state->write64(t);
+        state->write64(reinterpret_cast<uintptr_t>(cb));
+        state->write64(strlen(name));
+        state->write(name, strlen(name));
+    }
+}
+
+bool CpuGeneric::restoreState(CheckpointState *state) {
+    char name[256];
+    IFace *cb;
+    uint64_t t, ptr, len;
+
+    estate_ = static_cast<ECoreState>(state->read64());
+    step_cnt_ = state->read64();
+    idleStepCnt_ = state->read64();
+    cur_prv_level = state->read64();
+    exceptions_ = state->read64();
+    state->read(interrupt_pending_, sizeof(interrupt_pending_));
+    state->read(ctxregs_, sizeof(ctxregs_));
+    portRegs_.restoreRegisters(state);
+    portCSR_.restoreRegisters(state);
+    stackTraceCnt_.restoreRegisters(state);
+    stackTraceBuf_.restoreRegisters(state);
+    if (state->read64() != triggersTotal_.to_uint64()) {
+        RISCV_error("Checkpoint triggers number mismatch", 0);
+        return false;
+    }
+    state->read(ptriggers_,
+                triggersTotal_.to_int()*sizeof(TriggerStorageType));
+    updateTriggers();
+
+    queue_.hardReset();
+    uint64_t total = state->read64();
+    for (uint64_t i = 0; i < total; i++) {
+        t = state->read64();
+        ptr = state->read64();
+        len = state->read64();
+        if (len >= sizeof(name) || !state->read(name, len)) {
+            RISCV_error("Wrong checkpoint clock events", 0);
+            return false;
+        }
+        name[len] = '\0';
+        cb = 0;
+        if (len) {
+            cb = static_cast<IFace *>(
+                RISCV_get_service_iface(name, IFACE_CLOCK_LISTENER));
+        } else if (state->isLocal()) {
+            cb = reinterpret_cast<IFace *>(static_cast<uintptr_t>(ptr));
+        }
+        if (cb) {
+            queue_.put(t, cb);
+        } else {
+            RISCV_error("Clock event at %" RV_PRI64 "d can't be restored", t);
+        }
+    }
+
+    // Memory content was changed: drop decoded and translated code
+    flush(~0ull);
+    memtlbFlush();
+    resvtbl_->release(sysBusMasterID_.to_int(), 0);
+    pc_z_ = getPC();
+    flightCnt_ = 0;
+    quantumEnd_ = 0;
+
+    if (rhist_) {
+        if (!rewinding_) {
+            // Checkpoint starts another history
+            rhist_->reset();
+            reverseFrontier_ = step_cnt_;
+            reverseNext_ = step_cnt_;
+        }
+        reverseModified_ = false;
+        reverseInputNext_ = ~0ull;
+        scheduleInputs(rhist_->seekInputs(step_cnt_));
+    }
+    return true;
+}
+
 void CpuGeneric::registerStepCallback(IClockListener *cb,
                                                uint64_t t) {
     if (!isEnabled() && t <= step_cnt_) {
@@ -411,9 +1112,233 @@ bool CpuGeneric::moveStepCallback(IClockListener *cb, uint64_t t) {
     return false;
 }
 
+/**
+ * Inputs are accepted by the simulation thread and logged with the step
+ * of delivery so that the re-executed history receives them on the same
+ * steps.
+ */
+void CpuGeneric::postInput(IClockInput *dev, const char *buf, int sz) {
+    if (!rhist_) {
+        dev->clockInput(buf, sz);
+        return;
+    }
+    rhist_->postInput(dev, buf, sz);
+}
+
+void CpuGeneric::ReverseInputListener::stepCallback(uint64_t t) {
+    p_->reverseInputNext_ = ~0ull;
+    p_->scheduleInputs(p_->rhist_->deliverInputs(t));
+}
+
+void CpuGeneric::ReverseHaltListener::stepCallback(uint64_t t) {
+    if (p_->rewinding_ && t == p_->reverseTarget_) {
+        p_->haltreq_ = true;
+    }
+}
+
+void CpuGeneric::ExitLimitListener::stepCallback(uint64_t t) {
+    if (t == p_->stepLimit_.to_uint64()) {
+        p_->requestExit(~0ull, "Step limit reached");
+    }
+}
+
+void CpuGeneric::scheduleInputs(uint64_t t) {
+    if (t == ~0ull || t >= reverseInputNext_) {
+        return;
+    }
+    reverseInputNext_ = t;
+    moveStepCallback(&reverseInput_, t);
+}
+
+/**
+ * Called between instructions: periodic snapshots, inputs acceptance and
+ * breakpoints scanning of the re-executed history.
+ */
+void CpuGeneric::updateHistory() {
+    if (estate_ != CORE_Normal) {
+        return;
+    }
+    if (scanType_ == Scan_Breakpoint && rewinding_) {
+        for (int i = 0; i < scanBpTotal_; i++) {
+            if (scanBp_[i] == getNPC()) {
+                scanHit_ = step_cnt_;
+                break;
+            }
+        }
+    }
+    if (step_cnt_ >= reverseFrontier_) {
+        reverseFrontier_ = step_cnt_;
+        if (rhist_->isInputPosted()) {
+            rhist_->acceptInputs(step_cnt_ + 1);
+            scheduleInputs(step_cnt_ + 1);
+        }
+    }
+    if (step_cnt_ >= reverseNext_ && scanType_ == Scan_None) {
+        uint64_t interval = reverseInterval_.to_uint64();
+        rhist_->takeSnapshot(step_cnt_, reverseFrontier_, interval / 2,
+                             false);
+        reverseNext_ = step_cnt_ + interval;
+    }
+}
+
+/**
+ * Restore the snapshot (the latest before the target if 'idx' < 0) and
+ * re-execute the history up to the target step.
+ */
+bool CpuGeneric::rewind(uint64_t target, int idx) {
+    if (!rhist_ || estate_ != CORE_Halted || target > reverseFrontier_) {
+        return false;
+    }
+    if (idx < 0) {
+        idx = rhist_->findSnapshot(target);
+    }
+    if (idx < 0 || idx >= rhist_->snapshotTotal()
+        || rhist_->snapshotStep(idx) > target) {
+        return false;
+    }
+    reverseDbgCtl_ = getDebugControl();
+    memcpy(reverseTrig_, ptriggers_,
+           triggersTotal_.to_int()*sizeof(TriggerStorageType));
+
+    rewinding_ = true;
+    if (!rhist_->restoreSnapshot(idx)) {
+        rewinding_ = false;
+        RISCV_error("Snapshot at %" RV_PRI64 "d can't be restored",
+                    rhist_->snapshotStep(idx));
+        return false;
+    }
+    reverseNext_ = step_cnt_ + reverseInterval_.to_uint64();
+    reverseTarget_ = target;
+    // Debugger triggers are restored on target
+    trigExecCnt_ = 0;
+    trigICount_ = false;
+    estate_ = CORE_Normal;
+    if (step_cnt_ == target) {
+        updateHistory();
+        haltRewind();
+    } else {
+        moveStepCallback(&reverseHalt_, target);
+    }
+    return true;
+}
+
+void CpuGeneric::finishRewind() {
+    rewinding_ = false;
+    reverseTarget_ = ~0ull;
+    memcpy(ptriggers_, reverseTrig_,
+           triggersTotal_.to_int()*sizeof(TriggerStorageType));
+    updateTriggers();
+    setDebugControl(reverseDbgCtl_);
+}
+
+/** Intermediate halts of the history scanning aren't reported */
+void CpuGeneric::haltRewind() {
+    finishRewind();
+    if (scanType_ != Scan_None) {
+        estate_ = CORE_Halted;
+    } else {
+        halt(HALT_CAUSE_STEP, "Reverse execution");
+    }
+}
+
+bool CpuGeneric::postRewind(uint64_t target, int idx) {
+    DbgRegRequestType req;
+    req.write = false;
+    req.rewind = true;
+    req.flush = false;
+    req.regno = static_cast<uint32_t>(idx);
+    req.val = target;
+    postDbgRequest(&req);
+    if (req.val == 0) {
+        return false;
+    }
+    while (!isHalted() && isEnabled()) {
+        RISCV_sleep_ms(1);
+    }
+    return isHalted();
+}
+
+bool CpuGeneric::reverseGoto(uint64_t step) {
+    if (!rhist_ || !isHalted()) {
+        return false;
+    }
+    return postRewind(step, -1);
+}
+
+/**
+ * The history is scanned backward by segments between snapshots, each
+ * segment is re-executed with per instruction checks and the latest hit
+ * is taken.
+ */
+bool CpuGeneric::reverseFind(EReverseScan type, uint64_t addr, uint64_t sz,
+                             uint64_t *step) {
+    if (!rhist_ || !isHalted() || rhist_->snapshotTotal() == 0) {
+        return false;
+    }
+    uint64_t cur = step_cnt_;
+    *step = rhist_->snapshotStep(0);
+    if (type == Scan_Breakpoint) {
+        AttributeType brlist;
+        isrc_->getBreakpointList(&brlist);
+        if (scanBp_) {
+            delete [] scanBp_;
+        }
+        scanBp_ = new uint64_t[brlist.size() + 1];
+        scanBpTotal_ = 0;
+        for (unsigned i = 0; i < brlist.size(); i++) {
+            scanBp_[scanBpTotal_++] = brlist[i][BrkList_address].to_uint64();
+        }
+    }
+    scanAddr_ = addr;
+    scanSize_ = sz;
+    scanType_ = type;
+
+    bool found = false;
+    uint64_t end = type == Scan_Write ? cur : cur - 1;
+    int idx = cur ? rhist_->findSnapshot(cur - 1) : -1;
+    while (idx >= 0) {
+        uint64_t s = rhist_->snapshotStep(idx);
+        scanHit_ = ~0ull;
+        if (!postRewind(end, idx)) {
+            break;
+        }
+        if (scanHit_ != ~0ull) {
+            *step = scanHit_;
+            found = true;
+            break;
+        }
+        end = type == Scan_Write ? s : s - 1;
+        idx = s ? rhist_->findSnapshot(s - 1) : -1;
+    }
+    scanType_ = Scan_None;
+    return found;
+}
+
+void CpuGeneric::getReverseInfo(AttributeType *res) {
+    res->make_list(5);
+    (*res)[0u].make_uint64(reverseFrontier_);
+    (*res)[1].make_uint64(step_cnt_);
+    if (!rhist_) {
+        (*res)[2].make_uint64(0);
+        (*res)[3].make_uint64(0);
+        (*res)[4].make_uint64(0);
+        return;
+    }
+    (*res)[2].make_uint64(rhist_->snapshotTotal());
+    if (rhist_->snapshotTotal()) {
+        (*res)[3].make_uint64(rhist_->snapshotStep(0));
+    } else {
+        (*res)[3].make_uint64(0);
+    }
+    (*res)[4].make_uint64(rhist_->inputTotal());
+}
+
 void CpuGeneric::setReg(int idx, uint64_t val) {
     R[idx] = val;
-    if (trace_file_) {
+    if (flightCur_) {
+        flightRegister(idx, val);
+    }
+    if (trace_ena_) {
         traceRegister(idx, val);
     }
 }
@@ -424,6 +1349,9 @@ void CpuGeneric::setBranch(uint64_t npc) {
 }
 
 void CpuGeneric::pushStackTrace() {
+    if (prof_->isEnabled()) {
+        prof_->call(getNPC());
+    }
     int cnt = static_cast<int>(stackTraceCnt_.getValue().val);
     if (cnt >= stackTraceSize_.to_int()) {
         return;
@@ -434,16 +1362,59 @@ void CpuGeneric::pushStackTrace() {
 }
 
 void CpuGeneric::popStackTrace() {
+    if (prof_->isEnabled()) {
+        prof_->ret();
+    }
     uint64_t cnt = stackTraceCnt_.getValue().val;
     if (cnt) {
         stackTraceCnt_.setValue(cnt - 1);
     }
 }
 
+/**
+ * Data access of the instruction. Access isn't performed if the address
+ * translation raised the page fault.
+ */
 ETransStatus CpuGeneric::dma_memop(Axi4TransactionType *tr) {
+    if (!vmemEna_) {
+        return phys_memop(tr);
+    }
+    uint64_t va = tr->addr;
+    EMemAccessType acc = tr->action == MemAction_Write ? MemAccess_Store
+                                                       : MemAccess_Load;
+    if (!translateAddress(va, acc, &tr->addr)) {
+        tr->addr = va;
+        tr->rpayload.b64[0] = 0;
+        return TRANS_OK;
+    }
+    ETransStatus ret = phys_memop(tr);
+    tr->addr = va;
+    return ret;
+}
+
+ETransStatus CpuGeneric::dma_cmpxchg(Axi4TransactionType *tr,
+                                     bool *success) {
+    if (!vmemEna_) {
+        return phys_cmpxchg(tr, success);
+    }
+    uint64_t va = tr->addr;
+    if (!translateAddress(va, MemAccess_Store, &tr->addr)) {
+        // Reported as stored to break the retry loops of AMO
+        tr->addr = va;
+        *success = true;
+        return TRANS_OK;
+    }
+    ETransStatus ret = phys_cmpxchg(tr, success);
+    tr->addr = va;
+    return ret;
+}
+
+ETransStatus CpuGeneric::phys_memop(Axi4TransactionType *tr) {
     ETransStatus ret = TRANS_OK;
     tr->source_idx = sysBusMasterID_.to_int();
-    if (tr->xsize <= sysBusWidthBytes_.to_uint32()) {
+    if (memtlbEna_ && memtlbAccess(tr)) {
+        // RAM access without bus transport
+    } else if (tr->xsize <= sysBusWidthBytes_.to_uint32()) {
         ret = isysbus_->b_transport(tr);
     } else {
         // 1-byte access for HC08
@@ -463,7 +1434,20 @@ ETransStatus CpuGeneric::dma_memop(Axi4TransactionType *tr) {
         }
     }
 
-    if (trace_file_) {
+    if (tr->action == MemAction_Write) {
+        memopWritten(tr->addr, tr->xsize);
+        if (tr->addr == exitAddr_ && exitType_ == Exit_Tohost
+            && (tr->wpayload.b64[0] & 0x1)) {
+            // riscv-tests: 1 = pass, otherwise (test number << 1) | 1
+            uint64_t v = tr->wpayload.b64[0];
+            if (tr->xsize < 8) {
+                v &= (1ull << (8 * tr->xsize)) - 1;
+            }
+            requestExit(v >> 1, "Exit by tohost");
+        }
+    }
+
+    if (trace_ena_ || flightCur_) {
         int we = tr->action == MemAction_Write ? 1 : 0;
         Reg64Type memop_data;
         memop_data.val = 0;
@@ -472,16 +1456,225 @@ ETransStatus CpuGeneric::dma_memop(Axi4TransactionType *tr) {
         } else {
             memcpy(memop_data.buf, tr->wpayload.b8, tr->xsize);
         }
-        traceMemop(tr->addr, we,  memop_data.val, tr->xsize);
+        if (flightCur_) {
+            flightMemop(tr->addr, we,  memop_data.val, tr->xsize);
+        }
+        if (trace_ena_) {
+            traceMemop(tr->addr, we,  memop_data.val, tr->xsize);
+        }
     }
     return ret;
 }
 
+/**
+ * Compare-and-swap used by the atomic instructions. RAM shared by harts
+ * running in different host threads is modified by the host atomic
+ * operation, device registers are accessed with two transactions.
+ *
+ * @param tr rpayload is the expected value and wpayload is the new one,
+ *           on return rpayload contains the value read from memory.
+ */
+ETransStatus CpuGeneric::phys_cmpxchg(Axi4TransactionType *tr,
+                                      bool *success) {
+    ETransStatus ret = TRANS_OK;
+    MemTlbType *e = memtlbEntry(tr->addr, tr->xsize);
+    *success = false;
+    tr->source_idx = sysBusMasterID_.to_int();
+    if (e && !e->readonly && (tr->xsize == 4 || tr->xsize == 8)
+        && (tr->addr & (tr->xsize - 1)) == 0) {
+        uint8_t *p = &e->ptr[tr->addr & ((1ull << MEMTLB_PAGE_BITS) - 1)];
+        if (tr->xsize == 4) {
+            uint32_t v = tr->rpayload.b32[0];
+            *success = reinterpret_cast<std::atomic<uint32_t> *>(p)->
+                    compare_exchange_strong(v, tr->wpayload.b32[0]);
+            tr->rpayload.b64[0] = v;
+        } else {
+            uint64_t v = tr->rpayload.b64[0];
+            *success = reinterpret_cast<std::atomic<uint64_t> *>(p)->
+                    compare_exchange_strong(v, tr->wpayload.b64[0]);
+            tr->rpayload.b64[0] = v;
+        }
+        tr->response = MemResp_Valid;
+        if (*success) {
+            if (e->dirty) {
+                *e->dirty = 1;
+            }
+            memopWritten(tr->addr, tr->xsize);
+            if (trace_ena_ || flightCur_) {
+                Reg64Type memop_data;
+                memop_data.val = 0;
+                memcpy(memop_data.buf, tr->wpayload.b8, tr->xsize);
+                if (flightCur_) {
+                    flightMemop(tr->addr, 1, memop_data.val, tr->xsize);
+                }
+                if (trace_ena_) {
+                    traceMemop(tr->addr, 1, memop_data.val, tr->xsize);
+                }
+            }
+        }
+        return ret;
+    }
+
+    Axi4TransactionType tr1 = *tr;
+    tr1.action = MemAction_Read;
+    ret = phys_memop(&tr1);
+    if (ret == TRANS_OK
+        && memcmp(tr1.rpayload.b8, tr->rpayload.b8, tr->xsize) == 0) {
+        tr->action = MemAction_Write;
+        tr->wstrb = (1 << tr->xsize) - 1;
+        ret = phys_memop(tr);
+        *success = ret == TRANS_OK;
+    }
+    tr->rpayload = tr1.rpayload;
+    return ret;
+}
+
+/** Self-modifying code and reservations of other harts */
+void CpuGeneric::memopWritten(uint64_t addr, uint32_t sz) {
+    // Plain page has no decoded code, data stores skip the lookups
+    uint64_t page = addr >> MEMTLB_PAGE_BITS;
+    MemTlbType *e = &memtlb_[page & (MEMTLB_SIZE - 1)];
+    bool plain = e->page == page && e->plain
+        && ((addr + sz - 1) >> MEMTLB_PAGE_BITS) == page;
+    if (icachePages_ && !plain) {
+        icacheInvalidate(addr, sz);
+    }
+    if (blockTotal_ && !plain) {
+        invalidateBlocks(addr, sz);
+    }
+    resvtbl_->invalidate(sysBusMasterID_.to_int(), addr, sz);
+    if (scanType_ == Scan_Write && addr < scanAddr_ + scanSize_
+        && scanAddr_ < addr + sz) {
+        scanHit_ = step_cnt_;
+    }
+}
+
+void CpuGeneric::memtlbFlush() {
+    for (int i = 0; i < MEMTLB_SIZE; i++) {
+        memtlb_[i].page = ~0ull;
+        memtlb_[i].ptr = 0;
+        memtlb_[i].readonly = true;
+        memtlb_[i].plain = false;
+        memtlb_[i].dirty = 0;
+    }
+}
+
+/** Decoded instructions appeared on the page */
+void CpuGeneric::memtlbCodePage(uint64_t page) {
+    MemTlbType *e = &memtlb_[page & (MEMTLB_SIZE - 1)];
+    if (e->page == page) {
+        e->plain = false;
+    }
+}
+
+/**
+ * Host pointers are valid only for the bus map they were taken from. The
+ * map compiled on HAP_ConfigDone may be published after this hart started
+ * and cached the empty-map pages as MMIO.
+ */
+void CpuGeneric::memtlbCheckMap() {
+    uint32_t gen = mapGen_->load(std::memory_order_acquire);
+    if (gen != memtlbGen_) {
+        memtlbGen_ = gen;
+        memtlbFlush();
+    }
+}
+
+/**
+ * @return entry with the host pointer of the page or 0 if the access
+ *         requires bus transport
+ */
+CpuGeneric::MemTlbType *CpuGeneric::memtlbEntry(uint64_t addr, uint32_t sz) {
+    uint64_t page = addr >> MEMTLB_PAGE_BITS;
+    if (sz > PAYLOAD_MAX_BYTES
+        || ((addr + sz - 1) >> MEMTLB_PAGE_BITS) != page) {
+        return 0;
+    }
+
+    MemTlbType *e = &memtlb_[page & (MEMTLB_SIZE - 1)];
+    if (e->page != page) {
+        HostMemoryRangeType range;
+        uint64_t paddr = page << MEMTLB_PAGE_BITS;
+        uint64_t psize = 1ull << MEMTLB_PAGE_BITS;
+        e->page = page;
+        e->ptr = 0;
+        e->readonly = true;
+        e->plain = false;
+        e->dirty = 0;
+        range.dirty = 0;
+        if (isysbus_->getHostMemory(paddr, &range)
+            && range.addr <= paddr
+            && paddr + psize <= range.addr + range.size) {
+            e->ptr = range.ptr + (paddr - range.addr);
+            e->readonly = range.readonly;
+            // Page without decoded code and exit address, memtlbCodePage()
+            // clears the flag when code is decoded later.
+            e->plain = !e->readonly
+                && !(icachePages_ && icacheFind(page))
+                && !(blockTotal_ && blockPageFind(page))
+                && !(exitType_ == Exit_Tohost
+                    && (exitAddr_ >> MEMTLB_PAGE_BITS) == page);
+            if (range.dirty) {
+                e->dirty = &range.dirty[(paddr - range.addr)
+                                        >> CheckpointPageType::PAGE_BITS];
+            }
+        }
+    }
+    if (e->ptr == 0) {
+        return 0;
+    }
+    return e;
+}
+
+/**
+ * @return true if the transaction was served from the host memory
+ */
+bool CpuGeneric::memtlbAccess(Axi4TransactionType *tr) {
+    MemTlbType *e = memtlbEntry(tr->addr, tr->xsize);
+    if (e == 0) {
+        return false;
+    }
+
+    uint8_t *p = &e->ptr[tr->addr & ((1ull << MEMTLB_PAGE_BITS) - 1)];
+    if (tr->action == MemAction_Read) {
+        tr->rpayload.b64[0] = 0;
+        memcpy(tr->rpayload.b8, p, tr->xsize);
+    } else {
+        if (e->readonly) {
+            // Error reporting
+            return false;
+        }
+        if (((1ul << tr->xsize) - 1) == tr->wstrb) {
+            memcpy(p, tr->wpayload.b8, tr->xsize);
+        } else {
+            for (uint32_t i = 0; i < tr->xsize; i++) {
+                if ((tr->wstrb >> i) & 0x1) {
+                    p[i] = tr->wpayload.b8[i];
+                }
+            }
+        }
+        if (e->dirty) {
+            *e->dirty = 1;
+        }
+    }
+    tr->response = MemResp_Valid;
+    return true;
+}
+
 void CpuGeneric::resume() {
     if (estate_ == CORE_OFF) {
         RISCV_error("CPU is turned-off", 0);
     }
     estate_ = CORE_Normal;
+    resolveExit();
+    if (rhist_ && reverseModified_) {
+        // Recorded future isn't valid anymore and the re-executed history
+        // should pass through the modified state
+        rhist_->truncate(step_cnt_);
+        reverseFrontier_ = step_cnt_;
+        rhist_->takeSnapshot(step_cnt_, reverseFrontier_, 0, true);
+        reverseModified_ = false;
+    }
 }
 
 void CpuGeneric::halt(uint32_t cause, const char *descr) {
@@ -489,6 +1682,9 @@ void CpuGeneric::halt(uint32_t cause, const char *descr) {
         RISCV_error("CPU is turned-off", 0);
         return;
     }
+    if (rewinding_) {
+        finishRewind();
+    }
     char strop[32];
     uint8_t tbyte;
     unsigned bytetot = oplen_;
@@ -523,6 +1719,7 @@ void CpuGeneric::halt(uint32_t cause, const char *descr) {
 bool CpuGeneric::isTriggerICount() {
     bool ret = false;
     TriggerStorageType *pt;
+    trigEvalCnt_++;
     for (unsigned i = 0; i < triggersTotal_.to_uint32(); i++) {
         pt = &ptriggers_[i];
         if (pt->data1.bitsdef.type == TriggerType_InstrCountMatch) {
@@ -558,6 +1755,7 @@ void CpuGeneric::power(EPowerAction onoff) {
 
 void CpuGeneric::reset(IFace *isource) {
     flush(~0ull);
+    memtlbFlush();
     /** Reset address can be changed in runtime */
     portRegs_.reset();
     setPC(getResetAddress());
@@ -567,23 +1765,130 @@ void CpuGeneric::reset(IFace *isource) {
         memset(ptriggers_,
                0,
                triggersTotal_.to_int()*sizeof(TriggerStorageType));
+        updateTriggers();
     }
     stackTraceCnt_.reset(isource);
     interrupt_pending_[0] = 0;
     interrupt_pending_[1] = 0;
     do_not_cache_ = false;
+    reverseModified_ = true;
 }
 
-bool CpuGeneric::isTriggerInstruction() {
-    uint64_t pc = getPC();
+/**
+ * Resolve IdleLoops entries: integer addresses or symbol names of the
+ * loops that spin until an interrupt, e.g. idle task or polling of a flag
+ * modified by an interrupt handler.
+ */
+void CpuGeneric::resolveIdleLoops() {
+    uint64_t addr;
+    idleEna_ = idleFastForward_.to_bool();
+    idleAddrTotal_ = 0;
+    if (!idleLoops_.is_list() || idleLoops_.size() == 0) {
+        return;
+    }
+    idleAddr_ = new uint64_t[idleLoops_.size()];
+    for (unsigned i = 0; i < idleLoops_.size(); i++) {
+        AttributeType &item = idleLoops_[i];
+        if (item.is_integer()) {
+            idleAddr_[idleAddrTotal_++] = item.to_uint64();
+        } else if (item.is_string() && isrc_
+            && isrc_->symbol2Address(item.to_string(), &addr) >= 0) {
+            idleAddr_[idleAddrTotal_++] = addr;
+        } else {
+            RISCV_error("Idle loop '%s' not resolved", item.to_string());
+        }
+    }
+}
+
+/**
+ * Exit symbols are resolved on each resume because the ELF-file is usually
+ * loaded after the configuration was done.
+ */
+void CpuGeneric::resolveExit() {
+    uint64_t limit = stepLimit_.to_uint64();
+    if (limit && step_cnt_ < limit) {
+        moveStepCallback(&exitLimit_, limit);
+    }
+    exitAddr_ = ~0ull;
+    if (exitType_ != Exit_Tohost && exitType_ != Exit_Break) {
+        return;
+    }
+    const char *symb = exitType_ == Exit_Tohost ? "tohost"
+                                                : exitCondition_.to_string();
+    if (!isrc_ || isrc_->symbol2Address(symb, &exitAddr_) < 0) {
+        exitAddr_ = ~0ull;
+        RISCV_error("Exit symbol '%s' not resolved", symb);
+    }
+}
+
+/**
+ * Exit is detected inside of the instruction, hart halts before the next
+ * one and notifies the batch runner.
+ */
+void CpuGeneric::requestExit(uint64_t code, const char *descr) {
+    exitCode_ = code;
+    exitDescr_ = descr;
+    exitPending_ = true;
+    haltreq_ = true;
+}
+
+/**
+ * Called after taken branch: instruction jumped to itself or to the
+ * configured idle loop address.
+ */
+bool CpuGeneric::isIdleLoop(Reg64Type *payload) {
+    uint64_t npc = getNPC();
+    if (npc == getPC()) {
+        return payload && isIdleInstruction(payload);
+    }
+    for (int i = 0; i < idleAddrTotal_; i++) {
+        if (idleAddr_[i] == npc) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Nothing except clock event or interrupt could break idle loop so move
+ * the step counter directly to the next event. Skipped steps are counted
+ * as cycles and time but not as retired instructions.
+ */
+void CpuGeneric::skipIdleSteps() {
+    if (estate_ != CORE_Normal || exceptions_ || haltreq_
+        || isInterruptPending()) {
+        return;
+    }
+    uint64_t t = queue_.getNextTime();
+    if (t == ~0ull || t <= step_cnt_) {
+        return;
+    }
+    if (prof_->isEnabled()) {
+        prof_->idle(t - step_cnt_, cur_prv_level);
+    }
+    idleStepCnt_ += t - step_cnt_;
+    step_cnt_ = t;
+    updateQueue();
+}
 
+/**
+ * Select armed triggers and precompute NAPOT masks so that the simulation
+ * loop doesn't check triggers at all while nothing is armed.
+ */
+void CpuGeneric::updateTriggers() {
     TriggerData1Type::bits_type2 *pt;
-    bool fire = false;
-    uint64_t action = 0;
+    TriggerMatchType *pm;
     uint64_t mask;
     int tcnt;
+
+    trigExecCnt_ = 0;
+    trigICount_ = false;
     for (int i = 0; i < triggersTotal_.to_int(); i++) {
         pt = &ptriggers_[i].data1.mcontrol_bits;
+        if (pt->type == TriggerType_InstrCountMatch) {
+            trigICount_ = true;
+            continue;
+        }
         if (pt->type != TriggerType_AddrDataMatch) {
             continue;
         }
@@ -595,13 +1900,10 @@ bool CpuGeneric::isTriggerInstruction() {
             continue;
         }
 
-        switch (pt->match) {
-        case 0:
-            if (pc == ptriggers_[i].data2) {
-                pt->hit = 1;
-            }
-            break;
-        case 1:
+        pm = &trigExec_[trigExecCnt_++];
+        pm->trig = &ptriggers_[i];
+        pm->mask = 0;
+        if (pt->match == 1) {
             mask = 1;
             tcnt = 0;
             while ((tcnt < mcontrolMaskmax_.to_int())
@@ -609,30 +1911,55 @@ bool CpuGeneric::isTriggerInstruction() {
                 mask <<= 1;
                 tcnt++;
             }
-            mask = ~(mask - 1);
-            if ((pc & mask) == (ptriggers_[i].data2 & mask)) {
+            pm->mask = ~(mask - 1);
+        }
+    }
+}
+
+bool CpuGeneric::isTriggerInstruction() {
+    uint64_t pc = getPC();
+
+    TriggerData1Type::bits_type2 *pt;
+    TriggerStorageType *ptrig;
+    bool fire = false;
+    uint64_t action = 0;
+    uint64_t mask;
+    trigEvalCnt_++;
+    for (int i = 0; i < trigExecCnt_; i++) {
+        ptrig = trigExec_[i].trig;
+        pt = &ptrig->data1.mcontrol_bits;
+
+        switch (pt->match) {
+        case 0:
+            if (pc == ptrig->data2) {
+                pt->hit = 1;
+            }
+            break;
+        case 1:
+            mask = trigExec_[i].mask;
+            if ((pc & mask) == (ptrig->data2 & mask)) {
                 pt->hit = 1;
             }
             break;
         case 2:
-            if (pc >= ptriggers_[i].data2) {
+            if (pc >= ptrig->data2) {
                 pt->hit = 1;
             }
             break;
         case 3:
-            if (pc < ptriggers_[i].data2) {
+            if (pc < ptrig->data2) {
                 pt->hit = 1;
             }
             break;
         case 4:
-            mask = (pc & 0xFFFFFFFFull) & (ptriggers_[i].data2 >> 32);
-            if (mask == (ptriggers_[i].data2 & 0xFFFFFFFFull)) {
+            mask = (pc & 0xFFFFFFFFull) & (ptrig->data2 >> 32);
+            if (mask == (ptrig->data2 & 0xFFFFFFFFull)) {
                 pt->hit = 1;
             }
             break;
         case 5:
-            mask = (pc >> 32) & (ptriggers_[i].data2 >> 32);
-            if (mask == (ptriggers_[i].data2 & 0xFFFFFFFFull)) {
+            mask = (pc >> 32) & (ptrig->data2 >> 32);
+            if (mask == (ptrig->data2 & 0xFFFFFFFFull)) {
                 pt->hit = 1;
             }
             break;
@@ -660,6 +1987,290 @@ bool CpuGeneric::isTriggerInstruction() {
 }
 
 
+/**
+ * Blocks are executed only when no debug features require per instruction
+ * checks: stepping, armed triggers, halt request, trace file or the
+ * history scanning.
+ */
+bool CpuGeneric::isBlockExecEnabled() {
+    if (estate_ != CORE_Normal || haltreq_ || trace_ena_
+        || trigICount_ || trigExecCnt_ || scanType_ != Scan_None) {
+        return false;
+    }
+    return !isStepEnabled();
+}
+
+/**
+ * Execute cached block of instructions. Event queue is processed on the
+ * same steps as in per instruction mode, interrupts and stack protection
+ * are checked at the block boundary.
+ */
+void CpuGeneric::updateBlock() {
+    uint64_t pc = getNPC();
+    uint64_t pa = pc;
+    if (vmemEna_ && !translateAddress(pc, MemAccess_Fetch, &pa)) {
+        // Fault is raised again by the instruction fetch
+        updatePipeline();
+        return;
+    }
+    BlockType *blk = &blocks_[(pc >> 1) & (blockTotal_ - 1)];
+    if (blk->cnt == 0 || blk->pc != pc || blk->pa != pa) {
+        if (!buildBlock(blk, pc, pa)) {
+            updatePipeline();
+            return;
+        }
+    }
+
+    // Native code isn't instrumented, profiling uses the interpreter
+    if (prof_->isEnabled() || !execCompiledBlock(blk)) {
+        for (int i = 0; i < blk->cnt; i++) {
+            if (getNPC() != blk->item[i].pc || !execBlockItem(blk, i)) {
+                break;
+            }
+        }
+    }
+    if (idleEna_ && (idleAddrTotal_ || getNPC() == getPC())) {
+        // Block could be stopped before its end, find the last executed one
+        Reg64Type *payload = 0;
+        for (int i = 0; i < blk->cnt; i++) {
+            if (blk->item[i].pc == getPC()) {
+                payload = &blk->item[i].payload;
+                break;
+            }
+        }
+        if (isIdleLoop(payload)) {
+            skipIdleSteps();
+        }
+    }
+    handleTrap();
+}
+
+/**
+ * Execute one instruction of the block.
+ * @return false if the block execution should be stopped
+ */
+bool CpuGeneric::execBlockItem(BlockType *blk, int idx) {
+    BlockItemType *p = &blk->item[idx];
+    uint64_t step = ++step_cnt_;
+    setPC(p->pc);
+    branch_ = false;
+    cacheline_[0] = p->payload;
+    instr_ = p->instr;
+    if (flight_) {
+        flightStart(p->pc, p->payload.buf32[0]);
+    }
+    if (prof_->isEnabled()) {
+        prof_->step(p->pc, instr_, cur_prv_level);
+    }
+    oplen_ = instr_->exec(cacheline_);
+    flightCur_ = 0;
+    pc_z_ = getPC();
+
+    if (do_not_cache_) {
+        do_not_cache_ = false;
+        removeBlock(blk);
+    } else if (icovtracker_) {
+        icovtracker_->markAddress(getPC(), static_cast<uint8_t>(oplen_));
+    }
+    if (!branch_) {
+        setNPC(getPC() + oplen_);
+    }
+    if (step_cnt_ >= queue_.getNextTime()) {
+        updateQueue();
+    }
+    // Block is also stopped after idle steps skipping and on interrupt
+    // raised by the clock callbacks or by the instruction itself, so that
+    // interrupts are taken on the same steps as in per instruction mode.
+    return !(exceptions_ || estate_ != CORE_Normal || blk->cnt == 0
+            || step_cnt_ != step || haltreq_ || isInterruptTaken());
+}
+
+/**
+ * Block is identified by the virtual and physical addresses. With enabled
+ * address translation it doesn't cross the page boundary so the single
+ * translation of the first instruction is enough.
+ */
+bool CpuGeneric::buildBlock(BlockType *blk, uint64_t pc, uint64_t pa) {
+    GenericInstruction *instr;
+    BlockItemType *p;
+    unsigned len;
+
+    if (blk->cnt) {
+        removeBlock(blk);
+    }
+    blk->pc = pc;
+    blk->pa = pa;
+    blk->end = pc;
+    blk->hits = 0;
+    blk->native = 0;
+    while (blk->cnt < BLOCK_INSTR_MAX) {
+        if (vmemEna_ && ((blk->end + 3) >> VMEM_PAGE_BITS)
+                        != (pc >> VMEM_PAGE_BITS)) {
+            break;
+        }
+        trans_.action = MemAction_Read;
+        trans_.addr = pa + (blk->end - pc);
+        trans_.xsize = 4;
+        trans_.wstrb = 0;
+        if (phys_memop(&trans_) == TRANS_ERROR) {
+            break;
+        }
+        cacheline_[0].val = trans_.rpayload.b64[0];
+        instr = decodeInstruction(cacheline_);
+        if (instr == 0) {
+            break;
+        }
+        p = &blk->item[blk->cnt++];
+        p->instr = instr;
+        p->payload = cacheline_[0];
+        p->pc = blk->end;
+
+        len = getInstrLength(cacheline_);
+        if (len == 0) {
+            blk->end++;
+            break;
+        }
+        blk->end += len;
+        if (isBlockEnd(cacheline_)) {
+            break;
+        }
+    }
+    if (blk->cnt == 0) {
+        return false;
+    }
+    linkBlockPages(blk);
+    return true;
+}
+
+void CpuGeneric::removeBlock(BlockType *blk) {
+    if (blk->cnt == 0) {
+        return;
+    }
+    unlinkBlockPages(blk);
+    blk->cnt = 0;
+    blk->native = 0;
+}
+
+/** Executed on each FENCE.I, so that the pool itself isn't touched */
+void CpuGeneric::blockPagesReset() {
+    memset(blockPageHash_, 0, 2*blockTotal_*sizeof(BlockPageType *));
+    blockPageFree_ = 0;
+    blockPageUsed_ = 0;
+}
+
+CpuGeneric::BlockPageType *CpuGeneric::blockPageFind(uint64_t page) {
+    BlockPageType *p = blockPageHash_[page & (2*blockTotal_ - 1)];
+    while (p && p->page != page) {
+        p = p->hnext;
+    }
+    return p;
+}
+
+/**
+ * Block is linked into the list of each page it occupies: pnext[0] in the
+ * page of the first instruction, pnext[1] in the next page.
+ */
+void CpuGeneric::linkBlockPages(BlockType *blk) {
+    uint64_t last = blk->pa + (blk->end - blk->pc) - 1;
+    uint64_t page = blk->pa >> BLOCK_PAGE_BITS;
+    uint64_t g, gend;
+    BlockPageType *p;
+    BlockPageType **pp;
+    for (int i = 0; i < 2 && page <= (last >> BLOCK_PAGE_BITS); i++, page++) {
+        p = blockPageFind(page);
+        if (p == 0) {
+            if (blockPageFree_) {
+                p = blockPageFree_;
+                blockPageFree_ = p->hnext;
+            } else {
+                p = &blockPages_[blockPageUsed_++];
+            }
+            memtlbCodePage(page);
+            p->page = page;
+            p->blocks = 0;
+            p->total = 0;
+            memset(p->granule, 0, sizeof(p->granule));
+            pp = &blockPageHash_[page & (2*blockTotal_ - 1)];
+            p->hnext = *pp;
+            *pp = p;
+        }
+        blk->pnext[i] = p->blocks;
+        p->blocks = blk;
+
+        g = i == 0 ? blk->pa >> BLOCK_GRANULE_BITS
+                   : page << (BLOCK_PAGE_BITS - BLOCK_GRANULE_BITS);
+        gend = last >> BLOCK_GRANULE_BITS;
+        for (; g <= gend && (g >> (BLOCK_PAGE_BITS - BLOCK_GRANULE_BITS)) == page;
+             g++) {
+            p->granule[g & (BLOCK_PAGE_GRANULES - 1)]++;
+            p->total++;
+        }
+    }
+}
+
+void CpuGeneric::unlinkBlockPages(BlockType *blk) {
+    uint64_t last = blk->pa + (blk->end - blk->pc) - 1;
+    uint64_t page = blk->pa >> BLOCK_PAGE_BITS;
+    uint64_t g, gend;
+    BlockPageType *p;
+    BlockPageType **pp;
+    BlockType **pb;
+    for (int i = 0; i < 2 && page <= (last >> BLOCK_PAGE_BITS); i++, page++) {
+        p = blockPageFind(page);
+        pb = &p->blocks;
+        while (*pb != blk) {
+            pb = &(*pb)->pnext[((*pb)->pa >> BLOCK_PAGE_BITS) == page ? 0 : 1];
+        }
+        *pb = blk->pnext[i];
+
+        g = i == 0 ? blk->pa >> BLOCK_GRANULE_BITS
+                   : page << (BLOCK_PAGE_BITS - BLOCK_GRANULE_BITS);
+        gend = last >> BLOCK_GRANULE_BITS;
+        for (; g <= gend && (g >> (BLOCK_PAGE_BITS - BLOCK_GRANULE_BITS)) == page;
+             g++) {
+            p->granule[g & (BLOCK_PAGE_GRANULES - 1)]--;
+            p->total--;
+        }
+        if (p->total == 0) {
+            pp = &blockPageHash_[page & (2*blockTotal_ - 1)];
+            while (*pp != p) {
+                pp = &(*pp)->hnext;
+            }
+            *pp = p->hnext;
+            p->hnext = blockPageFree_;
+            blockPageFree_ = p;
+        }
+    }
+}
+
+/**
+ * Only blocks of the written pages are checked, stores into granules
+ * without blocks are rejected by the counters.
+ */
+void CpuGeneric::invalidateBlocks(uint64_t addr, uint64_t sz) {
+    uint64_t gstart = addr >> BLOCK_GRANULE_BITS;
+    uint64_t gend = (addr + sz - 1) >> BLOCK_GRANULE_BITS;
+    uint64_t page;
+    BlockPageType *p;
+    BlockType *blk, *nxt;
+    for (uint64_t g = gstart; g <= gend; g++) {
+        page = g >> (BLOCK_PAGE_BITS - BLOCK_GRANULE_BITS);
+        p = blockPageFind(page);
+        if (p == 0 || p->granule[g & (BLOCK_PAGE_GRANULES - 1)] == 0) {
+            continue;
+        }
+        blk = p->blocks;
+        while (blk) {
+            nxt = blk->pnext[(blk->pa >> BLOCK_PAGE_BITS) == page ? 0 : 1];
+            if (addr < blk->pa + (blk->end - blk->pc)
+                && (addr + sz) > blk->pa) {
+                removeBlock(blk);
+            }
+            blk = nxt;
+        }
+    }
+}
+
 bool CpuGeneric::executeProgbuf(uint32_t *progbuf) {
     if (!isHalted()) {
         return true;
@@ -31,9 +31,16 @@
 #include "coreservices/icmdexec.h"
 #include "coreservices/itap.h"
 #include "coreservices/icoveragetracker.h"
+#include "coreservices/iquantum.h"
+#include "coreservices/icheckpoint.h"
 #include "generic/mapreg.h"
+#include "generic/reservation.h"
+#include "generic/trace_file.h"
+#include "generic/reverse_exec.h"
+#include "generic/cpu_profiler.h"
 #include <riscv-isa.h>
 #include <fstream>
+#include <atomic>
 
 namespace debugger {
 
@@ -44,6 +51,7 @@ class CpuGeneric : public IService,
                    public IClock,
                    public IPower,
                    public IResetListener,
+                   public ICheckpoint,
                    public IHap {
  public:
     explicit CpuGeneric(const char *name);
@@ -65,21 +73,67 @@ class CpuGeneric : public IService,
     virtual void popStackTrace();
     virtual uint64_t getPrvLevel() { return cur_prv_level; }
     virtual void setPrvLevel(uint64_t lvl) { cur_prv_level = lvl; }
+    /** Data accesses of the instructions, translated when vmemEna_ */
     virtual ETransStatus dma_memop(Axi4TransactionType *tr);
+    virtual ETransStatus dma_cmpxchg(Axi4TransactionType *tr, bool *success);
+    void reserveAddress(uint64_t addr) {
+        resvtbl_->reserve(sysBusMasterID_.to_int(), addr);
+    }
+    bool releaseAddress(uint64_t addr) {
+        return resvtbl_->release(sysBusMasterID_.to_int(), addr);
+    }
     virtual void generateException(int e, uint64_t arg) { exceptions_ |= 1ull << e; }
     virtual void generateExceptionLoadInstruction(uint64_t addr) {}
     virtual bool isOn() { return estate_ != CORE_OFF; }
+    uint64_t getTriggerEvalCount() { return trigEvalCnt_; }
     virtual void resume();
     virtual void halt(uint32_t cause, const char *descr);
     virtual void flush(uint64_t addr);
     virtual void doNotCache(uint64_t addr) { do_not_cache_ = true; }
+    /** Flight recorder content, the last 'cnt' records (oldest first) */
+    void getFlightRecords(unsigned cnt, AttributeType *res);
+    /** Execution profiler controlled from the commands thread */
+    void startProfile() { prof_->start(); }
+    void stopProfile() { prof_->stop(); }
+    bool isProfiling() { return prof_->isEnabled(); }
+    void getProfile(unsigned topN, AttributeType *res) {
+        prof_->getReport(isrc_, topN, res);
+    }
+    bool writeProfileStacks(const char *file) {
+        return prof_->writeFolded(isrc_, file);
+    }
+
+    /**
+     * Reverse execution. Methods are called from the commands thread
+     * while the hart is halted.
+     */
+    enum EReverseScan {
+        Scan_None,
+        Scan_Breakpoint,        // the latest step halted on a breakpoint
+        Scan_Write              // the latest store into the address range
+    };
+    bool isReverseEnabled() { return rhist_ != 0; }
+    /** Re-execute the history up to the step */
+    bool reverseGoto(uint64_t step);
+    /**
+     * Search the history backward from the current step.
+     * @return false if nothing found, 'step' is the begin of history then
+     */
+    bool reverseFind(EReverseScan type, uint64_t addr, uint64_t sz,
+                     uint64_t *step);
+    /** [frontier, step, snapshots, oldest step, inputs] */
+    void getReverseInfo(AttributeType *res);
+
+    /** ICheckpoint */
+    virtual void saveState(CheckpointState *state);
+    virtual bool restoreState(CheckpointState *state);
 
     /** IDPort interface */
     virtual void resumereq() {resumereq_ = true; }
     virtual void haltreq() { haltreq_ = true; }
     virtual bool isHalted() { return estate_ == CORE_Halted; }
-    virtual uint64_t readRegDbg(uint32_t regno) { return 0; }
-    virtual void writeRegDbg(uint32_t regno, uint64_t val) {}
+    virtual uint64_t readRegDbg(uint32_t regno);
+    virtual void writeRegDbg(uint32_t regno, uint64_t val);
     virtual bool executeProgbuf(uint32_t *progbuf);
     virtual bool isExecutingProgbuf() { return estate_ == CORE_ProgbufExec; }
     virtual void setResetPin(bool val) {}
@@ -102,12 +156,30 @@ class CpuGeneric : public IService,
     virtual bool isStepEnabled() { return false; }
     virtual bool isTriggerICount();
     virtual bool isTriggerInstruction();
+    /** Debug port registers access in context of the simulation thread */
+    virtual uint64_t readRegDbgDirect(uint32_t regno) { return 0; }
+    virtual void writeRegDbgDirect(uint32_t regno, uint64_t val) {}
+    /** Instruction jumping to itself without side effects */
+    virtual bool isIdleInstruction(Reg64Type *payload) { return false; }
+    /** Enabled interrupt request that should break idle state */
+    virtual bool isInterruptPending() { return false; }
+    /** Interrupt is taken by handleInterrupts() after this instruction */
+    virtual bool isInterruptTaken() { return false; }
+    /** Debugger controlled stepping state kept on reverse execution */
+    virtual uint64_t getDebugControl() { return 0; }
+    virtual void setDebugControl(uint64_t v) {}
 
  public:
     /** IClock */
     virtual uint64_t getStepCounter() { return step_cnt_; }
+    /** Steps skipped in idle state, not counted as retired instructions */
+    uint64_t getIdleStepCounter() { return idleStepCnt_; }
     virtual void registerStepCallback(IClockListener *cb, uint64_t t);
     virtual bool moveStepCallback(IClockListener *cb, uint64_t t);
+    virtual void postInput(IClockInput *dev, const char *buf, int sz);
+    virtual bool isReplay() {
+        return rhist_ && step_cnt_ <= reverseFrontier_;
+    }
     virtual double getFreqHz() {
         if (freqHz_.is_floating()) {
             return freqHz_.to_float();
@@ -134,10 +206,36 @@ class CpuGeneric : public IService,
     virtual bool updateState();
     virtual uint64_t fetchingAddress() { return getPC(); }
     virtual void fetchILine();
+    void fetchCrossPage();
     virtual void updateQueue();
     virtual void enterProgbufExec();
     virtual void exitProgbufExec();
 
+    /**
+     * Debugger threads don't access registers directly, request is passed
+     * into the simulation thread and executed between instructions.
+     */
+    struct DbgRegRequestType {
+        bool write;
+        bool rewind;            // val = target step, regno = snapshot index
+        bool flush;             // val = flushing address
+        uint32_t regno;
+        uint64_t val;
+    };
+    void postDbgRequest(DbgRegRequestType *req);
+    void serveDbgRequest();
+    void execDbgRequest(DbgRegRequestType *req);
+
+    /** Basic blocks execution engine */
+    virtual bool isBlockExecEnabled();
+    virtual void updateBlock();
+    /** Instruction size used to build blocks, 0 = single instruction blocks */
+    virtual unsigned getInstrLength(Reg64Type *payload) { return 0; }
+    /** Jumps, branches and traps terminate the block */
+    virtual bool isBlockEnd(Reg64Type *payload) { return false; }
+    void invalidateBlocks(uint64_t addr, uint64_t sz);
+    void flushCaches(uint64_t addr);
+
  protected:
     AttributeType isEnable_;
     AttributeType freqHz_;
@@ -148,16 +246,29 @@ class CpuGeneric : public IService,
     AttributeType sourceCode_;
     AttributeType stackTraceSize_;
     AttributeType generateTraceFile_;
+    AttributeType binaryTrace_;
+    AttributeType traceCompression_;
+    AttributeType flightRecorder_;
     AttributeType resetVector_;
     AttributeType sysBusMasterID_;
-    AttributeType cacheBaseAddr_;
-    AttributeType cacheAddrMask_;
+    AttributeType icacheBudget_;
     AttributeType coverageTracker_;
     AttributeType resetState_;
     AttributeType triggersTotal_;
     AttributeType mcontrolMaskmax_;
+    AttributeType blockCacheSize_;
+    AttributeType directMemAccess_;
+    AttributeType idleFastForward_;
+    AttributeType idleLoops_;     // list of addresses or symbol names
+    AttributeType quantumSync_;
+    AttributeType reverseInterval_;
+    AttributeType reverseSnapshots_;
+    AttributeType profilerEntries_;
+    AttributeType exitCondition_; // tohost, ecall or symbol of EBREAK
+    AttributeType stepLimit_;
 
     ISourceCode *isrc_;
+    CpuProfiler *prof_;
     ICoverageTracker *icovtracker_;
     ICmdExecutor *icmdexec_;
     IMemoryOperation *isysbus_;
@@ -197,6 +308,19 @@ class CpuGeneric : public IService,
         uint64_t extra;
     } *ptriggers_;
 
+    // Armed triggers compiled from tdata1/tdata2. Should be rebuilt by
+    // updateTriggers() on any trigger registers modification.
+    struct TriggerMatchType {
+        TriggerStorageType *trig;
+        uint64_t mask;          // NAPOT address mask (match = 1)
+    };
+    TriggerMatchType *trigExec_;    // instruction address match triggers
+    int trigExecCnt_;
+    bool trigICount_;               // instruction count trigger is set
+    uint64_t trigEvalCnt_;          // number of triggers evaluations
+
+    void updateTriggers();
+
     uint64_t step_cnt_;
     volatile bool resumereq_;
     volatile bool haltreq_;
@@ -218,8 +342,18 @@ class CpuGeneric : public IService,
     uint64_t interrupt_pending_[2];
     bool do_not_cache_;         // Do not put instruction into ICache
 
-    mutex_def mutex_csr_;
     event_def eventConfigDone_;
+
+    enum EDbgRequestState {
+        DbgReq_Idle,
+        DbgReq_Posted,
+        DbgReq_Busy
+    };
+    std::atomic<int> dbgreqState_;
+    DbgRegRequestType *dbgreq_;
+    mutex_def mutex_dbgreq_;        // one request from all debuggers
+    event_def eventDbgReqDone_;
+    uint64_t simThreadId_;
     ClockAsyncTQueueType queue_;
 
     enum ECoreState {
@@ -232,40 +366,297 @@ class CpuGeneric : public IService,
     Axi4TransactionType trans_;
     Reg64Type cacheline_[512/4];
     
-    // Simple memory cache to avoid access to sysbus and speed-up simulation
-    struct ICacheType {
+    // Decoded instructions cache to avoid access to sysbus and decoder.
+    // Pages are allocated on the first fetch from any address and evicted
+    // in LRU order when the memory budget is exceeded.
+    static const int ICACHE_PAGE_BITS = 12;
+    static const int ICACHE_PAGE_ITEMS = 1 << (ICACHE_PAGE_BITS - 1);
+    static const int ICACHE_HASH_SIZE = 1 << 10;
+
+    struct ICacheItemType {
         GenericInstruction *instr;
         uint32_t buf;
-    } *icache_;            // parsed instructions storage
-    int memcache_sz_;               // allocated size
-    uint64_t CACHE_BASE_ADDR_;
-    uint64_t CACHE_MASK_;
+    };
+
+    struct ICachePageType {
+        uint64_t page;              // address >> ICACHE_PAGE_BITS
+        ICachePageType *hnext;      // hash chain
+        ICachePageType *prev;       // LRU list: more recently used
+        ICachePageType *next;       // LRU list: less recently used
+        ICacheItemType item[ICACHE_PAGE_ITEMS];   // one per half-word
+    };
+
+    ICachePageType *icacheHash_[ICACHE_HASH_SIZE];
+    ICachePageType *icacheHead_;        // most recently used page
+    ICachePageType *icacheTail_;        // eviction candidate
+    ICachePageType *icacheLast_;        // page of the last fetch
+    unsigned icachePages_;
+    unsigned icachePagesMax_;
+    ICacheItemType *icacheItem_;        // entry of the current fetch or 0
     uint64_t fetch_addr_;
-    uint64_t cache_offset_;         // instruction pointer - CACHE_BASE_ADDR
-    bool cachable_pc_;              // fetched_pc hit into cachable region
 
-    uint64_t cur_prv_level;
+    ICachePageType *icacheFind(uint64_t page);
+    ICachePageType *icacheAlloc(uint64_t page);
+    void icacheInvalidate(uint64_t addr, uint64_t sz);
+
+    // Translation of the bus addresses into host pointers of RAM-backed
+    // devices. Pages of the MMIO devices have zero pointer and always
+    // use the bus transport.
+    static const int MEMTLB_PAGE_BITS = 12;
+    static const int MEMTLB_SIZE = 256;
+
+    // Layout is read by the compiled code (JitMemTlbType).
+    struct MemTlbType {
+        uint64_t page;      // address >> MEMTLB_PAGE_BITS or ~0 if invalid
+        uint8_t *ptr;       // host pointer of the page or 0
+        bool readonly;
+        bool plain;         // writable, stores don't need memopWritten()
+        uint8_t *dirty;     // checkpoint page flag or 0
+    } memtlb_[MEMTLB_SIZE];
+    bool memtlbEna_;
+    const std::atomic<uint32_t> *mapGen_;   // bus map generation or 0
+    uint32_t memtlbGen_;                    // generation of cached entries
+
+    void memtlbFlush();
+    void memtlbCheckMap();
+    void memtlbCodePage(uint64_t page);
+    MemTlbType *memtlbEntry(uint64_t addr, uint32_t sz);
+    bool memtlbAccess(Axi4TransactionType *tr);
+    void memopWritten(uint64_t addr, uint32_t sz);
+
+    // Virtual memory. Fetch and data addresses are translated only while
+    // vmemEna_ is set by the derived class, all caches below (icache,
+    // blocks, memtlb) use physical addresses.
+    enum EMemAccessType {
+        MemAccess_Fetch,
+        MemAccess_Load,
+        MemAccess_Store
+    };
+    static const int VMEM_PAGE_BITS = 12;
+    bool vmemEna_;
+    uint64_t fetchVpage_;       // last translated fetch page, ~0 if none
+    uint64_t fetchPbase_;
+    /** Must be called on any change of the translation context */
+    void flushFetchPage() { fetchVpage_ = ~0ull; }
+
+    /**
+     * @return false if the access isn't permitted, the page fault
+     *         exception is raised by the implementation
+     */
+    virtual bool translateAddress(uint64_t va, EMemAccessType acc,
+                                  uint64_t *pa) {
+        *pa = va;
+        return true;
+    }
+    ETransStatus phys_memop(Axi4TransactionType *tr);
+    ETransStatus phys_cmpxchg(Axi4TransactionType *tr, bool *success);
+
+    // LR/SC reservations of the system bus or own table when the bus
+    // doesn't share it:
+    ReservationTable *resvtbl_;
+    ReservationTable resvLocal_;
+
+    // Idle state fast-forward to the next scheduled clock event:
+    bool idleEna_;
+    uint64_t *idleAddr_;        // resolved IdleLoops entries
+    int idleAddrTotal_;
+    uint64_t idleStepCnt_;
+
+    void resolveIdleLoops();
+    bool isIdleLoop(Reg64Type *payload);
+    void skipIdleSteps();
+
+    // Multi-hart time window synchronization:
+    IQuantumSync *iquantum_;
+    int quantumIdx_;
+    uint64_t quantumEnd_;       // step to report the hart state again
+    bool quantumActive_;
+
+    bool isQuantumActive() {
+        return estate_ == CORE_Normal
+            || (estate_ == CORE_Halted && resumereq_);
+    }
+    void syncQuantum();
 
-    struct trace_action_type {
-        bool memop;             // 0=register; 1=memop
-        int waddr;              // register addr
-        uint64_t wdata;         // register data
-        int memop_write;        // 0=read
-        uint64_t memop_addr;
-        Reg64Type memop_data;
-        int memop_size;
+    // Basic blocks of pre-decoded instructions executed without per
+    // instruction state checking:
+    static const int BLOCK_INSTR_MAX = 32;
+    static const int BLOCK_GRANULE_BITS = 8;
+    static const int BLOCK_PAGE_BITS = 12;
+    static const int BLOCK_PAGE_GRANULES =
+                        1 << (BLOCK_PAGE_BITS - BLOCK_GRANULE_BITS);
+
+    struct BlockItemType {
+        GenericInstruction *instr;
+        Reg64Type payload;
+        uint64_t pc;
     };
 
-    struct trace_type {
-        uint64_t step_cnt;
+    struct BlockType {
         uint64_t pc;
-        uint32_t instr;
-        char disasm[256];
-        // 1 instruction several actions
-        trace_action_type action[64];
+        uint64_t pa;            // physical address of the first instruction
+        uint64_t end;           // address of the next instruction after block
+        int cnt;                // 0 = invalid block
+        unsigned hits;          // executions counter for the native tier
+        void *native;           // translated host code
+        BlockType *pnext[2];    // next block in the first and second page
+        BlockItemType item[BLOCK_INSTR_MAX];
+    } *blocks_;
+    unsigned blockTotal_;
+
+    // Physical pages with blocks hashed by the full page number. Each page
+    // keeps its blocks and the number of blocks in its granules, stores
+    // into granules without blocks don't require to search blocks. Block
+    // occupies two pages at most so the pool never runs out.
+    struct BlockPageType {
+        uint64_t page;                          // address >> BLOCK_PAGE_BITS
+        BlockPageType *hnext;                   // hash chain or free list
+        BlockType *blocks;                      // chained by pnext[]
+        unsigned total;                         // sum of granule counters
+        uint16_t granule[BLOCK_PAGE_GRANULES];
+    } *blockPages_;
+    BlockPageType **blockPageHash_;             // 2 * blockTotal_ chains
+    BlockPageType *blockPageFree_;
+    unsigned blockPageUsed_;                    // never allocated after it
+
+    BlockPageType *blockPageFind(uint64_t page);
+    void blockPagesReset();
+
+    bool buildBlock(BlockType *blk, uint64_t pc, uint64_t pa);
+    bool execBlockItem(BlockType *blk, int idx);
+    /** Native tier hook: returns true if the block was executed */
+    virtual bool execCompiledBlock(BlockType *blk) { return false; }
+    void removeBlock(BlockType *blk);
+    void linkBlockPages(BlockType *blk);
+    void unlinkBlockPages(BlockType *blk);
+
+    uint64_t cur_prv_level;
+
+    TraceStepType trace_data_;
+    std::ofstream *trace_file_;         // text format
+    TraceWriter *trace_writer_;         // binary format
+    bool trace_ena_;
+
+    /**
+     * Reverse execution: the history is re-executed from the nearest
+     * snapshot with the logged inputs. Debugger triggers and stepping
+     * state aren't the part of the history.
+     */
+    class ReverseInputListener : public IClockListener {
+     public:
+        explicit ReverseInputListener(CpuGeneric *parent) : p_(parent) {}
+        virtual void stepCallback(uint64_t t);
+     private:
+        CpuGeneric *p_;
+    } reverseInput_;
+
+    class ReverseHaltListener : public IClockListener {
+     public:
+        explicit ReverseHaltListener(CpuGeneric *parent) : p_(parent) {}
+        virtual void stepCallback(uint64_t t);
+     private:
+        CpuGeneric *p_;
+    } reverseHalt_;
+
+    /**
+     * Batch mode exit: store of an odd value into 'tohost', exit system
+     * call or EBREAK at the symbol, and the step limit. The hart halts and
+     * triggers HAP_CpuExit with the exit code (~0 on the step limit).
+     */
+    enum EExitType {
+        Exit_None,
+        Exit_Tohost,
+        Exit_Ecall,
+        Exit_Break
+    };
+    class ExitLimitListener : public IClockListener {
+     public:
+        explicit ExitLimitListener(CpuGeneric *parent) : p_(parent) {}
+        virtual void stepCallback(uint64_t t);
+     private:
+        CpuGeneric *p_;
+    } exitLimit_;
+
+    EExitType exitType_;
+    uint64_t exitAddr_;             // tohost or EBREAK address, ~0 if unused
+    uint64_t exitCode_;
+    const char *exitDescr_;
+    bool exitPending_;
+
+    void resolveExit();
+    void requestExit(uint64_t code, const char *descr);
+
+    ReverseHistory *rhist_;
+    uint64_t reverseNext_;          // step of the next periodic snapshot
+    uint64_t reverseFrontier_;      // the latest executed step
+    uint64_t reverseTarget_;        // step to halt on or ~0ull
+    uint64_t reverseInputNext_;     // scheduled inputs delivery step
+    bool reverseModified_;          // state changed by debugger while halted
+    bool rewinding_;
+    uint64_t reverseDbgCtl_;
+    TriggerStorageType *reverseTrig_;
+
+    EReverseScan scanType_;
+    uint64_t scanAddr_;
+    uint64_t scanSize_;
+    uint64_t scanHit_;
+    uint64_t *scanBp_;
+    int scanBpTotal_;
+
+    void updateHistory();
+    void scheduleInputs(uint64_t t);
+    bool rewind(uint64_t target, int idx);
+    void finishRewind();
+    void haltRewind();
+    bool postRewind(uint64_t target, int idx);
+
+    /**
+     * Flight recorder: always enabled ring of the last executed
+     * instructions. Natively executed blocks are stored as one record.
+     */
+    static const int FLIGHT_ACTIONS_MAX = 4;
+    struct FlightRecordType {
+        uint64_t step;
+        uint64_t pc;
+        uint32_t instr;         // instruction or block instructions number
+        bool block;
         int action_cnt;
-    } trace_data_;
-    std::ofstream *trace_file_;
+        TraceActionType action[FLIGHT_ACTIONS_MAX];
+    } *flight_;
+    FlightRecordType *flightCur_;       // record of executing instruction
+    uint64_t flightCnt_;
+    uint64_t flightMask_;
+
+    void flightStart(uint64_t pc, uint32_t instr) {
+        flightCur_ = &flight_[flightCnt_++ & flightMask_];
+        flightCur_->step = step_cnt_;
+        flightCur_->pc = pc;
+        flightCur_->instr = instr;
+        flightCur_->block = false;
+        flightCur_->action_cnt = 0;
+    }
+    void flightRegister(int idx, uint64_t v) {
+        if (flightCur_->action_cnt < FLIGHT_ACTIONS_MAX) {
+            TraceActionType *p = &flightCur_->action[flightCur_->action_cnt++];
+            p->memop = false;
+            p->waddr = idx;
+            p->wdata = v;
+        }
+    }
+    void flightMemop(uint64_t addr, int we, uint64_t v, uint32_t sz);
+    /**
+     * Entry of natively executed block, instructions number is set by
+     * caller after execution. Instructions executed by the interpreter
+     * inside of the block follow this record.
+     */
+    FlightRecordType *flightBlock(uint64_t pc) {
+        flightStart(pc, 0);
+        FlightRecordType *p = flightCur_;
+        p->step = step_cnt_ + 1;
+        p->block = true;
+        flightCur_ = 0;
+        return p;
+    }
 };
 
 }  // namespace debugger
@@ -0,0 +1,294 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <fstream>
+#include "cpu_profiler.h"
+
+namespace debugger {
+
+/** Function or instruction with the accumulated counter */
+struct ProfItemType {
+    uint64_t key;
+    uint64_t cnt;
+};
+
+static int sort_by_key(const void *a, const void *b) {
+    uint64_t ka = static_cast<const ProfItemType *>(a)->key;
+    uint64_t kb = static_cast<const ProfItemType *>(b)->key;
+    return ka < kb ? -1 : (ka > kb ? 1 : 0);
+}
+
+static int sort_by_cnt(const void *a, const void *b) {
+    uint64_t ca = static_cast<const ProfItemType *>(a)->cnt;
+    uint64_t cb = static_cast<const ProfItemType *>(b)->cnt;
+    return ca > cb ? -1 : (ca < cb ? 1 : 0);
+}
+
+CpuProfiler::CpuProfiler(unsigned pcTotal) {
+    pcTotal_ = 1;
+    while (pcTotal_ < pcTotal) {
+        pcTotal_ <<= 1;
+    }
+    pcMask_ = pcTotal_ - 1;
+    pcTbl_ = 0;
+    instrTbl_ = 0;
+    nodeParent_ = 0;
+    nodeFunc_ = 0;
+    nodeCnt_ = 0;
+    nodeHash_ = 0;
+    ena_.store(false);
+    clearReq_.store(false);
+}
+
+CpuProfiler::~CpuProfiler() {
+    if (pcTbl_) {
+        delete [] pcTbl_;
+        delete [] instrTbl_;
+        delete [] nodeParent_;
+        delete [] nodeFunc_;
+        delete [] nodeCnt_;
+        delete [] nodeHash_;
+    }
+}
+
+void CpuProfiler::start() {
+    if (!pcTbl_) {
+        pcTbl_ = new PcEntryType[pcTotal_];
+        instrTbl_ = new InstrEntryType[INSTR_MAX];
+        nodeParent_ = new unsigned[NODE_MAX];
+        nodeFunc_ = new uint64_t[NODE_MAX];
+        nodeCnt_ = new uint64_t[NODE_MAX];
+        nodeHash_ = new unsigned[2 * NODE_MAX];
+        clear();
+    } else {
+        clearReq_.store(true, std::memory_order_release);
+    }
+    ena_.store(true, std::memory_order_release);
+}
+
+void CpuProfiler::clear() {
+    memset(pcTbl_, 0xFF, pcTotal_ * sizeof(PcEntryType));
+    memset(instrTbl_, 0, INSTR_MAX * sizeof(InstrEntryType));
+    memset(prvCnt_, 0, sizeof(prvCnt_));
+    memset(excCnt_, 0, sizeof(excCnt_));
+    memset(irqCnt_, 0, sizeof(irqCnt_));
+    memset(nodeHash_, 0, 2 * NODE_MAX * sizeof(unsigned));
+    idleCnt_ = 0;
+    dropped_ = 0;
+    nodeParent_[0] = 0;
+    nodeFunc_[0] = 0;
+    nodeCnt_[0] = 0;
+    nodeTotal_ = 1;
+    node_ = 0;
+    depthOver_ = 0;
+    clearReq_.store(false, std::memory_order_release);
+}
+
+void CpuProfiler::call(uint64_t addr) {
+    if (clearReq_.load(std::memory_order_acquire)) {
+        clear();
+    }
+    if (depthOver_) {
+        depthOver_++;
+        return;
+    }
+    unsigned idx = (hashAddr(addr) ^ (node_ * 0x9E37u)) & (2 * NODE_MAX - 1);
+    unsigned n;
+    while ((n = nodeHash_[idx]) != 0) {
+        if (nodeParent_[n] == node_ && nodeFunc_[n] == addr) {
+            node_ = n;
+            return;
+        }
+        idx = (idx + 1) & (2 * NODE_MAX - 1);
+    }
+    if (nodeTotal_ == NODE_MAX) {
+        // Stay in the current node until the matching return
+        depthOver_ = 1;
+        dropped_++;
+        return;
+    }
+    n = nodeTotal_++;
+    nodeParent_[n] = node_;
+    nodeFunc_[n] = addr;
+    nodeCnt_[n] = 0;
+    nodeHash_[idx] = n;
+    node_ = n;
+}
+
+void CpuProfiler::ret() {
+    if (depthOver_) {
+        depthOver_--;
+    } else if (node_ != 0) {
+        node_ = nodeParent_[node_];
+    }
+}
+
+void CpuProfiler::symbolName(ISourceCode *isrc, uint64_t addr,
+                             char *buf, size_t sz, uint64_t *start) {
+    AttributeType info;
+    *start = addr;
+    if (isrc) {
+        // [name, offset] of the symbol containing the address
+        isrc->addressToSymbol(addr, &info);
+        if (info[0u].size()) {
+            *start = addr - info[1].to_uint64();
+            RISCV_sprintf(buf, sz, "%s", info[0u].to_string());
+            return;
+        }
+    }
+    RISCV_sprintf(buf, sz, "0x%" RV_PRI64 "x", addr);
+}
+
+void CpuProfiler::getReport(ISourceCode *isrc, unsigned topN,
+                            AttributeType *res) {
+    res->make_list(8);
+    if (!pcTbl_ || clearReq_.load(std::memory_order_acquire)) {
+        for (unsigned i = 0; i < 3; i++) {
+            (*res)[i].make_uint64(0);
+        }
+        (*res)[3].make_list(0);
+        for (unsigned i = 4; i < 8; i++) {
+            (*res)[i].make_list(0);
+        }
+        return;
+    }
+    uint64_t total = 0;
+    for (int i = 0; i < 4; i++) {
+        total += prvCnt_[i];
+    }
+    (*res)[0u].make_uint64(total);
+    (*res)[1].make_uint64(idleCnt_);
+    (*res)[2].make_uint64(dropped_);
+    (*res)[3].make_list(4);
+    for (unsigned i = 0; i < 4; i++) {
+        (*res)[3][i].make_uint64(prvCnt_[i]);
+    }
+    // Percentage is relative to the executed instructions
+    double base = total > idleCnt_ ? static_cast<double>(total - idleCnt_)
+                                   : 1.0;
+
+    // PC counters merged by the function start address
+    char name[256];
+    ProfItemType *items = new ProfItemType[pcTotal_];
+    unsigned cnt = 0;
+    for (unsigned i = 0; i < pcTotal_; i++) {
+        if (pcTbl_[i].pc == EMPTY) {
+            continue;
+        }
+        symbolName(isrc, pcTbl_[i].pc, name, sizeof(name), &items[cnt].key);
+        items[cnt++].cnt = pcTbl_[i].cnt;
+    }
+    qsort(items, cnt, sizeof(ProfItemType), sort_by_key);
+    unsigned fcnt = 0;
+    for (unsigned i = 0; i < cnt; i++) {
+        if (fcnt && items[fcnt - 1].key == items[i].key) {
+            items[fcnt - 1].cnt += items[i].cnt;
+        } else {
+            items[fcnt++] = items[i];
+        }
+    }
+    qsort(items, fcnt, sizeof(ProfItemType), sort_by_cnt);
+    if (topN == 0) {
+        topN = ~0u;
+    }
+    AttributeType &funcs = (*res)[4];
+    funcs.make_list(fcnt < topN ? fcnt : topN);
+    uint64_t start;
+    for (unsigned i = 0; i < funcs.size(); i++) {
+        AttributeType &item = funcs[i];
+        symbolName(isrc, items[i].key, name, sizeof(name), &start);
+        item.make_list(4);
+        item[0u].make_string(name);
+        item[1].make_uint64(items[i].key);
+        item[2].make_uint64(items[i].cnt);
+        item[3].make_floating(100.0 * static_cast<double>(items[i].cnt) / base);
+    }
+    delete [] items;
+
+    items = new ProfItemType[INSTR_MAX];
+    cnt = 0;
+    for (unsigned i = 0; i < INSTR_MAX; i++) {
+        if (instrTbl_[i].cnt) {
+            items[cnt].key = reinterpret_cast<uintptr_t>(instrTbl_[i].instr);
+            items[cnt++].cnt = instrTbl_[i].cnt;
+        }
+    }
+    qsort(items, cnt, sizeof(ProfItemType), sort_by_cnt);
+    AttributeType &instr = (*res)[5];
+    instr.make_list(0);
+    for (unsigned i = 0; i < cnt && i < topN; i++) {
+        GenericInstruction *p =
+            reinterpret_cast<GenericInstruction *>(items[i].key);
+        AttributeType item;
+        item.make_list(3);
+        item[0u].make_string(p ? p->name() : "illegal");
+        item[1].make_uint64(items[i].cnt);
+        item[2].make_floating(100.0 * static_cast<double>(items[i].cnt) / base);
+        instr.add_to_list(&item);
+    }
+    delete [] items;
+
+    for (unsigned k = 0; k < 2; k++) {
+        uint64_t *p = k == 0 ? excCnt_ : irqCnt_;
+        AttributeType &traps = (*res)[6 + k];
+        traps.make_list(0);
+        for (int i = 0; i < TRAP_MAX; i++) {
+            if (p[i] == 0) {
+                continue;
+            }
+            AttributeType item;
+            item.make_list(2);
+            item[0u].make_int64(i);
+            item[1].make_uint64(p[i]);
+            traps.add_to_list(&item);
+        }
+    }
+}
+
+bool CpuProfiler::writeFolded(ISourceCode *isrc, const char *file) {
+    if (!pcTbl_ || clearReq_.load(std::memory_order_acquire)) {
+        return false;
+    }
+    std::ofstream os(file);
+    if (!os.is_open()) {
+        return false;
+    }
+    char name[256];
+    unsigned chain[DEPTH_MAX];
+    uint64_t start;
+    for (unsigned n = 0; n < nodeTotal_; n++) {
+        if (nodeCnt_[n] == 0) {
+            continue;
+        }
+        // Deep recursion keeps only the frames closest to the leaf
+        int depth = 0;
+        for (unsigned t = n; t != 0 && depth < static_cast<int>(DEPTH_MAX);
+             t = nodeParent_[t]) {
+            chain[depth++] = t;
+        }
+        os << "[start]";
+        for (int i = depth - 1; i >= 0; i--) {
+            symbolName(isrc, nodeFunc_[chain[i]], name, sizeof(name), &start);
+            os << ';' << name;
+        }
+        os << ' ' << nodeCnt_[n] << '\n';
+    }
+    return true;
+}
+
+}  // namespace debugger
@@ -0,0 +1,163 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef __SRC_COMMON_GENERIC_CPU_PROFILER_H__
+#define __SRC_COMMON_GENERIC_CPU_PROFILER_H__
+
+#include <api_core.h>
+#include "coreservices/icpufunctional.h"
+#include "coreservices/isrccode.h"
+#include <atomic>
+
+namespace debugger {
+
+/**
+ * Execution profile of one hart: per-PC and per-instruction counters,
+ * steps in each privilege level, exception and interrupt counters and the
+ * call tree built from the stack trace events.
+ *
+ * Tables have fixed capacity and open addressing, they are allocated on
+ * the first start and updated by the simulation thread only without any
+ * locks. Commands thread enables or disables counting and reads the
+ * tables, reports are consistent when the hart is halted or the profiler
+ * is stopped. Events that don't fit into the tables are counted as
+ * dropped.
+ */
+class CpuProfiler {
+ public:
+    explicit CpuProfiler(unsigned pcTotal);
+    ~CpuProfiler();
+
+    /** Commands thread */
+    void start();
+    void stop() { ena_.store(false, std::memory_order_release); }
+    bool isEnabled() { return ena_.load(std::memory_order_relaxed); }
+
+    /** Simulation thread, called only while enabled */
+    void step(uint64_t pc, GenericInstruction *instr, uint64_t prv) {
+        if (clearReq_.load(std::memory_order_acquire)) {
+            clear();
+        }
+        prvCnt_[prv & 0x3]++;
+        nodeCnt_[node_]++;
+        countPc(pc);
+        countInstr(instr);
+    }
+    void idle(uint64_t steps, uint64_t prv) {
+        prvCnt_[prv & 0x3] += steps;
+        idleCnt_ += steps;
+    }
+    void exception(int e) { excCnt_[e & (TRAP_MAX - 1)]++; }
+    void interrupt(int code) { irqCnt_[code & (TRAP_MAX - 1)]++; }
+    /** Stack trace events: function entry at 'addr' and return */
+    void call(uint64_t addr);
+    void ret();
+
+    /**
+     * [total,idle,dropped,[U,S,H,M],[[func,addr,cnt,%],*],
+     *  [[instr,cnt,%],*],[[exc,cnt],*],[[irq,cnt],*]]
+     * Functions and instructions are sorted by count, the first 'topN'.
+     */
+    void getReport(ISourceCode *isrc, unsigned topN, AttributeType *res);
+    /** Call tree in folded stacks format, one 'f0;f1;..;fn count' per line */
+    bool writeFolded(ISourceCode *isrc, const char *file);
+
+ private:
+    void clear();
+    void countPc(uint64_t pc) {
+        unsigned idx = hashAddr(pc) & pcMask_;
+        for (unsigned i = 0; i < PROBE_MAX; i++) {
+            PcEntryType *e = &pcTbl_[(idx + i) & pcMask_];
+            if (e->pc == pc) {
+                e->cnt++;
+                return;
+            }
+            if (e->pc == EMPTY) {
+                e->pc = pc;
+                e->cnt = 1;
+                return;
+            }
+        }
+        dropped_++;
+    }
+    void countInstr(GenericInstruction *instr) {
+        unsigned idx = static_cast<unsigned>(
+            hashAddr(reinterpret_cast<uintptr_t>(instr))) & (INSTR_MAX - 1);
+        for (unsigned i = 0; i < INSTR_MAX; i++) {
+            InstrEntryType *e = &instrTbl_[(idx + i) & (INSTR_MAX - 1)];
+            if (e->instr == instr) {
+                e->cnt++;
+                return;
+            }
+            if (e->cnt == 0) {
+                e->instr = instr;
+                e->cnt = 1;
+                return;
+            }
+        }
+    }
+    static unsigned hashAddr(uint64_t a) {
+        return static_cast<unsigned>(((a >> 1) * 0x9E3779B97F4A7C15ull) >> 40);
+    }
+    void symbolName(ISourceCode *isrc, uint64_t addr, char *buf, size_t sz,
+                    uint64_t *start);
+
+ private:
+    static const uint64_t EMPTY = ~0ull;
+    static const unsigned PROBE_MAX = 16;
+    static const unsigned INSTR_MAX = 1024;
+    static const unsigned NODE_MAX = 1 << 14;
+    static const unsigned DEPTH_MAX = 256;
+    static const int TRAP_MAX = 64;
+
+    struct PcEntryType {
+        uint64_t pc;
+        uint64_t cnt;
+    };
+    struct InstrEntryType {
+        GenericInstruction *instr;
+        uint64_t cnt;
+    };
+
+    std::atomic<bool> ena_;
+    std::atomic<bool> clearReq_;
+
+    PcEntryType *pcTbl_;
+    unsigned pcTotal_;
+    unsigned pcMask_;
+    InstrEntryType *instrTbl_;
+    uint64_t prvCnt_[4];
+    uint64_t idleCnt_;
+    uint64_t dropped_;
+    uint64_t excCnt_[TRAP_MAX];
+    uint64_t irqCnt_[TRAP_MAX];
+
+    /**
+     * Call tree: node 0 is the context where profiling started, children
+     * are found through the hash of (parent, function address).
+     */
+    unsigned *nodeParent_;
+    uint64_t *nodeFunc_;
+    uint64_t *nodeCnt_;
+    unsigned *nodeHash_;        // 2 * NODE_MAX, 0 = empty
+    unsigned nodeTotal_;
+    unsigned node_;             // current node
+    unsigned depthOver_;        // calls above the tree capacity
+};
+
+}  // namespace debugger
+
+#endif  // __SRC_COMMON_GENERIC_CPU_PROFILER_H__
@@ -38,6 +38,13 @@ CmdDmiCpuGneric::CmdDmiCpuGneric(IFace *parent, uint64_t dmibar, ITap *tap)
         "    core0 stop\n"
         "    core0 go\n"
         "    core0 step\n");
+
+    AttributeType *hartid = static_cast<AttributeType *>(
+        static_cast<IService *>(parent)->getAttribute("HartID"));
+    hartsel_ = 0;
+    if (hartid && hartid->is_integer()) {
+        hartsel_ = hartid->to_uint32();
+    }
 }
 
 
@@ -81,6 +88,11 @@ void CmdDmiCpuGneric::exec(AttributeType *args, AttributeType *res) {
         return;
     }
 
+    DMCONTROL_TYPE::ValueType dmcontrol;
+    dmcontrol.val = 0;
+    selecthart(&dmcontrol);
+    dma_write(dmibar_ + 4*0x10, 4, dmcontrol.u8);
+
     clearcmderr();
     if (par1.is_equal("halt") || par1.is_equal("stop") || par1.is_equal("break")) {
         halt();
@@ -151,6 +163,11 @@ void CmdDmiCpuGneric::setStep(bool val) {
     waitbusy();
 }
 
+void CmdDmiCpuGneric::selecthart(DMCONTROL_TYPE::ValueType *dmcontrol) {
+    dmcontrol->bits.hartsello = hartsel_;
+    dmcontrol->bits.hartselhi = hartsel_ >> 10;
+}
+
 void CmdDmiCpuGneric::clearcmderr() {
     ABSTRACTCS_TYPE::ValueType abstractcs;
     abstractcs.val = 0;
@@ -163,6 +180,7 @@ void CmdDmiCpuGneric::resume() {
     DMSTATUS_TYPE::ValueType dmstatus;
     dmcontrol.val = 0;
     dmcontrol.bits.resumereq = 1;
+    selecthart(&dmcontrol);
     dma_write(dmibar_ + 4*0x10, 4, dmcontrol.u8);
     // Wait until resume request accepted
     bool stepped = false;
@@ -178,6 +196,7 @@ void CmdDmiCpuGneric::halt() {
     DMCONTROL_TYPE::ValueType dmcontrol;
     dmcontrol.val = 0;
     dmcontrol.bits.haltreq = 1;
+    selecthart(&dmcontrol);
     dma_write(dmibar_ + 4*0x10, 4, dmcontrol.u8);
 }
 
@@ -18,6 +18,7 @@
 
 #include "api_core.h"
 #include "coreservices/icommand.h"
+#include "debug/dmi_regs.h"
 
 namespace debugger {
 
@@ -34,6 +35,7 @@ class CmdDmiCpuGneric : public ICommand  {
     virtual const uint32_t reg2addr(const char *name);
 
  private:
+    void selecthart(DMCONTROL_TYPE::ValueType *dmcontrol);
     void clearcmderr();
     void resume();
     void halt();
@@ -42,6 +44,9 @@ class CmdDmiCpuGneric : public ICommand  {
     void setStep(bool val);
     void readreg(uint32_t regno, uint8_t *buf8);
     void writereg(uint32_t regno, uint8_t *buf8);
+
+ private:
+    uint32_t hartsel_;      // HartID of the parent CPU
 };
 
 class CmdDmiCpuRiscV : public CmdDmiCpuGneric {
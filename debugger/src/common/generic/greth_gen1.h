@@ -76,6 +76,7 @@ class GrethGeneric : public IService,
 
     /** IMemoryOperation */
     virtual ETransStatus b_transport(Axi4TransactionType *trans);
+    virtual bool isSerialized() { return true; }
 
     /** IAxi4NbResponse */
     virtual void nb_response(Axi4TransactionType *trans);
@@ -21,6 +21,7 @@
 #include <iservice.h>
 #include "coreservices/imemop.h"
 #include "coreservices/ireset.h"
+#include "coreservices/icheckpoint.h"
 
 namespace debugger {
 
@@ -32,6 +33,12 @@ class MappedReg64Type : public IMemoryOperation,
 
     /** IMemoryOperation methods */
     virtual ETransStatus b_transport(Axi4TransactionType *trans);
+    virtual void saveRegisters(CheckpointState *state) {
+        state->write(&value_, sizeof(value_));
+    }
+    virtual void restoreRegisters(CheckpointState *state) {
+        state->read(&value_, sizeof(value_));
+    }
 
     /** IResetListener interface */
     virtual void reset(IFace *isource) { value_.val = hard_reset_value_; }
@@ -74,6 +81,12 @@ class MappedReg32Type : public IMemoryOperation,
 
     /** IMemoryOperation methods */
     virtual ETransStatus b_transport(Axi4TransactionType *trans);
+    virtual void saveRegisters(CheckpointState *state) {
+        state->write(&value_, sizeof(value_));
+    }
+    virtual void restoreRegisters(CheckpointState *state) {
+        state->read(&value_, sizeof(value_));
+    }
 
     /** IResetListener interface */
     virtual void reset(IFace *isource) { value_.val = hard_reset_value_; }
@@ -116,6 +129,12 @@ class MappedReg16Type : public IMemoryOperation,
 
     /** IMemoryOperation methods */
     virtual ETransStatus b_transport(Axi4TransactionType *trans);
+    virtual void saveRegisters(CheckpointState *state) {
+        state->write(&value_, sizeof(value_));
+    }
+    virtual void restoreRegisters(CheckpointState *state) {
+        state->read(&value_, sizeof(value_));
+    }
 
     /** IResetListener interface */
     virtual void reset(IFace *isource) { value_.word = hard_reset_value_; }
@@ -158,6 +177,12 @@ class MappedReg8Type : public IMemoryOperation,
 
     /** IMemoryOperation methods */
     virtual ETransStatus b_transport(Axi4TransactionType *trans);
+    virtual void saveRegisters(CheckpointState *state) {
+        state->write(&value_, sizeof(value_));
+    }
+    virtual void restoreRegisters(CheckpointState *state) {
+        state->read(&value_, sizeof(value_));
+    }
 
     /** IResetListener interface */
     virtual void reset(IFace *isource) { value_.byte = hard_reset_value_; }
@@ -212,6 +237,12 @@ class GenericReg64Bank : public IMemoryOperation {
 
     /** IMemoryOperation methods */
     virtual ETransStatus b_transport(Axi4TransactionType *trans);
+    virtual void saveRegisters(CheckpointState *state) {
+        state->write(regs_, length_.to_uint64());
+    }
+    virtual void restoreRegisters(CheckpointState *state) {
+        state->read(regs_, length_.to_uint64());
+    }
 
     /** IResetListener interface */
     virtual void reset();
@@ -250,6 +281,12 @@ class GenericReg32Bank : public IMemoryOperation {
 
     /** IMemoryOperation methods */
     virtual ETransStatus b_transport(Axi4TransactionType *trans);
+    virtual void saveRegisters(CheckpointState *state) {
+        state->write(regs_, length_.to_uint64());
+    }
+    virtual void restoreRegisters(CheckpointState *state) {
+        state->read(regs_, length_.to_uint64());
+    }
 
     /** IResetListener interface */
     virtual void reset();
@@ -287,6 +324,12 @@ class GenericReg16Bank : public IMemoryOperation {
 
     /** IMemoryOperation methods */
     virtual ETransStatus b_transport(Axi4TransactionType *trans);
+    virtual void saveRegisters(CheckpointState *state) {
+        state->write(regs_, length_.to_uint64());
+    }
+    virtual void restoreRegisters(CheckpointState *state) {
+        state->read(regs_, length_.to_uint64());
+    }
 
     /** IResetListener interface */
     virtual void reset();
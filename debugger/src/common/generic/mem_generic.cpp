@@ -21,6 +21,7 @@ namespace debugger {
 
 MemoryGeneric::MemoryGeneric(const char *name)  : IService(name) {
     registerInterface(static_cast<IMemoryOperation *>(this));
+    registerInterface(static_cast<ICheckpoint *>(this));
     registerAttribute("ReadOnly", &readOnly_);
     registerAttribute("DpiClient", &dpiClient_);
     registerAttribute("DpiRoutes", &dpiRoutes_);
@@ -28,16 +29,27 @@ MemoryGeneric::MemoryGeneric(const char *name)  : IService(name) {
     readOnly_.make_boolean(false);
     mem_ = NULL;
     idpi_ = 0;
+    dirty_ = 0;
+    ckptPages_ = 0;
+    pageTotal_ = 0;
 }
 
 MemoryGeneric::~MemoryGeneric() {
     if (mem_) {
         delete mem_;
     }
+    setCheckpointBase(0);
+    if (dirty_) {
+        delete [] dirty_;
+    }
 }
 
 void MemoryGeneric::postinitService() {
     mem_ = new uint8_t[static_cast<unsigned>(length_.to_uint64())];
+    pageTotal_ = (length_.to_uint64() + CheckpointPageType::PAGE_SIZE - 1)
+                >> CheckpointPageType::PAGE_BITS;
+    dirty_ = new uint8_t[pageTotal_];
+    memset(dirty_, 1, pageTotal_);
 
     if (dpiClient_.is_string() && dpiClient_.size()) {
         idpi_ = static_cast<IDpi *>(
@@ -65,6 +77,8 @@ ETransStatus MemoryGeneric::b_transport(Axi4TransactionType *trans) {
                 mem_[off + i] = trans->wpayload.b8[i];
             }
         }
+        dirty_[off >> CheckpointPageType::PAGE_BITS] = 1;
+        dirty_[(off + trans->xsize - 1) >> CheckpointPageType::PAGE_BITS] = 1;
 
         /** Access to SystemVerilog */
         if (idpi_ && dpiRoutes_[trans->source_idx].to_bool()) {
@@ -99,4 +113,146 @@ ETransStatus MemoryGeneric::b_transport(Axi4TransactionType *trans) {
     return TRANS_OK;
 }
 
+ETransStatus MemoryGeneric::b_burst(Axi4BurstType *burst) {
+    uint64_t off = burst->addr - getBaseAddress();
+    if (mem_ == 0 || idpi_ || burst->addr < getBaseAddress()
+        || off + burst->size > getLength()) {
+        // Wrapped range or each beat should be duplicated into SystemVerilog
+        return IMemoryOperation::b_burst(burst);
+    }
+    if (burst->size == 0) {
+        return TRANS_OK;
+    }
+
+    if (burst->action == MemAction_Write) {
+        if (readOnly_.to_bool()) {
+            // Reported the same way as the single beat write
+            RISCV_error("Write to READ ONLY memory", NULL);
+            return TRANS_OK;
+        }
+        memcpy(&mem_[off], burst->buf, burst->size);
+        uint64_t pg0 = off >> CheckpointPageType::PAGE_BITS;
+        uint64_t pg1 = (off + burst->size - 1) >> CheckpointPageType::PAGE_BITS;
+        memset(&dirty_[pg0], 1, pg1 - pg0 + 1);
+    } else {
+        memcpy(burst->buf, &mem_[off], burst->size);
+    }
+    RISCV_debug("[%08" RV_PRI64 "x] %s %d bytes burst",
+        burst->addr, burst->action == MemAction_Write ? "<=" : "=>",
+        burst->size);
+    return TRANS_OK;
+}
+
+bool MemoryGeneric::getHostMemory(uint64_t addr,
+                                  HostMemoryRangeType *range) {
+    if (mem_ == 0 || idpi_) {
+        // Each access should be duplicated into SystemVerilog
+        return false;
+    }
+    if (addr < getBaseAddress() || addr >= getBaseAddress() + getLength()) {
+        return false;
+    }
+    range->addr = getBaseAddress();
+    range->size = getLength();
+    range->ptr = mem_;
+    range->readonly = readOnly_.to_bool();
+    range->dirty = dirty_;
+    return true;
+}
+
+/**
+ * Only pages written since the previous checkpoint are copied, others are
+ * shared with it. Zero filled pages aren't stored at all.
+ */
+void MemoryGeneric::saveState(CheckpointState *state) {
+    CheckpointPageType **pages = new CheckpointPageType *[pageTotal_];
+    CheckpointPageType *pg;
+    uint64_t sz;
+    for (uint64_t i = 0; i < pageTotal_; i++) {
+        if (ckptPages_ && !dirty_[i]) {
+            pages[i] = ckptPages_[i];
+            if (pages[i]) {
+                pages[i]->addRef();
+            }
+            continue;
+        }
+        uint8_t *p = &mem_[i << CheckpointPageType::PAGE_BITS];
+        sz = pageLength(i);
+        pages[i] = 0;
+        for (uint64_t n = 0; n < sz; n++) {
+            if (p[n]) {
+                pg = new CheckpointPageType;
+                memcpy(pg->data, p, sz);
+                pages[i] = pg;
+                break;
+            }
+        }
+        dirty_[i] = 0;
+    }
+    state->write64(length_.to_uint64());
+    state->setPages(pages, pageTotal_);
+    setCheckpointBase(pages);
+}
+
+/**
+ * Pages that are clean and the same as in the restored checkpoint are
+ * already in place, only the rest is copied.
+ */
+bool MemoryGeneric::restoreState(CheckpointState *state) {
+    CheckpointPageType **pages = state->pages();
+    if (state->read64() != length_.to_uint64()
+        || state->pageTotal() != pageTotal_) {
+        RISCV_error("Checkpoint memory size mismatch", 0);
+        return false;
+    }
+    for (uint64_t i = 0; i < pageTotal_; i++) {
+        if (ckptPages_ && !dirty_[i] && ckptPages_[i] == pages[i]) {
+            continue;
+        }
+        uint8_t *p = &mem_[i << CheckpointPageType::PAGE_BITS];
+        if (pages[i]) {
+            memcpy(p, pages[i]->data, pageLength(i));
+        } else {
+            memset(p, 0, pageLength(i));
+        }
+        dirty_[i] = 0;
+    }
+    setCheckpointBase(pages);
+    return true;
+}
+
+void MemoryGeneric::setCheckpointBase(CheckpointPageType **pages) {
+    if (ckptPages_) {
+        for (uint64_t i = 0; i < pageTotal_; i++) {
+            if (ckptPages_[i]) {
+                ckptPages_[i]->release();
+            }
+        }
+    }
+    if (pages == 0) {
+        if (ckptPages_) {
+            delete [] ckptPages_;
+        }
+        ckptPages_ = 0;
+        return;
+    }
+    if (ckptPages_ == 0) {
+        ckptPages_ = new CheckpointPageType *[pageTotal_];
+    }
+    for (uint64_t i = 0; i < pageTotal_; i++) {
+        ckptPages_[i] = pages[i];
+        if (pages[i]) {
+            pages[i]->addRef();
+        }
+    }
+}
+
+uint64_t MemoryGeneric::pageLength(uint64_t idx) {
+    uint64_t off = idx << CheckpointPageType::PAGE_BITS;
+    if (off + CheckpointPageType::PAGE_SIZE > length_.to_uint64()) {
+        return length_.to_uint64() - off;
+    }
+    return CheckpointPageType::PAGE_SIZE;
+}
+
 }  // namespace debugger
@@ -20,12 +20,14 @@
 #include "iclass.h"
 #include "iservice.h"
 #include "coreservices/imemop.h"
+#include "coreservices/icheckpoint.h"
 #include <coreservices/idpi.h>
 
 namespace debugger {
 
 class MemoryGeneric : public IService, 
-                      public IMemoryOperation {
+                      public IMemoryOperation,
+                      public ICheckpoint {
  public:
     MemoryGeneric(const char *name);
     ~MemoryGeneric();
@@ -35,6 +37,16 @@ class MemoryGeneric : public IService,
 
     /** IMemoryOperation */
     virtual ETransStatus b_transport(Axi4TransactionType *trans);
+    virtual ETransStatus b_burst(Axi4BurstType *burst);
+    virtual bool getHostMemory(uint64_t addr, HostMemoryRangeType *range);
+
+    /** ICheckpoint */
+    virtual void saveState(CheckpointState *state);
+    virtual bool restoreState(CheckpointState *state);
+
+ protected:
+    void setCheckpointBase(CheckpointPageType **pages);
+    uint64_t pageLength(uint64_t idx);
 
  protected:
     AttributeType readOnly_;
@@ -44,6 +56,11 @@ class MemoryGeneric : public IService,
     IDpi *idpi_;
 
     uint8_t *mem_;
+    // Pages written since the last checkpoint save or restore and pages of
+    // that checkpoint: clean pages are shared with the next checkpoint.
+    uint8_t *dirty_;
+    CheckpointPageType **ckptPages_;
+    uint64_t pageTotal_;
 };
 
 }  // namespace debugger
@@ -0,0 +1,97 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef __SRC_COMMON_GENERIC_RESERVATION_H__
+#define __SRC_COMMON_GENERIC_RESERVATION_H__
+
+#include <inttypes.h>
+#include <atomic>
+
+namespace debugger {
+
+/**
+ * LR/SC reservations of the bus masters. Table is shared by all harts
+ * running in different host threads: store of any master into the reserved
+ * granule clears reservations of other masters.
+ */
+class ReservationTable {
+ public:
+    static const int MASTERS_MAX = 64;
+    static const int GRANULE_BITS = 6;      // 64 bytes, one cache line
+
+    ReservationTable() : cnt_(0) {
+        for (int i = 0; i < MASTERS_MAX; i++) {
+            addr_[i] = INVALID;
+        }
+    }
+
+    void reserve(int idx, uint64_t addr) {
+        if (idx < 0 || idx >= MASTERS_MAX) {
+            return;
+        }
+        if (addr_[idx].exchange(addr >> GRANULE_BITS) == INVALID) {
+            cnt_.fetch_add(1);
+        }
+    }
+
+    /** Clear own reservation
+     * @return true if the reservation on the address was still valid
+     */
+    bool release(int idx, uint64_t addr) {
+        if (idx < 0 || idx >= MASTERS_MAX) {
+            return false;
+        }
+        uint64_t prev = addr_[idx].exchange(INVALID);
+        if (prev == INVALID) {
+            return false;
+        }
+        cnt_.fetch_sub(1);
+        return prev == (addr >> GRANULE_BITS);
+    }
+
+    /** Compiled stores skip invalidate() while there are no reservations */
+    const std::atomic<int> *getValidCounter() { return &cnt_; }
+
+    /** Store of the master 'idx' (burst too) breaks reservations of others */
+    void invalidate(int idx, uint64_t addr, uint32_t sz) {
+        if (cnt_.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+        uint64_t g0 = addr >> GRANULE_BITS;
+        uint64_t g1 = (addr + sz - 1) >> GRANULE_BITS;
+        uint64_t t;
+        for (int i = 0; i < MASTERS_MAX; i++) {
+            if (i == idx) {
+                continue;
+            }
+            t = addr_[i].load(std::memory_order_relaxed);
+            if (t >= g0 && t <= g1
+                && addr_[i].compare_exchange_strong(t, INVALID)) {
+                cnt_.fetch_sub(1);
+            }
+        }
+    }
+
+ private:
+    static const uint64_t INVALID = ~0ull;
+
+    std::atomic<uint64_t> addr_[MASTERS_MAX];   // granule index or INVALID
+    std::atomic<int> cnt_;                      // valid reservations
+};
+
+}  // namespace debugger
+
+#endif  // __SRC_COMMON_GENERIC_RESERVATION_H__
@@ -0,0 +1,246 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <iservice.h>
+#include "reverse_exec.h"
+
+namespace debugger {
+
+ReverseHistory::ReverseHistory(int snapshotsMax) {
+    AttributeType list;
+    RISCV_get_services_with_iface(IFACE_CHECKPOINT, &list);
+    ckptTotal_ = static_cast<int>(list.size());
+    ckpt_ = new ICheckpoint *[ckptTotal_ + 1];
+    for (int i = 0; i < ckptTotal_; i++) {
+        IService *iserv = static_cast<IService *>(list[i].to_iface());
+        ckpt_[i] = static_cast<ICheckpoint *>(
+                    iserv->getInterface(IFACE_CHECKPOINT));
+    }
+
+    snapMax_ = snapshotsMax < 2 ? 2 : snapshotsMax;
+    snapAlloc_ = snapMax_ + 1;
+    snap_ = new SnapshotType[snapAlloc_];
+    snapCnt_ = 0;
+
+    log_ = 0;
+    logCnt_ = 0;
+    logMax_ = 0;
+    logPos_ = 0;
+    pend_ = 0;
+    pendCnt_ = 0;
+    pendMax_ = 0;
+    posted_ = false;
+    RISCV_mutex_init(&mutexInput_);
+}
+
+ReverseHistory::~ReverseHistory() {
+    freeSnapshot(0);
+    delete [] snap_;
+    delete [] ckpt_;
+    if (log_) {
+        delete [] log_;
+    }
+    if (pend_) {
+        delete [] pend_;
+    }
+    RISCV_mutex_destroy(&mutexInput_);
+}
+
+/** Free snapshots starting from the index */
+void ReverseHistory::freeSnapshot(int idx) {
+    for (int i = idx; i < snapCnt_; i++) {
+        for (int n = 0; n < ckptTotal_; n++) {
+            delete snap_[i].states[n];
+        }
+        delete [] snap_[i].states;
+    }
+    if (idx < snapCnt_) {
+        snapCnt_ = idx;
+    }
+}
+
+void ReverseHistory::takeSnapshot(uint64_t step, uint64_t frontier,
+                                  uint64_t mingap, bool pinned) {
+    int idx = findSnapshot(step);
+    if (idx >= 0 && snap_[idx].step == step) {
+        // State could be modified by debugger while halted on this step
+        pinned = pinned || snap_[idx].pinned;
+        for (int n = 0; n < ckptTotal_; n++) {
+            delete snap_[idx].states[n];
+        }
+        delete [] snap_[idx].states;
+    } else {
+        if ((idx >= 0 && step - snap_[idx].step < mingap)
+            || (idx + 1 < snapCnt_ && snap_[idx + 1].step - step < mingap)) {
+            return;
+        }
+        if (snapCnt_ == snapAlloc_) {
+            SnapshotType *t = new SnapshotType[2 * snapAlloc_];
+            memcpy(t, snap_, snapCnt_*sizeof(SnapshotType));
+            delete [] snap_;
+            snap_ = t;
+            snapAlloc_ *= 2;
+        }
+        idx++;
+        memmove(&snap_[idx + 1], &snap_[idx],
+                (snapCnt_ - idx)*sizeof(SnapshotType));
+        snapCnt_++;
+    }
+
+    snap_[idx].step = step;
+    snap_[idx].pinned = pinned;
+    snap_[idx].states = new CheckpointState *[ckptTotal_ + 1];
+    for (int n = 0; n < ckptTotal_; n++) {
+        snap_[idx].states[n] = new CheckpointState;
+        ckpt_[n]->saveState(snap_[idx].states[n]);
+    }
+    if (snapCnt_ > snapMax_) {
+        thinOut(frontier);
+    }
+}
+
+/**
+ * Remove the snapshot whose neighbours are the closest relative to its
+ * age. The oldest and the newest snapshots are always kept.
+ */
+void ReverseHistory::thinOut(uint64_t frontier) {
+    int sel = -1;
+    double w, wmin = 0;
+    for (int i = 1; i < snapCnt_ - 1; i++) {
+        if (snap_[i].pinned) {
+            continue;
+        }
+        w = static_cast<double>(snap_[i + 1].step - snap_[i - 1].step);
+        if (frontier > snap_[i].step) {
+            w /= static_cast<double>(frontier - snap_[i].step);
+        }
+        if (sel < 0 || w < wmin) {
+            wmin = w;
+            sel = i;
+        }
+    }
+    if (sel < 0) {
+        return;
+    }
+    for (int n = 0; n < ckptTotal_; n++) {
+        delete snap_[sel].states[n];
+    }
+    delete [] snap_[sel].states;
+    memmove(&snap_[sel], &snap_[sel + 1],
+            (snapCnt_ - sel - 1)*sizeof(SnapshotType));
+    snapCnt_--;
+}
+
+int ReverseHistory::findSnapshot(uint64_t step) {
+    int lo = 0;
+    int hi = snapCnt_;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (snap_[mid].step <= step) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo - 1;
+}
+
+bool ReverseHistory::restoreSnapshot(int idx) {
+    for (int n = 0; n < ckptTotal_; n++) {
+        snap_[idx].states[n]->rewind();
+        if (!ckpt_[n]->restoreState(snap_[idx].states[n])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ReverseHistory::truncate(uint64_t step) {
+    freeSnapshot(findSnapshot(step) + 1);
+    while (logCnt_ && log_[logCnt_ - 1].step > step) {
+        logCnt_--;
+    }
+    if (logPos_ > logCnt_) {
+        logPos_ = logCnt_;
+    }
+}
+
+void ReverseHistory::addRecord(InputRecordType **buf, int *cnt, int *max,
+                               uint64_t step, IClockInput *dev,
+                               const char *data, int sz) {
+    while (sz > 0) {
+        if (*cnt == *max) {
+            int nmax = *max ? 2 * (*max) : 256;
+            InputRecordType *t = new InputRecordType[nmax];
+            if (*buf) {
+                memcpy(t, *buf, (*cnt)*sizeof(InputRecordType));
+                delete [] *buf;
+            }
+            *buf = t;
+            *max = nmax;
+        }
+        InputRecordType *p = &(*buf)[(*cnt)++];
+        p->step = step;
+        p->dev = dev;
+        p->sz = sz < INPUT_CHUNK ? sz : INPUT_CHUNK;
+        memcpy(p->data, data, p->sz);
+        data += p->sz;
+        sz -= p->sz;
+    }
+}
+
+void ReverseHistory::postInput(IClockInput *dev, const char *buf, int sz) {
+    RISCV_mutex_lock(&mutexInput_);
+    addRecord(&pend_, &pendCnt_, &pendMax_, 0, dev, buf, sz);
+    posted_.store(true, std::memory_order_release);
+    RISCV_mutex_unlock(&mutexInput_);
+}
+
+void ReverseHistory::acceptInputs(uint64_t step) {
+    RISCV_mutex_lock(&mutexInput_);
+    for (int i = 0; i < pendCnt_; i++) {
+        addRecord(&log_, &logCnt_, &logMax_, step, pend_[i].dev,
+                  pend_[i].data, pend_[i].sz);
+    }
+    pendCnt_ = 0;
+    posted_.store(false, std::memory_order_relaxed);
+    RISCV_mutex_unlock(&mutexInput_);
+}
+
+uint64_t ReverseHistory::deliverInputs(uint64_t step) {
+    while (logPos_ < logCnt_ && log_[logPos_].step <= step) {
+        log_[logPos_].dev->clockInput(log_[logPos_].data, log_[logPos_].sz);
+        logPos_++;
+    }
+    return logPos_ < logCnt_ ? log_[logPos_].step : ~0ull;
+}
+
+uint64_t ReverseHistory::seekInputs(uint64_t step) {
+    int lo = 0;
+    int hi = logCnt_;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (log_[mid].step <= step) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    logPos_ = lo;
+    return logPos_ < logCnt_ ? log_[logPos_].step : ~0ull;
+}
+
+}  // namespace debugger
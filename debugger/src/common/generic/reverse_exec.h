@@ -0,0 +1,113 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef __SRC_COMMON_GENERIC_REVERSE_EXEC_H__
+#define __SRC_COMMON_GENERIC_REVERSE_EXEC_H__
+
+#include <api_core.h>
+#include "coreservices/icheckpoint.h"
+#include "coreservices/iclock.h"
+#include <atomic>
+
+namespace debugger {
+
+/**
+ * Execution history of the platform driven by one clock: periodic
+ * snapshots of all ICheckpoint services and the log of the external
+ * inputs. Any step of the history is reproduced by re-execution from the
+ * nearest snapshot with the inputs delivered on the recorded steps.
+ * All methods except postInput() are called from the clock thread or
+ * while it is halted.
+ */
+class ReverseHistory {
+ public:
+    explicit ReverseHistory(int snapshotsMax);
+    ~ReverseHistory();
+
+    /**
+     * Snapshot of the current state. Snapshots closer than 'mingap' to
+     * the existing ones are skipped, old snapshots are thinned out so that
+     * the density decreases with the distance from the 'frontier' step.
+     * Pinned snapshot (state modified by debugger) is never removed.
+     */
+    void takeSnapshot(uint64_t step, uint64_t frontier, uint64_t mingap,
+                      bool pinned);
+    /** @return index of the latest snapshot not later than 'step' or -1 */
+    int findSnapshot(uint64_t step);
+    uint64_t snapshotStep(int idx) { return snap_[idx].step; }
+    int snapshotTotal() { return snapCnt_; }
+    bool restoreSnapshot(int idx);
+
+    /** Past state was modified: drop the history after the step */
+    void truncate(uint64_t step);
+    void reset() { truncate(0); freeSnapshot(0); }
+
+    /** Input from any thread accepted later by the clock thread */
+    void postInput(IClockInput *dev, const char *buf, int sz);
+    bool isInputPosted() { return posted_.load(std::memory_order_relaxed); }
+    /** Log the posted inputs to be delivered on the step */
+    void acceptInputs(uint64_t step);
+    /**
+     * Deliver the logged inputs up to the step.
+     * @return step of the next logged input or ~0ull
+     */
+    uint64_t deliverInputs(uint64_t step);
+    /** Replay the inputs logged after the step, @return next input step */
+    uint64_t seekInputs(uint64_t step);
+    int inputTotal() { return logCnt_; }
+
+ private:
+    struct SnapshotType {
+        uint64_t step;
+        bool pinned;
+        CheckpointState **states;
+    };
+
+    static const int INPUT_CHUNK = 16;
+    struct InputRecordType {
+        uint64_t step;
+        IClockInput *dev;
+        int sz;
+        char data[INPUT_CHUNK];
+    };
+
+    void freeSnapshot(int idx);
+    void thinOut(uint64_t frontier);
+    void addRecord(InputRecordType **buf, int *cnt, int *max,
+                   uint64_t step, IClockInput *dev, const char *data, int sz);
+
+ private:
+    ICheckpoint **ckpt_;
+    int ckptTotal_;
+    SnapshotType *snap_;        // sorted by step
+    int snapCnt_;
+    int snapMax_;
+    int snapAlloc_;             // pinned snapshots could exceed maximum
+
+    InputRecordType *log_;      // sorted by step
+    int logCnt_;
+    int logMax_;
+    int logPos_;                // next record to deliver
+    InputRecordType *pend_;     // posted but not accepted yet
+    int pendCnt_;
+    int pendMax_;
+    std::atomic<bool> posted_;
+    mutex_def mutexInput_;
+};
+
+}  // namespace debugger
+
+#endif  // __SRC_COMMON_GENERIC_REVERSE_EXEC_H__
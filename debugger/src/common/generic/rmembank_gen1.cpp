@@ -14,6 +14,7 @@
  *  limitations under the License.
  */
 
+#include <stdlib.h>
 #include "api_core.h"
 #include "rmembank_gen1.h"
 
@@ -22,7 +23,9 @@ namespace debugger {
 RegMemBankGeneric::RegMemBankGeneric(const char *name)
     : IService(name), IHap(HAP_ConfigDone) {
     registerInterface(static_cast<IMemoryOperation *>(this));
+    registerInterface(static_cast<ICheckpoint *>(this));
     stubmem = 0;
+    stubused_ = 0;
     imaphash_ = 0;
 
     RISCV_register_hap(static_cast<IHap *>(this));
@@ -31,15 +34,18 @@ RegMemBankGeneric::RegMemBankGeneric(const char *name)
 RegMemBankGeneric::~RegMemBankGeneric() {
     if (stubmem) {
         delete [] stubmem;
+        delete [] stubused_;
     }
     if (imaphash_) {
-        delete [] imaphash_;
+        free(imaphash_);
     }
 }
 
 void RegMemBankGeneric::postinitService() {
-    imaphash_ = new IMemoryOperation *[length_.to_int()];
-    memset(imaphash_, 0, length_.to_int()*sizeof(IMemoryOperation *));
+    // Zeroed pages from the system: large sparse banks like the 64 MB PLIC
+    // don't touch the whole map on start
+    imaphash_ = static_cast<IMemoryOperation **>(
+        calloc(length_.to_int(), sizeof(IMemoryOperation *)));
 
     IMemoryOperation *imem;
     for (unsigned i = 0; i < listMap_.size(); i++) {
@@ -67,8 +73,12 @@ void RegMemBankGeneric::postinitService() {
             map(imem);
         }
     }
+    // Stub chunk is filled with the reset pattern on the first write
     stubmem = new uint8_t[length_.to_int()];
-    memset(stubmem, 0xFF, length_.to_int());
+    uint64_t chunks = (length_.to_uint64() + CheckpointPageType::PAGE_SIZE - 1)
+                        >> CheckpointPageType::PAGE_BITS;
+    stubused_ = new uint8_t[chunks];
+    memset(stubused_, 0, chunks);
 }
 
 /** We need correctly mapped device list to compute hash, postinit
@@ -84,6 +94,59 @@ void RegMemBankGeneric::hapTriggered(EHapType type,
     RISCV_unregister_hap(static_cast<IHap *>(this));
 }
 
+void RegMemBankGeneric::saveState(CheckpointState *state) {
+    IMemoryOperation *imem;
+    state->write64(imap_.size());
+    for (unsigned i = 0; i < imap_.size(); i++) {
+        imem = static_cast<IMemoryOperation *>(imap_[i].to_iface());
+        imem->saveRegisters(state);
+    }
+
+    // Unmapped area keeps the reset pattern: only modified chunks
+    uint64_t chunk = CheckpointPageType::PAGE_SIZE;
+    uint64_t total = length_.to_uint64();
+    for (uint64_t off = 0; off < total; off += chunk) {
+        if (!stubused_[off >> CheckpointPageType::PAGE_BITS]) {
+            continue;
+        }
+        uint64_t sz = total - off < chunk ? total - off : chunk;
+        for (uint64_t i = 0; i < sz; i++) {
+            if (stubmem[off + i] != 0xFF) {
+                state->write64(off);
+                state->write(&stubmem[off], sz);
+                break;
+            }
+        }
+    }
+    state->write64(~0ull);
+}
+
+bool RegMemBankGeneric::restoreState(CheckpointState *state) {
+    IMemoryOperation *imem;
+    if (state->read64() != imap_.size()) {
+        RISCV_error("Checkpoint registers map mismatch", 0);
+        return false;
+    }
+    for (unsigned i = 0; i < imap_.size(); i++) {
+        imem = static_cast<IMemoryOperation *>(imap_[i].to_iface());
+        imem->restoreRegisters(state);
+    }
+    uint64_t chunk = CheckpointPageType::PAGE_SIZE;
+    uint64_t total = length_.to_uint64();
+    uint64_t off;
+    for (off = 0; off < total; off += chunk) {
+        stubused_[off >> CheckpointPageType::PAGE_BITS] = 0;
+    }
+    while ((off = state->read64()) < total) {
+        uint64_t sz = total - off < chunk ? total - off : chunk;
+        if (!state->read(&stubmem[off], sz)) {
+            return false;
+        }
+        stubused_[off >> CheckpointPageType::PAGE_BITS] = 1;
+    }
+    return off == ~0ull;
+}
+
 ETransStatus RegMemBankGeneric::b_transport(Axi4TransactionType *trans) {
     IMemoryOperation *imem;
     uint64_t t_addr = trans->addr;      // orignal address
@@ -116,9 +179,19 @@ ETransStatus RegMemBankGeneric::b_transport(Axi4TransactionType *trans) {
             off += tr.xsize;
         } else {
             // Stubs:
+            uint8_t *used = &stubused_[off >> CheckpointPageType::PAGE_BITS];
             if (trans->action == MemAction_Read) {
-                trans->rpayload.b8[off - off0] = stubmem[off];
+                trans->rpayload.b8[off - off0] = *used ? stubmem[off] : 0xFF;
             } else  if (tr.wstrb & 0x1) {
+                if (!*used) {
+                    uint64_t chunk = off & ~(CheckpointPageType::PAGE_SIZE - 1);
+                    uint64_t sz = length_.to_uint64() - chunk;
+                    if (sz > CheckpointPageType::PAGE_SIZE) {
+                        sz = CheckpointPageType::PAGE_SIZE;
+                    }
+                    memset(&stubmem[chunk], 0xFF, sz);
+                    *used = 1;
+                }
                 stubmem[off] = trans->wpayload.b8[off - off0];
             }
             tr.wstrb >>= 1;
@@ -20,11 +20,13 @@
 #include "iservice.h"
 #include "ihap.h"
 #include "coreservices/imemop.h"
+#include "coreservices/icheckpoint.h"
 
 namespace debugger {
 
 class RegMemBankGeneric : public IService, 
                           public IMemoryOperation,
+                          public ICheckpoint,
                           public IHap {
  public:
     explicit RegMemBankGeneric(const char *name);
@@ -37,8 +39,14 @@ class RegMemBankGeneric : public IService,
     virtual ETransStatus b_transport(Axi4TransactionType *trans);
     virtual ETransStatus nb_transport(Axi4TransactionType *trans,
                               IAxi4NbResponse *cb);
+    /** Registers callbacks of peripherals aren't re-entrant */
+    virtual bool isSerialized() { return true; }
 
 
+    /** ICheckpoint: mapped registers and stub memory */
+    virtual void saveState(CheckpointState *state);
+    virtual bool restoreState(CheckpointState *state);
+
     /** IHap */
     virtual void hapTriggered(EHapType type, uint64_t param,
                               const char *descr);
@@ -51,6 +59,7 @@ class RegMemBankGeneric : public IService,
  protected:
     IMemoryOperation **imaphash_;
     uint8_t *stubmem;
+    uint8_t *stubused_;     // checkpoint chunks written at least once
 };
 
 }  // namespace debugger
@@ -0,0 +1,460 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <string.h>
+#include "trace_file.h"
+
+namespace debugger {
+
+enum ETraceRecord {
+    TraceRec_Step = 1,
+    TraceRec_Reg,
+    TraceRec_MemRead,
+    TraceRec_MemWrite
+};
+
+static const int LZ_HASH_BITS = 12;
+static const uint32_t LZ_MIN_MATCH = 4;
+static const uint32_t LZ_MAX_OFFSET = 0xFFFF;
+
+/**
+ * Byte oriented LZ77 block compression (LZ4-like sequences): token with
+ * literals and match lengths, literals, 16-bits offset.
+ */
+static uint32_t lz_put_length(uint8_t *dst, uint32_t op, uint32_t len) {
+    while (len >= 255) {
+        dst[op++] = 255;
+        len -= 255;
+    }
+    dst[op++] = static_cast<uint8_t>(len);
+    return op;
+}
+
+static uint32_t lz_put_sequence(uint8_t *dst, uint32_t op,
+                                const uint8_t *lit, uint32_t litlen,
+                                uint32_t offset, uint32_t mlen) {
+    uint32_t token = (litlen < 15 ? litlen : 15) << 4;
+    if (mlen) {
+        mlen -= LZ_MIN_MATCH;
+        token |= mlen < 15 ? mlen : 15;
+    }
+    dst[op++] = static_cast<uint8_t>(token);
+    if (litlen >= 15) {
+        op = lz_put_length(dst, op, litlen - 15);
+    }
+    memcpy(&dst[op], lit, litlen);
+    op += litlen;
+    if (offset) {
+        dst[op++] = static_cast<uint8_t>(offset);
+        dst[op++] = static_cast<uint8_t>(offset >> 8);
+        if (mlen >= 15) {
+            op = lz_put_length(dst, op, mlen - 15);
+        }
+    }
+    return op;
+}
+
+/** @return compressed size, dst should be at least sz + sz/255 + 16 */
+static uint32_t lz_compress(const uint8_t *src, uint32_t sz, uint8_t *dst) {
+    int32_t htbl[1 << LZ_HASH_BITS];
+    uint32_t ip = 0;
+    uint32_t anchor = 0;
+    uint32_t op = 0;
+    uint32_t seq, refseq, h, mlen;
+    int32_t ref;
+
+    for (int i = 0; i < (1 << LZ_HASH_BITS); i++) {
+        htbl[i] = -1;
+    }
+    while (ip + LZ_MIN_MATCH <= sz) {
+        memcpy(&seq, &src[ip], 4);
+        h = (seq * 2654435761u) >> (32 - LZ_HASH_BITS);
+        ref = htbl[h];
+        htbl[h] = static_cast<int32_t>(ip);
+        if (ref < 0 || ip - ref > LZ_MAX_OFFSET) {
+            ip += 1 + ((ip - anchor) >> 6);
+            continue;
+        }
+        memcpy(&refseq, &src[ref], 4);
+        if (refseq != seq) {
+            ip += 1 + ((ip - anchor) >> 6);
+            continue;
+        }
+        mlen = LZ_MIN_MATCH;
+        while (ip + mlen < sz && src[ref + mlen] == src[ip + mlen]) {
+            mlen++;
+        }
+        op = lz_put_sequence(dst, op, &src[anchor], ip - anchor,
+                             ip - ref, mlen);
+        ip += mlen;
+        anchor = ip;
+    }
+    return lz_put_sequence(dst, op, &src[anchor], sz - anchor, 0, 0);
+}
+
+static bool lz_get_length(const uint8_t *src, uint32_t sz, uint32_t *ip,
+                          uint32_t *len) {
+    uint8_t b;
+    do {
+        if (*ip >= sz) {
+            return false;
+        }
+        b = src[(*ip)++];
+        *len += b;
+    } while (b == 255);
+    return true;
+}
+
+static bool lz_decompress(const uint8_t *src, uint32_t sz,
+                          uint8_t *dst, uint32_t dstsz) {
+    uint32_t ip = 0;
+    uint32_t op = 0;
+    uint32_t token, len, offset;
+    while (ip < sz) {
+        token = src[ip++];
+        len = token >> 4;
+        if (len == 15 && !lz_get_length(src, sz, &ip, &len)) {
+            return false;
+        }
+        if (ip + len > sz || op + len > dstsz) {
+            return false;
+        }
+        memcpy(&dst[op], &src[ip], len);
+        ip += len;
+        op += len;
+        if (ip == sz) {
+            break;
+        }
+
+        if (ip + 2 > sz) {
+            return false;
+        }
+        offset = src[ip] | (static_cast<uint32_t>(src[ip + 1]) << 8);
+        ip += 2;
+        len = token & 0xF;
+        if (len == 15 && !lz_get_length(src, sz, &ip, &len)) {
+            return false;
+        }
+        len += LZ_MIN_MATCH;
+        if (offset == 0 || offset > op || op + len > dstsz) {
+            return false;
+        }
+        // Overlapped copy is the run-length case
+        for (uint32_t i = 0; i < len; i++, op++) {
+            dst[op] = dst[op - offset];
+        }
+    }
+    return op == dstsz;
+}
+
+TraceWriter::TraceWriter(const char *filename, bool compress)
+    : IThread(), compress_(compress), closing_(false),
+    wrcnt_(0), rdcnt_(0), rdcache_(0) {
+    uint32_t hdr[2];
+    memset(&enc_, 0, sizeof(enc_));
+    ring_ = new uint8_t[RING_SIZE];
+    block_ = new uint8_t[BLOCK_SIZE];
+    packed_ = new uint8_t[2 * BLOCK_SIZE];
+
+    file_.open(filename, std::ios::out | std::ios::binary);
+    if (!file_.is_open()) {
+        return;
+    }
+    hdr[0] = TRACE_FILE_VERSION;
+    hdr[1] = compress_ ? TRACE_FLAG_COMPRESSED : 0;
+    file_.write(TRACE_FILE_MAGIC, sizeof(TRACE_FILE_MAGIC));
+    file_.write(reinterpret_cast<char *>(hdr), sizeof(hdr));
+}
+
+TraceWriter::~TraceWriter() {
+    closing_.store(true);
+    stop();
+    if (file_.is_open()) {
+        file_.close();
+    }
+    delete [] ring_;
+    delete [] block_;
+    delete [] packed_;
+}
+
+/** Unsigned LEB128 */
+static uint32_t put_varint(uint8_t *buf, uint32_t off, uint64_t v) {
+    while (v >= 0x80) {
+        buf[off++] = static_cast<uint8_t>(v | 0x80);
+        v >>= 7;
+    }
+    buf[off++] = static_cast<uint8_t>(v);
+    return off;
+}
+
+static uint64_t zigzag(uint64_t v) {
+    return (v << 1) ^ (0 - (v >> 63));
+}
+
+static uint64_t unzigzag(uint64_t v) {
+    return (v >> 1) ^ (0 - (v & 1));
+}
+
+void TraceWriter::writeStep(TraceStepType *t) {
+    uint8_t buf[32 + 24 * TRACE_ACTIONS_MAX];
+    uint32_t off = 0;
+    TraceActionType *pa;
+    uint8_t idx;
+
+    buf[off++] = TraceRec_Step;
+    buf[off++] = static_cast<uint8_t>(t->action_cnt);
+    memcpy(&buf[off], &t->instr, 4);
+    off += 4;
+    off = put_varint(buf, off, t->step_cnt - enc_.step);
+    off = put_varint(buf, off, zigzag(t->pc - enc_.pc));
+    enc_.step = t->step_cnt;
+    enc_.pc = t->pc;
+    for (int i = 0; i < t->action_cnt; i++) {
+        pa = &t->action[i];
+        if (!pa->memop) {
+            idx = static_cast<uint8_t>(pa->waddr);
+            buf[off++] = TraceRec_Reg;
+            buf[off++] = idx;
+            off = put_varint(buf, off, pa->wdata ^ enc_.regs[idx]);
+            enc_.regs[idx] = pa->wdata;
+        } else {
+            buf[off++] = pa->memop_write ? TraceRec_MemWrite
+                                         : TraceRec_MemRead;
+            buf[off++] = static_cast<uint8_t>(pa->memop_size);
+            off = put_varint(buf, off, zigzag(pa->memop_addr - enc_.maddr));
+            off = put_varint(buf, off, pa->memop_data.val ^ enc_.mdata);
+            enc_.maddr = pa->memop_addr;
+            enc_.mdata = pa->memop_data.val;
+        }
+    }
+    write(buf, off);
+}
+
+/**
+ * Simulation waits only if the writer thread can't keep up and the ring
+ * is full, trace is never truncated.
+ */
+void TraceWriter::write(const uint8_t *buf, uint32_t sz) {
+    uint64_t wr = wrcnt_.load(std::memory_order_relaxed);
+    while (wr + sz - rdcache_ > RING_SIZE) {
+        rdcache_ = rdcnt_.load(std::memory_order_acquire);
+        if (wr + sz - rdcache_ > RING_SIZE) {
+            RISCV_sleep_ms(1);
+        }
+    }
+    uint32_t pos = static_cast<uint32_t>(wr & (RING_SIZE - 1));
+    uint32_t part = RING_SIZE - pos;
+    if (part >= sz) {
+        memcpy(&ring_[pos], buf, sz);
+    } else {
+        memcpy(&ring_[pos], buf, part);
+        memcpy(ring_, &buf[part], sz - part);
+    }
+    wrcnt_.store(wr + sz, std::memory_order_release);
+}
+
+void TraceWriter::busyLoop() {
+    uint64_t rd = 0;
+    uint64_t wr = 0;
+    uint64_t wrprev = 0;
+    uint32_t sz, pos, part;
+    bool ena = true;
+
+    // Drain the ring before exit
+    while (ena || rd != wr) {
+        ena = !closing_.load();
+        wr = wrcnt_.load(std::memory_order_acquire);
+        // Wait full block while the producer is active
+        if (ena && (rd == wr || (wr - rd < BLOCK_SIZE && wr != wrprev))) {
+            wrprev = wr;
+            RISCV_sleep_ms(1);
+            continue;
+        }
+        sz = wr - rd < BLOCK_SIZE ? static_cast<uint32_t>(wr - rd)
+                                  : BLOCK_SIZE;
+        pos = static_cast<uint32_t>(rd & (RING_SIZE - 1));
+        part = RING_SIZE - pos;
+        if (part >= sz) {
+            memcpy(block_, &ring_[pos], sz);
+        } else {
+            memcpy(block_, &ring_[pos], part);
+            memcpy(&block_[part], ring_, sz - part);
+        }
+        rd += sz;
+        rdcnt_.store(rd, std::memory_order_release);
+        writeBlock(sz);
+    }
+    file_.flush();
+}
+
+void TraceWriter::writeBlock(uint32_t sz) {
+    uint32_t hdr[2];
+    const uint8_t *data = block_;
+    hdr[0] = sz;
+    hdr[1] = sz;
+    if (compress_) {
+        uint32_t packedsz = lz_compress(block_, sz, packed_);
+        if (packedsz < sz) {
+            hdr[1] = packedsz;
+            data = packed_;
+        }
+    }
+    file_.write(reinterpret_cast<char *>(hdr), sizeof(hdr));
+    file_.write(reinterpret_cast<const char *>(data), hdr[1]);
+}
+
+TraceReader::TraceReader() {
+    memset(&dec_, 0, sizeof(dec_));
+    block_ = 0;
+    packed_ = 0;
+    blockSize_ = 0;
+    blockPos_ = 0;
+}
+
+TraceReader::~TraceReader() {
+    if (block_) {
+        delete [] block_;
+        delete [] packed_;
+    }
+}
+
+bool TraceReader::open(const char *filename) {
+    char magic[sizeof(TRACE_FILE_MAGIC)];
+    uint32_t hdr[2];
+    file_.open(filename, std::ios::in | std::ios::binary);
+    if (!file_.is_open()) {
+        return false;
+    }
+    file_.read(magic, sizeof(magic));
+    file_.read(reinterpret_cast<char *>(hdr), sizeof(hdr));
+    if (!file_.good()
+        || memcmp(magic, TRACE_FILE_MAGIC, sizeof(magic)) != 0
+        || hdr[0] != TRACE_FILE_VERSION) {
+        file_.close();
+        return false;
+    }
+    return true;
+}
+
+bool TraceReader::readBlock() {
+    uint32_t hdr[2];
+    file_.read(reinterpret_cast<char *>(hdr), sizeof(hdr));
+    if (!file_.good() || hdr[0] == 0 || hdr[1] > 2 * hdr[0] + 16) {
+        return false;
+    }
+    if (blockSize_ < hdr[0] || !block_) {
+        if (block_) {
+            delete [] block_;
+            delete [] packed_;
+        }
+        block_ = new uint8_t[hdr[0]];
+        packed_ = new uint8_t[2 * hdr[0] + 16];
+    }
+    blockSize_ = hdr[0];
+    blockPos_ = 0;
+    if (hdr[1] == hdr[0]) {
+        file_.read(reinterpret_cast<char *>(block_), hdr[0]);
+        return file_.good();
+    }
+    file_.read(reinterpret_cast<char *>(packed_), hdr[1]);
+    if (!file_.good()) {
+        return false;
+    }
+    return lz_decompress(packed_, hdr[1], block_, hdr[0]);
+}
+
+/** Records may cross the blocks boundary */
+bool TraceReader::read(uint8_t *buf, uint32_t sz) {
+    uint32_t n;
+    while (sz) {
+        if (blockPos_ == blockSize_ && !readBlock()) {
+            return false;
+        }
+        n = blockSize_ - blockPos_;
+        if (n > sz) {
+            n = sz;
+        }
+        memcpy(buf, &block_[blockPos_], n);
+        blockPos_ += n;
+        buf += n;
+        sz -= n;
+    }
+    return true;
+}
+
+bool TraceReader::readVarint(uint64_t *v) {
+    uint8_t b;
+    int shift = 0;
+    *v = 0;
+    do {
+        if (shift > 63 || !read(&b, 1)) {
+            return false;
+        }
+        *v |= static_cast<uint64_t>(b & 0x7F) << shift;
+        shift += 7;
+    } while (b & 0x80);
+    return true;
+}
+
+bool TraceReader::readStep(TraceStepType *t) {
+    uint8_t buf[4];
+    uint64_t v1, v2;
+    TraceActionType *pa;
+    if (!read(buf, 2) || buf[0] != TraceRec_Step) {
+        return false;
+    }
+    t->action_cnt = buf[1];
+    if (t->action_cnt > TRACE_ACTIONS_MAX || !read(buf, 4)
+        || !readVarint(&v1) || !readVarint(&v2)) {
+        return false;
+    }
+    memcpy(&t->instr, buf, 4);
+    dec_.step += v1;
+    dec_.pc += unzigzag(v2);
+    t->step_cnt = dec_.step;
+    t->pc = dec_.pc;
+    for (int i = 0; i < t->action_cnt; i++) {
+        pa = &t->action[i];
+        if (!read(buf, 2)) {
+            return false;
+        }
+        if (buf[0] == TraceRec_Reg) {
+            if (!readVarint(&v1)) {
+                return false;
+            }
+            pa->memop = false;
+            pa->waddr = buf[1];
+            dec_.regs[buf[1]] ^= v1;
+            pa->wdata = dec_.regs[buf[1]];
+        } else if (buf[0] == TraceRec_MemRead || buf[0] == TraceRec_MemWrite) {
+            if (!readVarint(&v1) || !readVarint(&v2)) {
+                return false;
+            }
+            pa->memop = true;
+            pa->memop_write = buf[0] == TraceRec_MemWrite ? 1 : 0;
+            pa->memop_size = buf[1];
+            dec_.maddr += unzigzag(v1);
+            dec_.mdata ^= v2;
+            pa->memop_addr = dec_.maddr;
+            pa->memop_data.val = dec_.mdata;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace debugger
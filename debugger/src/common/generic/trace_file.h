@@ -0,0 +1,139 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef __SRC_COMMON_GENERIC_TRACE_FILE_H__
+#define __SRC_COMMON_GENERIC_TRACE_FILE_H__
+
+#include <api_types.h>
+#include <api_core.h>
+#include "coreservices/ithread.h"
+#include <fstream>
+#include <atomic>
+
+namespace debugger {
+
+static const int TRACE_ACTIONS_MAX = 64;
+
+typedef struct TraceActionType {
+    bool memop;             // 0=register; 1=memop
+    int waddr;              // register addr
+    uint64_t wdata;         // register data
+    int memop_write;        // 0=read
+    uint64_t memop_addr;
+    Reg64Type memop_data;
+    int memop_size;
+} TraceActionType;
+
+/** Executed instruction with the register writes and memory operations */
+typedef struct TraceStepType {
+    uint64_t step_cnt;
+    uint64_t pc;
+    uint32_t instr;
+    // 1 instruction several actions
+    TraceActionType action[TRACE_ACTIONS_MAX];
+    int action_cnt;
+} TraceStepType;
+
+/**
+ * Binary trace file:
+ *      header: "RVTRACE" magic, version and flags (4 bytes each)
+ *      blocks: [raw size][stored size][data], stored size equal to raw
+ *              size means not compressed block.
+ * Blocks contain the stream of records, values are LEB128 varints of the
+ * difference with the previous record (zigzag for the addresses, xor for
+ * the data) so that the typical instruction takes about ten bytes:
+ *      step:   [1][actions count][instr:4][step delta][pc delta]
+ *      reg:    [2][reg index][value xor previous value of the register]
+ *      memop:  [3 read, 4 write][size][addr delta][value xor previous]
+ */
+static const char TRACE_FILE_MAGIC[8] = "RVTRACE";
+static const uint32_t TRACE_FILE_VERSION = 1;
+
+/** Previous values the records are encoded against */
+typedef struct TraceDeltaType {
+    uint64_t step;
+    uint64_t pc;
+    uint64_t regs[256];
+    uint64_t maddr;
+    uint64_t mdata;
+} TraceDeltaType;
+static const uint32_t TRACE_FLAG_COMPRESSED = 0x1;
+
+/**
+ * Simulation thread only copies encoded records into the lock-free ring
+ * buffer, the compression and file output run in the writer thread.
+ */
+class TraceWriter : public IThread {
+ public:
+    TraceWriter(const char *filename, bool compress);
+    virtual ~TraceWriter();
+
+    bool isOpened() { return file_.is_open(); }
+
+    /** Producer side, single thread */
+    void writeStep(TraceStepType *t);
+
+ protected:
+    /** IThread interface */
+    virtual void busyLoop();
+
+ private:
+    void write(const uint8_t *buf, uint32_t sz);
+    void writeBlock(uint32_t sz);
+
+ private:
+    static const uint32_t RING_SIZE = 1 << 22;
+    static const uint32_t BLOCK_SIZE = 1 << 16;
+
+    std::ofstream file_;
+    bool compress_;
+    uint8_t *ring_;
+    uint8_t *block_;
+    uint8_t *packed_;
+    std::atomic<bool> closing_;
+    std::atomic<uint64_t> wrcnt_;   // total bytes put by the producer
+    std::atomic<uint64_t> rdcnt_;   // total bytes taken by the writer
+    uint64_t rdcache_;              // producer copy of rdcnt_
+    TraceDeltaType enc_;
+};
+
+class TraceReader {
+ public:
+    TraceReader();
+    ~TraceReader();
+
+    bool open(const char *filename);
+
+    /** @return false at the end of file or on format error */
+    bool readStep(TraceStepType *t);
+
+ private:
+    bool read(uint8_t *buf, uint32_t sz);
+    bool readVarint(uint64_t *v);
+    bool readBlock();
+
+ private:
+    std::ifstream file_;
+    uint8_t *block_;
+    uint8_t *packed_;
+    uint32_t blockSize_;
+    uint32_t blockPos_;
+    TraceDeltaType dec_;
+};
+
+}  // namespace debugger
+
+#endif  // __SRC_COMMON_GENERIC_TRACE_FILE_H__
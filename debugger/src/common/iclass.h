@@ -54,6 +54,16 @@ class IClass : public IFace {
         }
     }
 
+    virtual void deleteService(IService *isrv) {
+        for (unsigned i = 0; i < listInstances_.size(); i++) {
+            if (listInstances_[i].to_iface() == isrv) {
+                listInstances_.remove_from_list(i);
+                delete isrv;
+                break;
+            }
+        }
+    }
+
     virtual void postinitServices() {
         IService *tmp = NULL;
         for (unsigned i = 0; i < listInstances_.size(); i++) {
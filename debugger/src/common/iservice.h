@@ -35,6 +35,7 @@ class IService : public IFace {
         registerAttribute("ObjDescription", &obj_descr_);
         obj_name_.make_string(obj_name);
         obj_descr_.make_string("");
+        namespaceName_.make_string(".");
         logLevel_.make_int64(LOG_ERROR);
     }
     virtual ~IService() {
@@ -50,6 +51,7 @@ class IService : public IFace {
     virtual void setNamespace(const char *sname) {
         namespaceName_.make_string(sname);
     }
+    virtual const char *getNamespace() { return namespaceName_.to_string(); }
 
     virtual void initService(const AttributeType *args) {
         if (!args || !args->is_list()) {
@@ -284,7 +284,7 @@ union csr_mstatus_type {
         uint64_t FS     : 2;    // [14:13]: RW: FPU context status
         uint64_t XS     : 2;    // [16:15]: RW: extension context status
         uint64_t MPRV   : 1;    // [17] Memory privilege bit
-        uint64_t PUM    : 1;    // [18]
+        uint64_t SUM    : 1;    // [18] permit S-mode access to U pages
         uint64_t MXR    : 1;    // [19]
         uint64_t rsrv1  : 4;    // [23:20]
         uint64_t VM     : 5;    // [28:24] Virtualization management field
@@ -302,6 +302,15 @@ union csr_mcause_type {
     uint64_t value;
 };
 
+union csr_satp_type {
+    struct bits_type {
+        uint64_t PPN    : 44;   // [43:0] root page table physical page number
+        uint64_t ASID   : 16;   // [59:44] address space identifier
+        uint64_t MODE   : 4;    // [63:60] 0=Bare, 8=Sv39, 9=Sv48
+    } bits;
+    uint64_t value;
+};
+
 union csr_mie_type {
     struct bits_type {
         uint64_t USIE   : 1;    // [0] Use sw interrupt
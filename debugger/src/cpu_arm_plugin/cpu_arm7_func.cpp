@@ -346,18 +346,19 @@ void CpuCortex_Functional::generateIllegalOpcode() {
 
 void CpuCortex_Functional::traceOutput() {
     char tstr[1024];
-    trace_action_type *pa;
+    char disasm[256];
+    TraceActionType *pa;
 
     disasm_thumb(trace_data_.pc,
                  trace_data_.instr,
-                 trace_data_.disasm,
-                 sizeof(trace_data_.disasm));
+                 disasm,
+                 sizeof(disasm));
 
     RISCV_sprintf(tstr, sizeof(tstr),
         "%9" RV_PRI64 "d: %08" RV_PRI64 "x: %s \n",
             trace_data_.step_cnt - 1,
             trace_data_.pc,
-            trace_data_.disasm);
+            disasm);
     (*trace_file_) << tstr;
 
     for (int i = 0; i < trace_data_.action_cnt; i++) {
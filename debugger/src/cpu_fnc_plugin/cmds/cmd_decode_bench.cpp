@@ -0,0 +1,120 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "cmd_decode_bench.h"
+#include "../cpu_riscv_func.h"
+
+namespace debugger {
+
+CmdDecodeBench::CmdDecodeBench(CpuRiver_Functional *icpu)
+    : ICommand("decode_bench", 0, 0) {
+
+    briefDescr_.make_string("Measure instruction decoder performance");
+    detailedDescr_.make_string(
+        "Description:\n"
+        "    Decode a set of instructions generated from the list of\n"
+        "    supported instructions using the hash lists scanning and\n"
+        "    the direct-indexed decoder table.\n"
+        "Usage:\n"
+        "    decode_bench [total]\n"
+        "Output format:\n"
+        "    [i,d,d,i]\n"
+        "         i - Total number of decoded instructions (int64_t).\n"
+        "         d - Hash lists decodes per second (double).\n"
+        "         d - Decoder table decodes per second (double).\n"
+        "         i - Number of mismatches between two decoders.\n"
+        "Example:\n"
+        "    decode_bench\n"
+        "    decode_bench 10000000\n");
+
+    icpu_ = icpu;
+}
+
+int CmdDecodeBench::isValid(AttributeType *args) {
+    if (!cmdName_.is_equal((*args)[0u].to_string())) {
+        return CMD_INVALID;
+    }
+    if (args->size() == 1
+        || (args->size() == 2 && (*args)[1].is_integer())) {
+        return CMD_VALID;
+    }
+    return CMD_WRONG_ARGS;
+}
+
+void CmdDecodeBench::exec(AttributeType *args, AttributeType *res) {
+    static const unsigned VECTORS_TOTAL = 4096;
+    uint64_t total = 10000000;
+    if (args->size() == 2) {
+        total = (*args)[1].to_uint64();
+    }
+    unsigned instr_total = icpu_->getInstructionTotal();
+    if (instr_total == 0 || total == 0) {
+        generateError(res, "Empty instruction set");
+        return;
+    }
+
+    // Test vectors: fixed bits of each supported instruction and
+    // pseudo-random '?' bits.
+    uint32_t *vec = new uint32_t[2*VECTORS_TOTAL];
+    uint32_t lfsr = 0x12345678;
+    for (unsigned i = 0; i < VECTORS_TOTAL; i++) {
+        RiscvInstruction *instr = icpu_->getInstruction(i % instr_total);
+        lfsr = lfsr * 1664525u + 1013904223u;
+        vec[2*i] = instr->opcode() | (lfsr & ~instr->mask());
+        vec[2*i + 1] = 0;
+    }
+
+    uint64_t mismatch = 0;
+    uintptr_t chk1 = 0;
+    uintptr_t chk2 = 0;
+    uint64_t t_start = RISCV_get_time_ms();
+    for (uint64_t i = 0; i < total; i++) {
+        chk1 += reinterpret_cast<uintptr_t>(icpu_->lookupInstructionList(
+                    &vec[2*(i % VECTORS_TOTAL)]));
+    }
+    uint64_t t_list = RISCV_get_time_ms() - t_start;
+
+    t_start = RISCV_get_time_ms();
+    for (uint64_t i = 0; i < total; i++) {
+        chk2 += reinterpret_cast<uintptr_t>(icpu_->lookupInstruction(
+                    &vec[2*(i % VECTORS_TOTAL)]));
+    }
+    uint64_t t_table = RISCV_get_time_ms() - t_start;
+
+    if (chk1 != chk2) {
+        for (unsigned i = 0; i < VECTORS_TOTAL; i++) {
+            if (icpu_->lookupInstructionList(&vec[2*i])
+                != icpu_->lookupInstruction(&vec[2*i])) {
+                mismatch++;
+            }
+        }
+    }
+    delete [] vec;
+
+    if (t_list == 0) {
+        t_list = 1;
+    }
+    if (t_table == 0) {
+        t_table = 1;
+    }
+    res->make_list(4);
+    (*res)[0u].make_uint64(total);
+    (*res)[1].make_floating(1000.0 * static_cast<double>(total) / t_list);
+    (*res)[2].make_floating(1000.0 * static_cast<double>(total) / t_table);
+    (*res)[3].make_uint64(mismatch);
+}
+
+}  // namespace debugger
@@ -0,0 +1,78 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "cmd_flight_rec.h"
+#include "generic/cpu_generic.h"
+
+namespace debugger {
+
+CmdFlightRec::CmdFlightRec(CpuGeneric *icpu)
+    : ICommand("flightrec", 0, 0) {
+
+    briefDescr_.make_string("Last executed instructions of the halted CPU");
+    detailedDescr_.make_string(
+        "Description:\n"
+        "    Read the flight recorder of the CPU: ring buffer of the last\n"
+        "    executed instructions with the register writes and memory\n"
+        "    operations. Size of the ring is set by the 'FlightRecorder'\n"
+        "    attribute. Natively executed blocks are recorded as one entry.\n"
+        "Usage:\n"
+        "    flightrec [<cpu name>] [<count>]\n"
+        "Output format:\n"
+        "    [[step,pc,instr,'mnemonic',[action,*]],*]\n"
+        "         instr  - instruction or number of instructions in block.\n"
+        "         action - ['reg',idx,value] or ['ld'|'st',addr,value,size].\n"
+        "Example:\n"
+        "    flightrec 16\n"
+        "    flightrec core1 8\n");
+
+    icpu_ = icpu;
+}
+
+int CmdFlightRec::isValid(AttributeType *args) {
+    if (!cmdName_.is_equal((*args)[0u].to_string())) {
+        return CMD_INVALID;
+    }
+    unsigned idx = 1;
+    if (args->size() > 1 && (*args)[1].is_string()) {
+        // Each CPU registers own command, skip others by name
+        if (!(*args)[1].is_equal(icpu_->getObjName())) {
+            return CMD_INVALID;
+        }
+        idx = 2;
+    }
+    if (args->size() == idx
+        || (args->size() == idx + 1 && (*args)[idx].is_integer())) {
+        return CMD_VALID;
+    }
+    return CMD_WRONG_ARGS;
+}
+
+void CmdFlightRec::exec(AttributeType *args, AttributeType *res) {
+    res->attr_free();
+    res->make_nil();
+    if (!icpu_->isHalted()) {
+        generateError(res, "CPU isn't halted");
+        return;
+    }
+    unsigned cnt = 0;
+    if ((*args)[args->size() - 1].is_integer()) {
+        cnt = (*args)[args->size() - 1].to_uint32();
+    }
+    icpu_->getFlightRecords(cnt, res);
+}
+
+}  // namespace debugger
@@ -0,0 +1,60 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "cmd_fpu_diff.h"
+#include "../cpu_riscv_func.h"
+
+namespace debugger {
+
+CmdFpuDiff::CmdFpuDiff(CpuRiver_Functional *icpu)
+    : ICommand("fpudiff", 0, 0) {
+
+    briefDescr_.make_string("Compare host FPU mode with the FPU model");
+    detailedDescr_.make_string(
+        "Description:\n"
+        "    Execute D-extension instructions on the FPU unit-test vectors\n"
+        "    in both modes and count differences. Registers f1..f3, x1..x3\n"
+        "    and fcsr are restored. Use only while CPU is halted.\n"
+        "Usage:\n"
+        "    fpudiff\n"
+        "Output format:\n"
+        "    [[s,n,v,x,f],...]\n"
+        "         s - Instruction name.\n"
+        "         n - Number of vectors.\n"
+        "         v - Different results with the regular operands.\n"
+        "         x - Different results with NaN, Inf or out of range.\n"
+        "         f - Different fflags.\n"
+        "Example:\n"
+        "    fpudiff\n");
+
+    icpu_ = icpu;
+}
+
+int CmdFpuDiff::isValid(AttributeType *args) {
+    if (!cmdName_.is_equal((*args)[0u].to_string())) {
+        return CMD_INVALID;
+    }
+    if (args->size() == 1) {
+        return CMD_VALID;
+    }
+    return CMD_WRONG_ARGS;
+}
+
+void CmdFpuDiff::exec(AttributeType *args, AttributeType *res) {
+    icpu_->testHostFpu(res);
+}
+
+}  // namespace debugger
@@ -0,0 +1,60 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "cmd_mmu.h"
+#include "../cpu_riscv_func.h"
+
+namespace debugger {
+
+CmdMmu::CmdMmu(CpuRiver_Functional *icpu)
+    : ICommand("mmu", 0, 0) {
+
+    briefDescr_.make_string("Address translation statistic");
+    detailedDescr_.make_string(
+        "Description:\n"
+        "    Software TLB counters of the Sv39/Sv48 translation for\n"
+        "    instruction fetches, loads and stores. Sequential fetches\n"
+        "    from the same page aren't counted.\n"
+        "Usage:\n"
+        "    mmu\n"
+        "Output format:\n"
+        "    [[h,l,w,f],[h,l,w,f],[h,l,w,f],n]\n"
+        "         h - L0 TLB hits.\n"
+        "         l - L1 TLB hits.\n"
+        "         w - Page table walks.\n"
+        "         f - Page faults.\n"
+        "         n - Number of the SFENCE.VMA flushes.\n"
+        "Example:\n"
+        "    mmu\n");
+
+    icpu_ = icpu;
+}
+
+int CmdMmu::isValid(AttributeType *args) {
+    if (!cmdName_.is_equal((*args)[0u].to_string())) {
+        return CMD_INVALID;
+    }
+    if (args->size() == 1) {
+        return CMD_VALID;
+    }
+    return CMD_WRONG_ARGS;
+}
+
+void CmdMmu::exec(AttributeType *args, AttributeType *res) {
+    icpu_->getMmuStat(res);
+}
+
+}  // namespace debugger
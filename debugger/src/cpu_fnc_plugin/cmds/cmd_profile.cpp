@@ -0,0 +1,108 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "cmd_profile.h"
+#include "generic/cpu_generic.h"
+
+namespace debugger {
+
+CmdProfile::CmdProfile(CpuGeneric *icpu)
+    : ICommand("profile", 0, 0) {
+
+    briefDescr_.make_string("Execution profiler of the CPU");
+    detailedDescr_.make_string(
+        "Description:\n"
+        "    Count executed instructions per PC and per opcode, steps in\n"
+        "    each privilege level, exceptions and interrupts. Report shows\n"
+        "    the top N functions resolved through the debug symbols.\n"
+        "    Folded call stacks are written for the flame graph tools.\n"
+        "    Size of the PC table is set by the 'ProfilerEntries' attribute.\n"
+        "    Natively compiled blocks are interpreted while profiling.\n"
+        "Usage:\n"
+        "    profile [<cpu name>] start|stop\n"
+        "    profile [<cpu name>] report [<N>]\n"
+        "    profile [<cpu name>] folded <file>\n"
+        "Output format:\n"
+        "    [total,idle,dropped,[U,S,H,M],[[func,addr,cnt,%],*],\n"
+        "     [[instr,cnt,%],*],[[exception,cnt],*],[[irq,cnt],*]]\n"
+        "Example:\n"
+        "    profile start\n"
+        "    profile report 10\n"
+        "    profile core1 folded prof.folded\n");
+
+    icpu_ = icpu;
+}
+
+static bool isOperation(AttributeType &arg) {
+    return arg.is_equal("start") || arg.is_equal("stop")
+        || arg.is_equal("report") || arg.is_equal("folded");
+}
+
+int CmdProfile::isValid(AttributeType *args) {
+    if (!cmdName_.is_equal((*args)[0u].to_string())) {
+        return CMD_INVALID;
+    }
+    if (args->size() < 2 || !(*args)[1].is_string()) {
+        return CMD_WRONG_ARGS;
+    }
+    unsigned idx = 1;
+    if (!isOperation((*args)[1])) {
+        // Each CPU registers own command, skip others by name
+        if (!(*args)[1].is_equal(icpu_->getObjName())) {
+            return CMD_INVALID;
+        }
+        idx = 2;
+    }
+    if (args->size() <= idx || !isOperation((*args)[idx])) {
+        return CMD_WRONG_ARGS;
+    }
+    AttributeType &op = (*args)[idx];
+    unsigned argcnt = args->size() - idx - 1;
+    if ((op.is_equal("start") || op.is_equal("stop")) && argcnt == 0) {
+        return CMD_VALID;
+    }
+    if (op.is_equal("report") && (argcnt == 0
+        || (argcnt == 1 && (*args)[idx + 1].is_integer()))) {
+        return CMD_VALID;
+    }
+    if (op.is_equal("folded") && argcnt == 1
+        && (*args)[idx + 1].is_string()) {
+        return CMD_VALID;
+    }
+    return CMD_WRONG_ARGS;
+}
+
+void CmdProfile::exec(AttributeType *args, AttributeType *res) {
+    res->attr_free();
+    res->make_nil();
+    unsigned idx = isOperation((*args)[1]) ? 1 : 2;
+    AttributeType &op = (*args)[idx];
+    if (op.is_equal("start")) {
+        icpu_->startProfile();
+    } else if (op.is_equal("stop")) {
+        icpu_->stopProfile();
+    } else if (op.is_equal("report")) {
+        unsigned topN = 20;
+        if (args->size() > idx + 1) {
+            topN = (*args)[idx + 1].to_uint32();
+        }
+        icpu_->getProfile(topN, res);
+    } else if (!icpu_->writeProfileStacks((*args)[idx + 1].to_string())) {
+        generateError(res, "Profile is empty or file cannot be opened");
+    }
+}
+
+}  // namespace debugger
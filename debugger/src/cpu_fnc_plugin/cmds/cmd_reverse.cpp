@@ -0,0 +1,161 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "cmd_reverse.h"
+#include "generic/cpu_generic.h"
+
+namespace debugger {
+
+CmdReverse::CmdReverse(CpuGeneric *icpu)
+    : ICommand("reverse", 0, 0) {
+
+    briefDescr_.make_string("Reverse execution of the halted CPU");
+    detailedDescr_.make_string(
+        "Description:\n"
+        "    Move the halted CPU backward in time. Periodic snapshots are\n"
+        "    taken each 'ReverseInterval' instructions and the history is\n"
+        "    re-executed from the nearest one with the logged inputs.\n"
+        "    Without arguments prints the history state.\n"
+        "Usage:\n"
+        "    reverse [<cpu name>] [step [<count>]]\n"
+        "    reverse [<cpu name>] continue\n"
+        "    reverse [<cpu name>] lastwrite <addr> [<size>]\n"
+        "    reverse [<cpu name>] goto <step>\n"
+        "Output format:\n"
+        "    [step,pc,begin] - begin=1 if the start of history was reached\n"
+        "    [frontier,step,snapshots,oldest,inputs] - history state\n"
+        "Example:\n"
+        "    reverse step\n"
+        "    reverse continue\n"
+        "    reverse lastwrite 0x80001000 8\n");
+
+    icpu_ = icpu;
+}
+
+bool CmdReverse::isAction(AttributeType &arg) {
+    return arg.is_equal("step") || arg.is_equal("continue")
+        || arg.is_equal("lastwrite") || arg.is_equal("goto");
+}
+
+int CmdReverse::isValid(AttributeType *args) {
+    if (!cmdName_.is_equal((*args)[0u].to_string())) {
+        return CMD_INVALID;
+    }
+    unsigned idx = 1;
+    if (args->size() > 1 && (*args)[1].is_string()
+        && !isAction((*args)[1])) {
+        // Each CPU registers own command, skip others by name
+        if (!(*args)[1].is_equal(icpu_->getObjName())) {
+            return CMD_INVALID;
+        }
+        idx = 2;
+    }
+    if (args->size() == idx) {
+        return CMD_VALID;
+    }
+    AttributeType &act = (*args)[idx];
+    unsigned argcnt = args->size() - idx - 1;
+    if ((act.is_equal("step") && argcnt <= 1)
+        || (act.is_equal("continue") && argcnt == 0)
+        || (act.is_equal("goto") && argcnt == 1)
+        || (act.is_equal("lastwrite") && (argcnt == 1 || argcnt == 2))) {
+        for (unsigned i = idx + 1; i < args->size(); i++) {
+            if (!(*args)[i].is_integer()) {
+                return CMD_WRONG_ARGS;
+            }
+        }
+        return CMD_VALID;
+    }
+    return CMD_WRONG_ARGS;
+}
+
+void CmdReverse::exec(AttributeType *args, AttributeType *res) {
+    res->attr_free();
+    res->make_nil();
+    if (!icpu_->isReverseEnabled()) {
+        generateError(res, "Reverse execution is disabled");
+        return;
+    }
+    if (!icpu_->isHalted()) {
+        generateError(res, "CPU isn't halted");
+        return;
+    }
+    unsigned idx = 1;
+    if (args->size() > 1 && !isAction((*args)[1])) {
+        idx = 2;
+    }
+    if (args->size() == idx) {
+        icpu_->getReverseInfo(res);
+        return;
+    }
+
+    AttributeType info;
+    icpu_->getReverseInfo(&info);
+    uint64_t cur = info[1].to_uint64();
+    uint64_t oldest = info[3].to_uint64();
+    uint64_t target = cur;
+    bool begin = false;
+
+    AttributeType &act = (*args)[idx];
+    if (act.is_equal("step")) {
+        uint64_t cnt = 1;
+        if (args->size() > idx + 1) {
+            cnt = (*args)[idx + 1].to_uint64();
+        }
+        if (cur < oldest + cnt) {
+            target = oldest;
+            begin = true;
+        } else {
+            target = cur - cnt;
+        }
+    } else if (act.is_equal("goto")) {
+        target = (*args)[idx + 1].to_uint64();
+        if (target > info[0u].to_uint64()) {
+            generateError(res, "Step wasn't executed yet");
+            return;
+        }
+        if (target < oldest) {
+            target = oldest;
+            begin = true;
+        }
+    } else if (act.is_equal("continue")) {
+        begin = !icpu_->reverseFind(CpuGeneric::Scan_Breakpoint, 0, 0,
+                                    &target);
+    } else if (act.is_equal("lastwrite")) {
+        uint64_t sz = 1;
+        if (args->size() > idx + 2) {
+            sz = (*args)[idx + 2].to_uint64();
+        }
+        begin = !icpu_->reverseFind(CpuGeneric::Scan_Write,
+                                    (*args)[idx + 1].to_uint64(), sz,
+                                    &target);
+    }
+
+    if (!icpu_->reverseGoto(target)) {
+        generateError(res, "Step can't be restored");
+        return;
+    }
+    makeResult(target, begin, res);
+}
+
+void CmdReverse::makeResult(uint64_t step, bool begin, AttributeType *res) {
+    res->make_list(3);
+    (*res)[0u].make_uint64(step);
+    (*res)[1].make_uint64(icpu_->getNPC());
+    (*res)[2].make_uint64(begin ? 1 : 0);
+}
+
+}  // namespace debugger
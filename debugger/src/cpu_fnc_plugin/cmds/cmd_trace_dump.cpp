@@ -0,0 +1,76 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "cmd_trace_dump.h"
+#include "../cpu_riscv_func.h"
+
+namespace debugger {
+
+CmdTraceDump::CmdTraceDump() : ICommand("tracedump", 0, 0) {
+
+    briefDescr_.make_string("Convert binary trace file into text format");
+    detailedDescr_.make_string(
+        "Description:\n"
+        "    Render the binary trace written with the 'BinaryTrace'\n"
+        "    attribute of the CPU into the text trace format.\n"
+        "Usage:\n"
+        "    tracedump <binary file> <text file>\n"
+        "Output format:\n"
+        "    i - Number of converted instructions (int64_t).\n"
+        "Example:\n"
+        "    tracedump trace_core0.bin trace_core0.log\n");
+}
+
+int CmdTraceDump::isValid(AttributeType *args) {
+    if (!cmdName_.is_equal((*args)[0u].to_string())) {
+        return CMD_INVALID;
+    }
+    if (args->size() == 3 && (*args)[1].is_string()
+        && (*args)[2].is_string()) {
+        return CMD_VALID;
+    }
+    return CMD_WRONG_ARGS;
+}
+
+void CmdTraceDump::exec(AttributeType *args, AttributeType *res) {
+    TraceReader reader;
+    TraceStepType *t;
+    std::ofstream ofs;
+    uint64_t cnt = 0;
+
+    res->attr_free();
+    res->make_nil();
+    if (!reader.open((*args)[1].to_string())) {
+        generateError(res, "Can't open binary trace file");
+        return;
+    }
+    ofs.open((*args)[2].to_string());
+    if (!ofs.is_open()) {
+        generateError(res, "Can't open output file");
+        return;
+    }
+
+    t = new TraceStepType;
+    while (reader.readStep(t)) {
+        CpuRiver_Functional::traceFormat(t, ofs);
+        cnt++;
+    }
+    delete t;
+    ofs.close();
+    res->make_uint64(cnt);
+}
+
+}  // namespace debugger
@@ -0,0 +1,68 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "cmd_trig_stat.h"
+#include "../cpu_riscv_func.h"
+
+namespace debugger {
+
+CmdTrigStat::CmdTrigStat(CpuRiver_Functional *icpu)
+    : ICommand("trigstat", 0, 0) {
+
+    briefDescr_.make_string("Hardware triggers evaluation statistic");
+    detailedDescr_.make_string(
+        "Description:\n"
+        "    Number of the hardware triggers evaluations. Triggers aren't\n"
+        "    evaluated at all while no one of them is armed.\n"
+        "Usage:\n"
+        "    trigstat\n"
+        "Output format:\n"
+        "    [i,d]\n"
+        "         i - Total number of evaluations (int64_t).\n"
+        "         d - Evaluations per second since previous call (double).\n"
+        "Example:\n"
+        "    trigstat\n");
+
+    icpu_ = icpu;
+    lastCnt_ = 0;
+    lastTime_ = RISCV_get_time_ms();
+}
+
+int CmdTrigStat::isValid(AttributeType *args) {
+    if (!cmdName_.is_equal((*args)[0u].to_string())) {
+        return CMD_INVALID;
+    }
+    if (args->size() == 1) {
+        return CMD_VALID;
+    }
+    return CMD_WRONG_ARGS;
+}
+
+void CmdTrigStat::exec(AttributeType *args, AttributeType *res) {
+    uint64_t cnt = icpu_->getTriggerEvalCount();
+    uint64_t t = RISCV_get_time_ms();
+    uint64_t dt = t - lastTime_;
+    if (dt == 0) {
+        dt = 1;
+    }
+    res->make_list(2);
+    (*res)[0u].make_uint64(cnt);
+    (*res)[1].make_floating(1000.0 * static_cast<double>(cnt - lastCnt_) / dt);
+    lastCnt_ = cnt;
+    lastTime_ = t;
+}
+
+}  // namespace debugger
@@ -19,6 +19,14 @@
 #include "generic/riscv_disasm.h"
 #include "generic/dmi/cmd_dmi_cpu.h"
 #include "debug/dmi_regs.h"
+#include "cmds/cmd_decode_bench.h"
+#include "cmds/cmd_trig_stat.h"
+#include "cmds/cmd_flight_rec.h"
+#include "cmds/cmd_reverse.h"
+#include "cmds/cmd_trace_dump.h"
+#include "cmds/cmd_mmu.h"
+#include "cmds/cmd_fpu_diff.h"
+#include "cmds/cmd_profile.h"
 
 namespace debugger {
 
@@ -32,12 +40,42 @@ CpuRiver_Functional::CpuRiver_Functional(const char *name) :
     registerAttribute("ListExtISA", &listExtISA_);
     registerAttribute("CLINT", &clint_);
     registerAttribute("PLIC", &plic_);
+    registerAttribute("JitThreshold", &jitThreshold_);
+    registerAttribute("JitCacheSize", &jitCacheSize_);
+    registerAttribute("HostFpu", &hostFpu_);
+
+    hostFpu_.make_boolean(false);
 
     mmuReservatedAddr_ = 0;
+    mmuReservedValue_ = 0;
     mmuReservedAddrWatchdog_ = 0;
+    stackOvr_ = 0;
+    stackUnd_ = 0;
+    plicCtxM_ = 0;
+    instrTotal_ = 0;
+    decodeTbl32_ = 0;
+    decodeTbl16_ = 0;
+    decodePool_ = 0;
+    decodePoolCnt_ = 0;
+    decodePoolSize_ = 0;
+    jit_ = 0;
+    dataPrv_ = PRV_M;
+    hostFpuEna_ = false;
 }
 
 CpuRiver_Functional::~CpuRiver_Functional() {
+    if (decodeTbl32_) {
+        delete [] decodeTbl32_;
+    }
+    if (decodeTbl16_) {
+        delete [] decodeTbl16_;
+    }
+    if (decodePool_) {
+        delete [] decodePool_;
+    }
+    if (jit_) {
+        delete jit_;
+    }
 }
 
 void CpuRiver_Functional::postinitService() {
@@ -60,11 +98,14 @@ void CpuRiver_Functional::postinitService() {
             addIsaExtensionM();
         }
     }
+    buildDecodeTable();
 
     // Power-on
     reset(0);
 
     CpuGeneric::postinitService();
+    mmu_.setBus(isysbus_, sysBusMasterID_.to_int());
+    hostFpuEna_ = hostFpu_.to_bool();
 
     iirqext_ = static_cast<IIrqController *>(RISCV_get_service_iface(
         plic_.to_string(), IFACE_IRQ_CONTROLLER));
@@ -80,6 +121,25 @@ void CpuRiver_Functional::postinitService() {
                     clint_.to_string());
     }
 
+    // M-mode context of the external interrupt controller
+    if (contextid_.is_list() && contextid_.size() > ICpuRiscV::PRV_M) {
+        plicCtxM_ = contextid_[ICpuRiscV::PRV_M].to_int();
+    }
+
+    irqPending_ = 0;
+    if (!iirqloc_ || !iirqloc_->registerPendingMask(2*hartid_.to_int(),
+                                    &irqPending_, IrqPending_Software)) {
+        irqPending_ |= 1ull << IrqPending_Software;
+    }
+    if (!iirqloc_ || !iirqloc_->registerPendingMask(2*hartid_.to_int() + 1,
+                                    &irqPending_, IrqPending_Timer)) {
+        irqPending_ |= 1ull << IrqPending_Timer;
+    }
+    if (!iirqext_ || !iirqext_->registerPendingMask(plicCtxM_,
+                                    &irqPending_, IrqPending_External)) {
+        irqPending_ |= 1ull << IrqPending_External;
+    }
+
     pcmd_br_ = new CmdBrRiscv(dmibar_.to_uint64(), 0);
     icmdexec_->registerCommand(static_cast<ICommand *>(pcmd_br_));
 
@@ -87,6 +147,47 @@ void CpuRiver_Functional::postinitService() {
     pcmd_cpu_->enableDMA(isysbus_, dmibar_.to_uint64());
     icmdexec_->registerCommand(pcmd_cpu_);
 
+    pcmd_decbench_ = new CmdDecodeBench(this);
+    icmdexec_->registerCommand(pcmd_decbench_);
+
+    pcmd_trigstat_ = new CmdTrigStat(this);
+    icmdexec_->registerCommand(pcmd_trigstat_);
+
+    pcmd_tracedump_ = new CmdTraceDump();
+    icmdexec_->registerCommand(pcmd_tracedump_);
+
+    pcmd_flightrec_ = new CmdFlightRec(this);
+    icmdexec_->registerCommand(pcmd_flightrec_);
+
+    pcmd_reverse_ = new CmdReverse(this);
+    icmdexec_->registerCommand(pcmd_reverse_);
+
+    pcmd_mmu_ = new CmdMmu(this);
+    icmdexec_->registerCommand(pcmd_mmu_);
+
+    pcmd_fpudiff_ = new CmdFpuDiff(this);
+    icmdexec_->registerCommand(pcmd_fpudiff_);
+
+    pcmd_profile_ = new CmdProfile(this);
+    icmdexec_->registerCommand(pcmd_profile_);
+
+    if (blockTotal_ && jitThreshold_.is_integer()
+        && jitThreshold_.to_uint32()) {
+        unsigned codesz = 16 << 20;
+        if (jitCacheSize_.is_integer() && jitCacheSize_.to_uint32()) {
+            codesz = jitCacheSize_.to_uint32();
+        }
+        jit_ = new RiscvJitX64(codesz, jitFallback);
+        if (!jit_->isAvailable()) {
+            RISCV_error("JIT isn't supported on this host", 0);
+            delete jit_;
+            jit_ = 0;
+        }
+        jitctx_.regs = R;
+        jitctx_.owner = this;
+        jitctx_.memtlb = 0;
+        jitctx_.resvcnt = resvtbl_->getValidCounter();
+    }
 }
 
 void CpuRiver_Functional::predeleteService() {
@@ -94,26 +195,137 @@ void CpuRiver_Functional::predeleteService() {
 
     icmdexec_->unregisterCommand(static_cast<ICommand *>(pcmd_br_));
     icmdexec_->unregisterCommand(static_cast<ICommand *>(pcmd_cpu_));
+    icmdexec_->unregisterCommand(pcmd_decbench_);
+    icmdexec_->unregisterCommand(pcmd_trigstat_);
+    icmdexec_->unregisterCommand(pcmd_tracedump_);
+    icmdexec_->unregisterCommand(pcmd_flightrec_);
+    icmdexec_->unregisterCommand(pcmd_reverse_);
+    icmdexec_->unregisterCommand(pcmd_mmu_);
+    icmdexec_->unregisterCommand(pcmd_fpudiff_);
+    icmdexec_->unregisterCommand(pcmd_profile_);
     delete pcmd_br_;
     delete pcmd_cpu_;
+    delete pcmd_decbench_;
+    delete pcmd_trigstat_;
+    delete pcmd_tracedump_;
+    delete pcmd_flightrec_;
+    delete pcmd_reverse_;
+    delete pcmd_mmu_;
+    delete pcmd_fpudiff_;
+    delete pcmd_profile_;
 }
 
 unsigned CpuRiver_Functional::addSupportedInstruction(
                                     RiscvInstruction *instr) {
     AttributeType tmp(instr);
     listInstr_[instr->hash()].add_to_list(&tmp);
+    instrTotal_++;
+    return 0;
+}
+
+RiscvInstruction *CpuRiver_Functional::getInstruction(unsigned idx) {
+    for (int i = 0; i < INSTR_HASH_TABLE_SIZE; i++) {
+        if (idx < listInstr_[i].size()) {
+            return static_cast<RiscvInstruction *>(listInstr_[i][idx].to_iface());
+        }
+        idx -= listInstr_[i].size();
+    }
     return 0;
 }
 
-/** Check stack protection exceptions: */
+/**
+ * Generate decoder tables from the hash lists. Every key is a concatenation
+ * of the opcode fields so the decoding is a single table access plus
+ * a check of the remaining bits of one (rarely several) candidates.
+ */
+void CpuRiver_Functional::buildDecodeTable() {
+    decodePoolCnt_ = 0;
+    decodePoolSize_ = 1024;
+    decodePool_ = new RiscvInstruction *[decodePoolSize_];
+    decodeTbl32_ = new DecodeEntryType[DECODE_TBL32_SIZE];
+    decodeTbl16_ = new DecodeEntryType[DECODE_TBL16_SIZE];
+
+    fillDecodeEntries(DECODE_TBL32_SIZE, false);
+    fillDecodeEntries(DECODE_TBL16_SIZE, true);
+    RISCV_debug("Decoder table generated: %d instructions, %d candidates",
+                instrTotal_, decodePoolCnt_);
+}
+
+void CpuRiver_Functional::fillDecodeEntries(int tblsz, bool rvc) {
+    DecodeEntryType *tbl = rvc ? decodeTbl16_ : decodeTbl32_;
+    uint32_t keymask = rvc ? DECODE_KEY16_MASK : DECODE_KEY32_MASK;
+    RiscvInstruction *tlist[INSTR_HASH_TABLE_SIZE * 4];
+    RiscvInstruction *instr;
+    uint32_t val;
+    unsigned cnt;
+    int hash_idx;
+
+    for (int key = 0; key < tblsz; key++) {
+        if (rvc) {
+            val = decodeKey16ToInstr(key);
+            hash_idx = hash16(static_cast<uint16_t>(val));
+        } else {
+            val = decodeKey32ToInstr(key);
+            hash_idx = hash32(val);
+        }
+
+        // Keep the same order as in the hash list to provide the same
+        // priority as the list scanning:
+        cnt = 0;
+        for (unsigned i = 0; i < listInstr_[hash_idx].size(); i++) {
+            instr = static_cast<RiscvInstruction *>(
+                            listInstr_[hash_idx][i].to_iface());
+            if (((val ^ instr->opcode()) & instr->mask() & keymask) != 0) {
+                continue;
+            }
+            if (cnt < sizeof(tlist)/sizeof(tlist[0])) {
+                tlist[cnt++] = instr;
+            }
+        }
+
+        // Re-use the same candidates list if it was already stored:
+        tbl[key].cnt = static_cast<uint16_t>(cnt);
+        tbl[key].idx = 0;
+        if (cnt == 0) {
+            continue;
+        }
+        bool found = false;
+        for (unsigned n = 0; n + cnt <= decodePoolCnt_; n++) {
+            if (memcmp(&decodePool_[n], tlist, cnt * sizeof(tlist[0])) == 0) {
+                tbl[key].idx = static_cast<uint16_t>(n);
+                found = true;
+                break;
+            }
+        }
+        if (found) {
+            continue;
+        }
+        if (decodePoolCnt_ + cnt > decodePoolSize_) {
+            RiscvInstruction **t = new RiscvInstruction *[2*decodePoolSize_];
+            memcpy(t, decodePool_, decodePoolCnt_ * sizeof(tlist[0]));
+            delete [] decodePool_;
+            decodePool_ = t;
+            decodePoolSize_ *= 2;
+        }
+        memcpy(&decodePool_[decodePoolCnt_], tlist, cnt * sizeof(tlist[0]));
+        tbl[key].idx = static_cast<uint16_t>(decodePoolCnt_);
+        decodePoolCnt_ += cnt;
+    }
+}
+
+/**
+ * Check stack protection exceptions. Boundaries are cached on CSR write so
+ * the unarmed case costs a single branch.
+ */
 void CpuRiver_Functional::checkStackProtection() {
-    uint64_t mstackovr = readCSR(CSR_mstackovr);
-    uint64_t mstackund = readCSR(CSR_mstackund);
+    if ((stackOvr_ | stackUnd_) == 0) {
+        return;
+    }
     uint64_t sp = portRegs_.read(Reg_sp).val;
-    if (mstackovr != 0 && sp < mstackovr) {
+    if (stackOvr_ != 0 && sp < stackOvr_) {
         generateException(EXCEPTION_StackOverflow, getPC());
         writeCSR(CSR_mstackovr, 0);
-    } else if (mstackund != 0 && sp > mstackund) {
+    } else if (stackUnd_ != 0 && sp > stackUnd_) {
         generateException(EXCEPTION_StackUnderflow, getPC());
         writeCSR(CSR_mstackund, 0);
     }
@@ -124,12 +336,25 @@ void CpuRiver_Functional::handleException(int e) {
         exitProgbufExec();
         return;
     }
+    if (exitType_ == Exit_Ecall && e >= EXCEPTION_CallFromUmode
+        && e <= EXCEPTION_CallFromMmode && R[Reg_a7] == SYSCALL_EXIT) {
+        requestExit(R[Reg_a0], "Exit by ecall");
+        return;
+    }
+    if (exitType_ == Exit_Break && e == EXCEPTION_Breakpoint
+        && getPC() == exitAddr_) {
+        requestExit(R[Reg_a0], "Exit by EBREAK");
+        return;
+    }
 
+    // Exceptions in U and S modes could be delegated into S-mode
+    bool deleg = cur_prv_level <= PRV_S
+                && ((readCSR(CSR_medeleg) >> e) & 0x1);
     if (estate_ != CORE_ProgbufExec) {
         csr_mcause_type mcause;
         mcause.bits.irq = 0;
         mcause.bits.code = e;
-        writeCSR(CSR_mcause, mcause.value);
+        writeCSR(deleg ? CSR_scause : CSR_mcause, mcause.value);
     }
 
     DCSR_TYPE::ValueType dcsr;
@@ -140,6 +365,18 @@ void CpuRiver_Functional::handleException(int e) {
         return;
     }
 
+    if ((1ull << e) & PAGE_FAULTS) {
+        // Return into the faulted instruction
+        setNPC(getPC());
+    }
+
+    if (deleg) {
+        writeCSR(CSR_stval, readCSR(CSR_mtval));
+        switchContext(PRV_S);
+        setNPC(readCSR(CSR_stvec) & ~0x3ull);
+        return;
+    }
+
     switchContext(PRV_M);
 
     uint64_t mtvec = readCSR(CSR_mtvec) & ~0x3ull;
@@ -147,9 +384,14 @@ void CpuRiver_Functional::handleException(int e) {
 }
 
 void CpuRiver_Functional::handleInterrupts() {
-    int ctx = 0;
+    int ctx = plicCtxM_;
     csr_mcause_type mcause;
     csr_mstatus_type mstatus;
+    uint64_t pending = irqPending_.load(std::memory_order_relaxed);
+    if (pending == 0) {
+        return;
+    }
+
     mstatus.value = readCSR(CSR_mstatus);
     if (mstatus.bits.MIE == 0) {
         return;
@@ -160,7 +402,7 @@ void CpuRiver_Functional::handleInterrupts() {
 
     // Check software interrupt
     mcause.value = 0;
-    if (mie.bits.MSIE == 1) {
+    if (mie.bits.MSIE == 1 && (pending & (1ull << IrqPending_Software))) {
         if (iirqloc_->getPendingRequest(2*hartid_.to_int())) {
             mcause.bits.irq = 1;
             mcause.bits.code = 3;
@@ -168,7 +410,8 @@ void CpuRiver_Functional::handleInterrupts() {
     }
 
     // Check mtimer interrupt
-    if (!mcause.bits.irq && mie.bits.MTIE == 1) {
+    if (!mcause.bits.irq && mie.bits.MTIE == 1
+        && (pending & (1ull << IrqPending_Timer))) {
         if (iirqloc_->getPendingRequest(2*hartid_.to_int() + 1)) {
             mcause.bits.irq = 1;
             mcause.bits.code = 7;
@@ -176,7 +419,8 @@ void CpuRiver_Functional::handleInterrupts() {
     }
 
     // Check PLIC interrupt request
-    if (!mcause.bits.irq && mie.bits.MEIE == 1) {
+    if (!mcause.bits.irq && mie.bits.MEIE == 1
+        && (pending & (1ull << IrqPending_External))) {
         // external interrupt disabled
         int irqidx = iirqext_->getPendingRequest(ctx);
         if (irqidx != IRQ_REQUEST_NONE) {
@@ -186,6 +430,9 @@ void CpuRiver_Functional::handleInterrupts() {
     }
 
     if (mcause.bits.irq) {
+        if (prof_->isEnabled()) {
+            prof_->interrupt(static_cast<int>(mcause.bits.code));
+        }
         writeCSR(CSR_mcause, mcause.value);
 
         switchContext(PRV_M);
@@ -202,15 +449,63 @@ void CpuRiver_Functional::handleInterrupts() {
     }
 }
 
+/** Any enabled interrupt request independently on mstatus.MIE */
+bool CpuRiver_Functional::isInterruptPending() {
+    if (irqPending_.load(std::memory_order_relaxed) == 0) {
+        return false;
+    }
+    return (readCSR(CSR_mip) & readCSR(CSR_mie)) != 0;
+}
+
+/** Same conditions as in handleInterrupts(), checked after each step */
+bool CpuRiver_Functional::isInterruptTaken() {
+    if (irqPending_.load(std::memory_order_relaxed) == 0) {
+        return false;
+    }
+    csr_mstatus_type mstatus;
+    mstatus.value = readCSR(CSR_mstatus);
+    return mstatus.bits.MIE && isInterruptPending();
+}
+
+/**
+ * Idle loop signatures: JAL, C.J and conditional branches with zero offset.
+ */
+bool CpuRiver_Functional::isIdleInstruction(Reg64Type *payload) {
+    uint32_t op = payload->buf32[0];
+    if ((op & 0x3) != 0x3) {
+        uint16_t op16 = payload->buf16[0];
+        // C.J, C.BEQZ, C.BNEZ: quadrant 1, funct3=101/110/111
+        if ((op16 & 0x3) != 0x1) {
+            return false;
+        }
+        if ((op16 >> 13) == 5) {
+            return (op16 & 0x1FFC) == 0;
+        }
+        return (op16 >> 13) >= 6 && (op16 & 0x1C7C) == 0;
+    }
+    if ((op & 0x7F) == 0x6F) {
+        return (op >> 12) == 0;             // JAL, imm=0
+    }
+    if ((op & 0x7F) == 0x63) {
+        return (op & 0xFE000F80) == 0;      // BRANCH, imm=0
+    }
+    return false;
+}
+
 void CpuRiver_Functional::switchContext(uint32_t prvnxt) {
-    // All traps handle via machine mode while CSR mdelegate
-    // doesn't setup other.
-    // @todo delegating
+    // Interrupts are always handled in machine mode, exceptions could be
+    // delegated into S-mode via medeleg.
     csr_mstatus_type mstatus;
     mstatus.value = readCSR(CSR_mstatus);
-    mstatus.bits.MPP = cur_prv_level;
-    mstatus.bits.MPIE = (mstatus.value >> cur_prv_level) & 0x1;
-    mstatus.bits.MIE = 0;
+    if (prvnxt == PRV_S) {
+        mstatus.bits.SPP = cur_prv_level;
+        mstatus.bits.SPIE = mstatus.bits.SIE;
+        mstatus.bits.SIE = 0;
+    } else {
+        mstatus.bits.MPP = cur_prv_level;
+        mstatus.bits.MPIE = (mstatus.value >> cur_prv_level) & 0x1;
+        mstatus.bits.MIE = 0;
+    }
     cur_prv_level = prvnxt;
     writeCSR(CSR_mstatus, mstatus.value);
 
@@ -223,6 +518,8 @@ void CpuRiver_Functional::reset(IFace *isource) {
     portRegs_.reset();
     uint64_t misa = readCSR(CSR_misa);
     portCSR_.reset();
+    stackOvr_ = 0;
+    stackUnd_ = 0;
     writeCSR(CSR_mvendorid, vendorid_.to_uint64());
     writeCSR(CSR_mimplementationid, implementationid_.to_uint64());
     writeCSR(CSR_mhartid, hartid_.to_uint64());
@@ -232,34 +529,118 @@ void CpuRiver_Functional::reset(IFace *isource) {
 
     cur_prv_level = PRV_M;           // Current privilege level
     mmuReservedAddrWatchdog_ = 0;
+    releaseAddress(mmuReservatedAddr_);
+    mmu_.flush(0, 0, true, true);
+    updateMmuContext();
+}
+
+bool CpuRiver_Functional::restoreState(CheckpointState *state) {
+    bool ret = CpuGeneric::restoreState(state);
+    // Page tables could be different in the restored memory
+    mmu_.flush(0, 0, true, true);
+    updateMmuContext();
+    // CSRs were restored without writeCSR()
+    stackOvr_ = portCSR_.read(CSR_mstackovr).val;
+    stackUnd_ = portCSR_.read(CSR_mstackund).val;
+    return ret;
+}
+
+/**
+ * Translation depends on satp, privilege level and mstatus MPRV, MPP,
+ * SUM and MXR bits. Should be called on any of them modification.
+ */
+void CpuRiver_Functional::updateMmuContext() {
+    csr_mstatus_type mstatus;
+    mstatus.value = portCSR_.read(CSR_mstatus).val;
+    mmu_.setContext(portCSR_.read(CSR_satp).val,
+                    mstatus.bits.SUM != 0, mstatus.bits.MXR != 0);
+    dataPrv_ = mstatus.bits.MPRV ? mstatus.bits.MPP : cur_prv_level;
+    vmemEna_ = mmu_.isPaging()
+            && (cur_prv_level != PRV_M || dataPrv_ != PRV_M);
+    flushFetchPage();
+}
+
+bool CpuRiver_Functional::translateAddress(uint64_t va, EMemAccessType acc,
+                                           uint64_t *pa) {
+    uint64_t prv = acc == MemAccess_Fetch ? cur_prv_level : dataPrv_;
+    if (prv == PRV_M) {
+        *pa = va;
+        return true;
+    }
+    if (acc != MemAccess_Fetch && (exceptions_ & PAGE_FAULTS)) {
+        // Store part of AMO after the faulted load
+        return false;
+    }
+    if (mmu_.translate(va, acc, static_cast<int>(prv), pa)) {
+        return true;
+    }
+    if (acc == MemAccess_Fetch) {
+        generateException(EXCEPTION_InstrPageFault, va);
+    } else if (acc == MemAccess_Load) {
+        generateException(EXCEPTION_LoadPageFault, va);
+    } else {
+        generateException(EXCEPTION_StorePageFault, va);
+    }
+    return false;
 }
 
 GenericInstruction *CpuRiver_Functional::decodeInstruction(Reg64Type *cache) {
+    return lookupInstruction(cacheline_[0].buf32);
+}
+
+/**
+ * Control transfers and SYSTEM instructions (traps, xRET, WFI, CSR accesses
+ * that may change translation or enable interrupts) end the block.
+ */
+bool CpuRiver_Functional::isBlockEnd(Reg64Type *payload) {
+    uint32_t op = payload->buf32[0];
+    if ((op & 0x3) == 0x3) {
+        switch (op & 0x7F) {
+        case 0x63:      // BRANCH
+        case 0x67:      // JALR
+        case 0x6F:      // JAL
+        case 0x73:      // SYSTEM
+            return true;
+        default:
+            return false;
+        }
+    }
+    uint32_t funct3 = (op >> 13) & 0x7;
+    if ((op & 0x3) == 0x1) {
+        // C.J, C.BEQZ, C.BNEZ
+        return funct3 >= 5;
+    }
+    if ((op & 0x3) == 0x2 && funct3 == 4 && ((op >> 2) & 0x1F) == 0) {
+        // C.JR, C.JALR, C.EBREAK (C.MV/C.ADD have non-zero rs2)
+        return ((op >> 7) & 0x1F) != 0 || ((op >> 12) & 0x1) != 0;
+    }
+    return false;
+}
+
+RiscvInstruction *CpuRiver_Functional::lookupInstructionList(
+                                                uint32_t *payload) {
     RiscvInstruction *instr = NULL;
-    int hash_idx = hash32(cacheline_[0].buf32[0]);
+    int hash_idx = hash32(payload[0]);
     for (unsigned i = 0; i < listInstr_[hash_idx].size(); i++) {
         instr = static_cast<RiscvInstruction *>(
                         listInstr_[hash_idx][i].to_iface());
-        if (instr->parse(cacheline_[0].buf32)) {
+        if (instr->parse(payload)) {
             break;
         }
         instr = NULL;
     }
     // Check compressed instructions:
     if (instr == NULL) {
-        hash_idx = hash16(cacheline_[0].buf16[0]);
+        hash_idx = hash16(static_cast<uint16_t>(payload[0]));
         for (unsigned i = 0; i < listInstr_[hash_idx].size(); i++) {
             instr = static_cast<RiscvInstruction *>(
                             listInstr_[hash_idx][i].to_iface());
-            if (instr->parse(cacheline_[0].buf32)) {
+            if (instr->parse(payload)) {
                 break;
             }
             instr = NULL;
         }
     }
-    if (mmuReservedAddrWatchdog_) {
-        mmuReservedAddrWatchdog_--;
-    }
     return instr;
 }
 
@@ -270,28 +651,33 @@ void CpuRiver_Functional::generateIllegalOpcode() {
 
 void CpuRiver_Functional::trackContextStart() {
     CpuGeneric::trackContextStart();
-    if (trace_file_ == 0) {
+    if (!trace_ena_) {
         return;
     }
 }
 
 void CpuRiver_Functional::traceOutput() {
+    traceFormat(&trace_data_, *trace_file_);
+    trace_file_->flush();
+}
+
+/** Text format of the trace file, also used by 'tracedump' */
+void CpuRiver_Functional::traceFormat(TraceStepType *t, std::ostream &os) {
     char tstr[1024];
+    char disasm[256];
 
-    riscv_disassembler(trace_data_.instr,
-                       trace_data_.disasm,
-                       sizeof(trace_data_.disasm));
+    riscv_disassembler(t->instr, disasm, sizeof(disasm));
 
     RISCV_sprintf(tstr, sizeof(tstr),
         "%9" RV_PRI64 "d: %08" RV_PRI64 "x: %s \r\n",
-            trace_data_.step_cnt,
-            trace_data_.pc,
-            trace_data_.disasm);
-    (*trace_file_) << tstr;
+            t->step_cnt,
+            t->pc,
+            disasm);
+    os << tstr;
 
 
-    for (int i = 0; i < trace_data_.action_cnt; i++) {
-        trace_action_type *pa = &trace_data_.action[i];
+    for (int i = 0; i < t->action_cnt; i++) {
+        TraceActionType *pa = &t->action[i];
         if (!pa->memop) {
             RISCV_sprintf(tstr, sizeof(tstr),
                 "%20s %10s <= %016" RV_PRI64 "x\r\n",
@@ -311,10 +697,8 @@ void CpuRiver_Functional::traceOutput() {
                     pa->memop_addr,
                     pa->memop_data.val);
         }
-        (*trace_file_) << tstr;
+        os << tstr;
     }
-
-    trace_file_->flush();
 }
 
 bool CpuRiver_Functional::isStepEnabled() {
@@ -323,6 +707,94 @@ bool CpuRiver_Functional::isStepEnabled() {
     return dcsr.bits.step;
 }
 
+/**
+ * Hot blocks are translated into the host code. Compiled block runs only
+ * if no step callback is scheduled inside of it, so IClock events are
+ * called on the same steps as in interpreter.
+ */
+bool CpuRiver_Functional::execCompiledBlock(BlockType *blk) {
+    if (!jit_ || icovtracker_) {
+        return false;
+    }
+    if (blk->native == 0) {
+        if (++blk->hits < jitThreshold_.to_uint32()) {
+            return false;
+        }
+        blk->native = reinterpret_cast<void *>(compileBlock(blk));
+        if (blk->native == 0) {
+            return false;
+        }
+    }
+    if (step_cnt_ + blk->cnt > queue_.getNextTime()) {
+        return false;
+    }
+
+    FlightRecordType *rec = 0;
+    if (flight_) {
+        rec = flightBlock(blk->pc);
+    }
+
+    jitctx_.npc = NPC_;
+    jitctx_.blk = blk;
+    jitctx_.step = step_cnt_;
+    // Blocks end on SYSTEM instructions: translation mode is constant
+    jitctx_.memtlb = memtlbEna_ && !vmemEna_ ? memtlb_ : 0;
+    int cnt = reinterpret_cast<jit_block_type>(blk->native)(&jitctx_);
+
+    step_cnt_ = jitctx_.step + cnt;
+    if (rec && rec->block) {
+        rec->instr = static_cast<uint32_t>(step_cnt_ - rec->step + 1);
+    }
+    setPC(blk->item[cnt - 1].pc);
+    pc_z_ = getPC();
+    if (step_cnt_ >= queue_.getNextTime()) {
+        updateQueue();
+    }
+    return true;
+}
+
+jit_block_type CpuRiver_Functional::compileBlock(BlockType *blk) {
+    static_assert(sizeof(MemTlbType) == sizeof(JitMemTlbType)
+        && offsetof(MemTlbType, ptr) == offsetof(JitMemTlbType, ptr)
+        && offsetof(MemTlbType, plain) == offsetof(JitMemTlbType, plain)
+        && offsetof(MemTlbType, dirty) == offsetof(JitMemTlbType, dirty)
+        && MEMTLB_PAGE_BITS == JIT_MEMTLB_PAGE_BITS
+        && MEMTLB_SIZE == JIT_MEMTLB_SIZE, "JitMemTlbType layout");
+    JitInstrType instr[BLOCK_INSTR_MAX];
+    for (int i = 0; i < blk->cnt; i++) {
+        instr[i].name = blk->item[i].instr->name();
+        instr[i].payload = blk->item[i].payload.buf32[0];
+        instr[i].pc = blk->item[i].pc;
+    }
+    jit_block_type ret = jit_->translate(instr, blk->cnt);
+    if (ret == 0) {
+        // Code buffer is full: drop all translations and start again
+        jit_->reset();
+        for (unsigned i = 0; i < blockTotal_; i++) {
+            blocks_[i].native = 0;
+            blocks_[i].hits = 0;
+        }
+        ret = jit_->translate(instr, blk->cnt);
+    }
+    return ret;
+}
+
+/**
+ * Interpreter fallback called from the compiled code.
+ */
+int CpuRiver_Functional::jitFallback(JitContextType *ctx, int idx) {
+    CpuRiver_Functional *p = static_cast<CpuRiver_Functional *>(ctx->owner);
+    BlockType *blk = static_cast<BlockType *>(ctx->blk);
+    p->step_cnt_ = ctx->step + idx;
+    p->setNPC(blk->item[idx].pc);
+    if (!p->execBlockItem(blk, idx) || idx + 1 >= blk->cnt) {
+        // Counter could be moved forward by the idle steps skipping
+        ctx->step = p->step_cnt_ - (idx + 1);
+        return 1;
+    }
+    return p->getNPC() != blk->item[idx + 1].pc;
+}
+
 void CpuRiver_Functional::enterDebugMode(uint64_t v, uint32_t cause) {
     DCSR_TYPE::ValueType dcsr;
     dcsr.val = static_cast<uint32_t>(readCSR(CSR_dcsr));
@@ -332,7 +804,7 @@ void CpuRiver_Functional::enterDebugMode(uint64_t v, uint32_t cause) {
 }
 
 
-uint64_t CpuRiver_Functional::readRegDbg(uint32_t regno) {
+uint64_t CpuRiver_Functional::readRegDbgDirect(uint32_t regno) {
     uint64_t rdata = 0;
     uint32_t region = regno >> 12;
     if (region == 0) {
@@ -345,10 +817,14 @@ uint64_t CpuRiver_Functional::readRegDbg(uint32_t regno) {
     return rdata;
 }
 
-void CpuRiver_Functional::writeRegDbg(uint32_t regno, uint64_t val) {
+void CpuRiver_Functional::writeRegDbgDirect(uint32_t regno, uint64_t val) {
     uint32_t region = regno >> 12;
     if (region == 0) {
         writeCSR(regno, val);
+        if (regno == CSR_dpc && isHalted()) {
+            // Debugger redirects the hart: execution resumes from dpc
+            setNPC(val);
+        }
     } else if (region == 1) {
         writeGPR(regno & 0x3F, val);
     } else if (region == 0xc) {
@@ -362,13 +838,36 @@ uint64_t CpuRiver_Functional::readCSR(uint32_t regno) {
     bool rd_access = true;;
     switch (regno) {
     case CSR_mcycle:
-    case CSR_minsret:
     case CSR_cycle:
     case CSR_time:
-    case CSR_insret:
         ret = step_cnt_;
         rd_access = false;
         break;
+    case CSR_minsret:
+    case CSR_insret:
+        ret = step_cnt_ - idleStepCnt_;
+        rd_access = false;
+        break;
+    case CSR_mhartid:
+        ret = hartid_.to_uint64();
+        rd_access = false;
+        break;
+    case CSR_sstatus:
+        ret = portCSR_.read(CSR_mstatus).val & SSTATUS_MASK;
+        rd_access = false;
+        break;
+    case CSR_sie:
+        ret = portCSR_.read(CSR_mie).val & portCSR_.read(CSR_mideleg).val;
+        rd_access = false;
+        break;
+    case CSR_fflags:
+        ret = portCSR_.read(CSR_fcsr).val & 0x1F;
+        rd_access = false;
+        break;
+    case CSR_frm:
+        ret = (portCSR_.read(CSR_fcsr).val >> 5) & 0x7;
+        rd_access = false;
+        break;
     case CSR_dpc:
         if (!isHalted()) {
             ret = getNPC();
@@ -405,7 +904,7 @@ uint64_t CpuRiver_Functional::readCSR(uint32_t regno) {
             mip.value = 0;
             mip.bits.MSIP = iirqloc_->getPendingRequest(2*hartid);
             mip.bits.MTIP = iirqloc_->getPendingRequest(2*hartid + 1);
-            mip.bits.MEIP = iirqext_->getPendingRequest(hartid) != IRQ_REQUEST_NONE;
+            mip.bits.MEIP = iirqext_->getPendingRequest(plicCtxM_) != IRQ_REQUEST_NONE;
             ret = mip.value;
             rd_access = false;
         }
@@ -413,9 +912,7 @@ uint64_t CpuRiver_Functional::readCSR(uint32_t regno) {
     default:;
     }
     if (rd_access) {
-        RISCV_mutex_lock(&mutex_csr_);
         ret = portCSR_.read(regno).val;
-        RISCV_mutex_unlock(&mutex_csr_);
     }
     return ret;
 }
@@ -423,6 +920,8 @@ uint64_t CpuRiver_Functional::readCSR(uint32_t regno) {
 void CpuRiver_Functional::writeCSR(uint32_t regno, uint64_t val) {
     bool wr_access = true;
     uint64_t trigidx;
+    uint64_t deleg;
+    csr_satp_type satp;
     switch (regno) {
     // Read-Only registers
     case CSR_misa:
@@ -455,6 +954,7 @@ void CpuRiver_Functional::writeCSR(uint32_t regno, uint64_t val) {
             tdata1.mcontrol_bits.maskmax = mcontrolMaskmax_.to_uint64();
         }
         ptriggers_[trigidx].data1.val = val;
+        updateTriggers();
         RISCV_info("[tdata1] <= %016" RV_PRI64 "x, type=%d",
             val, static_cast<uint32_t>(tdata1.bitsdef.type));
         val = tdata1.val;
@@ -462,6 +962,7 @@ void CpuRiver_Functional::writeCSR(uint32_t regno, uint64_t val) {
     case CSR_tdata2:
         trigidx = readCSR(CSR_tselect);
         ptriggers_[trigidx].data2 = val;
+        updateTriggers();
         RISCV_info("[tdata2] <= %016" RV_PRI64 "x", val);
         break;
     case CSR_textra:
@@ -469,21 +970,48 @@ void CpuRiver_Functional::writeCSR(uint32_t regno, uint64_t val) {
         ptriggers_[trigidx].extra = val;
         RISCV_info("[textra] <= %016" RV_PRI64 "x", val);
         break;
+    case CSR_mstackovr:
+        stackOvr_ = val;
+        break;
+    case CSR_mstackund:
+        stackUnd_ = val;
+        break;
     case CSR_flushi:
         flush(val);
         break;
+    case CSR_sstatus:
+        regno = CSR_mstatus;
+        val = (portCSR_.read(CSR_mstatus).val & ~SSTATUS_WMASK)
+            | (val & SSTATUS_WMASK);
+        break;
+    case CSR_fflags:
+        regno = CSR_fcsr;
+        val = (portCSR_.read(CSR_fcsr).val & ~0x1Full) | (val & 0x1F);
+        break;
+    case CSR_frm:
+        regno = CSR_fcsr;
+        val = (portCSR_.read(CSR_fcsr).val & ~0xE0ull) | ((val & 0x7) << 5);
+        break;
+    case CSR_sie:
+        deleg = portCSR_.read(CSR_mideleg).val;
+        regno = CSR_mie;
+        val = (portCSR_.read(CSR_mie).val & ~deleg) | (val & deleg);
+        break;
     case CSR_satp:
-        if ((val >> 60) & 0xf) {
-            RISCV_error(
-                "[satp] <= %016" RV_PRI64 "x. Paging not supported", val);
+        satp.value = val;
+        if (satp.bits.MODE != 0 && satp.bits.MODE != 8
+            && satp.bits.MODE != 9) {
+            // Write with unsupported mode has no effect
+            wr_access = false;
         }
         break;
     default:;
     }
     if (wr_access) {
-        RISCV_mutex_lock(&mutex_csr_);
         portCSR_.write(regno, val);
-        RISCV_mutex_unlock(&mutex_csr_);
+    }
+    if (regno == CSR_mstatus || regno == CSR_satp) {
+        updateMmuContext();
     }
 }
 
@@ -22,6 +22,8 @@
 #include "generic/cpu_generic.h"
 #include "generic/cmd_br_generic.h"
 #include "cmds/cmd_br_riscv.h"
+#include "jit/riscv_jit_x64.h"
+#include "riscv_mmu.h"
 #include "coreservices/icpuriscv.h"
 #include "coreservices/iirq.h"
 
@@ -43,12 +45,25 @@ class CpuRiver_Functional : public CpuGeneric,
     /** ICpuFunctional interface */
     virtual void enterDebugMode(uint64_t v, uint32_t cause) override;
     virtual void raiseSoftwareIrq() {}
+    virtual bool isInterruptPending() override;
+    virtual bool isInterruptTaken() override;
+    void waitForInterrupt() {
+        if (idleEna_) {
+            skipIdleSteps();
+        }
+    }
     virtual void setReg(int idx, uint64_t val) override {
-        if (idx) {
+        // Instruction with the page fault is restarted after the handler
+        if (idx && !(exceptions_ & PAGE_FAULTS)) {
             CpuGeneric::setReg(idx, val);
         }
     }
+    virtual void setPrvLevel(uint64_t lvl) override {
+        CpuGeneric::setPrvLevel(lvl);
+        updateMmuContext();
+    }
     virtual uint64_t getIrqAddress(int idx) { return readCSR(CSR_mtvec); }
+    static void traceFormat(TraceStepType *t, std::ostream &os);
     virtual void generateException(int e, uint64_t arg) override {
         writeCSR(CSR_mtval, arg);
         CpuGeneric::generateException(e, arg);
@@ -57,10 +72,6 @@ class CpuRiver_Functional : public CpuGeneric,
         generateException(EXCEPTION_InstrFault, addr);
     }
 
-    /** DPort interface */
-    virtual uint64_t readRegDbg(uint32_t regno) override;
-    virtual void writeRegDbg(uint32_t regno, uint64_t val) override;
-
     /** ICpuRiscV interface */
     virtual uint64_t readCSR(uint32_t idx);
     virtual void writeCSR(uint32_t idx, uint64_t val);
@@ -68,16 +79,34 @@ class CpuRiver_Functional : public CpuGeneric,
     virtual void writeGPR(uint32_t regno, uint64_t val) { R[regno] = val; }
     virtual uint64_t readNonStandardReg(uint32_t regno) { return 0; }
     virtual void writeNonStandardReg(uint32_t regno, uint64_t val) {}
-    virtual void mmuAddrReserve(uint64_t addr) override {
+    virtual void mmuAddrReserve(uint64_t addr, uint64_t value) override {
+        reserveAddress(addr);
         mmuReservatedAddr_ = addr;
-        mmuReservedAddrWatchdog_ = 64;
+        mmuReservedValue_ = value;
+        mmuReservedAddrWatchdog_ = step_cnt_ + 64;
     }
-    virtual bool mmuAddrRelease(uint64_t addr) override {
-        bool success = 0;
-        if (mmuReservedAddrWatchdog_ && mmuReservatedAddr_ == addr) {
-            success = true;
-            mmuReservedAddrWatchdog_ = 0;
+    /** ICheckpoint */
+    virtual bool restoreState(CheckpointState *state) override;
+
+    /** SFENCE.VMA */
+    void flushTlb(uint64_t va, uint64_t asid, bool allva, bool allasid) {
+        mmu_.flush(va, asid, allva, allasid);
+        flushFetchPage();
+    }
+    void getMmuStat(AttributeType *res) { mmu_.getStat(res); }
+    /** D-extension on the host FPU instead of the River FPU model */
+    bool isHostFpu() { return hostFpuEna_; }
+    /** Differential test of the host FPU mode against the FPU model */
+    void testHostFpu(AttributeType *res);
+    virtual bool mmuAddrRelease(uint64_t addr, uint64_t *value) override {
+        // Shared table is cleared by stores of other harts
+        bool success = releaseAddress(addr);
+        if (step_cnt_ >= mmuReservedAddrWatchdog_
+            || mmuReservatedAddr_ != addr) {
+            success = false;
         }
+        mmuReservedAddrWatchdog_ = 0;
+        *value = mmuReservedValue_;
         return success;
     }
 
@@ -85,6 +114,10 @@ class CpuRiver_Functional : public CpuGeneric,
     /** CpuGeneric common methods */
     virtual EEndianessType endianess() { return LittleEndian; }
     virtual GenericInstruction *decodeInstruction(Reg64Type *cache);
+    virtual unsigned getInstrLength(Reg64Type *payload) override {
+        return (payload->buf16[0] & 0x3) == 0x3 ? 4 : 2;
+    }
+    virtual bool isBlockEnd(Reg64Type *payload) override;
     virtual void generateIllegalOpcode();
     virtual void handleException(int e);
     virtual void handleInterrupts();
@@ -93,7 +126,19 @@ class CpuRiver_Functional : public CpuGeneric,
     /** // Stop tracking and write trace file */
     virtual void traceOutput() override;
     virtual bool isStepEnabled() override;
+    virtual uint64_t getDebugControl() override {
+        return readCSR(CSR_dcsr);
+    }
+    virtual void setDebugControl(uint64_t v) override {
+        writeCSR(CSR_dcsr, v);
+    }
     virtual void checkStackProtection() override;
+    virtual bool execCompiledBlock(BlockType *blk) override;
+    virtual uint64_t readRegDbgDirect(uint32_t regno) override;
+    virtual void writeRegDbgDirect(uint32_t regno, uint64_t val) override;
+    virtual bool isIdleInstruction(Reg64Type *payload) override;
+    virtual bool translateAddress(uint64_t va, EMemAccessType acc,
+                                  uint64_t *pa) override;
 
     void addIsaUserRV64I();
     void addIsaPrivilegedRV64I();
@@ -110,8 +155,83 @@ class CpuRiver_Functional : public CpuGeneric,
         return 0x20 | ((val >> 13) << 2) | t1;
     }
 
+ public:
+    /** Direct-indexed decoder generated from the enabled ISA list */
+    RiscvInstruction *lookupInstruction(uint32_t *payload) {
+        uint32_t val = payload[0];
+        DecodeEntryType *e;
+        if ((val & 0x3) == 0x3) {
+            e = &decodeTbl32_[decodeKey32(val)];
+        } else {
+            e = &decodeTbl16_[decodeKey16(val)];
+        }
+        RiscvInstruction **pinstr = &decodePool_[e->idx];
+        for (unsigned i = 0; i < e->cnt; i++) {
+            if (pinstr[i]->parse(payload)) {
+                return pinstr[i];
+            }
+        }
+        return 0;
+    }
+    /** Hash buckets scanning, kept as a reference for decode_bench */
+    RiscvInstruction *lookupInstructionList(uint32_t *payload);
+    /** List of all supported instructions used to generate test vectors */
+    unsigned getInstructionTotal() { return instrTotal_; }
+    RiscvInstruction *getInstruction(unsigned idx);
+
  private:
     void switchContext(uint32_t prvnxt);
+    void updateMmuContext();
+
+    static const uint64_t PAGE_FAULTS = (1ull << EXCEPTION_InstrPageFault)
+                                      | (1ull << EXCEPTION_LoadPageFault)
+                                      | (1ull << EXCEPTION_StorePageFault);
+    // Linux/newlib exit system call number in a7
+    static const uint64_t SYSCALL_EXIT = 93;
+    // sstatus fields visible (SD,UXL,MXR,SUM,XS,FS,VS,SPP,UBE,SPIE,SIE)
+    // and writable (MXR,SUM,FS,SPP,SPIE,SIE) in mstatus:
+    static const uint64_t SSTATUS_MASK = 0x80000003000DE762ull;
+    static const uint64_t SSTATUS_WMASK = 0x00000000000C6122ull;
+
+    /**
+     * 32-bits key: opcode[6:2], funct3[14:12], funct7[31:25]
+     * 16-bits key: quadrant[1:0], funct3[15:13], [12], [11:10], [6:5]
+     */
+    static const uint32_t DECODE_KEY32_MASK = 0xFE00707C;
+    static const uint32_t DECODE_KEY16_MASK = 0x0000FC63;
+    static const int DECODE_TBL32_SIZE = 1 << 15;
+    static const int DECODE_TBL16_SIZE = 1 << 10;
+
+    uint32_t decodeKey32(uint32_t val) {
+        return ((val >> 2) & 0x1F)
+             | (((val >> 12) & 0x7) << 5)
+             | (((val >> 25) & 0x7F) << 8);
+    }
+    uint32_t decodeKey16(uint32_t val) {
+        return (val & 0x3)
+             | (((val >> 13) & 0x7) << 2)
+             | (((val >> 12) & 0x1) << 5)
+             | (((val >> 10) & 0x3) << 6)
+             | (((val >> 5) & 0x3) << 8);
+    }
+    uint32_t decodeKey32ToInstr(uint32_t key) {
+        return 0x3 | ((key & 0x1F) << 2)
+             | (((key >> 5) & 0x7) << 12)
+             | (((key >> 8) & 0x7F) << 25);
+    }
+    uint32_t decodeKey16ToInstr(uint32_t key) {
+        return (key & 0x3)
+             | (((key >> 2) & 0x7) << 13)
+             | (((key >> 5) & 0x1) << 12)
+             | (((key >> 6) & 0x3) << 10)
+             | (((key >> 8) & 0x3) << 5);
+    }
+    void buildDecodeTable();
+    void fillDecodeEntries(int tblsz, bool rvc);
+
+    /** Native tier */
+    jit_block_type compileBlock(BlockType *blk);
+    static int jitFallback(JitContextType *ctx, int idx);
 
  private:
     AttributeType vendorid_;
@@ -121,18 +241,63 @@ class CpuRiver_Functional : public CpuGeneric,
     AttributeType listExtISA_;
     AttributeType clint_;       // Core-local interruptor
     AttributeType plic_;        // External interrupt controller
+    AttributeType jitThreshold_;    // Block executions before translation
+    AttributeType jitCacheSize_;    // Host code buffer size in bytes
+    AttributeType hostFpu_;         // D-extension on the host FPU
 
     static const int INSTR_HASH_TABLE_SIZE = 1 << 6;
     AttributeType listInstr_[INSTR_HASH_TABLE_SIZE];
+    unsigned instrTotal_;
+
+    // Each entry references the list of candidates (in registration order)
+    // which fixed bits are compatible with the entry key.
+    struct DecodeEntryType {
+        uint16_t idx;       // index in decodePool_
+        uint16_t cnt;       // number of candidates
+    };
+    DecodeEntryType *decodeTbl32_;
+    DecodeEntryType *decodeTbl16_;
+    RiscvInstruction **decodePool_;
+    unsigned decodePoolCnt_;
+    unsigned decodePoolSize_;
 
     IIrqController *iirqloc_;
     IIrqController *iirqext_;
 
     CmdBrRiscv *pcmd_br_;
     ICommand *pcmd_cpu_;
+    ICommand *pcmd_decbench_;
+    ICommand *pcmd_trigstat_;
+    ICommand *pcmd_tracedump_;
+    ICommand *pcmd_flightrec_;
+    ICommand *pcmd_reverse_;
+    ICommand *pcmd_mmu_;
+    ICommand *pcmd_fpudiff_;
+    ICommand *pcmd_profile_;
+
+    RiscvJitX64 *jit_;
+    JitContextType jitctx_;
+
+    RiscvMmu mmu_;
+    uint64_t dataPrv_;      // privilege level of loads and stores (MPRV)
+    bool hostFpuEna_;
+
+    // Requests levels pushed by CLINT and PLIC. Bit is set when request
+    // could be pending, controllers without notification support keep
+    // their bits always set.
+    enum EIrqPendingBit {
+        IrqPending_Software,
+        IrqPending_Timer,
+        IrqPending_External
+    };
+    std::atomic<uint64_t> irqPending_;
+    int plicCtxM_;
 
     uint64_t mmuReservatedAddr_;
-    int mmuReservedAddrWatchdog_;   // not exceed 64 instructions between LR/SC
+    uint64_t mmuReservedValue_;
+    uint64_t mmuReservedAddrWatchdog_;  // not exceed 64 instructions between LR/SC
+    uint64_t stackOvr_;     // cached CSR_mstackovr, 0 = disabled
+    uint64_t stackUnd_;     // cached CSR_mstackund, 0 = disabled
 };
 
 DECLARE_CLASS(CpuRiver_Functional)
@@ -36,6 +36,12 @@ class DmiFunctional : public RegMemBankGeneric,
     /** IService interface */
     virtual void postinitService() override;
 
+    /** ICheckpoint: debug interface isn't a part of the platform state */
+    virtual void saveState(CheckpointState *state) override {}
+    virtual bool restoreState(CheckpointState *state) override {
+        return true;
+    }
+
     /** IDmi interface */
     // Must be 2*n value
     virtual int getCpuMax() { return cpumax_.to_uint32(); }
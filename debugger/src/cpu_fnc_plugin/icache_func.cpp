@@ -222,21 +222,21 @@ void ICacheFunctional::getCachedValue(uint64_t addr,
 }
 
 void ICacheFunctional::readLine(uint64_t adr, WayMemType *way) {
-    Axi4TransactionType tr;
+    Axi4BurstType burst;
+    uint64_t line[ICACHE_LINE_BYTES / sizeof(uint64_t)];
     uint32_t index = getAdrIndex(adr);
     uint64_t tag = getAdrTag(adr);
     int burst_steps = ICACHE_LINE_BYTES / PAYLOAD_MAX_BYTES;
     int wstrb = 0x1;
-    tr.action = MemAction_Read;
-    tr.xsize = PAYLOAD_MAX_BYTES;
-    tr.addr = adr & ~(ICACHE_LINE_BYTES - 1);
-    tr.wstrb = 0;
-    for (int burst = 0; burst < burst_steps; burst ++) {
-        isysbus_->b_transport(&tr);
-        way->writeLine(index, tag, wstrb, tr.rpayload.b64[0]);
-
+    burst.action = MemAction_Read;
+    burst.addr = adr & ~(ICACHE_LINE_BYTES - 1);
+    burst.size = ICACHE_LINE_BYTES;
+    burst.buf = reinterpret_cast<uint8_t *>(line);
+    burst.source_idx = 0;
+    isysbus_->b_burst(&burst);
+    for (int i = 0; i < burst_steps; i++) {
+        way->writeLine(index, tag, wstrb, line[i]);
         wstrb <<= 1;
-        tr.addr += PAYLOAD_MAX_BYTES;
     }
 }
 
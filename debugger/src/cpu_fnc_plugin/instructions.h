@@ -45,6 +45,10 @@ public:
         return 0x20 | ((static_cast<uint16_t>(opcode_) >> 13) << 2) | t1;
     }
 
+    /** Fixed bits of the encoding used to build the decoder table */
+    uint32_t mask() { return mask_; }
+    uint32_t opcode() { return opcode_; }
+
 protected:
     AttributeType name_;
     CpuRiver_Functional *icpu_;
@@ -0,0 +1,876 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * @brief      Translator of the RISC-V basic blocks into x86-64 host code.
+ *
+ * Emulated registers stay in memory: rbx points to the registers bank,
+ * r12 to the JitContextType and r13 to the next instruction pointer.
+ * Instructions without native template (atomic, CSR, FPU, privileged,
+ * division) call the interpreter fallback. Aligned loads and stores hit in
+ * the memory TLB access the host memory directly, misses and MMIO are
+ * executed by the fallback.
+ */
+
+#include <api_types.h>
+#include <stddef.h>
+#include <string.h>
+#include "riscv-isa.h"
+#include "coreservices/icpuriscv.h"
+#include "riscv_jit_x64.h"
+
+#if defined(_WIN32) || defined(__CYGWIN__)
+#else
+    #include <sys/mman.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+    #define JIT_HOST_X64
+#endif
+
+namespace debugger {
+
+// Host registers
+static const int RAX = 0;
+static const int RCX = 1;
+static const int RDX = 2;
+
+// Host operations
+enum EJitAluOp {
+    Alu_ADD,
+    Alu_SUB,
+    Alu_AND,
+    Alu_OR,
+    Alu_XOR,
+    Alu_SLT,
+    Alu_SLTU,
+    Alu_SLL,
+    Alu_SRL,
+    Alu_SRA,
+    Alu_MUL,
+    Alu_MULH,
+    Alu_MULHU
+};
+
+enum EJitLoadOp {
+    Load_LD,
+    Load_LW,
+    Load_LWU,
+    Load_LH,
+    Load_LHU,
+    Load_LB,
+    Load_LBU
+};
+
+// Short jump opcodes used to skip the taken branch
+static const uint8_t JCC_JE = 0x74;
+static const uint8_t JCC_JNE = 0x75;
+static const uint8_t JCC_JB = 0x72;
+static const uint8_t JCC_JAE = 0x73;
+static const uint8_t JCC_JL = 0x7C;
+static const uint8_t JCC_JGE = 0x7D;
+
+static bool is_name(const char *name, const char *s) {
+    return strcmp(name, s) == 0;
+}
+
+RiscvJitX64::RiscvJitX64(unsigned codesz, jit_fallback_type fallback) {
+    code_ = 0;
+    codesz_ = codesz;
+    fallback_ = fallback;
+    fixupCnt_ = 0;
+    missCnt_ = 0;
+    nativeTotal_ = 0;
+    fallbackTotal_ = 0;
+#if defined(JIT_HOST_X64)
+#if defined(_WIN32) || defined(__CYGWIN__)
+    code_ = reinterpret_cast<uint8_t *>(VirtualAlloc(0, codesz_,
+                    MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+#else
+    void *p = mmap(0, codesz_, PROT_READ | PROT_WRITE | PROT_EXEC,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p != MAP_FAILED) {
+        code_ = reinterpret_cast<uint8_t *>(p);
+    }
+#endif
+#endif
+    ptr_ = code_;
+}
+
+RiscvJitX64::~RiscvJitX64() {
+    if (code_ == 0) {
+        return;
+    }
+#if defined(_WIN32) || defined(__CYGWIN__)
+    VirtualFree(code_, 0, MEM_RELEASE);
+#else
+    munmap(code_, codesz_);
+#endif
+}
+
+void RiscvJitX64::reset() {
+    ptr_ = code_;
+}
+
+jit_block_type RiscvJitX64::translate(JitInstrType *instr, int cnt) {
+    if (code_ == 0) {
+        return 0;
+    }
+    if (cnt > EXIT_FIXUP_MAX - 1) {
+        cnt = EXIT_FIXUP_MAX - 1;
+    }
+    if (static_cast<unsigned>(ptr_ - code_)
+            + CODE_INSTR_MAX * (cnt + 1) > codesz_) {
+        return 0;
+    }
+
+    uint8_t *start = ptr_;
+    fixupCnt_ = 0;
+    emitPrologue();
+    for (int i = 0; i < cnt; i++) {
+        if (translateInstr(&instr[i], i, i == cnt - 1)) {
+            nativeTotal_++;
+        } else {
+            emitFallback(i, i == cnt - 1);
+            fallbackTotal_++;
+        }
+    }
+
+    uint8_t *epilogue = ptr_;
+    emitEpilogue();
+    for (int i = 0; i < fixupCnt_; i++) {
+        int32_t rel = static_cast<int32_t>(epilogue - (fixup_[i] + 4));
+        memcpy(fixup_[i], &rel, 4);
+    }
+    return reinterpret_cast<jit_block_type>(start);
+}
+
+bool RiscvJitX64::translateInstr(JitInstrType *instr, int idx, bool last) {
+    const char *n = instr->name;
+    uint64_t pc = instr->pc;
+    uint32_t len = (instr->payload & 0x3) == 0x3 ? 4 : 2;
+    uint64_t imm;
+
+    if (n[0] != 'C' || n[1] != '_') {
+        ISA_R_type r;
+        ISA_I_type i;
+        r.value = instr->payload;
+        i.value = instr->payload;
+        imm = i.bits.imm;
+        if (imm & 0x800) {
+            imm |= EXT_SIGN_12;
+        }
+
+        if (is_name(n, "ADD")) {
+            emitAluRR(Alu_ADD, r.bits.rd, r.bits.rs1, r.bits.rs2, false);
+        } else if (is_name(n, "SUB")) {
+            emitAluRR(Alu_SUB, r.bits.rd, r.bits.rs1, r.bits.rs2, false);
+        } else if (is_name(n, "AND")) {
+            emitAluRR(Alu_AND, r.bits.rd, r.bits.rs1, r.bits.rs2, false);
+        } else if (is_name(n, "OR")) {
+            emitAluRR(Alu_OR, r.bits.rd, r.bits.rs1, r.bits.rs2, false);
+        } else if (is_name(n, "XOR")) {
+            emitAluRR(Alu_XOR, r.bits.rd, r.bits.rs1, r.bits.rs2, false);
+        } else if (is_name(n, "SLT")) {
+            emitAluRR(Alu_SLT, r.bits.rd, r.bits.rs1, r.bits.rs2, false);
+        } else if (is_name(n, "SLTU")) {
+            emitAluRR(Alu_SLTU, r.bits.rd, r.bits.rs1, r.bits.rs2, false);
+        } else if (is_name(n, "SLL")) {
+            emitAluRR(Alu_SLL, r.bits.rd, r.bits.rs1, r.bits.rs2, false);
+        } else if (is_name(n, "SRL")) {
+            emitAluRR(Alu_SRL, r.bits.rd, r.bits.rs1, r.bits.rs2, false);
+        } else if (is_name(n, "SRA")) {
+            emitAluRR(Alu_SRA, r.bits.rd, r.bits.rs1, r.bits.rs2, false);
+        } else if (is_name(n, "ADDW")) {
+            emitAluRR(Alu_ADD, r.bits.rd, r.bits.rs1, r.bits.rs2, true);
+        } else if (is_name(n, "SUBW")) {
+            emitAluRR(Alu_SUB, r.bits.rd, r.bits.rs1, r.bits.rs2, true);
+        } else if (is_name(n, "SLLW")) {
+            emitAluRR(Alu_SLL, r.bits.rd, r.bits.rs1, r.bits.rs2, true);
+        } else if (is_name(n, "SRLW")) {
+            emitAluRR(Alu_SRL, r.bits.rd, r.bits.rs1, r.bits.rs2, true);
+        } else if (is_name(n, "SRAW")) {
+            emitAluRR(Alu_SRA, r.bits.rd, r.bits.rs1, r.bits.rs2, true);
+        } else if (is_name(n, "MUL")) {
+            emitMul(Alu_MUL, r.bits.rd, r.bits.rs1, r.bits.rs2, false);
+        } else if (is_name(n, "MULW")) {
+            emitMul(Alu_MUL, r.bits.rd, r.bits.rs1, r.bits.rs2, true);
+        } else if (is_name(n, "MULH")) {
+            emitMul(Alu_MULH, r.bits.rd, r.bits.rs1, r.bits.rs2, false);
+        } else if (is_name(n, "MULHU")) {
+            emitMul(Alu_MULHU, r.bits.rd, r.bits.rs1, r.bits.rs2, false);
+        } else if (is_name(n, "ADDI")) {
+            emitAluRI(Alu_ADD, i.bits.rd, i.bits.rs1, imm, false);
+        } else if (is_name(n, "ANDI")) {
+            emitAluRI(Alu_AND, i.bits.rd, i.bits.rs1, imm, false);
+        } else if (is_name(n, "ORI")) {
+            emitAluRI(Alu_OR, i.bits.rd, i.bits.rs1, imm, false);
+        } else if (is_name(n, "XORI")) {
+            emitAluRI(Alu_XOR, i.bits.rd, i.bits.rs1, imm, false);
+        } else if (is_name(n, "SLTI")) {
+            emitAluRI(Alu_SLT, i.bits.rd, i.bits.rs1, imm, false);
+        } else if (is_name(n, "SLTIU")) {
+            emitAluRI(Alu_SLTU, i.bits.rd, i.bits.rs1, imm, false);
+        } else if (is_name(n, "ADDIW")) {
+            emitAluRI(Alu_ADD, i.bits.rd, i.bits.rs1, imm, true);
+        } else if (is_name(n, "SLLI")) {
+            emitShiftRI(Alu_SLL, i.bits.rd, i.bits.rs1, i.bits.imm & 0x3f,
+                        false);
+        } else if (is_name(n, "SRLI")) {
+            emitShiftRI(Alu_SRL, i.bits.rd, i.bits.rs1, i.bits.imm & 0x3f,
+                        false);
+        } else if (is_name(n, "SRAI")) {
+            emitShiftRI(Alu_SRA, i.bits.rd, i.bits.rs1, i.bits.imm & 0x3f,
+                        false);
+        } else if (is_name(n, "SLLIW") && !((i.bits.imm >> 5) & 0x1)) {
+            emitShiftRI(Alu_SLL, i.bits.rd, i.bits.rs1, i.bits.imm & 0x1f,
+                        true);
+        } else if (is_name(n, "SRLIW")) {
+            emitShiftRI(Alu_SRL, i.bits.rd, i.bits.rs1, i.bits.imm & 0x1f,
+                        true);
+        } else if (is_name(n, "SRAIW") && !((i.bits.imm >> 5) & 0x1)) {
+            emitShiftRI(Alu_SRA, i.bits.rd, i.bits.rs1, i.bits.imm & 0x1f,
+                        true);
+        } else if (is_name(n, "LUI") || is_name(n, "AUIPC")) {
+            ISA_U_type u;
+            u.value = instr->payload;
+            imm = u.bits.imm31_12 << 12;
+            if (imm & (1LL << 31)) {
+                imm |= EXT_SIGN_32;
+            }
+            if (n[0] == 'A') {
+                imm += pc;
+            }
+            if (u.bits.rd) {
+                emitLoadImm(RAX, imm);
+                emitStoreReg(RAX, u.bits.rd);
+            }
+        } else if (n[0] == 'B') {
+            ISA_SB_type u;
+            uint8_t jskip;
+            u.value = instr->payload;
+            if (is_name(n, "BEQ")) {
+                jskip = JCC_JNE;
+            } else if (is_name(n, "BNE")) {
+                jskip = JCC_JE;
+            } else if (is_name(n, "BLT")) {
+                jskip = JCC_JGE;
+            } else if (is_name(n, "BGE")) {
+                jskip = JCC_JL;
+            } else if (is_name(n, "BLTU")) {
+                jskip = JCC_JAE;
+            } else if (is_name(n, "BGEU")) {
+                jskip = JCC_JB;
+            } else {
+                return false;
+            }
+            imm = (u.bits.imm12 << 12) | (u.bits.imm11 << 11)
+                | (u.bits.imm10_5 << 5) | (u.bits.imm4_1 << 1);
+            if (u.bits.imm12) {
+                imm |= EXT_SIGN_12;
+            }
+            emitBranch(jskip, u.bits.rs1, u.bits.rs2, pc + imm, idx);
+        } else if (is_name(n, "JAL")) {
+            ISA_UJ_type u;
+            u.value = instr->payload;
+            if (u.bits.rd == ICpuRiscV::Reg_ra) {
+                return false;       // stack trace
+            }
+            imm = 0;
+            if (u.bits.imm20) {
+                imm = 0xfffffffffff00000LL;
+            }
+            imm |= (u.bits.imm19_12 << 12);
+            imm |= (u.bits.imm11 << 11);
+            imm |= (u.bits.imm10_1 << 1);
+            emitJump(pc + imm, u.bits.rd, pc + 4, idx);
+        } else if (is_name(n, "LD")) {
+            emitLoad(Load_LD, i.bits.rd, i.bits.rs1, imm, idx, last);
+        } else if (is_name(n, "LW")) {
+            emitLoad(Load_LW, i.bits.rd, i.bits.rs1, imm, idx, last);
+        } else if (is_name(n, "LWU")) {
+            emitLoad(Load_LWU, i.bits.rd, i.bits.rs1, imm, idx, last);
+        } else if (is_name(n, "LH")) {
+            emitLoad(Load_LH, i.bits.rd, i.bits.rs1, imm, idx, last);
+        } else if (is_name(n, "LHU")) {
+            emitLoad(Load_LHU, i.bits.rd, i.bits.rs1, imm, idx, last);
+        } else if (is_name(n, "LB")) {
+            emitLoad(Load_LB, i.bits.rd, i.bits.rs1, imm, idx, last);
+        } else if (is_name(n, "LBU")) {
+            emitLoad(Load_LBU, i.bits.rd, i.bits.rs1, imm, idx, last);
+        } else if (is_name(n, "SD") || is_name(n, "SW")
+                || is_name(n, "SH") || is_name(n, "SB")) {
+            ISA_S_type s;
+            int sz;
+            s.value = instr->payload;
+            imm = (s.bits.imm11_5 << 5) | s.bits.imm4_0;
+            if (imm & 0x800) {
+                imm |= EXT_SIGN_12;
+            }
+            switch (n[1]) {
+            case 'D': sz = 8; break;
+            case 'W': sz = 4; break;
+            case 'H': sz = 2; break;
+            default:  sz = 1;
+            }
+            emitStore(sz, s.bits.rs1, s.bits.rs2, imm, idx, last);
+        } else if (is_name(n, "JALR")) {
+            if (i.bits.rd == ICpuRiscV::Reg_ra
+                || (i.bits.imm == 0 && i.bits.rs1 == ICpuRiscV::Reg_ra)) {
+                return false;       // stack trace
+            }
+            emitJumpReg(i.bits.rs1, imm, true, i.bits.rd, pc + 4, idx);
+        } else {
+            return false;
+        }
+    } else {
+        ISA_CR_type cr;
+        ISA_CI_type ci;
+        ISA_CS_type cs;
+        ISA_CB_type cb;
+        cr.value = static_cast<uint16_t>(instr->payload);
+        ci.value = cr.value;
+        cs.value = cr.value;
+        cb.value = cr.value;
+        imm = ci.bits.imm;
+        if (ci.bits.imm6) {
+            imm |= EXT_SIGN_6;
+        }
+
+        if (is_name(n, "C_ADDI")) {
+            emitAluRI(Alu_ADD, ci.bits.rdrs, ci.bits.rdrs, imm, false);
+        } else if (is_name(n, "C_ADDIW")) {
+            emitAluRI(Alu_ADD, ci.bits.rdrs, ci.bits.rdrs, imm, true);
+        } else if (is_name(n, "C_LI")) {
+            emitAluRI(Alu_ADD, ci.bits.rdrs, 0, imm, false);
+        } else if (is_name(n, "C_LUI")) {
+            emitAluRI(Alu_ADD, ci.bits.rdrs, 0, imm << 12, false);
+        } else if (is_name(n, "C_ADDI16SP")) {
+            imm = (ci.spbits.imm8_7 << 3) | (ci.spbits.imm6 << 2)
+                | (ci.spbits.imm5 << 1) | ci.spbits.imm4;
+            if (ci.spbits.imm9) {
+                imm |= EXT_SIGN_6;
+            }
+            emitAluRI(Alu_ADD, ICpuRiscV::Reg_sp, ICpuRiscV::Reg_sp,
+                      imm << 4, false);
+        } else if (is_name(n, "C_ADDI4SPN")) {
+            ISA_CIW_type ciw;
+            ciw.value = cr.value;
+            imm = (ciw.bits.imm9_6 << 4) | (ciw.bits.imm5_4 << 2)
+                | (ciw.bits.imm3 << 1) | ciw.bits.imm2;
+            emitAluRI(Alu_ADD, 8 + ciw.bits.rd, ICpuRiscV::Reg_sp,
+                      imm << 2, false);
+        } else if (is_name(n, "C_ANDI")) {
+            imm = cb.shbits.shamt;
+            if (cb.shbits.shamt5) {
+                imm |= EXT_SIGN_6;
+            }
+            emitAluRI(Alu_AND, 8 + cb.bits.rs1, 8 + cb.bits.rs1, imm, false);
+        } else if (is_name(n, "C_SLLI")) {
+            emitShiftRI(Alu_SLL, cr.bits.rdrs1, cr.bits.rdrs1,
+                        (cb.shbits.shamt5 << 5) | cb.shbits.shamt, false);
+        } else if (is_name(n, "C_SRLI")) {
+            emitShiftRI(Alu_SRL, 8 + cb.shbits.rd, 8 + cb.shbits.rd,
+                        (cb.shbits.shamt5 << 5) | cb.shbits.shamt, false);
+        } else if (is_name(n, "C_SRAI")) {
+            emitShiftRI(Alu_SRA, 8 + cb.shbits.rd, 8 + cb.shbits.rd,
+                        (cb.shbits.shamt5 << 5) | cb.shbits.shamt, false);
+        } else if (is_name(n, "C_MV")) {
+            emitAluRR(Alu_ADD, cr.bits.rdrs1, 0, cr.bits.rs2, false);
+        } else if (is_name(n, "C_ADD")) {
+            emitAluRR(Alu_ADD, cr.bits.rdrs1, cr.bits.rdrs1, cr.bits.rs2,
+                      false);
+        } else if (is_name(n, "C_SUB")) {
+            emitAluRR(Alu_SUB, 8 + cs.bits.rs1, 8 + cs.bits.rs1,
+                      8 + cs.bits.rs2, false);
+        } else if (is_name(n, "C_XOR")) {
+            emitAluRR(Alu_XOR, 8 + cs.bits.rs1, 8 + cs.bits.rs1,
+                      8 + cs.bits.rs2, false);
+        } else if (is_name(n, "C_OR")) {
+            emitAluRR(Alu_OR, 8 + cs.bits.rs1, 8 + cs.bits.rs1,
+                      8 + cs.bits.rs2, false);
+        } else if (is_name(n, "C_AND")) {
+            emitAluRR(Alu_AND, 8 + cs.bits.rs1, 8 + cs.bits.rs1,
+                      8 + cs.bits.rs2, false);
+        } else if (is_name(n, "C_ADDW")) {
+            emitAluRR(Alu_ADD, 8 + cs.bits.rs1, 8 + cs.bits.rs1,
+                      8 + cs.bits.rs2, true);
+        } else if (is_name(n, "C_SUBW")) {
+            emitAluRR(Alu_SUB, 8 + cs.bits.rs1, 8 + cs.bits.rs1,
+                      8 + cs.bits.rs2, true);
+        } else if (is_name(n, "C_NOP")) {
+        } else if (is_name(n, "C_BEQZ") || is_name(n, "C_BNEZ")) {
+            imm = (cb.bits.off7_6 << 5) | (cb.bits.off5 << 4)
+                | (cb.bits.off4_3 << 2) | cb.bits.off2_1;
+            imm <<= 1;
+            if (cb.bits.off8) {
+                imm |= EXT_SIGN_9;
+            }
+            emitBranch(n[3] == 'E' ? JCC_JNE : JCC_JE, 8 + cb.bits.rs1, 0,
+                       pc + imm, idx);
+        } else if (is_name(n, "C_J")) {
+            ISA_CJ_type cj;
+            cj.value = cr.value;
+            imm = (cj.bits.off10 << 9) | (cj.bits.off9_8 << 7)
+                | (cj.bits.off7 << 6) | (cj.bits.off6 << 5)
+                | (cj.bits.off5 << 4) | (cj.bits.off4 << 3)
+                | cj.bits.off3_1;
+            imm <<= 1;
+            if (cj.bits.off11) {
+                imm |= EXT_SIGN_11;
+            }
+            emitJump(pc + imm, 0, 0, idx);
+        } else if (is_name(n, "C_JR")
+                && cr.bits.rdrs1 != ICpuRiscV::Reg_ra) {
+            emitJumpReg(cr.bits.rdrs1, 0, false, 0, 0, idx);
+        } else if (is_name(n, "C_LD") || is_name(n, "C_SD")) {
+            ISA_CL_type cl;
+            cl.value = cr.value;
+            imm = (cl.bits.imm27 << 4) | (cl.bits.imm6 << 3) | cl.bits.imm5_3;
+            if (n[2] == 'L') {
+                emitLoad(Load_LD, 8 + cl.bits.rd, 8 + cl.bits.rs1, imm << 3,
+                         idx, last);
+            } else {
+                emitStore(8, 8 + cs.bits.rs1, 8 + cs.bits.rs2, imm << 3,
+                          idx, last);
+            }
+        } else if (is_name(n, "C_LW") || is_name(n, "C_SW")) {
+            ISA_CL_type cl;
+            cl.value = cr.value;
+            imm = (cl.bits.imm6 << 4) | (cl.bits.imm5_3 << 1) | cl.bits.imm27;
+            if (n[2] == 'L') {
+                emitLoad(Load_LW, 8 + cl.bits.rd, 8 + cl.bits.rs1, imm << 2,
+                         idx, last);
+            } else {
+                emitStore(4, 8 + cs.bits.rs1, 8 + cs.bits.rs2, imm << 2,
+                          idx, last);
+            }
+        } else if (is_name(n, "C_LDSP")) {
+            imm = (ci.ldspbits.off8_6 << 3) | (ci.ldspbits.off5 << 2)
+                | ci.ldspbits.off4_3;
+            emitLoad(Load_LD, ci.ldspbits.rd, ICpuRiscV::Reg_sp, imm << 3,
+                     idx, last);
+        } else if (is_name(n, "C_LWSP")) {
+            imm = (ci.lwspbits.off7_6 << 4) | (ci.lwspbits.off5 << 3)
+                | ci.lwspbits.off4_2;
+            emitLoad(Load_LW, ci.lwspbits.rd, ICpuRiscV::Reg_sp, imm << 2,
+                     idx, last);
+        } else if (is_name(n, "C_SDSP") || is_name(n, "C_SWSP")) {
+            ISA_CSS_type css;
+            css.value = cr.value;
+            if (n[3] == 'D') {
+                imm = (css.dbits.imm8_6 << 3) | css.dbits.imm5_3;
+                emitStore(8, ICpuRiscV::Reg_sp, css.dbits.rs2, imm << 3,
+                          idx, last);
+            } else {
+                imm = (css.wbits.imm7_6 << 4) | css.wbits.imm5_2;
+                emitStore(4, ICpuRiscV::Reg_sp, css.wbits.rs2, imm << 2,
+                          idx, last);
+            }
+        } else {
+            return false;
+        }
+    }
+
+    if (last) {
+        emitSetNpc(pc + len);
+        emitExit(idx + 1);
+    }
+    return true;
+}
+
+void RiscvJitX64::emitFallback(int idx, bool last) {
+#if defined(_WIN32) || defined(__CYGWIN__)
+    emit8(0x4C); emit8(0x89); emit8(0xE1);      // mov rcx,r12
+    emit8(0xBA); emit32(idx);                   // mov edx,idx
+#else
+    emit8(0x4C); emit8(0x89); emit8(0xE7);      // mov rdi,r12
+    emit8(0xBE); emit32(idx);                   // mov esi,idx
+#endif
+    emit8(0x48); emit8(0xB8);                   // mov rax,fallback
+    emit64(reinterpret_cast<uint64_t>(fallback_));
+    emit8(0xFF); emit8(0xD0);                   // call rax
+    if (!last) {
+        emit8(0x85); emit8(0xC0);               // test eax,eax
+        emit8(0x74); emit8(0x0A);               // jz next
+    }
+    emitExit(idx + 1);
+}
+
+void RiscvJitX64::emitPrologue() {
+    emit8(0x53);                                // push rbx
+    emit8(0x41); emit8(0x54);                   // push r12
+    emit8(0x41); emit8(0x55);                   // push r13
+#if defined(_WIN32) || defined(__CYGWIN__)
+    emit8(0x48); emit8(0x83); emit8(0xEC); emit8(0x20);  // sub rsp,32
+    emit8(0x49); emit8(0x89); emit8(0xCC);      // mov r12,rcx
+#else
+    emit8(0x49); emit8(0x89); emit8(0xFC);      // mov r12,rdi
+#endif
+    emit8(0x49); emit8(0x8B); emit8(0x1C); emit8(0x24);  // mov rbx,[r12]
+    emit8(0x4D); emit8(0x8B); emit8(0x6C); emit8(0x24);  // mov r13,[r12+8]
+    emit8(0x08);
+}
+
+void RiscvJitX64::emitEpilogue() {
+#if defined(_WIN32) || defined(__CYGWIN__)
+    emit8(0x48); emit8(0x83); emit8(0xC4); emit8(0x20);  // add rsp,32
+#endif
+    emit8(0x41); emit8(0x5D);                   // pop r13
+    emit8(0x41); emit8(0x5C);                   // pop r12
+    emit8(0x5B);                                // pop rbx
+    emit8(0xC3);                                // ret
+}
+
+void RiscvJitX64::emitExit(int cnt) {
+    emit8(0xB8); emit32(cnt);                   // mov eax,cnt
+    emit8(0xE9);                                // jmp epilogue
+    fixup_[fixupCnt_++] = ptr_;
+    emit32(0);
+}
+
+void RiscvJitX64::emitSetNpc(uint64_t npc) {
+    emitLoadImm(RCX, npc);
+    emit8(0x49); emit8(0x89); emit8(0x4D); emit8(0x00);  // mov [r13],rcx
+}
+
+void RiscvJitX64::emitLoadReg(int hreg, int idx) {
+    if (idx == 0) {
+        emit8(0x31); emit8(0xC0 | (hreg << 3) | hreg);   // xor r32,r32
+        return;
+    }
+    emit8(0x48); emit8(0x8B); emit8(0x83 | (hreg << 3)); // mov r64,[rbx+d]
+    emit32(8 * idx);
+}
+
+void RiscvJitX64::emitStoreReg(int hreg, int idx) {
+    if (idx == 0) {
+        return;
+    }
+    emit8(0x48); emit8(0x89); emit8(0x83 | (hreg << 3)); // mov [rbx+d],r64
+    emit32(8 * idx);
+}
+
+void RiscvJitX64::emitLoadImm(int hreg, uint64_t imm) {
+    int64_t t = static_cast<int64_t>(imm);
+    if (t == static_cast<int32_t>(t)) {
+        emit8(0x48); emit8(0xC7); emit8(0xC0 | hreg);    // mov r64,simm32
+        emit32(static_cast<uint32_t>(imm));
+    } else {
+        emit8(0x48); emit8(0xB8 | hreg);                 // mov r64,imm64
+        emit64(imm);
+    }
+}
+
+void RiscvJitX64::emitAluRR(int op, int rd, int rs1, int rs2, bool w) {
+    if (rd == 0) {
+        return;
+    }
+    emitLoadReg(RAX, rs1);
+    emitLoadReg(RCX, rs2);
+    if (!w) {
+        emit8(0x48);
+    }
+    switch (op) {
+    case Alu_ADD: emit8(0x01); emit8(0xC8); break;  // add rax,rcx
+    case Alu_SUB: emit8(0x29); emit8(0xC8); break;  // sub rax,rcx
+    case Alu_AND: emit8(0x21); emit8(0xC8); break;  // and rax,rcx
+    case Alu_OR:  emit8(0x09); emit8(0xC8); break;  // or rax,rcx
+    case Alu_XOR: emit8(0x31); emit8(0xC8); break;  // xor rax,rcx
+    case Alu_SLL: emit8(0xD3); emit8(0xE0); break;  // shl rax,cl
+    case Alu_SRL: emit8(0xD3); emit8(0xE8); break;  // shr rax,cl
+    case Alu_SRA: emit8(0xD3); emit8(0xF8); break;  // sar rax,cl
+    case Alu_SLT:
+    case Alu_SLTU:
+        emit8(0x39); emit8(0xC8);                   // cmp rax,rcx
+        emit8(0x0F); emit8(op == Alu_SLT ? 0x9C : 0x92); emit8(0xC0);
+        emit8(0x0F); emit8(0xB6); emit8(0xC0);      // movzx eax,al
+        break;
+    default:;
+    }
+    if (w) {
+        emit8(0x48); emit8(0x63); emit8(0xC0);      // movsxd rax,eax
+    }
+    emitStoreReg(RAX, rd);
+}
+
+void RiscvJitX64::emitAluRI(int op, int rd, int rs1, uint64_t imm, bool w) {
+    if (rd == 0) {
+        return;
+    }
+    if (rs1 == 0 && !w && op == Alu_ADD) {
+        emitLoadImm(RAX, imm);
+        emitStoreReg(RAX, rd);
+        return;
+    }
+    emitLoadReg(RAX, rs1);
+    emitLoadImm(RCX, imm);
+    if (!w) {
+        emit8(0x48);
+    }
+    switch (op) {
+    case Alu_ADD: emit8(0x01); emit8(0xC8); break;
+    case Alu_AND: emit8(0x21); emit8(0xC8); break;
+    case Alu_OR:  emit8(0x09); emit8(0xC8); break;
+    case Alu_XOR: emit8(0x31); emit8(0xC8); break;
+    case Alu_SLT:
+    case Alu_SLTU:
+        emit8(0x39); emit8(0xC8);
+        emit8(0x0F); emit8(op == Alu_SLT ? 0x9C : 0x92); emit8(0xC0);
+        emit8(0x0F); emit8(0xB6); emit8(0xC0);
+        break;
+    default:;
+    }
+    if (w) {
+        emit8(0x48); emit8(0x63); emit8(0xC0);
+    }
+    emitStoreReg(RAX, rd);
+}
+
+void RiscvJitX64::emitShiftRI(int op, int rd, int rs1, unsigned shamt,
+                              bool w) {
+    if (rd == 0) {
+        return;
+    }
+    emitLoadReg(RAX, rs1);
+    if (!w) {
+        emit8(0x48);
+    }
+    emit8(0xC1);
+    switch (op) {
+    case Alu_SLL: emit8(0xE0); break;               // shl rax,imm8
+    case Alu_SRL: emit8(0xE8); break;               // shr rax,imm8
+    default:      emit8(0xF8);                      // sar rax,imm8
+    }
+    emit8(static_cast<uint8_t>(shamt));
+    if (w) {
+        emit8(0x48); emit8(0x63); emit8(0xC0);
+    }
+    emitStoreReg(RAX, rd);
+}
+
+void RiscvJitX64::emitMul(int op, int rd, int rs1, int rs2, bool w) {
+    if (rd == 0) {
+        return;
+    }
+    emitLoadReg(RAX, rs1);
+    emitLoadReg(RCX, rs2);
+    switch (op) {
+    case Alu_MUL:
+        if (!w) {
+            emit8(0x48);
+        }
+        emit8(0x0F); emit8(0xAF); emit8(0xC1);      // imul rax,rcx
+        if (w) {
+            emit8(0x48); emit8(0x63); emit8(0xC0);
+        }
+        break;
+    case Alu_MULH:
+        emit8(0x48); emit8(0xF7); emit8(0xE9);      // imul rcx
+        emit8(0x48); emit8(0x89); emit8(0xD0);      // mov rax,rdx
+        break;
+    default:
+        emit8(0x48); emit8(0xF7); emit8(0xE1);      // mul rcx
+        emit8(0x48); emit8(0x89); emit8(0xD0);
+    }
+    emitStoreReg(RAX, rd);
+}
+
+void RiscvJitX64::emitBranch(int jskip, int rs1, int rs2, uint64_t target,
+                             int idx) {
+    emitLoadReg(RAX, rs1);
+    emitLoadReg(RCX, rs2);
+    emit8(0x48); emit8(0x39); emit8(0xC8);          // cmp rax,rcx
+    emit8(static_cast<uint8_t>(jskip));
+    uint8_t *rel8 = ptr_;
+    emit8(0);
+    emitSetNpc(target);
+    emitExit(idx + 1);
+    *rel8 = static_cast<uint8_t>(ptr_ - (rel8 + 1));
+}
+
+void RiscvJitX64::emitJump(uint64_t target, int rd, uint64_t link, int idx) {
+    if (rd) {
+        emitLoadImm(RAX, link);
+        emitStoreReg(RAX, rd);
+    }
+    emitSetNpc(target);
+    emitExit(idx + 1);
+}
+
+void RiscvJitX64::emitJumpReg(int rs1, uint64_t imm, bool align, int rd,
+                              uint64_t link, int idx) {
+    emitLoadReg(RAX, rs1);
+    if (imm) {
+        emitLoadImm(RCX, imm);
+        emit8(0x48); emit8(0x01); emit8(0xC8);      // add rax,rcx
+    }
+    if (align) {
+        emit8(0x48); emit8(0x83); emit8(0xE0); emit8(0xFE);  // and rax,-2
+    }
+    if (rd) {
+        emitLoadImm(RCX, link);
+        emitStoreReg(RCX, rd);
+    }
+    emit8(0x49); emit8(0x89); emit8(0x45); emit8(0x00);  // mov [r13],rax
+    emitExit(idx + 1);
+}
+
+void RiscvJitX64::emitLoad(int op, int rd, int rs1, uint64_t imm, int idx,
+                           bool last) {
+    int sz;
+    switch (op) {
+    case Load_LD:  sz = 8; break;
+    case Load_LW:
+    case Load_LWU: sz = 4; break;
+    case Load_LH:
+    case Load_LHU: sz = 2; break;
+    default:       sz = 1;
+    }
+    emitMemEntry(rs1, imm, sz, false);
+    switch (op) {
+    case Load_LD:                                   // mov rax,[rcx+rax]
+        emit8(0x48); emit8(0x8B); emit8(0x04); emit8(0x01);
+        break;
+    case Load_LW:                                   // movsxd rax,[rcx+rax]
+        emit8(0x48); emit8(0x63); emit8(0x04); emit8(0x01);
+        break;
+    case Load_LWU:                                  // mov eax,[rcx+rax]
+        emit8(0x8B); emit8(0x04); emit8(0x01);
+        break;
+    case Load_LH:                                   // movsx rax,word
+        emit8(0x48); emit8(0x0F); emit8(0xBF); emit8(0x04); emit8(0x01);
+        break;
+    case Load_LHU:                                  // movzx eax,word
+        emit8(0x0F); emit8(0xB7); emit8(0x04); emit8(0x01);
+        break;
+    case Load_LB:                                   // movsx rax,byte
+        emit8(0x48); emit8(0x0F); emit8(0xBE); emit8(0x04); emit8(0x01);
+        break;
+    default:                                        // movzx eax,byte
+        emit8(0x0F); emit8(0xB6); emit8(0x04); emit8(0x01);
+    }
+    emitStoreReg(RAX, rd);
+    emitMiss(idx, last);
+}
+
+void RiscvJitX64::emitStore(int sz, int rs1, int rs2, uint64_t imm, int idx,
+                            bool last) {
+    emitMemEntry(rs1, imm, sz, true);
+    emitLoadReg(RDX, rs2);
+    switch (sz) {
+    case 8:                                         // mov [rcx+rax],rdx
+        emit8(0x48); emit8(0x89); emit8(0x14); emit8(0x01);
+        break;
+    case 4:                                         // mov [rcx+rax],edx
+        emit8(0x89); emit8(0x14); emit8(0x01);
+        break;
+    case 2:                                         // mov [rcx+rax],dx
+        emit8(0x66); emit8(0x89); emit8(0x14); emit8(0x01);
+        break;
+    default:                                        // mov [rcx+rax],dl
+        emit8(0x88); emit8(0x14); emit8(0x01);
+    }
+    emitMiss(idx, last);
+}
+
+/**
+ * Leaves the host pointer of the page in rcx and the page offset in rax.
+ * Misaligned access, disabled TLB, other page or MMIO device jump to the
+ * miss. Store also requires the 'plain' page without LR/SC reservations
+ * and sets the checkpoint dirty flag.
+ */
+void RiscvJitX64::emitMemEntry(int rs1, uint64_t imm, int sz, bool store) {
+    missCnt_ = 0;
+    emitLoadReg(RAX, rs1);
+    if (imm) {
+        emit8(0x48); emit8(0x05);                   // add rax,simm32
+        emit32(static_cast<uint32_t>(imm));
+    }
+    if (sz > 1) {
+        emit8(0xA8); emit8(static_cast<uint8_t>(sz - 1));  // test al,sz-1
+        emitJccMiss(JCC_JNE);
+    }
+    emit8(0x49); emit8(0x8B); emit8(0x4C); emit8(0x24);    // mov rcx,[r12+d]
+    emit8(offsetof(JitContextType, memtlb));
+    emit8(0x48); emit8(0x85); emit8(0xC9);          // test rcx,rcx
+    emitJccMiss(JCC_JE);
+    if (store) {
+        emit8(0x49); emit8(0x8B); emit8(0x54); emit8(0x24);  // mov rdx,[r12+d]
+        emit8(offsetof(JitContextType, resvcnt));
+        emit8(0x83); emit8(0x3A); emit8(0x00);      // cmp dword [rdx],0
+        emitJccMiss(JCC_JNE);
+    }
+    emit8(0x48); emit8(0x89); emit8(0xC2);          // mov rdx,rax
+    emit8(0x48); emit8(0xC1); emit8(0xEA);          // shr rdx,page_bits
+    emit8(JIT_MEMTLB_PAGE_BITS);
+    emit8(0x41); emit8(0x89); emit8(0xD0);          // mov r8d,edx
+    emit8(0x41); emit8(0x81); emit8(0xE0);          // and r8d,size-1
+    emit32(JIT_MEMTLB_SIZE - 1);
+    emit8(0x45); emit8(0x69); emit8(0xC0);          // imul r8d,r8d,entry
+    emit32(sizeof(JitMemTlbType));
+    emit8(0x4C); emit8(0x01); emit8(0xC1);          // add rcx,r8
+    emit8(0x48); emit8(0x39); emit8(0x11);          // cmp [rcx],rdx
+    emitJccMiss(JCC_JNE);
+    if (store) {
+        emit8(0x80); emit8(0x79);                   // cmp byte [rcx+d],0
+        emit8(offsetof(JitMemTlbType, plain)); emit8(0x00);
+        emitJccMiss(JCC_JE);
+        emit8(0x48); emit8(0x8B); emit8(0x51);      // mov rdx,[rcx+d]
+        emit8(offsetof(JitMemTlbType, dirty));
+        emit8(0x48); emit8(0x85); emit8(0xD2);      // test rdx,rdx
+        emit8(0x74); emit8(0x03);                   // jz +3
+        emit8(0xC6); emit8(0x02); emit8(0x01);      // mov byte [rdx],1
+    }
+    emit8(0x48); emit8(0x8B); emit8(0x49);          // mov rcx,[rcx+d]
+    emit8(offsetof(JitMemTlbType, ptr));
+    if (!store) {
+        // Plain page always has the pointer
+        emit8(0x48); emit8(0x85); emit8(0xC9);      // test rcx,rcx
+        emitJccMiss(JCC_JE);
+    }
+    emit8(0x25);                                    // and eax,page_mask
+    emit32((1u << JIT_MEMTLB_PAGE_BITS) - 1);
+}
+
+void RiscvJitX64::emitJccMiss(uint8_t cc) {
+    emit8(0x0F); emit8(cc + 0x10);                  // jcc rel32
+    miss_[missCnt_++] = ptr_;
+    emit32(0);
+}
+
+/** Host access skips the fallback, other instructions follow both paths */
+void RiscvJitX64::emitMiss(int idx, bool last) {
+    emit8(0xEB);                                    // jmp done
+    uint8_t *rel8 = ptr_;
+    emit8(0);
+    for (int i = 0; i < missCnt_; i++) {
+        int32_t rel = static_cast<int32_t>(ptr_ - (miss_[i] + 4));
+        memcpy(miss_[i], &rel, 4);
+    }
+    emitFallback(idx, last);
+    *rel8 = static_cast<uint8_t>(ptr_ - (rel8 + 1));
+}
+
+void RiscvJitX64::emit32(uint32_t v) {
+    memcpy(ptr_, &v, 4);
+    ptr_ += 4;
+}
+
+void RiscvJitX64::emit64(uint64_t v) {
+    memcpy(ptr_, &v, 8);
+    ptr_ += 8;
+}
+
+}  // namespace debugger
@@ -0,0 +1,149 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * @brief      Translator of the RISC-V basic blocks into x86-64 host code.
+ */
+
+#ifndef __DEBUGGER_SRC_CPU_FNC_PLUGIN_JIT_RISCV_JIT_X64_H__
+#define __DEBUGGER_SRC_CPU_FNC_PLUGIN_JIT_RISCV_JIT_X64_H__
+
+#include <inttypes.h>
+
+namespace debugger {
+
+/**
+ * Context passed into the compiled block. Field order is used by the
+ * generated code and must not be changed.
+ */
+struct JitContextType {
+    uint64_t *regs;         // [0] general purpose registers bank
+    uint64_t *npc;          // [8] next instruction pointer
+    void *owner;            // [16] interpreter fallback context
+    void *blk;              // [24] executing block
+    uint64_t step;          // [32] step counter before the block execution
+    void *memtlb;           // [40] JitMemTlbType table or 0 to use fallback
+    const void *resvcnt;    // [48] int number of the LR/SC reservations
+};
+
+/**
+ * Memory TLB entry of the CPU (CpuGeneric::MemTlbType) read by the
+ * compiled loads and stores. Table has JIT_MEMTLB_SIZE entries indexed by
+ * the page number.
+ */
+struct JitMemTlbType {
+    uint64_t page;          // [0] address >> JIT_MEMTLB_PAGE_BITS
+    uint8_t *ptr;           // [8] host pointer of the page or 0
+    bool readonly;          // [16]
+    bool plain;             // [17] store needs no side effects
+    uint8_t *dirty;         // [24] checkpoint page flag or 0
+};
+
+static const int JIT_MEMTLB_PAGE_BITS = 12;
+static const int JIT_MEMTLB_SIZE = 256;
+
+/**
+ * Interpreter fallback executes instruction 'idx' of the block and returns
+ * non-zero value if the compiled block should be left.
+ */
+typedef int (*jit_fallback_type)(JitContextType *ctx, int idx);
+
+/** Compiled block returns number of executed instructions */
+typedef int (*jit_block_type)(JitContextType *ctx);
+
+struct JitInstrType {
+    const char *name;       // instruction name selected by the decoder
+    uint32_t payload;
+    uint64_t pc;
+};
+
+class RiscvJitX64 {
+ public:
+    RiscvJitX64(unsigned codesz, jit_fallback_type fallback);
+    ~RiscvJitX64();
+
+    /** Host is x86-64 and executable memory was allocated */
+    bool isAvailable() { return code_ != 0; }
+
+    /**
+     * Translate instructions into the host code.
+     * @return 0 when the code buffer is full and reset() should be called.
+     */
+    jit_block_type translate(JitInstrType *instr, int cnt);
+
+    /** Drop all compiled blocks */
+    void reset();
+
+    uint64_t getNativeTotal() { return nativeTotal_; }
+    uint64_t getFallbackTotal() { return fallbackTotal_; }
+
+ private:
+    bool translateInstr(JitInstrType *instr, int idx, bool last);
+    void emitFallback(int idx, bool last);
+    void emitPrologue();
+    void emitEpilogue();
+    void emitExit(int cnt);
+    void emitSetNpc(uint64_t npc);
+
+    /** Operations with emulated registers */
+    void emitLoadReg(int hreg, int idx);
+    void emitStoreReg(int hreg, int idx);
+    void emitLoadImm(int hreg, uint64_t imm);
+
+    /** Common instruction templates */
+    void emitAluRR(int op, int rd, int rs1, int rs2, bool w);
+    void emitAluRI(int op, int rd, int rs1, uint64_t imm, bool w);
+    void emitShiftRI(int op, int rd, int rs1, unsigned shamt, bool w);
+    void emitMul(int op, int rd, int rs1, int rs2, bool w);
+    void emitBranch(int cc, int rs1, int rs2, uint64_t target, int idx);
+    void emitJump(uint64_t target, int rd, uint64_t link, int idx);
+    void emitJumpReg(int rs1, uint64_t imm, bool align, int rd,
+                     uint64_t link, int idx);
+    void emitLoad(int op, int rd, int rs1, uint64_t imm, int idx, bool last);
+    void emitStore(int sz, int rs1, int rs2, uint64_t imm, int idx,
+                   bool last);
+
+    /** Memory access through the memory TLB, misses jump to emitMiss() */
+    void emitMemEntry(int rs1, uint64_t imm, int sz, bool store);
+    void emitJccMiss(uint8_t cc);
+    void emitMiss(int idx, bool last);
+
+    void emit8(uint8_t v) { *ptr_++ = v; }
+    void emit32(uint32_t v);
+    void emit64(uint64_t v);
+
+ private:
+    static const int CODE_INSTR_MAX = 256;    // bytes per instruction reserve
+    static const int EXIT_FIXUP_MAX = 64;
+    static const int MISS_FIXUP_MAX = 8;
+
+    uint8_t *code_;
+    unsigned codesz_;
+    uint8_t *ptr_;
+    jit_fallback_type fallback_;
+
+    // Jumps to the epilogue resolved at the end of the block
+    uint8_t *fixup_[EXIT_FIXUP_MAX];
+    int fixupCnt_;
+    // Jumps to the fallback of the current memory access
+    uint8_t *miss_[MISS_FIXUP_MAX];
+    int missCnt_;
+
+    uint64_t nativeTotal_;
+    uint64_t fallbackTotal_;
+};
+
+}  // namespace debugger
+
+#endif  // __DEBUGGER_SRC_CPU_FNC_PLUGIN_JIT_RISCV_JIT_X64_H__
@@ -57,20 +57,24 @@ public:
                 // AMO always should generate Store exceptions (spike)
                 icpu_->generateException(ICpuRiscV::EXCEPTION_StoreFault, trans.addr);
             } else {
+                // Repeat if another hart modified the value after the read
                 uint64_t t;
-                trans.action = MemAction_Write;
-                trans.wstrb = (1 << trans.xsize) - 1;
-                if (rvbytes_ == 4) {
-                    t = trans.rpayload.b32[0];
-                    if (t & 0x80000000ull) {
-                        t |= EXT_SIGN_32;
+                uint64_t a = R[u.bits.rs2];
+                bool stored = false;
+                while (!stored) {
+                    if (rvbytes_ == 4) {
+                        t = trans.rpayload.b32[0];
+                        if (t & 0x80000000ull) {
+                            t |= EXT_SIGN_32;
+                        }
+                    } else {
+                        t = trans.rpayload.b64[0];
+                    }
+                    trans.wpayload.b64[0] = amo_op(a, t);
+                    if (icpu_->dma_cmpxchg(&trans, &stored) == TRANS_ERROR) {
+                        icpu_->generateException(ICpuRiscV::EXCEPTION_StoreFault, trans.addr);
+                        break;
                     }
-                } else {
-                    t = trans.rpayload.b64[0];
-                }
-                trans.wpayload.b64[0] = amo_op(R[u.bits.rs2], t);
-                if (icpu_->dma_memop(&trans) == TRANS_ERROR) {
-                    icpu_->generateException(ICpuRiscV::EXCEPTION_StoreFault, trans.addr);
                 }
                 icpu_->setReg(u.bits.rd, t);
             }
@@ -326,7 +330,7 @@ public:
                 if (t & 0x80000000ull) {
                     t |= EXT_SIGN_32;
                 }
-                icpu_->mmuAddrReserve(trans.addr);
+                icpu_->mmuAddrReserve(trans.addr, trans.rpayload.b32[0]);
                 icpu_->setReg(u.bits.rd, t);
             }
         }
@@ -353,8 +357,8 @@ public:
             if (icpu_->dma_memop(&trans) == TRANS_ERROR) {
                 icpu_->generateException(ICpuRiscV::EXCEPTION_LoadFault, trans.addr);
             } else {
-                icpu_->mmuAddrReserve(trans.addr);
-                icpu_->setReg(u.bits.rd, trans.rpayload.b32[0]);
+                icpu_->mmuAddrReserve(trans.addr, trans.rpayload.b64[0]);
+                icpu_->setReg(u.bits.rd, trans.rpayload.b64[0]);
             }
         }
         return 4;
@@ -371,18 +375,23 @@ public:
         ISA_R_type u;
         u.value = payload->buf32[0];
         bool error = 1;
-        if (icpu_->mmuAddrRelease(R[u.bits.rs1])) {
+        bool stored;
+        uint64_t loaded;
+        if (icpu_->mmuAddrRelease(R[u.bits.rs1], &loaded)) {
             trans.action = MemAction_Write;
             trans.addr = R[u.bits.rs1];
             trans.xsize = 4;
             trans.wstrb = (1 << trans.xsize) - 1;
+            trans.rpayload.b64[0] = loaded;
             trans.wpayload.b64[0] = R[u.bits.rs2];
             if (trans.addr & (trans.xsize - 1)) {
                 icpu_->generateException(ICpuRiscV::EXCEPTION_StoreMisalign, icpu_->getPC());
             } else {
-                if (icpu_->dma_memop(&trans) == TRANS_ERROR) {
+                // Fails if memory was changed after LR without breaking
+                // the reservation (store between the LR load and reserve)
+                if (icpu_->dma_cmpxchg(&trans, &stored) == TRANS_ERROR) {
                     icpu_->generateException(ICpuRiscV::EXCEPTION_StoreFault, trans.addr);
-                } else {
+                } else if (stored) {
                     error = 0;
                 }
             }
@@ -402,18 +411,23 @@ public:
         ISA_R_type u;
         u.value = payload->buf32[0];
         bool error = 1;
-        if (icpu_->mmuAddrRelease(R[u.bits.rs1])) {
+        bool stored;
+        uint64_t loaded;
+        if (icpu_->mmuAddrRelease(R[u.bits.rs1], &loaded)) {
             trans.action = MemAction_Write;
             trans.addr = R[u.bits.rs1];
             trans.xsize = 8;
             trans.wstrb = (1 << trans.xsize) - 1;
+            trans.rpayload.b64[0] = loaded;
             trans.wpayload.b64[0] = R[u.bits.rs2];
             if (trans.addr & (trans.xsize - 1)) {
                 icpu_->generateException(ICpuRiscV::EXCEPTION_StoreMisalign, icpu_->getPC());
             } else {
-                if (icpu_->dma_memop(&trans) == TRANS_ERROR) {
+                // Fails if memory was changed after LR without breaking
+                // the reservation (store between the LR load and reserve)
+                if (icpu_->dma_cmpxchg(&trans, &stored) == TRANS_ERROR) {
                     icpu_->generateException(ICpuRiscV::EXCEPTION_StoreFault, trans.addr);
-                } else {
+                } else if (stored) {
                     error = 0;
                 }
             }
@@ -19,6 +19,8 @@
 #include "api_core.h"
 #include "riscv-isa.h"
 #include "cpu_riscv_func.h"
+#include "riscv_host_fpu.h"
+#include "../socsim_plugin/fpu_func_tests.h"
 
 namespace debugger {
 
@@ -31,6 +33,34 @@ class FpuInstruction : public RiscvInstruction {
     }
 
  protected:
+    /**
+     * Rounding mode of the host FPU: instruction rm field or dynamic frm.
+     * @return false if the mode is reserved, illegal opcode is raised
+     */
+    bool hostRounding(Reg64Type *payload, uint32_t *rm) {
+        uint32_t v = (payload->buf32[0] >> 12) & 0x7;
+        if (v == 0x7) {
+            csr_fcsr_type fcsr;
+            fcsr.value = icpu_->readCSR(ICpuRiscV::CSR_fcsr);
+            v = static_cast<uint32_t>(fcsr.bits.FRM);
+        }
+        if (v > 4) {
+            icpu_->generateException(ICpuRiscV::EXCEPTION_InstrIllegal,
+                                     icpu_->getPC());
+            return false;
+        }
+        *rm = v;
+        return true;
+    }
+
+    /** Accrue exceptions of the host FPU mode into fflags */
+    void accrueFlags(uint32_t flags) {
+        if (flags) {
+            uint64_t fcsr = icpu_->readCSR(ICpuRiscV::CSR_fcsr);
+            icpu_->writeCSR(ICpuRiscV::CSR_fcsr, fcsr | flags);
+        }
+    }
+
     const int64_t BIT62 = 0x2000000000000000;
     const int64_t MSK61 = 0x1FFFFFFFFFFFFFFF;
 
@@ -922,6 +952,17 @@ class FADD_D : public FpuInstruction {
         u.value = payload->buf32[0];
         src1.val = RF[u.bits.rs1];
         src2.val = RF[u.bits.rs2];
+        if (icpu_->isHostFpu()) {
+            uint32_t rm;
+            if (!hostRounding(payload, &rm)) {
+                return 4;
+            }
+            RiscvHostFpu fpu(rm);
+            uint64_t res = fpu.add(src1.val, src2.val);
+            accrueFlags(fpu.flags());
+            icpu_->setReg(ICpuRiscV::RegFpu_Offset + u.bits.rd, res);
+            return 4;
+        }
         int except = 0;
         AddSubCompare(1, 0, 0, 0, 0, 0,
                        src1, src2, &dest, except);
@@ -944,6 +985,17 @@ class FCVT_D_L: public FpuInstruction {
         Reg64Type dest, src1;
         u.value = payload->buf32[0];
         src1.val = R[u.bits.rs1];
+        if (icpu_->isHostFpu()) {
+            uint32_t rm;
+            if (!hostRounding(payload, &rm)) {
+                return 4;
+            }
+            RiscvHostFpu fpu(rm);
+            uint64_t res = fpu.fromInt(src1.val, true, false);
+            accrueFlags(fpu.flags());
+            icpu_->setReg(ICpuRiscV::RegFpu_Offset + u.bits.rd, res);
+            return 4;
+        }
         Int2Double(1, 0, src1, &dest);
         //dest.f64 = static_cast<double>(src1.ival);
         icpu_->setReg(ICpuRiscV::RegFpu_Offset + u.bits.rd, dest.val);
@@ -964,6 +1016,17 @@ class FCVT_D_LU: public FpuInstruction {
         Reg64Type dest, src1;
         u.value = payload->buf32[0];
         src1.val = R[u.bits.rs1];
+        if (icpu_->isHostFpu()) {
+            uint32_t rm;
+            if (!hostRounding(payload, &rm)) {
+                return 4;
+            }
+            RiscvHostFpu fpu(rm);
+            uint64_t res = fpu.fromInt(src1.val, false, false);
+            accrueFlags(fpu.flags());
+            icpu_->setReg(ICpuRiscV::RegFpu_Offset + u.bits.rd, res);
+            return 4;
+        }
         Int2Double(0, 0, src1, &dest);
         //dest.f64 = static_cast<double>(src1.val);
         icpu_->setReg(ICpuRiscV::RegFpu_Offset + u.bits.rd, dest.val);
@@ -984,6 +1047,17 @@ class FCVT_D_W: public FpuInstruction {
         Reg64Type dest, src1;
         u.value = payload->buf32[0];
         src1.val = R[u.bits.rs1];
+        if (icpu_->isHostFpu()) {
+            uint32_t rm;
+            if (!hostRounding(payload, &rm)) {
+                return 4;
+            }
+            RiscvHostFpu fpu(rm);
+            uint64_t res = fpu.fromInt(src1.val, true, true);
+            accrueFlags(fpu.flags());
+            icpu_->setReg(ICpuRiscV::RegFpu_Offset + u.bits.rd, res);
+            return 4;
+        }
         Int2Double(1, 1, src1, &dest);
         //dest.f64 = static_cast<double>(static_cast<int>(src1.buf32[0]));
         icpu_->setReg(ICpuRiscV::RegFpu_Offset + u.bits.rd, dest.val);
@@ -1004,6 +1078,17 @@ class FCVT_D_WU: public FpuInstruction {
         Reg64Type dest, src1;
         u.value = payload->buf32[0];
         src1.val = R[u.bits.rs1];
+        if (icpu_->isHostFpu()) {
+            uint32_t rm;
+            if (!hostRounding(payload, &rm)) {
+                return 4;
+            }
+            RiscvHostFpu fpu(rm);
+            uint64_t res = fpu.fromInt(src1.val, false, true);
+            accrueFlags(fpu.flags());
+            icpu_->setReg(ICpuRiscV::RegFpu_Offset + u.bits.rd, res);
+            return 4;
+        }
         Int2Double(0, 1, src1, &dest);
         //dest.f64 = static_cast<double>(src1.buf32[0]);
         icpu_->setReg(ICpuRiscV::RegFpu_Offset + u.bits.rd, dest.val);
@@ -1024,6 +1109,17 @@ class FCVT_L_D: public FpuInstruction {
         Reg64Type dest, src1;
         u.value = payload->buf32[0];
         src1.val = RF[u.bits.rs1];
+        if (icpu_->isHostFpu()) {
+            uint32_t rm;
+            if (!hostRounding(payload, &rm)) {
+                return 4;
+            }
+            RiscvHostFpu fpu(rm);
+            uint64_t res = fpu.toInt(src1.val, true, false);
+            accrueFlags(fpu.flags());
+            icpu_->setReg(u.bits.rd, res);
+            return 4;
+        }
         int ovr, und;
         Double2Int(1, 0, src1, &dest, ovr, und);
         //dest.ival = static_cast<int64_t>(src1.f64);
@@ -1045,6 +1141,17 @@ class FCVT_LU_D : public FpuInstruction {
         Reg64Type dest, src1;
         u.value = payload->buf32[0];
         src1.val = RF[u.bits.rs1];
+        if (icpu_->isHostFpu()) {
+            uint32_t rm;
+            if (!hostRounding(payload, &rm)) {
+                return 4;
+            }
+            RiscvHostFpu fpu(rm);
+            uint64_t res = fpu.toInt(src1.val, false, false);
+            accrueFlags(fpu.flags());
+            icpu_->setReg(u.bits.rd, res);
+            return 4;
+        }
         int ovr, und;
         Double2Int(0, 0, src1, &dest, ovr, und);
         //dest.val = static_cast<uint64_t>(src1.f64);
@@ -1066,6 +1173,17 @@ class FCVT_W_D : public FpuInstruction {
         Reg64Type dest, src1;
         u.value = payload->buf32[0];
         src1.val = RF[u.bits.rs1];
+        if (icpu_->isHostFpu()) {
+            uint32_t rm;
+            if (!hostRounding(payload, &rm)) {
+                return 4;
+            }
+            RiscvHostFpu fpu(rm);
+            uint64_t res = fpu.toInt(src1.val, true, true);
+            accrueFlags(fpu.flags());
+            icpu_->setReg(u.bits.rd, res);
+            return 4;
+        }
         int ovr, und;
         Double2Int(1, 1, src1, &dest, ovr, und);
         //dest.ival = static_cast<int32_t>(src1.f64);
@@ -1087,6 +1205,17 @@ class FCVT_WU_D : public FpuInstruction {
         Reg64Type dest, src1;
         u.value = payload->buf32[0];
         src1.val = RF[u.bits.rs1];
+        if (icpu_->isHostFpu()) {
+            uint32_t rm;
+            if (!hostRounding(payload, &rm)) {
+                return 4;
+            }
+            RiscvHostFpu fpu(rm);
+            uint64_t res = fpu.toInt(src1.val, false, true);
+            accrueFlags(fpu.flags());
+            icpu_->setReg(u.bits.rd, res);
+            return 4;
+        }
         int ovr, und;
         Double2Int(0, 1, src1, &dest, ovr, und);
         //dest.val = static_cast<uint32_t>(src1.f64);
@@ -1110,6 +1239,18 @@ class FDIV_D : public FpuInstruction {
         A.val = RF[u.bits.rs1];
         B.val = RF[u.bits.rs2];
 
+        if (icpu_->isHostFpu()) {
+            uint32_t rm;
+            if (!hostRounding(payload, &rm)) {
+                return 4;
+            }
+            RiscvHostFpu fpu(rm);
+            uint64_t res = fpu.div(A.val, B.val);
+            accrueFlags(fpu.flags());
+            icpu_->setReg(ICpuRiscV::RegFpu_Offset + u.bits.rd, res);
+            return 4;
+        }
+
         uint64_t zeroA = !A.f64bits.exp && !A.f64bits.mant ? 1: 0;
         uint64_t zeroB = !B.f64bits.exp && !B.f64bits.mant ? 1: 0;
 
@@ -1264,6 +1405,13 @@ class FEQ_D : public FpuInstruction {
         u.value = payload->buf32[0];
         src1.val = RF[u.bits.rs1];
         src2.val = RF[u.bits.rs2];
+        if (icpu_->isHostFpu()) {
+            RiscvHostFpu fpu(0);
+            uint64_t res = fpu.eq(src1.val, src2.val);
+            accrueFlags(fpu.flags());
+            icpu_->setReg(u.bits.rd, res);
+            return 4;
+        }
         AddSubCompare(0, 0, 1, 1, 0, 0, src1, src2, &dest, except);
         if (src1.f64bits.exp == 0x7FF || src2.f64bits.exp == 0x7FF) {
             /** Do not cause trap, only signal Invalid Operation */
@@ -1330,6 +1478,13 @@ class FLE_D : public FpuInstruction {
         u.value = payload->buf32[0];
         src1.val = RF[u.bits.rs1];
         src2.val = RF[u.bits.rs2];
+        if (icpu_->isHostFpu()) {
+            RiscvHostFpu fpu(0);
+            uint64_t res = fpu.le(src1.val, src2.val);
+            accrueFlags(fpu.flags());
+            icpu_->setReg(u.bits.rd, res);
+            return 4;
+        }
         AddSubCompare(0, 0, 1, 1, 0, 1, src1, src2, &dest, except);
         if (src1.f64bits.exp == 0x7FF || src2.f64bits.exp == 0x7FF) {
             /** Do not cause trap, only signal Invalid Operation */
@@ -1362,6 +1517,13 @@ class FLT_D : public FpuInstruction {
         u.value = payload->buf32[0];
         src1.val = RF[u.bits.rs1];
         src2.val = RF[u.bits.rs2];
+        if (icpu_->isHostFpu()) {
+            RiscvHostFpu fpu(0);
+            uint64_t res = fpu.lt(src1.val, src2.val);
+            accrueFlags(fpu.flags());
+            icpu_->setReg(u.bits.rd, res);
+            return 4;
+        }
         AddSubCompare(0, 0, 1, 0, 0, 1, src1, src2, &dest, except);
         if (src1.f64bits.exp == 0x7FF || src2.f64bits.exp == 0x7FF) {
             /** Do not cause trap, only signal Invalid Operation */
@@ -1393,6 +1555,13 @@ class FMAX_D : public FpuInstruction {
         u.value = payload->buf32[0];
         src1.val = RF[u.bits.rs1];
         src2.val = RF[u.bits.rs2];
+        if (icpu_->isHostFpu()) {
+            RiscvHostFpu fpu(0);
+            uint64_t res = fpu.max(src1.val, src2.val);
+            accrueFlags(fpu.flags());
+            icpu_->setReg(ICpuRiscV::RegFpu_Offset + u.bits.rd, res);
+            return 4;
+        }
         AddSubCompare(0, 0, 0, 0, 1, 0, src1, src2, &dest, except);
         //dest.f64 = src1.f64 > src2.f64 ? src1.f64: src2.f64;
         icpu_->setReg(ICpuRiscV::RegFpu_Offset + u.bits.rd, dest.val);
@@ -1415,6 +1584,13 @@ class FMIN_D : public FpuInstruction {
         u.value = payload->buf32[0];
         src1.val = RF[u.bits.rs1];
         src2.val = RF[u.bits.rs2];
+        if (icpu_->isHostFpu()) {
+            RiscvHostFpu fpu(0);
+            uint64_t res = fpu.min(src1.val, src2.val);
+            accrueFlags(fpu.flags());
+            icpu_->setReg(ICpuRiscV::RegFpu_Offset + u.bits.rd, res);
+            return 4;
+        }
         AddSubCompare(0, 0, 0, 0, 0, 1, src1, src2, &dest, except);
         //dest.f64 = src1.f64 < src2.f64 ? src1.f64: src2.f64;
         icpu_->setReg(ICpuRiscV::RegFpu_Offset + u.bits.rd, dest.val);
@@ -1473,6 +1649,18 @@ class FMUL_D : public FpuInstruction {
         A.val = RF[u.bits.rs1];
         B.val = RF[u.bits.rs2];
 
+        if (icpu_->isHostFpu()) {
+            uint32_t rm;
+            if (!hostRounding(payload, &rm)) {
+                return 4;
+            }
+            RiscvHostFpu fpu(rm);
+            uint64_t res = fpu.mul(A.val, B.val);
+            accrueFlags(fpu.flags());
+            icpu_->setReg(ICpuRiscV::RegFpu_Offset + u.bits.rd, res);
+            return 4;
+        }
+
         uint64_t zeroA = !A.f64bits.exp && !A.f64bits.mant ? 1: 0;
         uint64_t zeroB = !B.f64bits.exp && !B.f64bits.mant ? 1: 0;
 
@@ -1646,6 +1834,17 @@ class FSUB_D : public FpuInstruction {
         u.value = payload->buf32[0];
         src1.val = RF[u.bits.rs1];
         src2.val = RF[u.bits.rs2];
+        if (icpu_->isHostFpu()) {
+            uint32_t rm;
+            if (!hostRounding(payload, &rm)) {
+                return 4;
+            }
+            RiscvHostFpu fpu(rm);
+            uint64_t res = fpu.sub(src1.val, src2.val);
+            accrueFlags(fpu.flags());
+            icpu_->setReg(ICpuRiscV::RegFpu_Offset + u.bits.rd, res);
+            return 4;
+        }
         AddSubCompare(0, 1, 0, 0, 0, 0, src1, src2, &dest, except);
         //dest.f64 = src1.f64 - src2.f64;
         icpu_->setReg(ICpuRiscV::RegFpu_Offset + u.bits.rd, dest.val);
@@ -1681,6 +1880,123 @@ void CpuRiver_Functional::addIsaExtensionD() {
     writeCSR(ICpuRiscV::CSR_misa, isa);
 }
 
+/**
+ * Both modes are executed through the instruction implementations on the
+ * vectors of the FPU model unit-test. Different values with NaN or
+ * infinity operands, NaN results and invalid conversions are counted
+ * separately: the model doesn't generate the RISC-V canonical NaN and
+ * doesn't saturate integer results.
+ */
+void CpuRiver_Functional::testHostFpu(AttributeType *res) {
+    struct FpuTestType {
+        RiscvInstruction *instr;
+        uint32_t rm;            // funct3: RTZ for conversions as the model
+        bool intsrc;
+        bool intdst;
+        const uint64_t *in;
+        size_t total;
+    } tests[] = {
+        {new FADD_D(this), 0, false, false, &TestCases_FADD_D[0][0],
+            sizeof(TestCases_FADD_D) / sizeof(uint64_t) / 2},
+        {new FSUB_D(this), 0, false, false, &TestCases_FSUB_D[0][0],
+            sizeof(TestCases_FSUB_D) / sizeof(uint64_t) / 2},
+        {new FMUL_D(this), 0, false, false, &TestCases_FMUL_D[0][0],
+            sizeof(TestCases_FMUL_D) / sizeof(uint64_t) / 2},
+        {new FDIV_D(this), 0, false, false, &TestCases_FDIV_D[0][0],
+            sizeof(TestCases_FDIV_D) / sizeof(uint64_t) / 2},
+        {new FMIN_D(this), 0, false, false, &TestCases_FCMP_D[0][0],
+            sizeof(TestCases_FCMP_D) / sizeof(uint64_t) / 2},
+        {new FMAX_D(this), 1, false, false, &TestCases_FCMP_D[0][0],
+            sizeof(TestCases_FCMP_D) / sizeof(uint64_t) / 2},
+        {new FEQ_D(this), 2, false, true, &TestCases_FCMP_D[0][0],
+            sizeof(TestCases_FCMP_D) / sizeof(uint64_t) / 2},
+        {new FLT_D(this), 1, false, true, &TestCases_FCMP_D[0][0],
+            sizeof(TestCases_FCMP_D) / sizeof(uint64_t) / 2},
+        {new FLE_D(this), 0, false, true, &TestCases_FCMP_D[0][0],
+            sizeof(TestCases_FCMP_D) / sizeof(uint64_t) / 2},
+        {new FCVT_D_L(this), 0, true, false, &TestCases_FCVT_D_L[0][0],
+            sizeof(TestCases_FCVT_D_L) / sizeof(uint64_t) / 2},
+        {new FCVT_D_LU(this), 0, true, false, &TestCases_FCVT_D_L[0][0],
+            sizeof(TestCases_FCVT_D_L) / sizeof(uint64_t) / 2},
+        {new FCVT_D_W(this), 0, true, false, &TestCases_FCVT_D_W[0][0],
+            sizeof(TestCases_FCVT_D_W) / sizeof(uint64_t) / 2},
+        {new FCVT_D_WU(this), 0, true, false, &TestCases_FCVT_D_W[0][0],
+            sizeof(TestCases_FCVT_D_W) / sizeof(uint64_t) / 2},
+        {new FCVT_L_D(this), 1, false, true, &TestCases_FCVT_L_D[0][0],
+            sizeof(TestCases_FCVT_L_D) / sizeof(uint64_t) / 2},
+        {new FCVT_LU_D(this), 1, false, true, &TestCases_FCVT_L_D[0][0],
+            sizeof(TestCases_FCVT_L_D) / sizeof(uint64_t) / 2},
+        {new FCVT_W_D(this), 1, false, true, &TestCases_FCVT_W_D[0][0],
+            sizeof(TestCases_FCVT_W_D) / sizeof(uint64_t) / 2},
+        {new FCVT_WU_D(this), 1, false, true, &TestCases_FCVT_W_D[0][0],
+            sizeof(TestCases_FCVT_W_D) / sizeof(uint64_t) / 2},
+    };
+    const int TEST_TOTAL = static_cast<int>(sizeof(tests) / sizeof(tests[0]));
+    uint64_t *RF = &R[RegFpu_Offset];
+    uint64_t saveR[4], saveRF[4];
+    uint64_t savefcsr = portCSR_.read(CSR_fcsr).val;
+    bool saveHost = hostFpuEna_;
+    memcpy(saveR, R, sizeof(saveR));
+    memcpy(saveRF, RF, sizeof(saveRF));
+
+    res->make_list(TEST_TOTAL);
+    for (int n = 0; n < TEST_TOTAL; n++) {
+        FpuTestType *t = &tests[n];
+        Reg64Type payload;
+        Reg64Type A, B;
+        uint64_t out[2], flags[2];
+        int difval = 0, difspecial = 0, difflags = 0;
+        // rd = 3, rs1 = 1, rs2 = 2
+        payload.val = t->instr->opcode() | (3 << 7) | (t->rm << 12)
+                    | (1 << 15) | (2 << 20);
+        for (size_t i = 0; i < t->total; i++) {
+            A.val = t->in[2*i];
+            B.val = t->in[2*i + 1];
+            for (int k = 0; k < 2; k++) {
+                hostFpuEna_ = k != 0;
+                portCSR_.write(CSR_fcsr, 0);
+                R[1] = RF[1] = A.val;
+                RF[2] = B.val;
+                R[3] = RF[3] = 0;
+                t->instr->exec(&payload);
+                out[k] = t->intdst ? R[3] : RF[3];
+                flags[k] = portCSR_.read(CSR_fcsr).val & 0x1F;
+            }
+            if (flags[0] != flags[1]) {
+                difflags++;
+            }
+            if (out[0] == out[1]) {
+                continue;
+            }
+            if ((!t->intsrc && (A.f64bits.exp == 0x7FF
+                                || B.f64bits.exp == 0x7FF))
+                || (!t->intdst && out[1] == RiscvHostFpu::CANONICAL_NAN)
+                || (t->intdst && (flags[1] & 0x10))) {
+                difspecial++;
+                continue;
+            }
+            difval++;
+            RISCV_info("[%d] %s %016" RV_PRI64 "x; %016" RV_PRI64 "x => "
+                       "model %016" RV_PRI64 "x != host %016" RV_PRI64 "x",
+                       static_cast<int>(i), t->instr->name(),
+                       A.val, B.val, out[0], out[1]);
+        }
+        AttributeType &item = (*res)[n];
+        item.make_list(5);
+        item[0u].make_string(t->instr->name());
+        item[1].make_uint64(t->total);
+        item[2].make_uint64(difval);
+        item[3].make_uint64(difspecial);
+        item[4].make_uint64(difflags);
+        delete t->instr;
+    }
+
+    hostFpuEna_ = saveHost;
+    portCSR_.write(CSR_fcsr, savefcsr);
+    memcpy(R, saveR, sizeof(saveR));
+    memcpy(RF, saveRF, sizeof(saveRF));
+}
+
 void CpuRiver_Functional::addIsaExtensionF() {
     // TODO
     /*
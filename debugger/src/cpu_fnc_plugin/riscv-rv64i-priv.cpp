@@ -252,6 +252,7 @@ public:
         mstatus.bits.SPIE = 1;
         icpu_->setPrvLevel(mstatus.bits.SPP);
         mstatus.bits.SPP = ICpuRiscV::PRV_U;
+        mstatus.bits.MPRV = 0;
             
         icpu_->writeCSR(ICpuRiscV::CSR_mstatus, mstatus.value);
         return 4;
@@ -309,6 +310,9 @@ public:
         mstatus.bits.MIE = mstatus.bits.MPIE;
         mstatus.bits.MPIE = 1;
         icpu_->setPrvLevel(mstatus.bits.MPP);
+        if (mstatus.bits.MPP != ICpuRiscV::PRV_M) {
+            mstatus.bits.MPRV = 0;
+        }
         mstatus.bits.MPP = ICpuRiscV::PRV_U;
 
         icpu_->writeCSR(ICpuRiscV::CSR_mstatus, mstatus.value);
@@ -335,7 +339,8 @@ public:
 /** 
  * @brief FENCE_I (memory barrier)
  *
- * Not used in functional model so that cache is not modeling.
+ * Code could be written by other harts or by DMA, so that all decoded
+ * instructions and blocks are dropped.
  */
 class FENCE_I : public RiscvInstruction {
 public:
@@ -343,6 +348,48 @@ public:
         RiscvInstruction(icpu, "FENCE_I", "?????????????????001?????0001111") {}
 
     virtual int exec(Reg64Type *payload) {
+        icpu_->flush(~0ull);
+        return 4;
+    }
+};
+
+/**
+ * @brief SFENCE.VMA (address translation cache flush)
+ *
+ * rs1 = x0 flushes all virtual addresses, rs2 = x0 flushes all ASIDs.
+ */
+class SFENCE_VMA : public RiscvInstruction {
+public:
+    SFENCE_VMA(CpuRiver_Functional *icpu) :
+        RiscvInstruction(icpu, "SFENCE_VMA", "0001001??????????000000001110011") {}
+
+    virtual int exec(Reg64Type *payload) {
+        ISA_R_type u;
+        u.value = payload->buf32[0];
+        if (icpu_->getPrvLevel() == ICpuRiscV::PRV_U) {
+            icpu_->generateException(ICpuRiscV::EXCEPTION_InstrIllegal, icpu_->getPC());
+            return 4;
+        }
+        icpu_->flushTlb(R[u.bits.rs1], R[u.bits.rs2],
+                        u.bits.rs1 == 0, u.bits.rs2 == 0);
+        return 4;
+    }
+};
+
+/**
+ * @brief WFI (wait for interrupt)
+ *
+ * Step counter moves to the next clock event if there's no enabled
+ * interrupt request. Otherwise (or when fast-forward is disabled) it is
+ * executed as NOP which is allowed by the specification.
+ */
+class WFI : public RiscvInstruction {
+public:
+    WFI(CpuRiver_Functional *icpu) :
+        RiscvInstruction(icpu, "WFI", "00010000010100000000000001110011") {}
+
+    virtual int exec(Reg64Type *payload) {
+        icpu_->waitForInterrupt();
         return 4;
     }
 };
@@ -383,6 +430,9 @@ public:
         case ICpuRiscV::PRV_M:
             icpu_->generateException(ICpuRiscV::EXCEPTION_CallFromMmode, icpu_->getPC());
             break;
+        case ICpuRiscV::PRV_S:
+            icpu_->generateException(ICpuRiscV::EXCEPTION_CallFromSmode, icpu_->getPC());
+            break;
         case ICpuRiscV::PRV_U:
             icpu_->generateException(ICpuRiscV::EXCEPTION_CallFromUmode, icpu_->getPC());
             break;
@@ -408,12 +458,12 @@ void CpuRiver_Functional::addIsaPrivilegedRV64I() {
     addSupportedInstruction(new FENCE_I(this));
     addSupportedInstruction(new ECALL(this));
     addSupportedInstruction(new EBREAK(this));
+    addSupportedInstruction(new WFI(this));
+    addSupportedInstruction(new SFENCE_VMA(this));
 
     // TODO:
     /*
   def DRET               = BitPat("b01111011001000000000000001110011")
-  def SFENCE_VMA         = BitPat("b0001001??????????000000001110011")
-  def WFI                = BitPat("b00010000010100000000000001110011")  // wait for interrupt
 
     def RDCYCLE            = BitPat("b11000000000000000010?????1110011")
     def RDTIME             = BitPat("b11000000000100000010?????1110011")
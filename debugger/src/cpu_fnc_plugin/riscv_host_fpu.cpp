@@ -0,0 +1,290 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <string.h>
+#include "riscv_host_fpu.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#define HOST_FPU_SSE
+#include <xmmintrin.h>
+#else
+#include <cfenv>
+#endif
+
+namespace debugger {
+
+// RISC-V fflags bits
+static const uint32_t FFLAG_NX = 0x01;
+static const uint32_t FFLAG_UF = 0x02;
+static const uint32_t FFLAG_OF = 0x04;
+static const uint32_t FFLAG_DZ = 0x08;
+static const uint32_t FFLAG_NV = 0x10;
+
+#ifdef HOST_FPU_SSE
+// MXCSR: [5:0] flags IE,DE,ZE,OE,UE,PE; [6] DAZ; [12:7] masks;
+//        [14:13] rounding control; [15] FTZ
+static const uint32_t MXCSR_FLAGS = 0x003F;
+static const uint32_t MXCSR_MASKS = 0x1F80;
+static const uint32_t MXCSR_RC = 0x6000;
+static const uint32_t MXCSR_DAZ_FTZ = 0x8040;
+// RNE, RTZ, RDN, RUP, RMM -> RC field
+static const uint32_t MXCSR_RMODE[5] = {0x0000, 0x6000, 0x2000, 0x4000, 0x0000};
+#else
+static const int FENV_RMODE[5] = {
+    FE_TONEAREST, FE_TOWARDZERO, FE_DOWNWARD, FE_UPWARD, FE_TONEAREST
+};
+#endif
+
+static double toDouble(uint64_t a) {
+    double ret;
+    memcpy(&ret, &a, sizeof(ret));
+    return ret;
+}
+
+static uint64_t toBits(double a) {
+    uint64_t ret;
+    memcpy(&ret, &a, sizeof(ret));
+    return ret;
+}
+
+RiscvHostFpu::RiscvHostFpu(uint32_t rm) {
+    flags_ = 0;
+    if (rm > 4) {
+        rm = 0;
+    }
+#ifdef HOST_FPU_SSE
+    saved_ = _mm_getcsr();
+    _mm_setcsr((saved_ & ~(MXCSR_FLAGS | MXCSR_RC | MXCSR_DAZ_FTZ))
+               | MXCSR_MASKS | MXCSR_RMODE[rm]);
+#else
+    saved_ = static_cast<uint32_t>(fegetround());
+    fesetround(FENV_RMODE[rm]);
+    feclearexcept(FE_ALL_EXCEPT);
+#endif
+}
+
+RiscvHostFpu::~RiscvHostFpu() {
+#ifdef HOST_FPU_SSE
+    _mm_setcsr(saved_);
+#else
+    fesetround(static_cast<int>(saved_));
+#endif
+}
+
+uint32_t RiscvHostFpu::flags() {
+    uint32_t ret = flags_;
+#ifdef HOST_FPU_SSE
+    uint32_t csr = _mm_getcsr();
+    ret |= (csr & 0x01) ? FFLAG_NV : 0;
+    ret |= (csr & 0x04) ? FFLAG_DZ : 0;
+    ret |= (csr & 0x08) ? FFLAG_OF : 0;
+    ret |= (csr & 0x10) ? FFLAG_UF : 0;
+    ret |= (csr & 0x20) ? FFLAG_NX : 0;
+#else
+    int e = fetestexcept(FE_ALL_EXCEPT);
+    ret |= (e & FE_INVALID) ? FFLAG_NV : 0;
+    ret |= (e & FE_DIVBYZERO) ? FFLAG_DZ : 0;
+    ret |= (e & FE_OVERFLOW) ? FFLAG_OF : 0;
+    ret |= (e & FE_UNDERFLOW) ? FFLAG_UF : 0;
+    ret |= (e & FE_INEXACT) ? FFLAG_NX : 0;
+#endif
+    return ret;
+}
+
+/**
+ * Operands and results are volatile so that the compiler doesn't fold
+ * or move arithmetic out of the scope of the modified control register.
+ */
+uint64_t RiscvHostFpu::add(uint64_t a, uint64_t b) {
+    volatile double x = toDouble(a);
+    volatile double y = toDouble(b);
+    volatile double r = x + y;
+    return canonical(toBits(r));
+}
+
+uint64_t RiscvHostFpu::sub(uint64_t a, uint64_t b) {
+    volatile double x = toDouble(a);
+    volatile double y = toDouble(b);
+    volatile double r = x - y;
+    return canonical(toBits(r));
+}
+
+uint64_t RiscvHostFpu::mul(uint64_t a, uint64_t b) {
+    volatile double x = toDouble(a);
+    volatile double y = toDouble(b);
+    volatile double r = x * y;
+    return canonical(toBits(r));
+}
+
+uint64_t RiscvHostFpu::div(uint64_t a, uint64_t b) {
+    volatile double x = toDouble(a);
+    volatile double y = toDouble(b);
+    volatile double r = x / y;
+    return canonical(toBits(r));
+}
+
+uint64_t RiscvHostFpu::fromInt(uint64_t a, bool sign, bool w32) {
+    volatile double r;
+    if (w32) {
+        // Always exact
+        if (sign) {
+            r = static_cast<double>(static_cast<int32_t>(a));
+        } else {
+            r = static_cast<double>(static_cast<uint32_t>(a));
+        }
+    } else {
+        if (sign) {
+            volatile int64_t v = static_cast<int64_t>(a);
+            r = static_cast<double>(v);
+        } else {
+            volatile uint64_t v = a;
+            r = static_cast<double>(v);
+        }
+    }
+    return toBits(r);
+}
+
+/**
+ * Rounding to integral uses the host adder in the current rounding mode,
+ * range checks and flags are in software: out of range and NaN inputs
+ * raise only NV and return the saturated value.
+ */
+uint64_t RiscvHostFpu::toInt(uint64_t a, bool sign, bool w32) {
+    const double TWO52 = 4503599627370496.0;
+    const double TWO63 = 9223372036854775808.0;
+    const double TWO64 = 18446744073709551616.0;
+    double x = toDouble(a);
+    volatile double r = x;
+    if (!isNan(a) && (a & 0x7ff0000000000000ull) < 0x4330000000000000ull) {
+        // |x| < 2^52: fraction is removed by the host rounding
+        volatile double t;
+        if (x >= 0) {
+            t = x + TWO52;
+            r = t - TWO52;
+        } else {
+            t = x - TWO52;
+            r = t + TWO52;
+        }
+    }
+#ifdef HOST_FPU_SSE
+    _mm_setcsr(_mm_getcsr() & ~MXCSR_FLAGS);
+#else
+    feclearexcept(FE_ALL_EXCEPT);
+#endif
+
+    double hi, lo;
+    if (w32) {
+        hi = sign ? 2147483647.0 : 4294967295.0;
+        lo = sign ? -2147483648.0 : 0.0;
+    } else {
+        hi = sign ? TWO63 : TWO64;      // exclusive
+        lo = sign ? -TWO63 : 0.0;
+    }
+    bool neg = (a >> 63) != 0;
+    uint64_t ret;
+    if (isNan(a) || (!neg && (w32 ? r > hi : r >= hi))) {
+        flags_ |= FFLAG_NV;
+        if (w32) {
+            ret = sign ? 0x7fffffffull : 0xffffffffull;
+        } else {
+            ret = sign ? 0x7fffffffffffffffull : ~0ull;
+        }
+    } else if (r < lo) {
+        flags_ |= FFLAG_NV;
+        if (w32) {
+            ret = sign ? 0x80000000ull : 0;
+        } else {
+            ret = sign ? 0x8000000000000000ull : 0;
+        }
+    } else {
+        if (r != x) {
+            flags_ |= FFLAG_NX;
+        }
+        if (sign) {
+            ret = static_cast<uint64_t>(static_cast<int64_t>(r));
+        } else {
+            ret = static_cast<uint64_t>(r);
+        }
+    }
+    if (w32) {
+        // RV64 keeps 32-bits results sign extended
+        ret = static_cast<uint64_t>(static_cast<int64_t>(
+                static_cast<int32_t>(ret)));
+    }
+    return ret;
+}
+
+uint64_t RiscvHostFpu::eq(uint64_t a, uint64_t b) {
+    if (isSNan(a) || isSNan(b)) {
+        flags_ |= FFLAG_NV;
+    }
+    if (isNan(a) || isNan(b)) {
+        return 0;
+    }
+    return toDouble(a) == toDouble(b) ? 1 : 0;
+}
+
+uint64_t RiscvHostFpu::lt(uint64_t a, uint64_t b) {
+    if (isNan(a) || isNan(b)) {
+        flags_ |= FFLAG_NV;
+        return 0;
+    }
+    return toDouble(a) < toDouble(b) ? 1 : 0;
+}
+
+uint64_t RiscvHostFpu::le(uint64_t a, uint64_t b) {
+    if (isNan(a) || isNan(b)) {
+        flags_ |= FFLAG_NV;
+        return 0;
+    }
+    return toDouble(a) <= toDouble(b) ? 1 : 0;
+}
+
+uint64_t RiscvHostFpu::min(uint64_t a, uint64_t b) {
+    if (isSNan(a) || isSNan(b)) {
+        flags_ |= FFLAG_NV;
+    }
+    if (isNan(a)) {
+        return canonical(b);
+    } else if (isNan(b)) {
+        return a;
+    }
+    double x = toDouble(a);
+    double y = toDouble(b);
+    if (x == y) {
+        return a | b;           // -0.0 is less than +0.0
+    }
+    return x < y ? a : b;
+}
+
+uint64_t RiscvHostFpu::max(uint64_t a, uint64_t b) {
+    if (isSNan(a) || isSNan(b)) {
+        flags_ |= FFLAG_NV;
+    }
+    if (isNan(a)) {
+        return canonical(b);
+    } else if (isNan(b)) {
+        return a;
+    }
+    double x = toDouble(a);
+    double y = toDouble(b);
+    if (x == y) {
+        return a & b;
+    }
+    return x > y ? a : b;
+}
+
+}  // namespace debugger
@@ -0,0 +1,76 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef __DEBUGGER_SRC_CPU_FNC_PLUGIN_RISCV_HOST_FPU_H__
+#define __DEBUGGER_SRC_CPU_FNC_PLUGIN_RISCV_HOST_FPU_H__
+
+#include <inttypes.h>
+
+namespace debugger {
+
+/**
+ * Double precision operations executed by the host FPU (SSE2 on x86-64).
+ *
+ * Object lifetime is the scope of one instruction: constructor switches
+ * the host rounding mode to the RISC-V one and clears the host exception
+ * flags, destructor restores the host control register. Results are
+ * returned with the RISC-V canonical NaN, integer conversions saturate
+ * as required by the ISA. Host has no round-to-nearest-max-magnitude mode
+ * so that RMM is executed as RNE.
+ */
+class RiscvHostFpu {
+ public:
+    /** @param rm RISC-V rounding mode 0..4 (already resolved from frm) */
+    explicit RiscvHostFpu(uint32_t rm);
+    ~RiscvHostFpu();
+
+    uint64_t add(uint64_t a, uint64_t b);
+    uint64_t sub(uint64_t a, uint64_t b);
+    uint64_t mul(uint64_t a, uint64_t b);
+    uint64_t div(uint64_t a, uint64_t b);
+    uint64_t fromInt(uint64_t a, bool sign, bool w32);
+    uint64_t toInt(uint64_t a, bool sign, bool w32);
+
+    /** Comparisons and min/max follow RISC-V NaN rules in software */
+    uint64_t eq(uint64_t a, uint64_t b);
+    uint64_t lt(uint64_t a, uint64_t b);
+    uint64_t le(uint64_t a, uint64_t b);
+    uint64_t min(uint64_t a, uint64_t b);
+    uint64_t max(uint64_t a, uint64_t b);
+
+    /** Accrued exceptions in the fflags format: NV,DZ,OF,UF,NX */
+    uint32_t flags();
+
+    static const uint64_t CANONICAL_NAN = 0x7ff8000000000000ull;
+
+ private:
+    static bool isNan(uint64_t a) {
+        return (a & 0x7fffffffffffffffull) > 0x7ff0000000000000ull;
+    }
+    static bool isSNan(uint64_t a) {
+        return isNan(a) && !(a & 0x0008000000000000ull);
+    }
+    static uint64_t canonical(uint64_t a) {
+        return isNan(a) ? CANONICAL_NAN : a;
+    }
+
+    uint32_t saved_;        // host control register before the instruction
+    uint32_t flags_;        // exceptions of the software parts
+};
+
+}  // namespace debugger
+
+#endif  // __DEBUGGER_SRC_CPU_FNC_PLUGIN_RISCV_HOST_FPU_H__
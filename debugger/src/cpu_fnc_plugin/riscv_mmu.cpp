@@ -0,0 +1,243 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <string.h>
+#include "riscv_mmu.h"
+
+namespace debugger {
+
+RiscvMmu::RiscvMmu() {
+    ibus_ = 0;
+    busid_ = 0;
+    satp_ = 0;
+    mode_ = 0;
+    asid_ = 0;
+    root_ = 0;
+    sum_ = false;
+    mxr_ = false;
+    l0_ = new L0EntryType[2][Access_Total][L0_SIZE];
+    l1_ = new L1EntryType[L1_SETS * L1_WAYS];
+    memset(l1_, 0, L1_SETS * L1_WAYS * sizeof(L1EntryType));
+    l1next_ = new uint8_t[L1_SETS];
+    memset(l1next_, 0, L1_SETS);
+    memset(stat_, 0, sizeof(stat_));
+    flushL0();
+    flushCnt_ = 0;
+}
+
+RiscvMmu::~RiscvMmu() {
+    delete [] l0_;
+    delete [] l1_;
+    delete [] l1next_;
+}
+
+void RiscvMmu::setContext(uint64_t satp, bool sum, bool mxr) {
+    if (satp == satp_ && sum == sum_ && mxr == mxr_) {
+        return;
+    }
+    satp_ = satp;
+    mode_ = satp >> 60;
+    asid_ = (satp >> 44) & 0xFFFF;
+    root_ = (satp & ((1ull << 44) - 1)) << PAGE_BITS;
+    sum_ = sum;
+    mxr_ = mxr;
+    flushL0();
+}
+
+void RiscvMmu::flushL0() {
+    // vpn = ~0 marks all entries as invalid
+    memset(l0_, 0xFF, 2 * sizeof(l0_[0]));
+}
+
+void RiscvMmu::flush(uint64_t va, uint64_t asid, bool allva, bool allasid) {
+    uint64_t vpn = va >> PAGE_BITS;
+    L1EntryType *e;
+    flushL0();
+    for (int i = 0; i < L1_SETS * L1_WAYS; i++) {
+        e = &l1_[i];
+        if (!allva && ((e->vpn ^ vpn) & e->mask) != 0) {
+            continue;
+        }
+        // Global mappings aren't flushed by the ASID specific fence
+        if (!allasid && ((e->flags & PTE_G) || e->asid != asid)) {
+            continue;
+        }
+        e->valid = false;
+    }
+    flushCnt_++;
+}
+
+bool RiscvMmu::translateSlow(uint64_t va, int acc, int prv, uint64_t *pa) {
+    int vabits = mode_ == 9 ? 48 : 39;
+    int64_t t = static_cast<int64_t>(va) >> (vabits - 1);
+    if (t != 0 && t != -1) {
+        // Upper bits must be equal to the most significant VA bit
+        stat_[acc].fault++;
+        return false;
+    }
+
+    uint64_t vpn = va >> PAGE_BITS;
+    L1EntryType *e = &l1_[(vpn & (L1_SETS - 1)) * L1_WAYS];
+    for (int i = 0; i < L1_WAYS; i++, e++) {
+        if (!e->valid || e->vpn != vpn
+            || (!(e->flags & PTE_G) && e->asid != asid_)) {
+            continue;
+        }
+        // A/D bits update and the permission faults go through the walker,
+        // PTE could be changed since it was cached.
+        if (!isPermitted(e->flags, acc, prv)
+            || (acc == Access_Store && !(e->flags & PTE_D))) {
+            break;
+        }
+        stat_[acc].l1hit++;
+        fillL0(vpn, e->ppn, acc, prv);
+        *pa = (e->ppn << PAGE_BITS) | (va & PAGE_MASK);
+        return true;
+    }
+    return walk(va, acc, prv, pa);
+}
+
+bool RiscvMmu::walk(uint64_t va, int acc, int prv, uint64_t *pa) {
+    int levels = mode_ == 9 ? 4 : 3;
+    uint64_t a = root_;
+    uint64_t pteaddr = 0;
+    uint64_t pte = 0;
+    int i;
+
+    stat_[acc].walk++;
+    for (i = levels - 1; i >= 0; i--) {
+        pteaddr = a + ((va >> (PAGE_BITS + 9 * i)) & 0x1FF) * 8;
+        if (!readPte(pteaddr, &pte)
+            || !(pte & PTE_V) || (!(pte & PTE_R) && (pte & PTE_W))) {
+            i = -1;
+            break;
+        }
+        if (pte & (PTE_R | PTE_X)) {
+            break;
+        }
+        a = ((pte >> 10) & ((1ull << 44) - 1)) << PAGE_BITS;
+    }
+    uint64_t ppn = (pte >> 10) & ((1ull << 44) - 1);
+    uint64_t lowmask = (1ull << (9 * (i > 0 ? i : 0))) - 1;
+    if (i < 0 || (ppn & lowmask) != 0
+        || !isPermitted(static_cast<uint8_t>(pte), acc, prv)) {
+        // No leaf, misaligned superpage or not permitted access
+        stat_[acc].fault++;
+        return false;
+    }
+
+    uint64_t upd = pte | PTE_A;
+    if (acc == Access_Store) {
+        upd |= PTE_D;
+    }
+    if (upd != pte) {
+        writePte(pteaddr, upd);
+    }
+
+    uint64_t vpn = va >> PAGE_BITS;
+    ppn |= vpn & lowmask;
+    int set = static_cast<int>(vpn & (L1_SETS - 1));
+    L1EntryType *e = &l1_[set * L1_WAYS];
+    int way = L1_WAYS;
+    for (int n = 0; n < L1_WAYS; n++) {
+        if (!e[n].valid || e[n].vpn == vpn) {
+            way = n;
+            break;
+        }
+    }
+    if (way == L1_WAYS) {
+        way = l1next_[set];
+        l1next_[set] = static_cast<uint8_t>((way + 1) % L1_WAYS);
+    }
+    e = &e[way];
+    e->vpn = vpn;
+    e->mask = ~lowmask;
+    e->ppn = ppn;
+    e->asid = static_cast<uint16_t>(asid_);
+    e->flags = static_cast<uint8_t>(upd);
+    e->valid = true;
+
+    fillL0(vpn, ppn, acc, prv);
+    *pa = (ppn << PAGE_BITS) | (va & PAGE_MASK);
+    return true;
+}
+
+bool RiscvMmu::isPermitted(uint8_t flags, int acc, int prv) {
+    if (prv == 0) {
+        if (!(flags & PTE_U)) {
+            return false;
+        }
+    } else if (flags & PTE_U) {
+        // S-mode accesses user pages only for data when SUM is set
+        if (acc == Access_Fetch || !sum_) {
+            return false;
+        }
+    }
+    switch (acc) {
+    case Access_Fetch:
+        return (flags & PTE_X) != 0;
+    case Access_Load:
+        return (flags & PTE_R) || (mxr_ && (flags & PTE_X));
+    default:
+        return (flags & PTE_W) != 0;
+    }
+}
+
+void RiscvMmu::fillL0(uint64_t vpn, uint64_t ppn, int acc, int prv) {
+    L0EntryType *e = &l0_[prv ? 1 : 0][acc][vpn & (L0_SIZE - 1)];
+    e->vpn = vpn;
+    e->pbase = ppn << PAGE_BITS;
+}
+
+bool RiscvMmu::readPte(uint64_t addr, uint64_t *pte) {
+    Axi4TransactionType tr;
+    tr.action = MemAction_Read;
+    tr.addr = addr;
+    tr.xsize = 8;
+    tr.wstrb = 0;
+    tr.source_idx = busid_;
+    if (ibus_->b_transport(&tr) == TRANS_ERROR) {
+        return false;
+    }
+    *pte = tr.rpayload.b64[0];
+    return true;
+}
+
+void RiscvMmu::writePte(uint64_t addr, uint64_t pte) {
+    Axi4TransactionType tr;
+    tr.action = MemAction_Write;
+    tr.addr = addr;
+    tr.xsize = 8;
+    tr.wstrb = 0xFF;
+    tr.wpayload.b64[0] = pte;
+    tr.source_idx = busid_;
+    ibus_->b_transport(&tr);
+}
+
+void RiscvMmu::getStat(AttributeType *res) {
+    res->make_list(Access_Total + 1);
+    for (int i = 0; i < Access_Total; i++) {
+        AttributeType &item = (*res)[static_cast<unsigned>(i)];
+        item.make_list(4);
+        item[0u].make_uint64(stat_[i].hit);
+        item[1].make_uint64(stat_[i].l1hit);
+        item[2].make_uint64(stat_[i].walk);
+        item[3].make_uint64(stat_[i].fault);
+    }
+    (*res)[Access_Total].make_uint64(flushCnt_);
+}
+
+}  // namespace debugger
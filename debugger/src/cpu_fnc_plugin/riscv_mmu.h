@@ -0,0 +1,152 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef __DEBUGGER_SRC_CPU_FNC_PLUGIN_RISCV_MMU_H__
+#define __DEBUGGER_SRC_CPU_FNC_PLUGIN_RISCV_MMU_H__
+
+#include <api_types.h>
+#include <attribute.h>
+#include "coreservices/imemop.h"
+
+namespace debugger {
+
+/**
+ * Sv39/Sv48 address translation with two levels of the software TLB:
+ *
+ *   L0 - direct-mapped table per privilege level (U/S) and access type
+ *        (fetch/load/store) with the already checked permissions. Hit is
+ *        a single compare. Tables are dropped on any satp, SUM or MXR
+ *        change and on sfence.vma.
+ *   L1 - set-associative table of the leaf PTEs tagged with ASID. Entries
+ *        of the superpages are stored per 4 KB fragment but remember the
+ *        leaf size so that sfence.vma of any address inside removes them.
+ *
+ * Misses are served by the page table walker that reads PTEs through the
+ * system bus and sets A/D bits in memory.
+ */
+class RiscvMmu {
+ public:
+    /** Access types, the same values as CpuGeneric::EMemAccessType */
+    enum EAccessType {
+        Access_Fetch,
+        Access_Load,
+        Access_Store,
+        Access_Total
+    };
+
+    RiscvMmu();
+    ~RiscvMmu();
+
+    void setBus(IMemoryOperation *ibus, int busid) {
+        ibus_ = ibus;
+        busid_ = busid;
+    }
+
+    /**
+     * Translation context: satp value and mstatus SUM/MXR bits.
+     * L0 tables are flushed if anything changed.
+     */
+    void setContext(uint64_t satp, bool sum, bool mxr);
+    bool isPaging() { return mode_ != 0; }
+
+    /**
+     * @param prv privilege level of the access: 0 = U, otherwise S
+     * @return false on page fault
+     */
+    bool translate(uint64_t va, int acc, int prv, uint64_t *pa) {
+        uint64_t vpn = va >> PAGE_BITS;
+        L0EntryType *e = &l0_[prv ? 1 : 0][acc][vpn & (L0_SIZE - 1)];
+        if (e->vpn == vpn) {
+            stat_[acc].hit++;
+            *pa = e->pbase | (va & PAGE_MASK);
+            return true;
+        }
+        return translateSlow(va, acc, prv, pa);
+    }
+
+    /** sfence.vma: 'allva' and 'allasid' correspond to rs1/rs2 = x0 */
+    void flush(uint64_t va, uint64_t asid, bool allva, bool allasid);
+
+    /** [[l0hit,l1hit,walk,fault] for fetch, load, store; flushes] */
+    void getStat(AttributeType *res);
+
+ private:
+    bool translateSlow(uint64_t va, int acc, int prv, uint64_t *pa);
+    bool walk(uint64_t va, int acc, int prv, uint64_t *pa);
+    bool isPermitted(uint8_t flags, int acc, int prv);
+    bool readPte(uint64_t addr, uint64_t *pte);
+    void writePte(uint64_t addr, uint64_t pte);
+    void fillL0(uint64_t vpn, uint64_t ppn, int acc, int prv);
+    void flushL0();
+
+ private:
+    static const int PAGE_BITS = 12;
+    static const uint64_t PAGE_MASK = (1ull << PAGE_BITS) - 1;
+    static const int L0_SIZE = 256;
+    static const int L1_SETS = 512;
+    static const int L1_WAYS = 4;
+
+    static const uint64_t PTE_V = 1ull << 0;
+    static const uint64_t PTE_R = 1ull << 1;
+    static const uint64_t PTE_W = 1ull << 2;
+    static const uint64_t PTE_X = 1ull << 3;
+    static const uint64_t PTE_U = 1ull << 4;
+    static const uint64_t PTE_G = 1ull << 5;
+    static const uint64_t PTE_A = 1ull << 6;
+    static const uint64_t PTE_D = 1ull << 7;
+
+    struct L0EntryType {
+        uint64_t vpn;           // ~0 if invalid
+        uint64_t pbase;         // physical address of the page
+    };
+
+    struct L1EntryType {
+        uint64_t vpn;           // 4 KB virtual page number
+        uint64_t mask;          // vpn bits of the leaf page
+        uint64_t ppn;           // 4 KB physical page number
+        uint16_t asid;
+        uint8_t flags;          // PTE[7:0]
+        bool valid;
+    };
+
+    struct StatType {
+        uint64_t hit;           // L0 hits
+        uint64_t l1hit;
+        uint64_t walk;
+        uint64_t fault;
+    };
+
+    IMemoryOperation *ibus_;
+    int busid_;
+
+    uint64_t satp_;
+    uint64_t mode_;             // 0 = Bare, 8 = Sv39, 9 = Sv48
+    uint64_t asid_;
+    uint64_t root_;             // physical address of the root table
+    bool sum_;
+    bool mxr_;
+
+    L0EntryType (*l0_)[Access_Total][L0_SIZE];
+    L1EntryType *l1_;
+    uint8_t *l1next_;           // round-robin victim per set
+
+    StatType stat_[Access_Total];
+    uint64_t flushCnt_;
+};
+
+}  // namespace debugger
+
+#endif  // __DEBUGGER_SRC_CPU_FNC_PLUGIN_RISCV_MMU_H__
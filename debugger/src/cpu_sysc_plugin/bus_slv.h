@@ -41,6 +41,8 @@ class BusSlave : public sc_module,
     virtual ETransStatus b_transport(Axi4TransactionType *trans);
     virtual ETransStatus nb_transport(Axi4TransactionType *trans,
                                       IAxi4NbResponse *cb) override ;
+    /** SystemC kernel isn't thread-safe */
+    virtual bool isSerialized() override { return true; }
 
  private:
     void readreg(uint64_t idx);
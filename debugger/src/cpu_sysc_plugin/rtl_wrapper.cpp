@@ -52,6 +52,8 @@ RtlWrapper::RtlWrapper(IFace *parent, sc_module_name name) : sc_module(name),
     v.clk_cnt = 0;
     r.clk_cnt = 0;
     trans.source_idx = 0;//CFG_NASTI_MASTER_CACHED;
+    burstTotal_ = 0;
+    burstError_ = false;
     w_msip = 0;
     w_mtip = 0;
     w_meip = 0;
@@ -288,7 +290,6 @@ void RtlWrapper::sys_bus_proc() {
     uint8_t strob;
     uint64_t offset;
 
-    step_queue_.initProc();
     step_queue_.pushPreQueued();
     uint64_t step_cnt = r.clk_cnt.read();
     while ((cb = step_queue_.getNext(step_cnt)) != 0) {
@@ -305,16 +306,39 @@ void RtlWrapper::sys_bus_proc() {
     uint64_t toff;
     switch (r.state.read()) {
     case State_Read:
-        trans.action = MemAction_Read;
-        trans.addr = r.req_addr.read();
-        trans.xsize = 8;
-        trans.wstrb = 0;
-        trans.wpayload.b64[0] = 0;
-        resp = ibus_->b_transport(&trans);
+        if (burstTotal_ == 0 && r.req_burst.read() == 1
+            && r.req_len.read() != 0) {
+            // INCR burst: fetch all beats at once, return one per clock
+            burst.action = MemAction_Read;
+            burst.addr = r.req_addr.read()
+                       & ~((1ull << CFG_LOG2_SYSBUS_DATA_BYTES) - 1);
+            burst.size = CFG_SYSBUS_DATA_BYTES * (r.req_len.read() + 1);
+            burst.buf = reinterpret_cast<uint8_t *>(burstBuf_);
+            burst.source_idx = trans.source_idx;
+            burstError_ = ibus_->b_burst(&burst) != TRANS_OK;
+            burstTotal_ = r.req_len.read() + 1;
+        }
 
         w_resp_valid = 1;
-        toff = r.req_addr.read()(CFG_LOG2_SYSBUS_DATA_BYTES - 1, 0);
-        wb_resp_data = (trans.rpayload.b64[0]) << (8*toff);
+        if (burstTotal_) {
+            toff = (r.req_addr.read() - burst.addr)
+                    >> CFG_LOG2_SYSBUS_DATA_BYTES;
+            wb_resp_data = burstBuf_[toff];
+            resp = burstError_ ? TRANS_ERROR : TRANS_OK;
+            if (r.req_len.read() == 0) {
+                burstTotal_ = 0;
+            }
+        } else {
+            trans.action = MemAction_Read;
+            trans.addr = r.req_addr.read();
+            trans.xsize = 8;
+            trans.wstrb = 0;
+            trans.wpayload.b64[0] = 0;
+            resp = ibus_->b_transport(&trans);
+
+            toff = r.req_addr.read()(CFG_LOG2_SYSBUS_DATA_BYTES - 1, 0);
+            wb_resp_data = (trans.rpayload.b64[0]) << (8*toff);
+        }
         if (resp == TRANS_ERROR) {
             w_r_error = 1;
         }
@@ -89,6 +89,12 @@ class RtlWrapper : public sc_module,
 
     Axi4TransactionType trans;
     ETransStatus resp;
+    // Read burst is requested from the bus at once on the first beat
+    static const int BURST_BEATS_MAX = 256;     // AXI4 arlen
+    Axi4BurstType burst;
+    uint64_t burstBuf_[BURST_BEATS_MAX];
+    int burstTotal_;
+    bool burstError_;
 
     bool request_reset;
     bool async_interrupt;
@@ -122,8 +128,10 @@ class RtlWrapper : public sc_module,
     virtual void writeGPR(uint32_t regno, uint64_t val) {}
     virtual uint64_t readNonStandardReg(uint32_t regno) { return 0; }
     virtual void writeNonStandardReg(uint32_t regno, uint64_t val) {}
-    virtual void mmuAddrReserve(uint64_t addr) { }
-    virtual bool mmuAddrRelease(uint64_t addr) { return true; }
+    virtual void mmuAddrReserve(uint64_t addr, uint64_t value) { }
+    virtual bool mmuAddrRelease(uint64_t addr, uint64_t *value) {
+        return true;
+    }
 
     /** IClock */
     virtual uint64_t getClockCounter() { return r.clk_cnt.read(); }
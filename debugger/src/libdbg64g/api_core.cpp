@@ -33,6 +33,7 @@
 #include "services/remote/tcpclient.h"
 #include "services/remote/tcpserver.h"
 #include "services/remote/dpiclient.h"
+#include "services/sync/quantum.h"
 #include "services/comport/comport.h"
 #include "services/console/autocompleter.h"
 #include "services/console/console.h"
@@ -55,8 +56,15 @@ static CoreTimerType timers_[TIMERS_MAX] = {{0}};
 
 CoreService *pcore_ = NULL;
 
+/** Farm mode platform of the thread, NULL = default platform */
+static thread_local CoreService *tls_core_ = NULL;
+
+static CoreService *curcore() {
+    return tls_core_ ? tls_core_ : pcore_;
+}
+
 IFace *getInterface(const char *name) {
-    return pcore_->getInterface(name);
+    return curcore()->getInterface(name);
 }
 
 extern "C" int RISCV_init() {
@@ -88,6 +96,7 @@ extern "C" int RISCV_init() {
     REGISTER_CLASS_IDX(Greth, 17)
     REGISTER_CLASS_IDX(DSU, 18);
     REGISTER_CLASS_IDX(TcpJtagBitBangClient, 19);
+    REGISTER_CLASS_IDX(QuantumSync, 20);
 
     pcore_->load_plugins();
     return 0;
@@ -103,20 +112,50 @@ extern "C" void RISCV_cleanup() {
     delete pcore_;
 }
 
+extern "C" void *RISCV_create_platform(const char *name) {
+    return new CoreService(name, pcore_);
+}
+
+extern "C" void RISCV_select_platform(void *hplatform) {
+    tls_core_ = static_cast<CoreService *>(hplatform);
+}
+
+extern "C" void RISCV_delete_platform(void *hplatform) {
+    CoreService *prev = tls_core_;
+    tls_core_ = static_cast<CoreService *>(hplatform);
+
+    AttributeType t1;
+    IService *iserv;
+    IThread *ith;
+    RISCV_get_services_with_iface(IFACE_THREAD, &t1);
+    tls_core_->setExiting();
+    for (unsigned i = 0; i < t1.size(); i++) {
+        iserv = static_cast<IService *>(t1[i].to_iface());
+        ith = static_cast<IThread *>(iserv->getInterface(IFACE_THREAD));
+        ith->stop();
+    }
+    tls_core_->triggerHap(HAP_BreakSimulation, 0, "Exiting");
+    tls_core_->shutdown();
+    tls_core_->predeletePlatformServices();
+    tls_core_->deletePlatformServices();
+    delete tls_core_;
+    tls_core_ = prev == hplatform ? NULL : prev;
+}
+
 extern "C" int RISCV_set_configuration(AttributeType *cfg) {
     if (!pcore_) {
         printf("Core library wasn't initialized.\n");
         return -1;
     }
-    if (pcore_->setConfig(cfg)) {
+    if (curcore()->setConfig(cfg)) {
         printf("Wrong configuration.\n");
         return -1;
     }
 
-    if (pcore_->createPlatformServices()) {
+    if (curcore()->createPlatformServices()) {
         return -1;
     }
-    pcore_->postinitPlatformServices();
+    curcore()->postinitPlatformServices();
 
     RISCV_printf(getInterface(IFACE_SERVICE), 0, "%s",
     "\n****************************************************************\n"
@@ -125,17 +164,17 @@ extern "C" int RISCV_set_configuration(AttributeType *cfg) {
     "  Licensed under the Apache License, Version 2.0.\n"
     "******************************************************************");
 
-    pcore_->triggerHap(HAP_ConfigDone, 0,
+    curcore()->triggerHap(HAP_ConfigDone, 0,
                       "Initial config done");
     return 0;
 }
 
 extern "C" void RISCV_get_configuration(AttributeType *cfg) {
-    pcore_->getConfig(cfg);
+    curcore()->getConfig(cfg);
 }
 
 extern "C" const AttributeType *RISCV_get_global_settings() {
-    return pcore_->getGlobalSettings();
+    return curcore()->getGlobalSettings();
 }
 
 extern "C" void RISCV_register_class(IFace *icls) {
@@ -147,20 +186,20 @@ extern "C" void RISCV_unregister_class(const char *clsname) {
 }
 
 extern "C" void RISCV_register_hap(IFace *ihap) {
-    pcore_->registerHap(ihap);
+    curcore()->registerHap(ihap);
 }
 
 extern "C" void RISCV_unregister_hap(IFace *ihap) {
-    pcore_->unregisterHap(ihap);
+    curcore()->unregisterHap(ihap);
 }
 
 extern "C" void RISCV_trigger_hap(int type, uint64_t param,
                                   const char *descr) {
-    pcore_->triggerHap(type, param, descr);
+    curcore()->triggerHap(type, param, descr);
 }
 
 extern "C" IFace *RISCV_get_class(const char *name) {
-    return pcore_->getClass(name);
+    return curcore()->getClass(name);
 }
 
 extern "C" IFace *RISCV_create_service(IFace *iclass, const char *name, 
@@ -173,7 +212,7 @@ extern "C" IFace *RISCV_create_service(IFace *iclass, const char *name,
 }
 
 extern "C" IFace *RISCV_get_service(const char *name) {
-    return pcore_->getService(name);
+    return curcore()->getService(name);
 }
 
 extern "C" IFace *RISCV_get_service_iface(const char *servname,
@@ -199,12 +238,12 @@ extern "C" IFace *RISCV_get_service_port_iface(const char *servname,
 
 extern "C" void RISCV_get_services_with_iface(const char *iname,
                                              AttributeType *list) {
-    pcore_->getServicesWithIFace(iname, list);
+    curcore()->getServicesWithIFace(iname, list);
 }
 
 extern "C" void RISCV_get_iface_list(const char *iname,
                                      AttributeType *list) {
-    pcore_->getIFaceList(iname, list);
+    curcore()->getIFaceList(iname, list);
 }
 
 extern "C" void RISCV_get_clock_services(AttributeType *list) {
@@ -230,19 +269,19 @@ static thread_return_t safe_exit_thread(void *args) {
         printf("Stopped\n");
     }
 
-    pcore_->triggerHap(HAP_BreakSimulation,
+    curcore()->triggerHap(HAP_BreakSimulation,
                        0,
                        "Exiting");
     printf("All threads were stopped!\n");
-    pcore_->shutdown();
+    curcore()->shutdown();
     return 0;
 }
 
 extern "C" void RISCV_break_simulation() {
-    if (pcore_->isExiting()) {
+    if (curcore()->isExiting()) {
         return;
     }
-    pcore_->setExiting();
+    curcore()->setExiting();
     LibThreadType data;
     data.func = reinterpret_cast<lib_thread_func>(safe_exit_thread);
     data.args = 0;
@@ -254,7 +293,7 @@ extern "C" void RISCV_dispatcher_start() {
     CoreTimerType *tmr;
     int sleep_interval = 20;
     int delta;
-    while (pcore_->isActive()) {
+    while (curcore()->isActive()) {
         delta = 20;
         for (int i = 0; i < TIMERS_MAX; i++) {
             tmr = &timers_[i];
@@ -314,28 +353,28 @@ extern "C" void RISCV_unregister_timer(timer_callback_type cb) {
 
 extern "C" void RISCV_generate_name(AttributeType *name) {
     char str[256];
-    pcore_->generateUniqueName("obj", str, sizeof(str));
+    curcore()->generateUniqueName("obj", str, sizeof(str));
     name->make_string(str);
 }
 
 extern "C" void RISCV_add_default_output(void *iout) {
-    pcore_->registerConsole(static_cast<IRawListener *>(iout));
+    curcore()->registerConsole(static_cast<IRawListener *>(iout));
 }
 
 extern "C" void RISCV_remove_default_output(void *iout) {
-    pcore_->unregisterConsole(static_cast<IRawListener *>(iout));
+    curcore()->unregisterConsole(static_cast<IRawListener *>(iout));
 }
 
 extern "C" void RISCV_set_default_clock(void *iclk) {
-    pcore_->setTimestampClk(static_cast<IFace *>(iclk));
+    curcore()->setTimestampClk(static_cast<IFace *>(iclk));
 }
 
 extern "C" int RISCV_enable_log(const char *filename) {
-    return pcore_->openLog(filename);
+    return curcore()->openLog(filename);
 }
 
 extern "C" void RISCV_disable_log() {
-    pcore_->closeLog();
+    curcore()->closeLog();
 }
 
 extern "C" int RISCV_printf(void *iface, int level, 
@@ -343,11 +382,12 @@ extern "C" int RISCV_printf(void *iface, int level,
     int ret = 0;
     va_list arg;
     IFace *iout = reinterpret_cast<IFace *>(iface);
-    uint64_t cur_t = pcore_->getTimestamp();
+    CoreService *pc = curcore();
+    uint64_t cur_t = pc->getTimestamp();
 
-    char *buf = pcore_->getpBufLog();
-    size_t buf_sz = pcore_->sizeBufLog();
-    pcore_->lockPrintf();
+    char *buf = pc->getpBufLog();
+    size_t buf_sz = pc->sizeBufLog();
+    pc->lockPrintf();
     if (iout == NULL) {
         ret = RISCV_sprintf(buf, buf_sz,
                     "[%" RV_PRI64 "d, \"%s\", \"", cur_t, "unknown");
@@ -356,7 +396,7 @@ extern "C" int RISCV_printf(void *iface, int level,
         AttributeType *local_level = 
                 static_cast<AttributeType *>(iserv->getAttribute("LogLevel"));
         if (level > static_cast<int>(local_level->to_int64())) {
-            pcore_->unlockPrintf();
+            pc->unlockPrintf();
             return 0;
         }
         ret = RISCV_sprintf(buf, buf_sz,
@@ -382,9 +422,9 @@ extern "C" int RISCV_printf(void *iface, int level,
     buf[ret++] = '\n';
     buf[ret] = '\0';
 
-    pcore_->outputConsole(buf, ret);
-    pcore_->outputLog(buf, ret);
-    pcore_->unlockPrintf();
+    pc->outputConsole(buf, ret);
+    pc->outputLog(buf, ret);
+    pc->unlockPrintf();
     return ret;
 }
 
@@ -405,11 +445,7 @@ extern "C" int RISCV_sscanf(const char *s, const char *fmt, ...) {
     int ret;
     va_list arg;
     va_start(arg, fmt);
-#if defined(_WIN32) || defined(__CYGWIN__)
     ret = vsscanf(s, fmt, arg);
-#else
-    ret = vsscanf(fmt, s, arg);
-#endif
     va_end(arg);
     return ret;
 }
@@ -449,12 +485,36 @@ extern "C" void RISCV_memory_barrier() {
 #endif
 }
 
+/** New thread inherits the platform of its parent */
+struct ThreadStartType {
+    lib_thread_func func;
+    void *args;
+    CoreService *core;
+};
+
+#if defined(_WIN32) || defined(__CYGWIN__)
+static thread_return_t __stdcall thread_start(void *args) {
+#else
+static thread_return_t thread_start(void *args) {
+#endif
+    ThreadStartType *p = static_cast<ThreadStartType *>(args);
+    lib_thread_func func = p->func;
+    void *func_args = p->args;
+    tls_core_ = p->core;
+    delete p;
+    return func(func_args);
+}
+
 extern "C" void RISCV_thread_create(void *data) {
     LibThreadType *p = (LibThreadType *)data;
+    ThreadStartType *start = new ThreadStartType;
+    start->func = p->func;
+    start->args = p->args;
+    start->core = tls_core_;
 #if defined(_WIN32) || defined(__CYGWIN__)
-    p->Handle = (thread_def)_beginthreadex(0, 0, p->func, p->args, 0, 0);
+    p->Handle = (thread_def)_beginthreadex(0, 0, thread_start, start, 0, 0);
 #else
-    pthread_create(&p->Handle, 0, p->func, p->args);
+    pthread_create(&p->Handle, 0, thread_start, start);
 #endif
 }
 
@@ -481,7 +541,7 @@ extern "C" void RISCV_event_create(event_def *ev, const char *name) {
     char event_name[256];
     wchar_t wevent_name[256];
     size_t converted;
-    pcore_->generateUniqueName("", event_name, sizeof(event_name));
+    curcore()->generateUniqueName("", event_name, sizeof(event_name));
     mbstowcs_s(&converted, wevent_name, event_name, sizeof(event_name));
     ev->state = false;
     ev->cond = CreateEventW(
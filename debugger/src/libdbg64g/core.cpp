@@ -31,6 +31,9 @@
 namespace debugger {
 
 CoreService::CoreService(const char *name) : IService("CoreService") {
+    root_ = this;
+    nspace_.make_string(".");
+    RISCV_mutex_init(&mutexRegistry_);
     active_ = 1;
     listPlugins_.make_list(0);
     listClasses_.make_list(0);
@@ -46,7 +49,29 @@ CoreService::CoreService(const char *name) : IService("CoreService") {
     logFile_ = 0;
 }
 
+CoreService::CoreService(const char *name, CoreService *root)
+    : IService("CoreService") {
+    root_ = root;
+    nspace_.make_string(name);
+    active_ = 1;
+    listPlugins_.make_list(0);
+    listClasses_.make_list(0);
+    listHap_.make_list(0);
+    listConsole_.make_list(0);
+
+    RISCV_mutex_init(&mutexPrintf_);
+    RISCV_mutex_init(&mutexDefaultConsoles_);
+    RISCV_mutex_init(&mutexLogFile_);
+    RISCV_event_create(&eventExiting_, "eventExiting_");
+    iclk_ = 0;
+    uniqueIdx_ = 0;
+    logFile_ = 0;
+}
+
 CoreService::~CoreService() {
+    if (root_ == this) {
+        RISCV_mutex_destroy(&mutexRegistry_);
+    }
     closeLog();
     RISCV_mutex_lock(&mutexPrintf_);
     RISCV_mutex_destroy(&mutexPrintf_);
@@ -82,14 +107,29 @@ int CoreService::setConfig(AttributeType *cfg) {
 
 void CoreService::getConfig(AttributeType *cfg) {
     IClass *icls;
+    IService *iserv;
+    const AttributeType *tlist;
     cfg->make_dict();
     (*cfg)["GlobalSettings"] = Config_["GlobalSettings"];
     (*cfg)["Services"].make_list(0);
-    for (unsigned i = 0; i < listClasses_.size(); i++) {
-        icls = static_cast<IClass *>(listClasses_[i].to_iface());
-        AttributeType val = icls->getConfiguration();
+    lockRegistry();
+    AttributeType &classes = root_->listClasses_;
+    for (unsigned i = 0; i < classes.size(); i++) {
+        icls = static_cast<IClass *>(classes[i].to_iface());
+        AttributeType val(Attr_Dict);
+        val["Class"].make_string(icls->getClassName());
+        val["Instances"].make_list(0);
+        tlist = icls->getInstanceList();
+        for (unsigned n = 0; n < tlist->size(); n++) {
+            iserv = static_cast<IService *>((*tlist)[n].to_iface());
+            if (isOwnService(iserv)) {
+                AttributeType inst = iserv->getConfiguration();
+                val["Instances"].add_to_list(&inst);
+            }
+        }
         (*cfg)["Services"].add_to_list(&val);
     }
+    unlockRegistry();
     cfg->to_config();
 }
 
@@ -100,24 +140,30 @@ int CoreService::createPlatformServices() {
     if (Services.is_list()) {
         for (unsigned i = 0; i < Services.size(); i++) {
             const char *clsname = Services[i]["Class"].to_string();
+            /**
+             * Special global setting for the GUI class, checked before the
+             * class look-up so that the headless build without GUI plugin
+             * accepts the same configuration.
+             */
+            if (strcmp(clsname, "GuiPluginClass") == 0) {
+                if (!Config_["GlobalSettings"]["GUI"].to_bool()) {
+                    RISCV_info("%s", "GUI disabled");
+                    continue;
+                }
+            }
             icls = static_cast<IClass *>(RISCV_get_class(clsname));
             if (icls == NULL) {
                 printf("Class %s not found\n", 
                                 Services[i]["Class"].to_string());
                 return -1;
             }
-            /** Special global setting for the GUI class: */
-            if (strcmp(icls->getClassName(), "GuiPluginClass") == 0) {
-                if (!Config_["GlobalSettings"]["GUI"].to_bool()) {
-                    RISCV_info("%s", "GUI disabled");
-                    continue;
-                }
-            }
 
             AttributeType &Instances = Services[i]["Instances"];
             for (unsigned n = 0; n < Instances.size(); n++) {
-                iserv =
-                    icls->createService(".", Instances[n]["Name"].to_string());
+                lockRegistry();
+                iserv = icls->createService(nspace_.to_string(),
+                                            Instances[n]["Name"].to_string());
+                unlockRegistry();
                 iserv->initService(&Instances[n]["Attr"]);
             }
         }
@@ -125,20 +171,67 @@ int CoreService::createPlatformServices() {
     return 0;
 }
 
-void CoreService::postinitPlatformServices() {
+/**
+ * Services of this namespace in the classes registration order. The list
+ * is a snapshot so the services may create other services and lookup the
+ * registry from their postinit without the registry lock.
+ */
+void CoreService::getOwnServices(AttributeType *list) {
     IClass *icls;
-    for (unsigned i = 0; i < listClasses_.size(); i++) {
-        icls = static_cast<IClass *>(listClasses_[i].to_iface());
-        icls->postinitServices();
+    IService *iserv;
+    const AttributeType *tlist;
+    list->make_list(0);
+    lockRegistry();
+    AttributeType &classes = root_->listClasses_;
+    for (unsigned i = 0; i < classes.size(); i++) {
+        icls = static_cast<IClass *>(classes[i].to_iface());
+        tlist = icls->getInstanceList();
+        for (unsigned n = 0; n < tlist->size(); n++) {
+            iserv = static_cast<IService *>((*tlist)[n].to_iface());
+            if (isOwnService(iserv)) {
+                AttributeType t1(iserv);
+                list->add_to_list(&t1);
+            }
+        }
+    }
+    unlockRegistry();
+}
+
+void CoreService::postinitPlatformServices() {
+    AttributeType list;
+    getOwnServices(&list);
+    for (unsigned i = 0; i < list.size(); i++) {
+        static_cast<IService *>(list[i].to_iface())->postinitService();
     }
 }
 
 void CoreService::predeletePlatformServices() {
+    AttributeType list;
+    getOwnServices(&list);
+    for (unsigned i = 0; i < list.size(); i++) {
+        static_cast<IService *>(list[i].to_iface())->predeleteService();
+    }
+}
+
+void CoreService::deletePlatformServices() {
     IClass *icls;
-    for (unsigned i = 0; i < listClasses_.size(); i++) {
-        icls = static_cast<IClass *>(listClasses_[i].to_iface());
-        icls->predeleteServices();
+    IService *iserv;
+    const AttributeType *tlist;
+    lockRegistry();
+    AttributeType &classes = root_->listClasses_;
+    for (unsigned i = 0; i < classes.size(); i++) {
+        icls = static_cast<IClass *>(classes[i].to_iface());
+        tlist = icls->getInstanceList();
+        for (unsigned n = 0; n < tlist->size(); ) {
+            iserv = static_cast<IService *>((*tlist)[n].to_iface());
+            if (isOwnService(iserv)) {
+                icls->deleteService(iserv);
+            } else {
+                n++;
+            }
+        }
     }
+    unlockRegistry();
 }
 
 const AttributeType *CoreService::getGlobalSettings() {
@@ -362,8 +455,9 @@ void CoreService::triggerHap(int type, uint64_t param, const char *descr) {
 
 IFace *CoreService::getClass(const char *name) {
     IClass *icls;
-    for (unsigned i = 0; i < listClasses_.size(); i++) {
-        icls = static_cast<IClass *>(listClasses_[i].to_iface());
+    AttributeType &classes = root_->listClasses_;
+    for (unsigned i = 0; i < classes.size(); i++) {
+        icls = static_cast<IClass *>(classes[i].to_iface());
         if (strcmp(name, icls->getClassName()) == 0) {
             return icls;
         }
@@ -374,12 +468,22 @@ IFace *CoreService::getClass(const char *name) {
 IFace *CoreService::getService(const char *name) {
     IClass *icls;
     IService *iserv;
-    for (unsigned i = 0; i < listClasses_.size(); i++) {
-        icls = static_cast<IClass *>(listClasses_[i].to_iface());
-        if ((iserv = icls->getInstance(name)) != NULL) {
-            return iserv;
+    const AttributeType *tlist;
+    lockRegistry();
+    AttributeType &classes = root_->listClasses_;
+    for (unsigned i = 0; i < classes.size(); i++) {
+        icls = static_cast<IClass *>(classes[i].to_iface());
+        tlist = icls->getInstanceList();
+        for (unsigned n = 0; n < tlist->size(); n++) {
+            iserv = static_cast<IService *>((*tlist)[n].to_iface());
+            if (isOwnService(iserv)
+                && strcmp(name, iserv->getObjName()) == 0) {
+                unlockRegistry();
+                return iserv;
+            }
         }
     }
+    unlockRegistry();
     return NULL;
 }
 
@@ -391,11 +495,16 @@ void CoreService::getServicesWithIFace(const char *iname,
     const AttributeType *tlist;
     list->make_list(0);
     
-    for (unsigned i = 0; i < listClasses_.size(); i++) {
-        icls = static_cast<IClass *>(listClasses_[i].to_iface());
+    lockRegistry();
+    AttributeType &classes = root_->listClasses_;
+    for (unsigned i = 0; i < classes.size(); i++) {
+        icls = static_cast<IClass *>(classes[i].to_iface());
         tlist = icls->getInstanceList();
         for (unsigned n = 0; n < tlist->size(); n++) {
             iserv = static_cast<IService *>((*tlist)[n].to_iface());
+            if (!isOwnService(iserv)) {
+                continue;
+            }
             iface = iserv->getInterface(iname);
             if (iface) {
                 AttributeType t1(iserv);
@@ -403,6 +512,7 @@ void CoreService::getServicesWithIFace(const char *iname,
             }
         }
     }
+    unlockRegistry();
 }
 
 void CoreService::getIFaceList(const char *iname,
@@ -414,11 +524,16 @@ void CoreService::getIFaceList(const char *iname,
     const AttributeType *tports;
     list->make_list(0);
     
-    for (unsigned i = 0; i < listClasses_.size(); i++) {
-        icls = static_cast<IClass *>(listClasses_[i].to_iface());
+    lockRegistry();
+    AttributeType &classes = root_->listClasses_;
+    for (unsigned i = 0; i < classes.size(); i++) {
+        icls = static_cast<IClass *>(classes[i].to_iface());
         tlist = icls->getInstanceList();
         for (unsigned n = 0; n < tlist->size(); n++) {
             iserv = static_cast<IService *>((*tlist)[n].to_iface());
+            if (!isOwnService(iserv)) {
+                continue;
+            }
             iface = iserv->getInterface(iname);
             if (iface) {
                 AttributeType t1(iface);
@@ -436,6 +551,7 @@ void CoreService::getIFaceList(const char *iname,
             }
         }
     }
+    unlockRegistry();
 }
 
 void CoreService::lockPrintf() {
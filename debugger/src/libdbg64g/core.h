@@ -36,9 +36,16 @@ struct CoreTimerType {
     int single_shot;
 };
 
+/**
+ * Platform kernel: configuration, service registry, haps, log and default
+ * clock. The root instance loads plugins and keeps the registered classes,
+ * farm platforms share them and see only the services of their own
+ * namespace.
+ */
 class CoreService : public IService {
  public:
     explicit CoreService(const char *name);
+    CoreService(const char *name, CoreService *root);
     virtual ~CoreService();
 
     int isActive();
@@ -53,6 +60,7 @@ class CoreService : public IService {
     int createPlatformServices();
     void postinitPlatformServices();
     void predeletePlatformServices();
+    void deletePlatformServices();
 
     void load_plugins();
     void unload_plugins();
@@ -84,6 +92,17 @@ class CoreService : public IService {
     void generateUniqueName(const char *prefix, char *out, size_t outsz);
 
  private:
+    void lockRegistry() { RISCV_mutex_lock(&root_->mutexRegistry_); }
+    void unlockRegistry() { RISCV_mutex_unlock(&root_->mutexRegistry_); }
+    bool isOwnService(IService *iserv) {
+        return strcmp(iserv->getNamespace(), nspace_.to_string()) == 0;
+    }
+    void getOwnServices(AttributeType *list);
+
+ private:
+    CoreService *root_;
+    AttributeType nspace_;          // namespace of the created services
+    mutex_def mutexRegistry_;       // root only: class instance lists
     AttributeType Config_;
     AttributeType listPlugins_;
     AttributeType listClasses_;
@@ -45,6 +45,12 @@ class DSU : public RegMemBankGeneric,
     virtual void postinitService() override;
     virtual void predeleteService() override;
 
+    /** ICheckpoint: debug interface isn't a part of the platform state */
+    virtual void saveState(CheckpointState *state) override {}
+    virtual bool restoreState(CheckpointState *state) override {
+        return true;
+    }
+
     /** IDsuGeneric */
     virtual void incrementRdAccess(int mst_id);
     virtual void incrementWrAccess(int mst_id);
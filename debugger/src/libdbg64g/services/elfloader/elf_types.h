@@ -144,10 +144,12 @@ class ElfHeaderType {
                 e_shoff_ = SwapBytes(h->e_shoff);
                 e_shnum_ = SwapBytes(h->e_shnum);
                 e_phoff_ = SwapBytes(h->e_phoff);
+                e_entry_ = SwapBytes(h->e_entry);
             } else {
                 e_shoff_ = h->e_shoff;
                 e_shnum_ = h->e_shnum;
                 e_phoff_ = h->e_phoff;
+                e_entry_ = h->e_entry;
             }
         } else {
             Elf64_Ehdr *h = reinterpret_cast<Elf64_Ehdr *>(pimg_);
@@ -155,10 +157,12 @@ class ElfHeaderType {
                 e_shoff_ = SwapBytes(h->e_shoff);
                 e_shnum_ = SwapBytes(h->e_shnum);
                 e_phoff_ = SwapBytes(h->e_phoff);
+                e_entry_ = SwapBytes(h->e_entry);
             } else {
                 e_shoff_ = h->e_shoff;
                 e_shnum_ = h->e_shnum;
                 e_phoff_ = h->e_phoff;
+                e_entry_ = h->e_entry;
             }
         }
     }
@@ -169,6 +173,7 @@ class ElfHeaderType {
     virtual uint64_t get_shoff() { return e_shoff_; }
     virtual ElfHalf get_shnum() { return e_shnum_; }
     virtual uint64_t get_phoff() { return e_phoff_; }
+    virtual uint64_t get_entry() { return e_entry_; }
  protected:
     uint8_t *pimg_;
     bool isElf_;
@@ -177,6 +182,7 @@ class ElfHeaderType {
     uint64_t e_shoff_;
     ElfHalf e_shnum_;
     uint64_t e_phoff_;
+    uint64_t e_entry_;
 };
 
    
@@ -23,6 +23,7 @@ ElfReaderService::ElfReaderService(const char *name) : IService(name) {
     registerInterface(static_cast<IElfReader *>(this));
     registerAttribute("SourceProc", &sourceProc_);
     image_ = NULL;
+    header_ = NULL;
     sectionNames_ = NULL;
     symbolList_.make_list(0);
     loadSectionList_.make_list(0);
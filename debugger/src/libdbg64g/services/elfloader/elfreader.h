@@ -58,6 +58,10 @@ public:
         return loadSectionList_[idx][LoadSh_data].data();
     }
 
+    virtual uint64_t entryPoint() {
+        return header_ ? header_->get_entry() : 0;
+    }
+
 private:
     int readElfHeader();
     int loadSections();
@@ -0,0 +1,332 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "iservice.h"
+#include "cmd_checkpoint.h"
+#include "coreservices/idport.h"
+
+namespace debugger {
+
+/** Hart state is consistent only between instructions */
+static bool isPlatformHalted() {
+    AttributeType harts;
+    IService *iserv;
+    IDPort *idport;
+    RISCV_get_services_with_iface(IFACE_DPORT, &harts);
+    for (unsigned i = 0; i < harts.size(); i++) {
+        iserv = static_cast<IService *>(harts[i].to_iface());
+        idport = static_cast<IDPort *>(iserv->getInterface(IFACE_DPORT));
+        if (!idport->isHalted()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+CmdSaveCheckpoint::CmdSaveCheckpoint()
+    : ICommand("save_checkpoint", 0, 0) {
+
+    briefDescr_.make_string("Save the platform state into file");
+    detailedDescr_.make_string(
+        "Description:\n"
+        "    Save registers and memory of all services into the file.\n"
+        "    Snapshot is also kept in memory so that the following restore\n"
+        "    copies only memory pages modified after the save. All harts\n"
+        "    should be halted.\n"
+        "Usage:\n"
+        "    save_checkpoint <file>\n"
+        "Example:\n"
+        "    save_checkpoint boot.ckpt\n");
+
+    snapshots_ = 0;
+}
+
+CmdSaveCheckpoint::~CmdSaveCheckpoint() {
+    CheckpointSnapshotType *p;
+    while (snapshots_) {
+        p = snapshots_;
+        snapshots_ = p->next;
+        freeSnapshot(p);
+    }
+}
+
+int CmdSaveCheckpoint::isValid(AttributeType *args) {
+    if (!cmdName_.is_equal((*args)[0u].to_string())) {
+        return CMD_INVALID;
+    }
+    if (args->size() == 2 && (*args)[1].is_string()) {
+        return CMD_VALID;
+    }
+    return CMD_WRONG_ARGS;
+}
+
+void CmdSaveCheckpoint::exec(AttributeType *args, AttributeType *res) {
+    res->make_nil();
+    if (isValid(args) != CMD_VALID) {
+        generateError(res, "Wrong argument list");
+        return;
+    }
+    if (!isPlatformHalted()) {
+        generateError(res, "Harts should be halted");
+        return;
+    }
+
+    AttributeType list;
+    IService *iserv;
+    ICheckpoint *ickpt;
+    RISCV_get_services_with_iface(IFACE_CHECKPOINT, &list);
+
+    CheckpointSnapshotType *p = new CheckpointSnapshotType;
+    p->file.make_string((*args)[1].to_string());
+    p->names.make_list(list.size());
+    p->states = new CheckpointState *[list.size()];
+    p->next = 0;
+    for (unsigned i = 0; i < list.size(); i++) {
+        iserv = static_cast<IService *>(list[i].to_iface());
+        ickpt = static_cast<ICheckpoint *>(
+                    iserv->getInterface(IFACE_CHECKPOINT));
+        p->names[i].make_string(iserv->getObjName());
+        p->states[i] = new CheckpointState;
+        ickpt->saveState(p->states[i]);
+    }
+
+    if (!writeFile(p)) {
+        freeSnapshot(p);
+        generateError(res, "Can't write file");
+        return;
+    }
+    addSnapshot(p);
+}
+
+CheckpointSnapshotType *CmdSaveCheckpoint::getSnapshot(const char *file) {
+    for (CheckpointSnapshotType *p = snapshots_; p; p = p->next) {
+        if (p->file.is_equal(file)) {
+            return p;
+        }
+    }
+    return 0;
+}
+
+void CmdSaveCheckpoint::addSnapshot(CheckpointSnapshotType *p) {
+    CheckpointSnapshotType **pp = &snapshots_;
+    while (*pp) {
+        if ((*pp)->file.is_equal(p->file.to_string())) {
+            CheckpointSnapshotType *old = *pp;
+            *pp = old->next;
+            freeSnapshot(old);
+            break;
+        }
+        pp = &(*pp)->next;
+    }
+    p->next = snapshots_;
+    snapshots_ = p;
+}
+
+void CmdSaveCheckpoint::freeSnapshot(CheckpointSnapshotType *p) {
+    for (unsigned i = 0; i < p->names.size(); i++) {
+        delete p->states[i];
+    }
+    delete [] p->states;
+    delete p;
+}
+
+bool CmdSaveCheckpoint::writeFile(CheckpointSnapshotType *p) {
+    FILE *fp = fopen(p->file.to_string(), "wb");
+    if (!fp) {
+        return false;
+    }
+    uint32_t hdr[2] = {CHECKPOINT_FILE_VERSION, p->names.size()};
+    fwrite(CHECKPOINT_FILE_MAGIC, 1, sizeof(CHECKPOINT_FILE_MAGIC), fp);
+    fwrite(hdr, 1, sizeof(hdr), fp);
+
+    CheckpointState *st;
+    CheckpointPageType **pages;
+    uint64_t t;
+    for (unsigned i = 0; i < p->names.size(); i++) {
+        st = p->states[i];
+        uint32_t namesz = p->names[i].size();
+        fwrite(&namesz, 1, sizeof(namesz), fp);
+        fwrite(p->names[i].to_string(), 1, namesz, fp);
+        t = st->size();
+        fwrite(&t, 1, sizeof(t), fp);
+        fwrite(st->data(), 1, t, fp);
+
+        pages = st->pages();
+        t = st->pageTotal();
+        fwrite(&t, 1, sizeof(t), fp);
+        t = 0;
+        for (uint64_t n = 0; n < st->pageTotal(); n++) {
+            if (pages[n]) {
+                t++;
+            }
+        }
+        fwrite(&t, 1, sizeof(t), fp);
+        for (uint64_t n = 0; n < st->pageTotal(); n++) {
+            if (!pages[n]) {
+                continue;
+            }
+            fwrite(&n, 1, sizeof(n), fp);
+            fwrite(pages[n]->data, 1, CheckpointPageType::PAGE_SIZE, fp);
+        }
+    }
+    bool ret = ferror(fp) == 0;
+    fclose(fp);
+    return ret;
+}
+
+
+CmdRestoreCheckpoint::CmdRestoreCheckpoint(CmdSaveCheckpoint *save)
+    : ICommand("restore_checkpoint", 0, 0) {
+
+    briefDescr_.make_string("Restore the platform state from file");
+    detailedDescr_.make_string(
+        "Description:\n"
+        "    Restore registers and memory of all services. Snapshot taken\n"
+        "    in this session is restored without reading the file. All\n"
+        "    harts should be halted.\n"
+        "Usage:\n"
+        "    restore_checkpoint <file>\n"
+        "Example:\n"
+        "    restore_checkpoint boot.ckpt\n");
+
+    save_ = save;
+}
+
+int CmdRestoreCheckpoint::isValid(AttributeType *args) {
+    if (!cmdName_.is_equal((*args)[0u].to_string())) {
+        return CMD_INVALID;
+    }
+    if (args->size() == 2 && (*args)[1].is_string()) {
+        return CMD_VALID;
+    }
+    return CMD_WRONG_ARGS;
+}
+
+void CmdRestoreCheckpoint::exec(AttributeType *args, AttributeType *res) {
+    res->make_nil();
+    if (isValid(args) != CMD_VALID) {
+        generateError(res, "Wrong argument list");
+        return;
+    }
+    if (!isPlatformHalted()) {
+        generateError(res, "Harts should be halted");
+        return;
+    }
+
+    const char *file = (*args)[1].to_string();
+    CheckpointSnapshotType *p = save_->getSnapshot(file);
+    if (!p) {
+        if ((p = readFile(file)) == 0) {
+            generateError(res, "Can't read checkpoint file");
+            return;
+        }
+        save_->addSnapshot(p);
+    }
+
+    ICheckpoint *ickpt;
+    for (unsigned i = 0; i < p->names.size(); i++) {
+        ickpt = static_cast<ICheckpoint *>(RISCV_get_service_iface(
+                    p->names[i].to_string(), IFACE_CHECKPOINT));
+        if (!ickpt) {
+            generateError(res, "Checkpoint doesn't match the platform");
+            return;
+        }
+        p->states[i]->rewind();
+        if (!ickpt->restoreState(p->states[i])) {
+            generateError(res, "Can't restore service state");
+            return;
+        }
+    }
+}
+
+CheckpointSnapshotType *CmdRestoreCheckpoint::readFile(const char *file) {
+    FILE *fp = fopen(file, "rb");
+    if (!fp) {
+        return 0;
+    }
+    char magic[sizeof(CHECKPOINT_FILE_MAGIC)];
+    uint32_t hdr[2];
+    if (fread(magic, 1, sizeof(magic), fp) != sizeof(magic)
+        || fread(hdr, 1, sizeof(hdr), fp) != sizeof(hdr)
+        || memcmp(magic, CHECKPOINT_FILE_MAGIC, sizeof(magic)) != 0
+        || hdr[0] != CHECKPOINT_FILE_VERSION) {
+        fclose(fp);
+        return 0;
+    }
+
+    CheckpointSnapshotType *p = new CheckpointSnapshotType;
+    p->file.make_string(file);
+    p->names.make_list(0);
+    p->states = new CheckpointState *[hdr[1]];
+    p->next = 0;
+
+    bool ok = true;
+    char name[256];
+    uint8_t *buf;
+    uint32_t namesz;
+    uint64_t sz, total, stored, idx;
+    CheckpointPageType **pages;
+    for (uint32_t i = 0; i < hdr[1] && ok; i++) {
+        ok = fread(&namesz, 1, sizeof(namesz), fp) == sizeof(namesz)
+            && namesz < sizeof(name)
+            && fread(name, 1, namesz, fp) == namesz
+            && fread(&sz, 1, sizeof(sz), fp) == sizeof(sz);
+        if (!ok) {
+            break;
+        }
+        name[namesz] = '\0';
+        p->names.new_list_item().make_string(name);
+        p->states[i] = new CheckpointState;
+        p->states[i]->setLocal(false);
+
+        buf = new uint8_t[sz + 1];
+        ok = fread(buf, 1, sz, fp) == sz;
+        p->states[i]->write(buf, sz);
+        delete [] buf;
+
+        ok = ok && fread(&total, 1, sizeof(total), fp) == sizeof(total)
+                && fread(&stored, 1, sizeof(stored), fp) == sizeof(stored)
+                && stored <= total;
+        if (!ok || total == 0) {
+            continue;
+        }
+        pages = new CheckpointPageType *[total];
+        memset(pages, 0, total*sizeof(CheckpointPageType *));
+        p->states[i]->setPages(pages, total);
+        for (uint64_t n = 0; n < stored && ok; n++) {
+            ok = fread(&idx, 1, sizeof(idx), fp) == sizeof(idx)
+                && idx < total && pages[idx] == 0;
+            if (ok) {
+                pages[idx] = new CheckpointPageType;
+                ok = fread(pages[idx]->data, 1, CheckpointPageType::PAGE_SIZE,
+                           fp) == CheckpointPageType::PAGE_SIZE;
+            }
+        }
+    }
+    fclose(fp);
+
+    if (!ok) {
+        for (unsigned i = 0; i < p->names.size(); i++) {
+            delete p->states[i];
+        }
+        delete [] p->states;
+        delete p;
+        return 0;
+    }
+    return p;
+}
+
+}  // namespace debugger
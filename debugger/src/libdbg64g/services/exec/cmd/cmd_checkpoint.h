@@ -0,0 +1,83 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef __DEBUGGER_CMD_CHECKPOINT_H__
+#define __DEBUGGER_CMD_CHECKPOINT_H__
+
+#include "api_core.h"
+#include "coreservices/icommand.h"
+#include "coreservices/icheckpoint.h"
+#include <stdio.h>
+
+namespace debugger {
+
+/** Saved states of all services implementing ICheckpoint */
+struct CheckpointSnapshotType {
+    AttributeType file;
+    AttributeType names;            // service names
+    CheckpointState **states;
+    CheckpointSnapshotType *next;
+};
+
+/**
+ * Checkpoint file:
+ *      header:  "RVCHKPT" magic, version, services count (4 bytes each)
+ *      service: [name size:4][name][state size:8][state][pages total:8]
+ *               [stored pages:8] and [page index:8][4 KB data] per stored
+ *               page, not stored pages are zero filled.
+ */
+static const char CHECKPOINT_FILE_MAGIC[8] = "RVCHKPT";
+static const uint32_t CHECKPOINT_FILE_VERSION = 1;
+
+class CmdSaveCheckpoint : public ICommand  {
+ public:
+    CmdSaveCheckpoint();
+    virtual ~CmdSaveCheckpoint();
+
+    /** ICommand */
+    virtual int isValid(AttributeType *args);
+    virtual void exec(AttributeType *args, AttributeType *res);
+
+    /** In-process snapshots keyed by the file name */
+    CheckpointSnapshotType *getSnapshot(const char *file);
+    void addSnapshot(CheckpointSnapshotType *p);
+
+ private:
+    bool writeFile(CheckpointSnapshotType *p);
+    void freeSnapshot(CheckpointSnapshotType *p);
+
+ private:
+    CheckpointSnapshotType *snapshots_;
+};
+
+class CmdRestoreCheckpoint : public ICommand  {
+ public:
+    explicit CmdRestoreCheckpoint(CmdSaveCheckpoint *save);
+
+    /** ICommand */
+    virtual int isValid(AttributeType *args);
+    virtual void exec(AttributeType *args, AttributeType *res);
+
+ private:
+    CheckpointSnapshotType *readFile(const char *file);
+
+ private:
+    CmdSaveCheckpoint *save_;
+};
+
+}  // namespace debugger
+
+#endif  // __DEBUGGER_CMD_CHECKPOINT_H__
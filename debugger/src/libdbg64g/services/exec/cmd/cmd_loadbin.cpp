@@ -16,10 +16,25 @@
 
 #include "iservice.h"
 #include "cmd_loadbin.h"
+#include "coreservices/icpufunctional.h"
 #include <iostream>
 
 namespace debugger {
 
+/** Decoded instructions of the previous image must be dropped */
+static void flushCpuCaches() {
+    AttributeType cpus;
+    IService *iserv;
+    ICpuFunctional *icpu;
+    RISCV_get_services_with_iface(IFACE_CPU_FUNCTIONAL, &cpus);
+    for (unsigned i = 0; i < cpus.size(); i++) {
+        iserv = static_cast<IService *>(cpus[i].to_iface());
+        icpu = static_cast<ICpuFunctional *>(
+                    iserv->getInterface(IFACE_CPU_FUNCTIONAL));
+        icpu->flush(~0ull);
+    }
+}
+
 CmdLoadBin::CmdLoadBin(uint64_t dmibar, ITap *tap)
     : ICommand("loadbin", dmibar, tap) {
 
@@ -43,7 +58,7 @@ int CmdLoadBin::isValid(AttributeType *args) {
 
 void CmdLoadBin::exec(AttributeType *args, AttributeType *res) {
     res->make_nil();
-    if (!isValid(args)) {
+    if (isValid(args) != CMD_VALID) {
         generateError(res, "Wrong argument list");
         return;
     }
@@ -62,8 +77,9 @@ void CmdLoadBin::exec(AttributeType *args, AttributeType *res) {
     fclose(fp);
 
     uint64_t addr = (*args)[2].to_uint64();
-    tap_->write(addr, sz, image);
+    dma_write(addr, sz, image);
     delete [] image;
+    flushCpuCaches();
 }
 
 }  // namespace debugger
@@ -17,10 +17,25 @@
 #include "iservice.h"
 #include "cmd_loadelf.h"
 #include "coreservices/ielfreader.h"
+#include "coreservices/icpufunctional.h"
 #include "debug/dsumap.h"
 
 namespace debugger {
 
+/** Decoded instructions of the previous image must be dropped */
+static void flushCpuCaches() {
+    AttributeType cpus;
+    IService *iserv;
+    ICpuFunctional *icpu;
+    RISCV_get_services_with_iface(IFACE_CPU_FUNCTIONAL, &cpus);
+    for (unsigned i = 0; i < cpus.size(); i++) {
+        iserv = static_cast<IService *>(cpus[i].to_iface());
+        icpu = static_cast<ICpuFunctional *>(
+                    iserv->getInterface(IFACE_CPU_FUNCTIONAL));
+        icpu->flush(~0ull);
+    }
+}
+
 CmdLoadElf::CmdLoadElf(uint64_t dmibar, ITap *tap)
     : ICommand("loadelf", dmibar, tap) {
 
@@ -76,19 +91,28 @@ void CmdLoadElf::exec(AttributeType *args, AttributeType *res) {
         return;
     }
 
-    Reg64Type t1;
-    t1.val = 0;
-    t1.bits.b1 = 1; // ndmreset
-    uint64_t addr = DSUREGBASE(ulocal.v.dmcontrol);
-    tap_->write(addr, 8, t1.buf);
+    if (tap_) {
+        Reg64Type t1;
+        t1.val = 0;
+        t1.bits.b1 = 1; // ndmreset
+        uint64_t addr = DSUREGBASE(ulocal.v.dmcontrol);
+        tap_->write(addr, 8, t1.buf);
+    }
 
     uint64_t sec_addr;
     int sec_sz;
     for (unsigned i = 0; i < elf->loadableSectionTotal(); i++) {
         sec_addr = elf->sectionAddress(i);
         sec_sz = static_cast<int>(elf->sectionSize(i));
-        tap_->write(sec_addr, sec_sz, elf->sectionData(i));
+        if (tap_) {
+            tap_->write(sec_addr, sec_sz, elf->sectionData(i));
+        } else if (dma_write(sec_addr, sec_sz,
+                             elf->sectionData(i)) != TRANS_OK) {
+            generateError(res, "Section write error");
+            return;
+        }
     }
+    flushCpuCaches();
 
     //soft_reset = 0;
     //tap_->write(addr, 8, reinterpret_cast<uint8_t *>(&soft_reset));
@@ -32,6 +32,7 @@
 #include "cmd/cmd_loadbin.h"
 #include "cmd/cmd_elf2raw.h"
 #include "cmd/cmd_cpucontext.h"
+#include "cmd/cmd_checkpoint.h"
 
 namespace debugger {
 
@@ -70,8 +71,10 @@ void CmdExecutor::postinitService() {
     tcmd->enableDMA(ibus_, dmibar_.to_uint64());
     registerCommand(new CmdElf2Raw(dmibar_.to_uint64(), 0));
     registerCommand(new CmdExit(dmibar_.to_uint64(), 0));
-    registerCommand(new CmdLoadBin(dmibar_.to_uint64(), 0));
-    registerCommand(new CmdLoadElf(dmibar_.to_uint64(), 0));
+    registerCommand(tcmd = new CmdLoadBin(dmibar_.to_uint64(), 0));
+    tcmd->enableDMA(ibus_, dmibar_.to_uint64());
+    registerCommand(tcmd = new CmdLoadElf(dmibar_.to_uint64(), 0));
+    tcmd->enableDMA(ibus_, dmibar_.to_uint64());
     registerCommand(new CmdLoadH86(dmibar_.to_uint64(), 0));
     registerCommand(new CmdLoadSrec(dmibar_.to_uint64(), 0));
     registerCommand(new CmdLog(dmibar_.to_uint64(), 0));
@@ -79,6 +82,9 @@ void CmdExecutor::postinitService() {
     registerCommand(tcmd = new CmdRead(dmibar_.to_uint64(), 0));
     tcmd->enableDMA(ibus_, dmibar_.to_uint64());
     registerCommand(new CmdReset(dmibar_.to_uint64(), 0));
+    CmdSaveCheckpoint *psave = new CmdSaveCheckpoint();
+    registerCommand(psave);
+    registerCommand(new CmdRestoreCheckpoint(psave));
     registerCommand(new CmdStack(dmibar_.to_uint64(), 0));
     registerCommand(new CmdSymb(dmibar_.to_uint64(), 0));
     registerCommand(tcmd = new CmdWrite(dmibar_.to_uint64(), 0));
@@ -48,5 +48,14 @@ ETransStatus MemoryLUT::b_transport(Axi4TransactionType *trans) {
     return itarget_->b_transport(trans);
 }
 
+ETransStatus MemoryLUT::b_burst(Axi4BurstType *burst) {
+    if (!itarget_) {
+        return TRANS_ERROR;
+    }
+    uint64_t off = burst->addr - getBaseAddress();
+    burst->addr = memOffset_.to_uint64() + off;
+    return itarget_->b_burst(burst);
+}
+
 }  // namespace debugger
 
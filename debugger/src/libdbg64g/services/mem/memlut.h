@@ -33,6 +33,7 @@ class MemoryLUT : public IService,
 
     /** IMemoryOperation */
     virtual ETransStatus b_transport(Axi4TransactionType *trans);
+    virtual ETransStatus b_burst(Axi4BurstType *burst);
 
  private:
     AttributeType memTarget_;
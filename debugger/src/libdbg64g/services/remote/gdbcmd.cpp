@@ -103,6 +103,9 @@ void GdbCommands::handlePacket(char *data) {
     case '?':   // Stop reason query.
         handleStopReasonQuery();
         break;
+    case 'b' :  // Backward step or continue.
+        handleReverse();
+        break;
     case 'c' :  // Continue (at addr)
     case 'C' :  // Continue with signal.
         handleContinue();
@@ -215,7 +218,8 @@ void GdbCommands::handleQuery() {
         /* Report a list of the features we support.
          * 1000h == 4096
          * 500h  == 1280 */
-        sendPacket("PacketSize=500;QStartNoAckMode+;vContSupported+");
+        sendPacket("PacketSize=500;QStartNoAckMode+;vContSupported+;"
+                   "qXfer:flightrec:read+;ReverseStep+;ReverseContinue+");
         //QNonStop+
     } else if (strncmp("qSymbol:", packet_data_, strlen("qSymbol:")) == 0) {
         /* Offer to look up symbols. Ignore for now */
@@ -230,8 +234,12 @@ void GdbCommands::handleQuery() {
     } else if (strncmp("qTStatus", packet_data_, strlen("qTStatus")) == 0) {
         /* Don't support tracing, return empty packet. */
         sendPacket("");
+    } else if (strncmp("qXfer:flightrec:read:", packet_data_,
+                        strlen("qXfer:flightrec:read:")) == 0) {
+        /* Simulator specific object: flight recorder of the CPU */
+        handleXferFlightRec(&packet_data_[strlen("qXfer:flightrec:read:")]);
     } else if (strncmp("qXfer:", packet_data_, strlen("qXfer:")) == 0) {
-        /* No 'qXfer' requests supported, return empty packet. */
+        /* Other 'qXfer' objects aren't supported, return empty packet. */
         sendPacket("");
     } else {
         RISCV_error("Unrecognized RSP query: %s \n", packet_data_);
@@ -239,6 +247,69 @@ void GdbCommands::handleQuery() {
     }
 }
 
+/**
+ * qXfer:flightrec:read:annex:offset,length
+ *      annex is the optional CPU name. Text of the 'flightrec' command output
+ *      (one record per line) is generated on the zero offset and then read
+ *      by chunks. Reply 'm' means more data, 'l' is the last chunk.
+ */
+void GdbCommands::handleXferFlightRec(const char *args) {
+    char annex[64];
+    unsigned offset, len;
+    unsigned i = 0;
+    while (args[i] && args[i] != ':' && i < sizeof(annex) - 1) {
+        annex[i] = args[i];
+        i++;
+    }
+    annex[i] = '\0';
+    if (args[i] != ':'
+        || RISCV_sscanf(&args[i + 1], "%x,%x", &offset, &len) != 2) {
+        sendPacket("E00");
+        return;
+    }
+
+    if (offset == 0) {
+        AttributeType res;
+        char tstr[128];
+        RISCV_sprintf(tstr, sizeof(tstr), "flightrec %s", annex);
+        xferData_.make_string("");
+        if (iexec_) {
+            iexec_->exec(tstr, &res, false);
+        }
+        if (!res.is_list() || (res.size() && !res[0u].is_list())) {
+            sendPacket("E01");
+            return;
+        }
+        std::string text;
+        for (unsigned n = 0; n < res.size(); n++) {
+            text += res[n].to_config().to_string();
+            text += "\n";
+        }
+        xferData_.make_string(text.c_str());
+    }
+
+    const char *p = xferData_.to_string();
+    unsigned total = xferData_.size();
+    char reply[DATA_MAX + 2];
+    unsigned maxsz = len < DATA_MAX ? len : DATA_MAX;
+    unsigned sz = 1;
+    reply[0] = 'l';
+    // Binary data: '#', '$', '}' and '*' are escaped
+    while (offset < total && sz + 2 <= maxsz) {
+        char c = p[offset++];
+        if (c == '#' || c == '$' || c == '}' || c == '*') {
+            reply[sz++] = '}';
+            c ^= 0x20;
+        }
+        reply[sz++] = c;
+    }
+    reply[sz] = '\0';
+    if (offset < total) {
+        reply[0] = 'm';
+    }
+    sendPacket(reply);
+}
+
 void GdbCommands::handleStopReasonQuery() {
     sendPacket("S05");
 }
@@ -255,6 +326,30 @@ void GdbCommands::handleContinue() {
     sendPacket("S05");
 }
 
+/**
+ * 'bs' and 'bc' packets. Reaching the start of the recorded history is
+ * reported with the 'replaylog' stop reason.
+ */
+void GdbCommands::handleReverse() {
+    AttributeType res;
+    if (!iexec_ || (packet_data_[1] != 's' && packet_data_[1] != 'c')) {
+        sendPacket("E01");
+        return;
+    }
+    if (packet_data_[1] == 's') {
+        iexec_->exec("reverse step 1", &res, false);
+    } else {
+        iexec_->exec("reverse continue", &res, false);
+    }
+    if (!res.is_list() || res.size() != 3 || !res[0u].is_integer()) {
+        sendPacket("E01");
+    } else if (res[2].to_int()) {
+        sendPacket("T05replaylog:begin;");
+    } else {
+        sendPacket("S05");
+    }
+}
+
 void GdbCommands::handleDetach() {
     /* Reply "OK" to GDB and close socket. */
     sendPacket("OK");
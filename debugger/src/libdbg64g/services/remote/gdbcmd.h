@@ -18,6 +18,7 @@
 #define __DEBUGGER_SERVICES_REMOTE_GDBCMD_H__
 
 #include "tcpcmd_gen.h"
+#include <string>
 
 namespace debugger {
 
@@ -65,6 +66,7 @@ class GdbCommands : public TcpCommandsGen {
     // RSP packet handlers
     void handleStopReasonQuery();
     void handleContinue();
+    void handleReverse();
     void handleDetach();
     void handleGetRegisters();
     void handleSetRegisters();
@@ -81,6 +83,7 @@ class GdbCommands : public TcpCommandsGen {
     void handleVCommand();
     void handleWriteMemory();
     void handleBreakpoint();
+    void handleXferFlightRec(const char *args);
 
     void appendRegValue(char *s, uint32_t value);
 
@@ -89,6 +92,7 @@ class GdbCommands : public TcpCommandsGen {
     //bool is_ack_mode;
     //bool last_success_;
     char packet_data_[1 << 16];
+    AttributeType xferData_;        // qXfer object read by chunks
     enum EState {
         State_AckMode,
         State_WaitAckToSwitch,
@@ -32,6 +32,10 @@ TcpServer::TcpServer(const char *name) : IService(name) {
 }
 
 void TcpServer::postinitService() {
+    if (!isEnable_.to_bool()) {
+        // Host port stays free for other instances (farm mode)
+        return;
+    }
     createServerSocket();
 
     if (listen(hsock_, 1) < 0)  {
@@ -44,11 +48,9 @@ void TcpServer::postinitService() {
         setBlockingMode(false);
     }
 
-    if (isEnable_.to_bool()) {
-        if (!run()) {
-            RISCV_error("Can't create thread.", NULL);
-            return;
-        }
+    if (!run()) {
+        RISCV_error("Can't create thread.", NULL);
+        return;
     }
 }
 
@@ -0,0 +1,92 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "cmd_smp.h"
+#include "quantum.h"
+
+namespace debugger {
+
+CmdSmp::CmdSmp(QuantumSync *isync)
+    : ICommand("smp", 0, 0) {
+
+    briefDescr_.make_string("Multi-hart run control and statistic");
+    detailedDescr_.make_string(
+        "Description:\n"
+        "    Resume or halt all harts attached to the quantum synchronizer\n"
+        "    at once, or read the synchronization statistic.\n"
+        "Usage:\n"
+        "    smp [go|halt]\n"
+        "Output format:\n"
+        "    [w,d,[s0,s1,..]]\n"
+        "         w - Total number of the passed windows (int64_t).\n"
+        "         d - Aggregate MIPS since previous call (double).\n"
+        "         sN - Step counter of the hart N (int64_t).\n"
+        "Example:\n"
+        "    smp go\n"
+        "    smp\n");
+
+    isync_ = isync;
+    lastSteps_ = 0;
+    lastTime_ = RISCV_get_time_ms();
+}
+
+int CmdSmp::isValid(AttributeType *args) {
+    if (!cmdName_.is_equal((*args)[0u].to_string())) {
+        return CMD_INVALID;
+    }
+    if (args->size() == 1) {
+        return CMD_VALID;
+    }
+    if (args->size() == 2 && ((*args)[1].is_equal("go")
+                          || (*args)[1].is_equal("halt"))) {
+        return CMD_VALID;
+    }
+    return CMD_WRONG_ARGS;
+}
+
+void CmdSmp::exec(AttributeType *args, AttributeType *res) {
+    res->attr_free();
+    res->make_nil();
+    if (args->size() == 2) {
+        if ((*args)[1].is_equal("go")) {
+            isync_->resumeAll();
+        } else {
+            isync_->haltAll();
+        }
+        return;
+    }
+
+    int total = isync_->getHartTotal();
+    uint64_t steps = 0;
+    uint64_t t = RISCV_get_time_ms();
+    uint64_t dt = t - lastTime_;
+    if (dt == 0) {
+        dt = 1;
+    }
+    res->make_list(3);
+    (*res)[0u].make_uint64(isync_->getWindowCount());
+    (*res)[2].make_list(total);
+    for (int i = 0; i < total; i++) {
+        (*res)[2][i].make_uint64(isync_->getHartStep(i));
+        steps += isync_->getHartStep(i);
+    }
+    (*res)[1].make_floating(static_cast<double>(steps - lastSteps_)
+                            / (1000.0 * dt));
+    lastSteps_ = steps;
+    lastTime_ = t;
+}
+
+}  // namespace debugger
@@ -0,0 +1,222 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <api_core.h>
+#include <string.h>
+#include "quantum.h"
+#include "cmd_smp.h"
+
+namespace debugger {
+
+QuantumSync::QuantumSync(const char *name) : IService(name) {
+    registerInterface(static_cast<IQuantumSync *>(this));
+    registerAttribute("Quantum", &quantum_);
+    registerAttribute("Deterministic", &deterministic_);
+    registerAttribute("CmdExecutor", &cmdexec_);
+
+    quantum_.make_uint64(10000);
+    deterministic_.make_boolean(false);
+
+    RISCV_mutex_init(&mutex_);
+    memset(harts_, 0, sizeof(harts_));
+    icmdexec_ = 0;
+    pcmd_ = 0;
+    hartTotal_ = 0;
+    turn_ = -1;
+    quantumSteps_ = 0;
+    windowEnd_ = 0;
+    windowCnt_ = 0;
+}
+
+QuantumSync::~QuantumSync() {
+    for (int i = 0; i < hartTotal_; i++) {
+        RISCV_event_close(&harts_[i].ev);
+    }
+    RISCV_mutex_destroy(&mutex_);
+}
+
+void QuantumSync::postinitService() {
+    quantumSteps_ = quantum_.to_uint64();
+    if (quantumSteps_ == 0) {
+        quantumSteps_ = 1;
+    }
+    windowEnd_ = quantumSteps_;
+
+    icmdexec_ = static_cast<ICmdExecutor *>(
+       RISCV_get_service_iface(cmdexec_.to_string(), IFACE_CMD_EXECUTOR));
+    if (!icmdexec_) {
+        RISCV_error("ICmdExecutor interface '%s' not found",
+                    cmdexec_.to_string());
+        return;
+    }
+    pcmd_ = new CmdSmp(this);
+    icmdexec_->registerCommand(pcmd_);
+}
+
+void QuantumSync::predeleteService() {
+    if (icmdexec_ && pcmd_) {
+        icmdexec_->unregisterCommand(pcmd_);
+        delete pcmd_;
+    }
+}
+
+int QuantumSync::attachHart(IService *isrv) {
+    HartType *h;
+    int ret = -1;
+    RISCV_mutex_lock(&mutex_);
+    if (hartTotal_ < QUANTUM_HART_MAX) {
+        ret = hartTotal_++;
+        h = &harts_[ret];
+        h->name = isrv->getObjName();
+        h->idport = static_cast<IDPort *>(isrv->getInterface(IFACE_DPORT));
+        h->step = 0;
+        h->offset = 0;
+        h->active = false;
+        RISCV_event_create(&h->ev, "quantum_hart");
+    } else {
+        RISCV_error("Harts limit %d reached", QUANTUM_HART_MAX);
+    }
+    RISCV_mutex_unlock(&mutex_);
+    return ret;
+}
+
+uint64_t QuantumSync::syncQuantum(int idx, uint64_t step, bool active) {
+    HartType *h = &harts_[idx];
+    uint64_t ret = 0;
+
+    RISCV_mutex_lock(&mutex_);
+    RISCV_event_clear(&h->ev);
+    if (active && !h->active) {
+        joinHart(h, step + h->offset);
+    }
+    h->step = step + h->offset;
+
+    if (!active || h->step >= windowEnd_) {
+        if (!active) {
+            h->active = false;
+            ret = ~0ull;
+        }
+        if (turn_ == idx) {
+            turn_ = -1;
+            notifyAll();
+        }
+        advanceWindow();
+    }
+    if (active && h->step < windowEnd_ && isTurnOf(idx)) {
+        ret = windowEnd_ - h->offset;
+    }
+    RISCV_mutex_unlock(&mutex_);
+    return ret;
+}
+
+void QuantumSync::waitQuantum(int idx, int ms) {
+    RISCV_event_wait_ms(&harts_[idx].ev, ms);
+}
+
+/**
+ * Resume all halted harts at once, so that the deterministic run doesn't
+ * depend on the order of the debugger commands.
+ */
+void QuantumSync::resumeAll() {
+    HartType *h;
+    RISCV_mutex_lock(&mutex_);
+    for (int i = 0; i < hartTotal_; i++) {
+        h = &harts_[i];
+        if (!h->idport || !h->idport->isHalted()) {
+            continue;
+        }
+        if (!h->active) {
+            joinHart(h, h->step);
+        }
+        h->idport->resumereq();
+    }
+    notifyAll();
+    RISCV_mutex_unlock(&mutex_);
+}
+
+void QuantumSync::haltAll() {
+    for (int i = 0; i < hartTotal_; i++) {
+        if (harts_[i].idport && !harts_[i].idport->isHalted()) {
+            harts_[i].idport->haltreq();
+        }
+    }
+}
+
+/**
+ * Hart that was halted while others run continues from the current window
+ * start instead of holding all others until it catches up.
+ */
+void QuantumSync::joinHart(HartType *h, uint64_t t) {
+    bool any = false;
+    for (int i = 0; i < hartTotal_; i++) {
+        any |= harts_[i].active;
+    }
+    if (t + quantumSteps_ < windowEnd_) {
+        h->offset += windowEnd_ - quantumSteps_ - t;
+        h->step = windowEnd_ - quantumSteps_;
+    } else if (!any && t >= windowEnd_) {
+        windowEnd_ = (t / quantumSteps_ + 1) * quantumSteps_;
+    }
+    h->active = true;
+}
+
+void QuantumSync::advanceWindow() {
+    uint64_t tmin = ~0ull;
+    for (int i = 0; i < hartTotal_; i++) {
+        if (!harts_[i].active) {
+            continue;
+        }
+        if (harts_[i].step < windowEnd_) {
+            return;
+        }
+        if (harts_[i].step < tmin) {
+            tmin = harts_[i].step;
+        }
+    }
+    if (tmin == ~0ull) {
+        return;
+    }
+    windowEnd_ = (tmin / quantumSteps_ + 1) * quantumSteps_;
+    windowCnt_++;
+    notifyAll();
+}
+
+void QuantumSync::notifyAll() {
+    for (int i = 0; i < hartTotal_; i++) {
+        RISCV_event_set(&harts_[i].ev);
+    }
+}
+
+/**
+ * In deterministic mode harts execute the window one by one in the order
+ * of attachment, otherwise all of them run in parallel.
+ */
+bool QuantumSync::isTurnOf(int idx) {
+    if (!deterministic_.to_bool()) {
+        return true;
+    }
+    if (turn_ < 0) {
+        for (int i = 0; i < hartTotal_; i++) {
+            if (harts_[i].active && harts_[i].step < windowEnd_) {
+                turn_ = i;
+                break;
+            }
+        }
+    }
+    return turn_ == idx;
+}
+
+}  // namespace debugger
@@ -0,0 +1,89 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef __DEBUGGER_SRC_LIBDBG64G_SERVICES_SYNC_QUANTUM_H__
+#define __DEBUGGER_SRC_LIBDBG64G_SERVICES_SYNC_QUANTUM_H__
+
+#include "iclass.h"
+#include "iservice.h"
+#include "coreservices/iquantum.h"
+#include "coreservices/idport.h"
+#include "coreservices/icmdexec.h"
+
+namespace debugger {
+
+static const int QUANTUM_HART_MAX = 64;
+
+class QuantumSync : public IService,
+                    public IQuantumSync {
+ public:
+    explicit QuantumSync(const char *name);
+    virtual ~QuantumSync();
+
+    /** IService interface */
+    virtual void postinitService() override;
+    virtual void predeleteService() override;
+
+    /** IQuantumSync */
+    virtual int attachHart(IService *isrv) override;
+    virtual uint64_t syncQuantum(int idx, uint64_t step, bool active) override;
+    virtual void waitQuantum(int idx, int ms) override;
+
+    /** Common methods */
+    void resumeAll();
+    void haltAll();
+    int getHartTotal() { return hartTotal_; }
+    const char *getHartName(int idx) { return harts_[idx].name; }
+    uint64_t getHartStep(int idx) { return harts_[idx].step; }
+    uint64_t getWindowCount() { return windowCnt_; }
+
+ private:
+    struct HartType {
+        const char *name;
+        IDPort *idport;
+        uint64_t step;      // last reported step, global time units
+        uint64_t offset;    // hart step counter to the global time
+        bool active;
+        event_def ev;
+    };
+
+    void joinHart(HartType *h, uint64_t t);
+    void advanceWindow();
+    void notifyAll();
+    bool isTurnOf(int idx);
+
+ private:
+    AttributeType quantum_;
+    AttributeType deterministic_;
+    AttributeType cmdexec_;
+
+    ICmdExecutor *icmdexec_;
+    ICommand *pcmd_;
+
+    mutex_def mutex_;
+    HartType harts_[QUANTUM_HART_MAX];
+    int hartTotal_;
+    int turn_;                  // deterministic mode: running hart or -1
+    uint64_t quantumSteps_;
+    uint64_t windowEnd_;        // global time where all active harts meet
+    uint64_t windowCnt_;
+};
+
+DECLARE_CLASS(QuantumSync)
+
+}  // namespace debugger
+
+#endif  // __DEBUGGER_SRC_LIBDBG64G_SERVICES_SYNC_QUANTUM_H__
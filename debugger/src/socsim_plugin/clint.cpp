@@ -28,6 +28,16 @@ CLINT::CLINT(const char *name) : RegMemBankGeneric(name),
     registerInterface(static_cast<IIrqController *>(this));
     registerAttribute("Clock", &clock_);
     update_time_ = 0;
+    iclk_ = 0;
+    hartTotal_ = 0;
+    irqmask_ = new IrqPendingBitType[2*CLINT_HART_MAX];
+    memset(irqmask_, 0, 2*CLINT_HART_MAX*sizeof(IrqPendingBitType));
+    RISCV_mutex_init(&mutex_);
+}
+
+CLINT::~CLINT() {
+    delete [] irqmask_;
+    RISCV_mutex_destroy(&mutex_);
 }
 
 void CLINT::postinitService() {
@@ -39,21 +49,27 @@ void CLINT::postinitService() {
     if (!iclk_) {
         RISCV_error("Can't get IClock interface %s",
                     clock_.to_string());
+        return;
     }
+    updateTimerRequests();
 }
 
 void CLINT::setTimer(uint64_t v) {
+    RISCV_mutex_lock(&mutex_);
     update_time_ = iclk_->getStepCounter();
     mtime.setValue(v);
+    RISCV_mutex_unlock(&mutex_);
 }
 
 void CLINT::updateTimer() {
+    RISCV_mutex_lock(&mutex_);
     uint64_t cur_time = iclk_->getStepCounter();
     uint64_t dt = cur_time - update_time_;
     uint64_t t = mtime.getValue().val;
 
     update_time_ = cur_time;
     mtime.setValue(t + dt);
+    RISCV_mutex_unlock(&mutex_);
 }
 
 int CLINT::getPendingRequest(int ctxid) {
@@ -80,6 +96,110 @@ int CLINT::getPendingRequest(int ctxid) {
     return ret;
 }
 
+bool CLINT::registerPendingMask(int ctxid, std::atomic<uint64_t> *pmask,
+                                int bitidx) {
+    if (ctxid < 0 || ctxid >= 2*(CLINT_HART_MAX - 1)) {
+        return false;
+    }
+    irqmask_[ctxid].pmask = pmask;
+    irqmask_[ctxid].bit = 1ull << bitidx;
+    if (ctxid / 2 >= hartTotal_) {
+        hartTotal_ = ctxid / 2 + 1;
+    }
+    if (ctxid & 0x1) {
+        // mtimecmp is zero before the first write, so the request is
+        // active until the clock is connected
+        irqmask_[ctxid].setLevel(true);
+        if (iclk_) {
+            updateTimerRequests();
+        }
+    } else {
+        updateSoftwareRequest(ctxid / 2);
+    }
+    return true;
+}
+
+void CLINT::saveState(CheckpointState *state) {
+    RegMemBankGeneric::saveState(state);
+    state->write64(update_time_);
+}
+
+/**
+ * Clock of the harts could be not restored yet, so the levels are computed
+ * from the stored mtime value. Timer event is restored by the clock owner.
+ */
+bool CLINT::restoreState(CheckpointState *state) {
+    if (!RegMemBankGeneric::restoreState(state)) {
+        return false;
+    }
+    RISCV_mutex_lock(&mutex_);
+    update_time_ = state->read64();
+    uint64_t t = mtime.getValue().val;
+    for (int i = 0; i < hartTotal_; i++) {
+        irqmask_[2*i].setLevel(msip.getp()[i].bits.b0 != 0);
+        irqmask_[2*i + 1].setLevel(t >= mtimecmp.getp()[i].val);
+    }
+    RISCV_mutex_unlock(&mutex_);
+    return true;
+}
+
+void CLINT::updateSoftwareRequest(int hartid) {
+    irqmask_[2*hartid].setLevel(msip.getp()[hartid].bits.b0 != 0);
+}
+
+/**
+ * Update timer requests levels of all subscribed harts and schedule
+ * callback on the step when mtime reaches the nearest mtimecmp.
+ */
+void CLINT::updateTimerRequests() {
+    uint64_t dt = ~0ull;
+    uint64_t t;
+    uint64_t cmp;
+
+    RISCV_mutex_lock(&mutex_);
+    updateTimer();
+    t = mtime.getValue().val;
+    for (int i = 0; i < hartTotal_; i++) {
+        if (irqmask_[2*i + 1].pmask == 0) {
+            continue;
+        }
+        cmp = mtimecmp.getp()[i].val;
+        if (t >= cmp) {
+            irqmask_[2*i + 1].setLevel(true);
+        } else {
+            irqmask_[2*i + 1].setLevel(false);
+            if ((cmp - t) < dt) {
+                dt = cmp - t;
+            }
+        }
+    }
+    if (dt != ~0ull) {
+        iclk_->moveStepCallback(static_cast<IClockListener *>(this),
+                                update_time_ + dt);
+    }
+    RISCV_mutex_unlock(&mutex_);
+}
+
+void CLINT::stepCallback(uint64_t t) {
+    updateTimerRequests();
+}
+
+void CLINT::CLINT_MSIP_TYPE::write(int idx, uint32_t val) {
+    CLINT *p = static_cast<CLINT *>(parent_);
+    GenericReg32Bank::write(idx, val);
+    if (idx < p->hartTotal_) {
+        p->updateSoftwareRequest(idx);
+    }
+}
+
+void CLINT::CLINT_MTIMECMP_TYPE::write(int idx, uint64_t val) {
+    CLINT *p = static_cast<CLINT *>(parent_);
+    GenericReg64Bank::write(idx, val);
+    if (idx < p->hartTotal_ && p->iclk_) {
+        p->updateTimerRequests();
+    }
+}
+
 uint64_t CLINT::CLINT_MTIME_TYPE::aboutToRead(uint64_t cur_val) {
     CLINT *p = static_cast<CLINT *>(parent_);
     p->updateTimer();
@@ -90,6 +210,9 @@ uint64_t CLINT::CLINT_MTIME_TYPE::aboutToRead(uint64_t cur_val) {
 uint64_t CLINT::CLINT_MTIME_TYPE::aboutToWrite(uint64_t new_val) {
     CLINT *p = static_cast<CLINT *>(parent_);
     p->setTimer(new_val);
+    if (p->iclk_) {
+        p->updateTimerRequests();
+    }
     return new_val;
 }
 
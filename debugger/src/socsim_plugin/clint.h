@@ -29,9 +29,11 @@ namespace debugger {
 static const int CLINT_HART_MAX = 4096;
 
 class CLINT : public RegMemBankGeneric,
-              public IIrqController {
+              public IIrqController,
+              public IClockListener {
  public:
     explicit CLINT(const char *name);
+    virtual ~CLINT();
 
     /** IService interface */
     virtual void postinitService() override;
@@ -39,10 +41,21 @@ class CLINT : public RegMemBankGeneric,
     /** IIrqController */
     virtual int requestInterrupt(IFace *isrc, int idx) { return 0; }
     virtual int getPendingRequest(int ctxid);
+    virtual bool registerPendingMask(int ctxid, std::atomic<uint64_t> *pmask,
+                                     int bitidx) override;
+
+    /** IClockListener: mtime reached the nearest mtimecmp */
+    virtual void stepCallback(uint64_t t) override;
+
+    /** ICheckpoint: interrupt levels follow the restored registers */
+    virtual void saveState(CheckpointState *state) override;
+    virtual bool restoreState(CheckpointState *state) override;
 
  private:
     void setTimer(uint64_t v);
     void updateTimer();
+    void updateSoftwareRequest(int hartid);
+    void updateTimerRequests();
 
  private:
 
@@ -50,6 +63,8 @@ class CLINT : public RegMemBankGeneric,
      public:
         CLINT_MSIP_TYPE(IService *parent, const char *name, uint64_t addr)
             : GenericReg32Bank(parent, name, addr, CLINT_HART_MAX) {}
+
+        virtual void write(int idx, uint32_t val) override;
     };
 
     class CLINT_MTIMECMP_TYPE : public GenericReg64Bank {
@@ -58,6 +73,8 @@ class CLINT : public RegMemBankGeneric,
             : GenericReg64Bank(parent, name, addr, CLINT_HART_MAX - 1) {
             // shouldn't be reset on reset signal
         }
+
+        virtual void write(int idx, uint64_t val) override;
     };
 
     class CLINT_MTIME_TYPE : public MappedReg64Type {
@@ -79,6 +96,11 @@ class CLINT : public RegMemBankGeneric,
     CLINT_MTIME_TYPE mtime;          // [00bff8] 1 register for all hart
 
     uint64_t update_time_;          // Last time when mtime was updated
+
+    // Subscribed CPU pending masks: [2*hartid] software, [2*hartid+1] timer
+    IrqPendingBitType *irqmask_;
+    int hartTotal_;                 // max. subscribed hart index + 1
+    mutex_def mutex_;               // accessed from all harts threads
 };
 
 DECLARE_CLASS(CLINT)
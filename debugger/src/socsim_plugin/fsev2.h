@@ -21,6 +21,7 @@ public:
 
     /** IMemoryOperation */
     virtual ETransStatus b_transport(Axi4TransactionType *trans);
+    virtual bool isSerialized() { return true; }
 
 private:
     static const int FSE2_CHAN_MAX = 32;
@@ -28,6 +28,7 @@ public:
 
     /** IMemoryOperation */
     virtual ETransStatus b_transport(Axi4TransactionType *trans);
+    virtual bool isSerialized() { return true; }
 
     /** IClockListener */
     virtual void stepCallback(uint64_t t);
@@ -32,6 +32,8 @@ PLIC::PLIC(const char *name) : RegMemBankGeneric(name),
     ctx_enable = 0;
     ctx_priority_th = 0;
     ctx_claim = 0;
+    irqmask_ = 0;
+    RISCV_mutex_init(&mutex_);
 }
 
 PLIC::~PLIC() {
@@ -45,6 +47,10 @@ PLIC::~PLIC() {
         delete [] ctx_priority_th;
         delete [] ctx_claim;
     }
+    if (irqmask_) {
+        delete [] irqmask_;
+    }
+    RISCV_mutex_destroy(&mutex_);
 }
 
 void PLIC::postinitService() {
@@ -57,6 +63,10 @@ void PLIC::postinitService() {
         ctx_enable = new PLIC_ENABLE_TYPE* [ctx_total];
         ctx_priority_th = new PLIC_CONTEXT_PRIOIRTY_TYPE* [ctx_total];
         ctx_claim = new PLIC_CLAIM_COMPLETE_TYPE* [ctx_total];
+        if (!irqmask_) {
+            irqmask_ = new IrqPendingBitType[ctx_total];
+            memset(irqmask_, 0, ctx_total*sizeof(IrqPendingBitType));
+        }
 
         for (unsigned i = 0; i < contextList_.size(); i++) {
             RISCV_sprintf(tstr, sizeof(tstr), "%s::enable",
@@ -96,6 +106,7 @@ int PLIC::getPendingRequest(int ctxid) {
 
     // Select the highest priority request;
     uint32_t tidx;
+    RISCV_mutex_lock(&mutex_);
     for (unsigned i = 0; i < pendingList_.size(); i++) {
         tidx = pendingList_[i].to_uint32();
         if (!isEnabled(tidx)) {
@@ -133,10 +144,73 @@ int PLIC::getPendingRequest(int ctxid) {
             }
         }
     }
+    RISCV_mutex_unlock(&mutex_);
 
     return irqidx;
 }
 
+/**
+ * CPU could subscribe before the contexts are created in postinit.
+ */
+bool PLIC::registerPendingMask(int ctxid, std::atomic<uint64_t> *pmask,
+                               int bitidx) {
+    if (ctxid < 0 || ctxid >= static_cast<int>(contextList_.size())) {
+        return false;
+    }
+    if (!irqmask_) {
+        irqmask_ = new IrqPendingBitType[contextList_.size()];
+        memset(irqmask_, 0,
+               contextList_.size()*sizeof(IrqPendingBitType));
+    }
+    irqmask_[ctxid].pmask = pmask;
+    irqmask_[ctxid].bit = 1ull << bitidx;
+    if (ctx_enable) {
+        updatePendingMask();
+    } else {
+        irqmask_[ctxid].setLevel(pendingList_.size() != 0);
+    }
+    return true;
+}
+
+bool PLIC::restoreState(CheckpointState *state) {
+    if (!RegMemBankGeneric::restoreState(state)) {
+        return false;
+    }
+    RISCV_mutex_lock(&mutex_);
+    pendingList_.make_list(0);
+    for (int i = 1; i < PLIC_GLOBAL_IRQ_MAX; i++) {
+        if (pending.getpR32()[i >> 5] & (1ul << (i & 0x1f))) {
+            pendingList_.new_list_item().make_int64(i);
+        }
+    }
+    updatePendingMask();
+    RISCV_mutex_unlock(&mutex_);
+    return true;
+}
+
+/** Re-evaluate requests of all contexts after pending/enable change */
+void PLIC::updatePendingMask() {
+    if (!irqmask_ || !ctx_enable) {
+        return;
+    }
+    for (unsigned i = 0; i < contextList_.size(); i++) {
+        irqmask_[i].setLevel(getPendingRequest(i) != IRQ_REQUEST_NONE);
+    }
+}
+
+/**
+ * Threshold is changed after aboutToWrite() call, so request is signalled
+ * if any interrupt is pending and CPU makes the final decision.
+ */
+void PLIC::setPendingMaskHint() {
+    if (!irqmask_ || pendingList_.size() == 0) {
+        return;
+    }
+    for (unsigned i = 0; i < contextList_.size(); i++) {
+        irqmask_[i].setLevel(true);
+    }
+}
+
 bool PLIC::isEnabled(uint32_t irqidx) {
     // Check bits [2:0]
     // A priority value of 0 is
@@ -170,6 +244,7 @@ bool PLIC::isUnmasked(uint32_t ctxid, uint32_t irqidx) {
 }
 
 void PLIC::setPendingBit(int idx) {
+    RISCV_mutex_lock(&mutex_);
     pending.getpR32()[idx >> 5] |= 1ul << (idx & 0x1f);
     bool add = true;
     for (unsigned i = 0; i < pendingList_.size(); i++) {
@@ -182,6 +257,8 @@ void PLIC::setPendingBit(int idx) {
     if (add) {
         pendingList_.new_list_item().make_int64(idx);
     }
+    updatePendingMask();
+    RISCV_mutex_unlock(&mutex_);
     RISCV_info("request Interrupt %d", idx);
 }
 
@@ -189,6 +266,7 @@ void PLIC::clearPendingBit(int idx) {
     if (idx == 0) {
         return;
     }
+    RISCV_mutex_lock(&mutex_);
     pending.getpR32()[idx >> 5] &= ~(1ul << (idx & 0x1f));
     for (unsigned i = 0; i < pendingList_.size(); i++) {
         if (pendingList_[i].to_int() == idx) {
@@ -196,6 +274,8 @@ void PLIC::clearPendingBit(int idx) {
             break;
         }
     }
+    updatePendingMask();
+    RISCV_mutex_unlock(&mutex_);
 }
 
 void PLIC::enableInterrupt(uint32_t ctxid, int idx) {
@@ -207,8 +287,11 @@ void PLIC::disableInterrupt(uint32_t ctxid, int idx) {
 }
 
 uint32_t PLIC::claim(unsigned ctxid) {
+    // Two harts shouldn't claim the same request
+    RISCV_mutex_lock(&mutex_);
     uint32_t irqidx = getPendingRequest(ctxid);
     clearPendingBit(irqidx);
+    RISCV_mutex_unlock(&mutex_);
     return irqidx;
 }
 
@@ -230,6 +313,13 @@ void PLIC::PLIC_ENABLE_TYPE::write(int idx, uint32_t val) {
             p->enableInterrupt(contextid_, 32*idx + i);
         }
     }
+    p->updatePendingMask();
+}
+
+uint32_t PLIC::PLIC_CONTEXT_PRIOIRTY_TYPE::aboutToWrite(uint32_t nxt_val) {
+    PLIC *p = static_cast<PLIC *>(parent_);
+    p->setPendingMaskHint();
+    return nxt_val;
 }
 
 uint32_t PLIC::PLIC_CLAIM_COMPLETE_TYPE::aboutToRead(uint32_t prv_val) {
@@ -39,6 +39,11 @@ class PLIC : public RegMemBankGeneric,
     /** IIrqController */
     virtual int requestInterrupt(IFace *isrc, int idx);
     virtual int getPendingRequest(int ctxid);
+    virtual bool registerPendingMask(int ctxid, std::atomic<uint64_t> *pmask,
+                                     int bitidx) override;
+
+    /** ICheckpoint: pending list is rebuilt from the pending bits */
+    virtual bool restoreState(CheckpointState *state) override;
 
     /** Controller specific methods visible for ports */
     void enableInterrupt(uint32_t ctxid, int idx);
@@ -47,6 +52,8 @@ class PLIC : public RegMemBankGeneric,
     void complete(uint32_t ctxid, uint32_t idx);
     void setPendingBit(int idx);
     void clearPendingBit(int idx);
+    void updatePendingMask();
+    void setPendingMaskHint();
 
  private:
     bool isEnabled(uint32_t irqidx);
@@ -72,6 +79,7 @@ class PLIC : public RegMemBankGeneric,
 
         virtual void write(int idx, uint32_t val) override {
             GenericReg32Bank::write(idx, val & 0x7);
+            static_cast<PLIC *>(parent_)->updatePendingMask();
         }
     };
 
@@ -83,6 +91,8 @@ class PLIC : public RegMemBankGeneric,
         }
 
         uint32_t getContextPrioiry() { return getValue().val & 0x7; }
+     protected:
+        virtual uint32_t aboutToWrite(uint32_t nxt_val) override;
      protected:
         unsigned contextid_;
     };
@@ -109,6 +119,8 @@ class PLIC : public RegMemBankGeneric,
     PLIC_ENABLE_TYPE **ctx_enable;                  // [002000 + 0x80*n] 0..1023 1 bit per interrupt for context N
     PLIC_CONTEXT_PRIOIRTY_TYPE **ctx_priority_th;   // [200000 + 0x1000*N] priority threshold for context N
     PLIC_CLAIM_COMPLETE_TYPE **ctx_claim;           // [200004 + 0x1000*N] claim/complete for context N
+    IrqPendingBitType *irqmask_;                    // subscribed CPU per context
+    mutex_def mutex_;                               // harts run in own threads
 };
 
 DECLARE_CLASS(PLIC)
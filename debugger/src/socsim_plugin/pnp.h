@@ -28,6 +28,7 @@ public:
 
     /** IMemoryOperation */
     virtual ETransStatus b_transport(Axi4TransactionType *trans);
+    virtual bool isSerialized() { return true; }
 
 private:
     void addMaster(unsigned idx, unsigned vid, unsigned did);
@@ -34,6 +34,7 @@ class RfController : public IService,
 
     /** IMemoryOperation */
     virtual ETransStatus b_transport(Axi4TransactionType *trans);
+    virtual bool isSerialized() { return true; }
     
  private:
     AttributeType subsystemConfig_;
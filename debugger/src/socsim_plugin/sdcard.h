@@ -36,6 +36,7 @@ class SdCard : public IService,
 
     /** IMemoryOperation */
     virtual ETransStatus b_transport(Axi4TransactionType *trans);
+    virtual bool isSerialized() { return true; }
 
     /** ISlaveSPI */
     virtual size_t spiWrite(uint64_t addr, uint8_t *buf, size_t bufsz);
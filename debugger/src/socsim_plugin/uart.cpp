@@ -32,6 +32,7 @@ UART::UART(const char *name) : RegMemBankGeneric(name),
     fwcpuid_(static_cast<IService *>(this), "fwcpuid", 0x1C) {
     registerInterface(static_cast<ISerial *>(this));
     registerInterface(static_cast<IClockListener *>(this));
+    registerInterface(static_cast<IClockInput *>(this));
     registerAttribute("FifoSize", &fifoSize_);
     registerAttribute("IrqController", &irqctrl_);
     registerAttribute("IrqIdRx", &irqidrx_);
@@ -112,10 +113,19 @@ uint32_t UART::getScaler() {
 #endif
 }
 
+/**
+ * Called from the console or GUI threads, the clock decides the step when
+ * data is received so that the simulation could be re-executed.
+ */
 int UART::writeData(const char *buf, int sz) {
-    if (rxfifo_ == 0) {
+    if (rxfifo_ == 0 || !iclk_) {
         return 0;
     }
+    iclk_->postInput(static_cast<IClockInput *>(this), buf, sz);
+    return sz;
+}
+
+void UART::clockInput(const char *buf, int sz) {
     if (static_cast<uint32_t>(sz) > 
         (fifoSize_.to_uint32() - rx_total_)) {
         sz = (fifoSize_.to_uint32() - rx_total_);
@@ -133,7 +143,29 @@ int UART::writeData(const char *buf, int sz) {
         iirq_->requestInterrupt(static_cast<IService *>(this),
                               irqidrx_.to_int());
     }
-    return sz;
+}
+
+void UART::saveState(CheckpointState *state) {
+    RegMemBankGeneric::saveState(state);
+    state->write64(rx_total_);
+    state->write64(p_rx_wr_ - rxfifo_);
+    state->write64(p_rx_rd_ - rxfifo_);
+    state->write(rxfifo_, fifoSize_.to_uint64());
+    state->write64(tx_total_);
+}
+
+bool UART::restoreState(CheckpointState *state) {
+    if (!RegMemBankGeneric::restoreState(state)) {
+        return false;
+    }
+    rx_total_ = static_cast<uint32_t>(state->read64());
+    p_rx_wr_ = &rxfifo_[state->read64() % fifoSize_.to_uint64()];
+    p_rx_rd_ = &rxfifo_[state->read64() % fifoSize_.to_uint64()];
+    if (!state->read(rxfifo_, fifoSize_.to_uint64())) {
+        return false;
+    }
+    tx_total_ = static_cast<uint32_t>(state->read64());
+    return true;
 }
 
 void UART::registerRawListener(IFace *listener) {
@@ -186,6 +218,10 @@ void UART::stepCallback(uint64_t t) {
 void UART::putByte(char v) {
     char tbuf[2] = {v};
     uint64_t t = iclk_->getStepCounter();
+    if (iclk_->isReplay()) {
+        // Already sent when this step was executed first time
+        return;
+    }
     RISCV_info("[%" RV_PRI64 "d]Set data = %s", t, tbuf);
 
     RISCV_mutex_lock(&mutexListeners_);
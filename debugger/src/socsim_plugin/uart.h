@@ -71,7 +71,8 @@ class UartCmdType : public ICommand {
 
 class UART : public RegMemBankGeneric,
              public ISerial,
-             public IClockListener {
+             public IClockListener,
+             public IClockInput {
  public:
     explicit UART(const char *name);
     virtual ~UART();
@@ -91,6 +92,13 @@ class UART : public RegMemBankGeneric,
     /** IClockListener */
     virtual void stepCallback(uint64_t t);
 
+    /** IClockInput: received data is passed via clock */
+    virtual void clockInput(const char *buf, int sz);
+
+    /** ICheckpoint: registers and RX fifo */
+    virtual void saveState(CheckpointState *state);
+    virtual bool restoreState(CheckpointState *state);
+
     /** Common methods */
     uint32_t getScaler();
     int getFifoSize() { return fifoSize_.to_int(); }
@@ -0,0 +1,42 @@
+/*
+ *  Copyright 2018 Sergey Khabarov, sergeykhbr@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef __EXAMPLES_SIMBENCH_SRC_SIMBENCH_H__
+#define __EXAMPLES_SIMBENCH_SRC_SIMBENCH_H__
+
+/** SoC addresses of the functional River platform */
+#define CLINT_MSIP          0x02000000
+#define CLINT_MTIMECMP      0x02004000
+#define CLINT_MTIME         0x0200bff8
+#define UART0_TXDATA        0x10010000
+
+/** Exit code 'reg' is passed to the simulator through 'tohost' */
+.macro SIMBENCH_EXIT reg
+    slli \reg, \reg, 1
+    ori \reg, \reg, 1
+    la t6, tohost
+    sd \reg, 0(t6)
+1:  j 1b
+.endm
+
+/** HTIF mailbox polled by the simulator in batch mode */
+.macro SIMBENCH_TOHOST
+    .balign 8, 0
+tohost:
+    .dword 0
+.endm
+
+#endif  // __EXAMPLES_SIMBENCH_SRC_SIMBENCH_H__